@@ -0,0 +1,234 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BENCHFIXTURE_HPP
+#define BENCHFIXTURE_HPP
+
+// C Standard Libraries
+#include <stdlib.h> // mkdtemp
+#include <unistd.h> // unlink, rmdir
+#include <dirent.h> // opendir, readdir, closedir
+#include <cstring> // strcmp, strerror
+#include <cerrno>
+
+// C++ Standard Libraries
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept> // std::runtime_error
+
+/**
+ * BenchFixture class
+ * File: BenchFixture.hpp
+ * Purpose: Temporary directory for a benchmark (or check), with the config file and the (empty) hardware whitelist of a gateway.
+ *          The config has every required key; Scanning is off, so only the benchmark's own devices get added and real hardware is never touched.
+ *          Everything in the directory (e.g. the gateway's log, sockets or the devices' links) gets removed together with it, once the fixture gets destroyed.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+class BenchFixture
+{
+private:
+    // Variables
+    std::string directory;
+
+    /**
+     * Removes every file in the directory, and the directory itself.
+    */
+    void remove()
+    {
+        DIR * directoryStream = opendir( directory.c_str() );
+
+        if ( directoryStream != nullptr )
+        {
+            while ( dirent * entry = readdir( directoryStream ) )
+            {
+                if ( strcmp( entry->d_name, "." ) != 0 && strcmp( entry->d_name, ".." ) != 0 )
+                {
+                    unlink( getPath( entry->d_name ).c_str() );
+                }
+            }
+
+            closedir( directoryStream );
+        }
+
+        rmdir( directory.c_str() );
+    }
+
+public:
+    // Constructors
+    /**
+     * Constructor; Creates the directory "/tmp/spg-<name>-XXXXXX" and, unless createConfig is false, the config files in it.
+     * Throws std::runtime_error if the directory can't be created.
+     *
+     * @param name Name of the benchmark, e.g. "soak".
+     * @param configLines Lines "<KEY>=<value>"; Replace the default of the same key, or get appended.
+     * @param createConfig Whether the config file and the hardware whitelist get created.
+    */
+    BenchFixture( std::string name, std::vector<std::string> configLines = {}, bool createConfig = true )
+    {
+        std::string directoryTemplate = "/tmp/spg-" + name + "-XXXXXX";
+        std::vector<char> path( directoryTemplate.begin(), directoryTemplate.end() );
+        path.push_back( '\0' );
+
+        if ( mkdtemp( path.data() ) == nullptr )
+        {
+            throw std::runtime_error( "Couldn't create a temporary directory: " + std::string( strerror( errno ) ) );
+        }
+
+        this->directory = path.data();
+
+        if ( !createConfig )
+        {
+            return;
+        }
+
+        std::vector<std::string> lines = {
+            "LOGGING_ACTIVE=0",
+            "SCAN_INTERVAL=0",
+            "WAIT_BEFORE_COMMUNICATION=0",
+            "BAUD_RATE=115200",
+            "MESSAGE_DELIMITER=:",
+            "COMMAND_GETID=getid",
+            "MESSAGE_TYPE_ID=id",
+            "LOG_LEVEL=WARN"
+        };
+
+        for ( std::string const & configLine : configLines )
+        {
+            std::string key = configLine.substr( 0, configLine.find( '=' ) + 1 );
+            bool replaced = false;
+
+            for ( std::string & line : lines )
+            {
+                if ( line.compare( 0, key.length(), key ) == 0 )
+                {
+                    line = configLine;
+                    replaced = true;
+                }
+            }
+
+            if ( !replaced )
+            {
+                lines.push_back( configLine );
+            }
+        }
+
+        std::string config;
+
+        for ( std::string const & line : lines )
+        {
+            config += line + "\n";
+        }
+
+        writeFile( "config.cfg", config );
+        writeFile( "hardware-whitelist.txt", "" ); // Empty, so every device is allowed
+    }
+
+    BenchFixture( const BenchFixture & ) = delete;
+    BenchFixture & operator=( const BenchFixture & ) = delete;
+
+    // Destructor
+    ~BenchFixture()
+    {
+        remove();
+    }
+
+    // Methods
+    /**
+     * Gets the path of the directory.
+     *
+     * @return Path of the directory.
+    */
+    std::string getDirectory()
+    {
+        return this->directory;
+    }
+
+    /**
+     * Gets the path of a file in the directory.
+     *
+     * @param fileName Name of the file.
+     * @return Path of the file.
+    */
+    std::string getPath( std::string fileName )
+    {
+        return this->directory + "/" + fileName;
+    }
+
+    /**
+     * Gets the path of the gateway's config file.
+     *
+     * @return Path of the config file.
+    */
+    std::string getConfigFile()
+    {
+        return getPath( "config.cfg" );
+    }
+
+    /**
+     * Gets the path of the gateway's hardware whitelist.
+     *
+     * @return Path of the hardware whitelist.
+    */
+    std::string getWhitelistFile()
+    {
+        return getPath( "hardware-whitelist.txt" );
+    }
+
+    /**
+     * Appends a line to the gateway's config file, e.g. for keys whose value is a path in the directory.
+     *
+     * @param configLine Line "<KEY>=<value>".
+    */
+    void appendConfigLine( std::string configLine )
+    {
+        std::ofstream config( getConfigFile(), std::ios::app );
+        config << configLine << "\n";
+        config.close();
+
+        if ( !config.good() )
+        {
+            throw std::runtime_error( "Couldn't write " + getConfigFile() );
+        }
+    }
+
+    /**
+     * Writes a file into the directory. Throws std::runtime_error if it can't be written.
+     *
+     * @param fileName Name of the file.
+     * @param content Content of the file.
+     * @return Path of the file.
+    */
+    std::string writeFile( std::string fileName, std::string content )
+    {
+        std::string path = getPath( fileName );
+        std::ofstream file( path );
+        file << content;
+        file.close();
+
+        if ( !file.good() )
+        {
+            throw std::runtime_error( "Couldn't write " + path );
+        }
+
+        return path;
+    }
+};
+
+#endif // BENCHFIXTURE_HPP
@@ -0,0 +1,113 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BENCHOPTIONS_HPP
+#define BENCHOPTIONS_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <stdexcept> // std::invalid_argument, std::logic_error
+
+/**
+ * Command line helpers of the benchmarks (and checks).
+ * File: BenchOptions.hpp
+ * Purpose: Parses the numbers of command line options strictly, so a typo ends in the usage instead of an uncaught exception or a silently truncated value.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+/**
+ * Checks whether the usage was requested with "--help" or "-h".
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Returns true if the usage was requested.
+*/
+inline bool isUsageRequested( int argc, char* argv[] )
+{
+    for ( int index = 1; index < argc; index++ )
+    {
+        std::string argument = argv[index];
+
+        if ( argument == "--help" || argument == "-h" )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Parses an unsigned number of a command line option. Throws std::invalid_argument if it isn't one, naming the option.
+ *
+ * @param name Name of the option, e.g. "--devices".
+ * @param value Value of the option.
+ * @return Number.
+*/
+inline unsigned long long parseUnsignedOption( std::string name, std::string value )
+{
+    std::size_t parsed = 0;
+    unsigned long long number = 0;
+
+    try
+    {
+        number = std::stoull( value, &parsed );
+    }
+    catch ( const std::logic_error & e ) // std::invalid_argument and std::out_of_range
+    {
+        parsed = 0;
+    }
+
+    if ( parsed == 0 || parsed != value.length() || value[0] == '-' )
+    {
+        throw std::invalid_argument( "Invalid value \"" + value + "\" for " + name + "." );
+    }
+
+    return number;
+}
+
+/**
+ * Parses a decimal number of a command line option. Throws std::invalid_argument if it isn't one, naming the option.
+ *
+ * @param name Name of the option, e.g. "--duration".
+ * @param value Value of the option.
+ * @return Number.
+*/
+inline double parseDoubleOption( std::string name, std::string value )
+{
+    std::size_t parsed = 0;
+    double number = 0;
+
+    try
+    {
+        number = std::stod( value, &parsed );
+    }
+    catch ( const std::logic_error & e )
+    {
+        parsed = 0;
+    }
+
+    if ( parsed == 0 || parsed != value.length() )
+    {
+        throw std::invalid_argument( "Invalid value \"" + value + "\" for " + name + "." );
+    }
+
+    return number;
+}
+
+#endif // BENCHOPTIONS_HPP
@@ -0,0 +1,441 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <stdlib.h> // malloc, free
+
+// C++ Standard Libraries
+#include <algorithm> // std::min
+#include <atomic>
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <memory>
+#include <new> // std::bad_alloc, std::nothrow_t
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../src/LoopbackTransport.hpp"
+#include "../src/AllocationTracker.hpp"
+
+/**
+ * alloc-check application
+ * File: alloc-check.cpp
+ * Purpose: Checks that the gateway doesn't allocate in steady state: Once the devices are registered (and warmed up), receiving and dispatching
+ *          a message must not allocate, and neither must sending a pre-built message. Installs counting allocation hooks, and runs the gateway
+ *          over loopback ports with inbound queues; Or, with an inbound queue capacity of 0, without them, so the lines go through the message workers.
+ *          The device IDs are long enough to not fit into a string's own buffer. Prints the allocations per message for every stage, and fails if
+ *          "read", "process" or "dispatch" allocated while receiving, or "send" while sending. Allocations of the callbacks themselves are printed,
+ *          but not checked.
+ *          Needs a gateway built with SERIALPORTGATEWAY_ALLOCATION_CHECK=1 (See "make alloccheck").
+ *          Usage: alloc-check [<devices> [<messagesPerDevice> [<inboundQueueCapacity>]]]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: alloc-check [<devices> [<messagesPerDevice> [<inboundQueueCapacity>]]]";
+
+// Counting allocation hooks; Not inlined, so the compiler doesn't see malloc/free paired with new/delete
+__attribute__((noinline)) void * operator new( std::size_t size )
+{
+    AllocationTracker::recordAllocation( size );
+    void * pointer = malloc( size == 0 ? 1 : size );
+
+    if ( pointer == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+__attribute__((noinline)) void * operator new[]( std::size_t size )
+{
+    return operator new( size );
+}
+
+__attribute__((noinline)) void * operator new( std::size_t size, const std::nothrow_t & ) noexcept
+{
+    AllocationTracker::recordAllocation( size );
+
+    return malloc( size == 0 ? 1 : size );
+}
+
+__attribute__((noinline)) void * operator new[]( std::size_t size, const std::nothrow_t & nothrow ) noexcept
+{
+    return operator new( size, nothrow );
+}
+
+__attribute__((noinline)) void operator delete( void * pointer ) noexcept
+{
+    free( pointer );
+}
+
+__attribute__((noinline)) void operator delete[]( void * pointer ) noexcept
+{
+    free( pointer );
+}
+
+__attribute__((noinline)) void operator delete( void * pointer, std::size_t ) noexcept
+{
+    free( pointer );
+}
+
+__attribute__((noinline)) void operator delete[]( void * pointer, std::size_t ) noexcept
+{
+    free( pointer );
+}
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Firmware struct
+ * Purpose: State of a simulated device, shared between its firmware thread and the check.
+*/
+struct Firmware
+{
+    LoopbackTransportFactory::LoopbackPortPointer loopbackPort;
+    std::string deviceId;
+    std::atomic<unsigned long long> linesToSend;
+    std::atomic<unsigned long long> linesReceived;
+};
+
+/**
+ * CheckGateway class
+ * Purpose: Gateway which only counts its messages.
+*/
+class CheckGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    std::atomic<unsigned long long> received;
+
+    // Constructors
+    CheckGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        received = 0;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        received++;
+    }
+};
+
+/**
+ * Simulated firmware of a single device: Answers "getid", counts every other line it receives, and sends the requested number of lines.
+ *
+ * @param firmware State of the device.
+*/
+void runFirmware( Firmware * firmware )
+{
+    std::string line = "check:" + std::string( 48, 'x' ) + "\n";
+    std::string command;
+
+    while ( !firmware->loopbackPort->isDisconnected() )
+    {
+        for ( ; firmware->linesToSend > 0; firmware->linesToSend-- )
+        {
+            if ( !firmware->loopbackPort->writeToGateway( line ) )
+            {
+                return;
+            }
+        }
+
+        if ( firmware->loopbackPort->readFromGateway( command, 1 ) )
+        {
+            if ( command == "getid" )
+            {
+                firmware->loopbackPort->writeToGateway( "id:" + firmware->deviceId + "\n" );
+            }
+            else
+            {
+                firmware->linesReceived++;
+            }
+        }
+    }
+}
+
+/**
+ * Waits until a counter reached a value, or didn't change for a second.
+ *
+ * @param counter Function returning the counter.
+ * @param expected Value to wait for.
+ * @return Whether the value got reached.
+*/
+template<typename Counter>
+bool waitFor( Counter counter, unsigned long long expected )
+{
+    unsigned long long last = counter();
+    Clock::time_point lastProgress = Clock::now();
+
+    while ( counter() < expected && Clock::now() - lastProgress < std::chrono::seconds( 1 ) )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+        if ( counter() != last )
+        {
+            last = counter();
+            lastProgress = Clock::now();
+        }
+    }
+
+    return counter() >= expected;
+}
+
+/**
+ * Prints the allocations per message for every stage.
+ *
+ * @param name Name of the phase, to be printed.
+ * @param snapshot Allocations counted during the phase.
+ * @param messages Number of messages of the phase.
+*/
+void printSnapshot( std::string name, const AllocationSnapshot & snapshot, unsigned long long messages )
+{
+    std::cout << name << " (" << messages << " messages):" << std::endl;
+
+    for ( std::size_t stage = 0; stage < static_cast<std::size_t>( AllocationStage::COUNT ); stage++ )
+    {
+        std::cout << "\t" << std::setw( 10 ) << std::left << AllocationTracker::getStageName( static_cast<AllocationStage>( stage ) )
+                  << static_cast<double>( snapshot.allocations[stage] ) / messages << " allocs/msg, "
+                  << static_cast<double>( snapshot.bytes[stage] ) / messages << " bytes/msg" << std::endl;
+    }
+}
+
+/**
+ * Checks that the given stages didn't allocate, and prints those which did.
+ *
+ * @param name Name of the phase, to be printed.
+ * @param snapshot Allocations counted during the phase.
+ * @param stages Stages which must not allocate.
+ * @return Whether none of the stages allocated.
+*/
+bool checkStages( std::string name, const AllocationSnapshot & snapshot, std::vector<AllocationStage> stages )
+{
+    bool passed = true;
+
+    for ( AllocationStage stage : stages )
+    {
+        unsigned long long allocations = snapshot.allocations[static_cast<std::size_t>( stage )];
+
+        if ( allocations > 0 )
+        {
+            std::cout << "FAILED: " << name << ": Stage \"" << AllocationTracker::getStageName( stage ) << "\" allocated " << allocations << " times" << std::endl;
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing (or the check failed), 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    unsigned int devices = 4;
+    unsigned long long messagesPerDevice = 10000;
+    unsigned int inboundQueueCapacity = 1024;
+
+    try
+    {
+        if ( argc > 4 )
+        {
+            throw std::invalid_argument( "Too many arguments." );
+        }
+
+        if ( argc > 1 )
+        {
+            devices = parseUnsignedOption( "<devices>", argv[1] );
+        }
+
+        if ( argc > 2 )
+        {
+            messagesPerDevice = parseUnsignedOption( "<messagesPerDevice>", argv[2] );
+        }
+
+        if ( argc > 3 )
+        {
+            inboundQueueCapacity = parseUnsignedOption( "<inboundQueueCapacity>", argv[3] );
+        }
+
+        if ( devices == 0 || messagesPerDevice == 0 )
+        {
+            throw std::invalid_argument( "Devices and messages per device must be > 0." );
+        }
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    if ( !AllocationTracker::isCompiledIn() )
+    {
+        std::cout << "The allocation stages are not compiled in; Rebuild with \"make clean && make alloccheck\"." << std::endl;
+
+        return 1;
+    }
+
+    BenchFixture fixture( "alloc-check", { "INBOUND_QUEUE_CAPACITY=" + std::to_string( inboundQueueCapacity ), "INBOUND_OVERFLOW_POLICY=block" } );
+
+    LoopbackTransportFactory * loopbackTransportFactory = new LoopbackTransportFactory();
+    CheckGateway * gateway = new CheckGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    gateway->useSerialTransportFactory( loopbackTransportFactory );
+
+    std::vector<std::unique_ptr<Firmware>> firmwares;
+    std::vector<std::thread> firmwareThreads;
+
+    for ( unsigned int index = 0; index < devices; index++ )
+    {
+        std::unique_ptr<Firmware> firmware( new Firmware() );
+        firmware->deviceId = "alloc-check-device-" + std::to_string( index ); // Longer than what fits into a string without allocating
+        firmware->loopbackPort = loopbackTransportFactory->addPort( "/loopback/" + firmware->deviceId );
+        firmware->linesToSend = 0;
+        firmware->linesReceived = 0;
+
+        firmwareThreads.push_back( std::thread( runFirmware, firmware.get() ) );
+        firmwares.push_back( std::move( firmware ) );
+    }
+
+    gateway->start();
+    unsigned int added = gateway->addNewSerialPorts( true );
+
+    std::cout << "Devices: " << added << " of " << devices << ", messages per device: " << messagesPerDevice << ", inbound queue capacity: " << inboundQueueCapacity << std::endl;
+
+    // Warm-up as long as the checked runs, so every slot of the queues' and workers' rings has been used, and buffers and thread-locals
+    // already have their steady-state size
+    unsigned long long sendsPerDevice = std::min<unsigned long long>( messagesPerDevice, 1000 );
+    std::string prebuiltMessage = "set:" + std::string( 48, 'y' );
+
+    for ( std::unique_ptr<Firmware> & firmware : firmwares )
+    {
+        firmware->linesToSend = messagesPerDevice;
+    }
+
+    for ( unsigned long long index = 0; index < sendsPerDevice; index++ )
+    {
+        for ( std::unique_ptr<Firmware> & firmware : firmwares )
+        {
+            gateway->sendMessageToSerialDevice( firmware->deviceId, prebuiltMessage );
+        }
+    }
+
+    auto countLinesReceived = [&]()
+    {
+        unsigned long long linesReceived = 0;
+
+        for ( std::unique_ptr<Firmware> & firmware : firmwares )
+        {
+            linesReceived += firmware->linesReceived;
+        }
+
+        return linesReceived;
+    };
+
+    bool completed = waitFor( [&]() { return gateway->received.load(); }, added * messagesPerDevice );
+    completed = waitFor( countLinesReceived, added * sendsPerDevice ) && completed;
+
+    // Receiving & dispatching
+    unsigned long long receivedBefore = gateway->received;
+    AllocationTracker::reset();
+
+    for ( std::unique_ptr<Firmware> & firmware : firmwares )
+    {
+        firmware->linesToSend = messagesPerDevice;
+    }
+
+    completed = waitFor( [&]() { return gateway->received.load(); }, receivedBefore + added * messagesPerDevice ) && completed;
+
+    AllocationSnapshot receiveSnapshot = AllocationTracker::getSnapshot();
+    unsigned long long receivedMessages = gateway->received - receivedBefore;
+
+    // Sending a pre-built message; The calling thread counts as "send" as well, as the call itself may copy the message
+    unsigned long long sentBefore = countLinesReceived();
+    AllocationTracker::reset();
+
+    {
+        AllocationStageScope allocationStageScope( AllocationStage::SEND );
+
+        for ( unsigned long long index = 0; index < sendsPerDevice; index++ )
+        {
+            for ( std::unique_ptr<Firmware> & firmware : firmwares )
+            {
+                gateway->sendMessageToSerialDevice( firmware->deviceId, prebuiltMessage );
+            }
+        }
+    }
+
+    completed = waitFor( countLinesReceived, sentBefore + devices * sendsPerDevice ) && completed;
+
+    AllocationSnapshot sendSnapshot = AllocationTracker::getSnapshot();
+    unsigned long long sentMessages = countLinesReceived() - sentBefore;
+
+    gateway->stop();
+
+    for ( std::unique_ptr<Firmware> & firmware : firmwares )
+    {
+        loopbackTransportFactory->removePort( firmware->loopbackPort->getPort() );
+    }
+
+    for ( std::thread & firmwareThread : firmwareThreads )
+    {
+        firmwareThread.join();
+    }
+
+    while ( !gateway->isEveryReadLoopQuitted() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    delete gateway;
+
+    printSnapshot( "Receiving & dispatching", receiveSnapshot, receivedMessages > 0 ? receivedMessages : 1 );
+    printSnapshot( "Sending", sendSnapshot, sentMessages > 0 ? sentMessages : 1 );
+
+    bool passed = added == devices && completed;
+
+    if ( !passed )
+    {
+        std::cout << "FAILED: Not every device got added, or not every message got delivered" << std::endl;
+    }
+
+    passed = checkStages( "Receiving & dispatching", receiveSnapshot, { AllocationStage::READ, AllocationStage::PROCESS, AllocationStage::DISPATCH } ) && passed;
+    passed = checkStages( "Sending", sendSnapshot, { AllocationStage::SEND } ) && passed;
+
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+
+    return passed ? 0 : 1;
+}
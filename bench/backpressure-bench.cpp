@@ -0,0 +1,183 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <limits>
+#include <thread>
+#include <chrono>
+
+#include "../src/InboundQueue.hpp"
+#include "../src/GatewayMetrics.hpp"
+#include "BenchOptions.hpp"
+
+/**
+ * backpressure-bench application
+ * File: backpressure-bench.cpp
+ * Purpose: Feeds telemetry messages (a few types, e.g. gauges) into an InboundQueue faster than a deliberately slow consumer can process them,
+ *          once per overflow policy, and once with an unbounded queue (which is what spawning a thread per message would amount to).
+ *          Prints how many messages got delivered, dropped and conflated, the peak queue depth (memory) and the latency from "read" to delivery.
+ *          Usage: backpressure-bench [<seconds> [<capacity>]]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const unsigned int PRODUCER_RATE = 20000; // Messages per second
+const unsigned int CONSUMER_TIME = 200; // µs per message; So the consumer manages at most 5000 messages per second
+const unsigned int TYPE_COUNT = 8;
+const std::string USAGE = "Usage: backpressure-bench [<seconds> [<capacity>]]";
+
+/**
+ * Runs the slow consumer against a queue for a number of seconds, and prints the results.
+ *
+ * @param name Name of the run, to be printed.
+ * @param capacity Capacity of the queue.
+ * @param overflowPolicy Overflow policy of the queue.
+ * @param seconds How long the producer runs.
+*/
+void runBenchmark( std::string name, std::size_t capacity, OverflowPolicy overflowPolicy, double seconds )
+{
+    typedef std::chrono::steady_clock Clock;
+
+    InboundQueue inboundQueue( capacity, overflowPolicy );
+    LatencyHistogram latency;
+    std::atomic<unsigned long long> delivered( 0 );
+
+    std::thread consumer( [&]()
+    {
+        InboundMessage inboundMessage;
+
+        while ( inboundQueue.pop( inboundMessage ) )
+        {
+            latency.record( std::chrono::duration_cast<std::chrono::microseconds>( Clock::now() - inboundMessage.readTime ).count() );
+            delivered++;
+
+            std::this_thread::sleep_for( std::chrono::microseconds( CONSUMER_TIME ) );
+        }
+    } );
+
+    unsigned long long produced = 0;
+    unsigned long long dropped = 0;
+    unsigned long long conflated = 0;
+    std::size_t peakDepth = 0;
+    Clock::time_point begin = Clock::now();
+    Clock::time_point end = begin + std::chrono::microseconds( static_cast<long long>( seconds * 1e6 ) );
+    Clock::time_point nextBatch = begin;
+
+    // Messages get produced in batches of 1 ms, since sleeping for less isn't precise
+    while ( Clock::now() < end )
+    {
+        for ( unsigned int index = 0; index < PRODUCER_RATE / 1000; index++, produced++ )
+        {
+            std::string type = "t" + std::to_string( produced % TYPE_COUNT );
+            InboundMessage inboundMessage = { type + ":" + std::to_string( produced ), type, Clock::now(), { 0, 0 } };
+
+            switch ( inboundQueue.push( inboundMessage ) )
+            {
+                case PushResult::DROPPED_OLDEST:
+                    dropped++;
+                    break;
+                case PushResult::CONFLATED:
+                    conflated++;
+                    break;
+                default:
+                    break;
+            }
+
+            std::size_t depth = inboundQueue.getSize();
+            peakDepth = depth > peakDepth ? depth : peakDepth;
+        }
+
+        nextBatch += std::chrono::milliseconds( 1 );
+        std::this_thread::sleep_until( nextBatch );
+    }
+
+    double producerSeconds = std::chrono::duration<double>( Clock::now() - begin ).count();
+
+    inboundQueue.close();
+    consumer.join();
+
+    LatencyHistogramSnapshot snapshot;
+    latency.addTo( snapshot );
+
+    // A queued message costs its slot in the ring (which stays allocated) and (for longer messages) the string buffers
+    std::size_t bytesPerMessage = sizeof( InboundMessage ) + 16;
+
+    std::cout << name << ":" << std::endl
+              << "\tproduced " << produced << " in " << producerSeconds << " s (target " << seconds << " s), delivered " << delivered << ", dropped " << dropped << ", conflated " << conflated << std::endl
+              << "\tpeak depth " << peakDepth << " (~" << peakDepth * bytesPerMessage / 1024 << " KiB)" << std::endl
+              << "\tlatency p50 " << snapshot.getPercentile( 50 ) / 1000.0 << " ms, p99 " << snapshot.getPercentile( 99 ) / 1000.0 << " ms, max " << snapshot.getMax() / 1000.0 << " ms" << std::endl;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    double seconds = 1.0;
+    std::size_t capacity = 64;
+
+    try
+    {
+        if ( argc > 3 )
+        {
+            throw std::invalid_argument( "Too many arguments." );
+        }
+
+        if ( argc > 1 )
+        {
+            seconds = parseDoubleOption( "<seconds>", argv[1] );
+        }
+
+        if ( argc > 2 )
+        {
+            capacity = parseUnsignedOption( "<capacity>", argv[2] );
+        }
+
+        if ( seconds <= 0 || capacity == 0 )
+        {
+            throw std::invalid_argument( "Seconds and capacity must be > 0." );
+        }
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    std::cout << "Producer: " << PRODUCER_RATE << " messages/s (" << TYPE_COUNT << " types), consumer: " << CONSUMER_TIME << " us/message, capacity: " << capacity << std::endl;
+
+    runBenchmark( "Unbounded (like a thread per message)", std::numeric_limits<std::size_t>::max(), OverflowPolicy::DROP_OLDEST, seconds );
+    runBenchmark( "block", capacity, OverflowPolicy::BLOCK, seconds );
+    runBenchmark( "drop_oldest", capacity, OverflowPolicy::DROP_OLDEST, seconds );
+    runBenchmark( "conflate", capacity, OverflowPolicy::CONFLATE, seconds );
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <unistd.h> // fork, pipe, read, write, close
+#include <sys/wait.h> // waitpid
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <iomanip> // std::setw, std::setprecision
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * baud-bench application
+ * File: baud-bench.cpp
+ * Purpose: Measures the telemetry throughput of link-bound devices with and without baud escalation. The virtual devices (served by a forked child process)
+ *          emulate a line at <baud> (10 bits per byte), reset whenever the port gets opened, and switch up to <maxBaud> when asked.
+ *          Every run gets its own gateway: One at the base rate, one with "BAUD_ESCALATION_COMMAND"/"BAUD_ESCALATION_RATE" set.
+ *          Prints the telemetry lines and bytes received per second and device, and how many lines the devices had to drop.
+ *          Usage: baud-bench [--devices <n>] [--baud <rate>] [--max-baud <rate>] [--rate <linesPerSecondPerDevice>] [--size <bytesPerLine>] [--duration <seconds>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: baud-bench [--devices <n>] [--baud <rate>] [--max-baud <rate>] [--rate <linesPerSecondPerDevice>] [--size <bytesPerLine>] [--duration <seconds>]";
+
+// Types
+struct Options
+{
+    unsigned int devices;
+    unsigned int baudRate;
+    unsigned int maxBaudRate;
+    unsigned int rate; // Lines per second, per device
+    unsigned int size; // Bytes per line, including the newline
+    double duration; // Seconds of streaming
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway which counts the telemetry lines it receives.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    std::atomic<unsigned long long> received;
+
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        received = 0;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        if ( serialMessage.getType() == "telemetry" )
+        {
+            received++;
+        }
+    }
+};
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 4, 9600, 115200, 200, 48, 5 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--baud" ) options.baudRate = parseUnsignedOption( name, value );
+        else if ( name == "--max-baud" ) options.maxBaudRate = parseUnsignedOption( name, value );
+        else if ( name == "--rate" ) options.rate = parseUnsignedOption( name, value );
+        else if ( name == "--size" ) options.size = parseUnsignedOption( name, value );
+        else if ( name == "--duration" ) options.duration = parseDoubleOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.baudRate == 0 || options.maxBaudRate < options.baudRate || options.rate == 0 || options.duration <= 0 )
+    {
+        throw std::invalid_argument( "Devices, baud rate, rate and duration must be > 0, and the maximum baud rate must not be below the baud rate." );
+    }
+
+    return options;
+}
+
+/**
+ * Adds every device to a gateway, streams telemetry for the duration, and prints the throughput.
+ *
+ * @param name Name of the run, to be printed.
+ * @param configLines Additional config lines of the run.
+ * @param ports Ports of the devices.
+ * @param options Benchmark options.
+ * @param controlFd Write end of the control pipe; "g" starts the telemetry, "s" stops it.
+ * @param resultFd Read end of the result pipe; Gets the number of dropped lines after "s".
+*/
+void runEscalation( std::string name, std::vector<std::string> configLines, const std::vector<std::string> & ports, const Options & options, int controlFd, int resultFd )
+{
+    std::vector<std::string> lines = { "ADAPTIVE_HANDSHAKE=1", "BAUD_RATE=" + std::to_string( options.baudRate ), "LOG_LEVEL=OFF" };
+    lines.insert( lines.end(), configLines.begin(), configLines.end() );
+
+    BenchFixture fixture( "baud", lines );
+
+    BenchGateway * gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    unsigned int failed = 0;
+    gateway->start();
+
+    for ( std::string const & port : ports )
+    {
+        if ( !gateway->addSerialDevice( port, true ) )
+        {
+            failed++;
+        }
+    }
+
+    unsigned long long dropped = 0;
+    unsigned long long receivedBefore = gateway->received;
+    write( controlFd, "g", 1 );
+    std::this_thread::sleep_for( std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) ) );
+    write( controlFd, "s", 1 );
+    read( resultFd, &dropped, sizeof( dropped ) );
+
+    double linesPerSecond = ( gateway->received - receivedBefore ) / options.duration / options.devices;
+
+    gateway->stop(); // Closes the ports, so the devices reset to their base rate when they get opened by the next run
+
+    while ( !gateway->isEveryReadLoopQuitted() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    delete gateway;
+
+    std::cout << std::setw( 10 ) << name << ":  " << std::fixed << std::setprecision( 1 ) << std::setw( 8 ) << linesPerSecond << " lines/s  "
+              << std::setw( 9 ) << linesPerSecond * options.size << " B/s per device  (dropped by the devices: " << dropped << ", failed: " << failed << ")" << std::endl;
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode; 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    DeviceSimulator simulator;
+    std::vector<std::string> ports;
+    DeviceBehaviour behaviour;
+    behaviour.telemetryRate = options.rate;
+    behaviour.telemetrySize = options.size;
+    behaviour.baudRate = options.baudRate;
+    behaviour.maxBaudRate = options.maxBaudRate;
+    behaviour.bootDelay = 50; // Resets on open, so every run starts at the base rate
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            ports.push_back( simulator.addDevice( "baud" + std::to_string( index ), behaviour )->getPort() );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    // The devices get served by a child process, so the gateway's threads don't share a scheduler with them
+    int controlPipe[2];
+    int resultPipe[2];
+
+    if ( pipe( controlPipe ) != 0 || pipe( resultPipe ) != 0 )
+    {
+        std::cerr << "Couldn't create pipes: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    pid_t farm = fork();
+
+    if ( farm == 0 )
+    {
+        char control;
+        unsigned long long droppedBefore = 0;
+        close( controlPipe[1] );
+        close( resultPipe[0] );
+        simulator.start();
+
+        while ( read( controlPipe[0], &control, 1 ) > 0 )
+        {
+            simulator.setTelemetryActive( control == 'g' );
+
+            if ( control == 's' )
+            {
+                unsigned long long dropped = simulator.getStatistics().linesDropped;
+                unsigned long long droppedNow = dropped - droppedBefore;
+                droppedBefore = dropped;
+                write( resultPipe[1], &droppedNow, sizeof( droppedNow ) );
+            }
+        }
+
+        simulator.stop();
+        _exit( 0 );
+    }
+
+    close( controlPipe[0] );
+    close( resultPipe[1] );
+
+    std::cout << options.devices << " devices at " << options.baudRate << " baud (up to " << options.maxBaudRate << "), " << options.rate << " lines/s of " << options.size << " bytes each" << std::endl;
+
+    runEscalation( "base", {}, ports, options, controlPipe[1], resultPipe[0] );
+    runEscalation( "escalated", { "BAUD_ESCALATION_COMMAND=setbaud", "BAUD_ESCALATION_RATE=" + std::to_string( options.maxBaudRate ) }, ports, options, controlPipe[1], resultPipe[0] );
+
+    close( controlPipe[1] );
+    waitpid( farm, nullptr, 0 );
+
+    return 0;
+}
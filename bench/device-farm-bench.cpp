@@ -0,0 +1,526 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <unistd.h> // fork, pipe, read, write
+#include <sys/wait.h> // waitpid
+#include <sys/resource.h> // getrusage
+#include <cstdio> // snprintf
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <cmath> // std::fabs
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * device-farm-bench application
+ * File: device-farm-bench.cpp
+ * Purpose: Benchmarks a SerialPortGateway end-to-end against a farm of virtual devices.
+ *          The devices are virtual devices on ptys (See DeviceSimulator), which get served by a forked child process; They answer "getid"
+ *          and then stream telemetry at a configurable rate and size, while the gateway serves the ptys like real serial ports.
+ *          Measures the startup time (until all devices are added), the end-to-end throughput and latency (firmware write until message callback),
+ *          and the gateway's CPU usage, peak thread count and peak RSS. The results are emitted as JSON;
+ *          Given a baseline (a previously saved result), every metric gets compared, and regressions beyond the tolerance fail the run.
+ *          Usage: device-farm-bench [--devices <n>] [--rate <linesPerSecondPerDevice>] [--size <bytesPerLine>] [--duration <seconds>]
+ *                                   [--set <CONFIG_KEY>=<value>]... [--output <file>] [--baseline <file>] [--tolerance <percent>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    unsigned int rate; // Lines per second, per device
+    unsigned int size; // Bytes per line, including the newline
+    double duration; // Seconds of streaming
+    std::vector<std::string> configOverrides; // Additional lines for the gateway's config file
+    std::string outputFile;
+    std::string baselineFile;
+    double tolerance; // Percent
+};
+
+struct Metric
+{
+    std::string key;
+    double value;
+    bool higherIsBetter;
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway which only records the end-to-end latency of every streamed line.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    LatencyHistogram latency; // µs
+    std::atomic<unsigned long long> received;
+
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        received = 0;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        // Content: "<sequence>,<steady clock ns when written>,<padding>"
+        std::string content = serialMessage.getContent();
+        std::size_t first = content.find( ',' );
+
+        if ( serialMessage.getType() != "telemetry" || first == std::string::npos )
+        {
+            return;
+        }
+
+        unsigned long long writeTime = std::stoull( content.substr( first + 1 ) );
+        unsigned long long now = std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+
+        latency.record( now > writeTime ? ( now - writeTime ) / 1000 : 0 );
+        received++;
+    }
+};
+
+// Constants
+const std::vector<std::string> METRIC_ORDER = { "throughput_lines_per_s", "lost_lines", "latency_p50_us", "latency_p99_us", "latency_p999_us", "startup_ms", "cpu_percent", "threads_peak", "rss_peak_kib" };
+const std::string USAGE = "Usage: device-farm-bench [--devices <n>] [--rate <linesPerSecondPerDevice>] [--size <bytesPerLine>] [--duration <seconds>]\n"
+                          "                         [--set <CONFIG_KEY>=<value>]... [--output <file>] [--baseline <file>] [--tolerance <percent>]";
+
+/**
+ * Writes a complete buffer to a file descriptor.
+ *
+ * @param fd File descriptor.
+ * @param data Data to be written.
+ * @return Whether everything could be written.
+*/
+bool writeAll( int fd, const std::string & data )
+{
+    std::size_t written = 0;
+
+    while ( written < data.length() )
+    {
+        ssize_t result = write( fd, data.data() + written, data.length() - written );
+
+        if ( result <= 0 )
+        {
+            return false;
+        }
+
+        written += result;
+    }
+
+    return true;
+}
+
+/**
+ * Runs the device farm; Gets executed in the forked child process.
+ * Telemetry starts once the parent writes a byte to the control pipe, and stops after the duration. Afterwards the number of sent lines
+ * gets written back, and the devices keep answering until the control pipe gets closed.
+ *
+ * @param simulator Simulator with all devices added.
+ * @param options Benchmark options.
+ * @param controlFd Read end of the control pipe.
+ * @param resultFd Write end of the result pipe.
+*/
+void runFarm( DeviceSimulator & simulator, const Options & options, int controlFd, int resultFd )
+{
+    char control;
+    simulator.start();
+
+    if ( read( controlFd, &control, 1 ) == 1 )
+    {
+        simulator.setTelemetryActive( true );
+        std::this_thread::sleep_for( std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) ) );
+        simulator.setTelemetryActive( false );
+    }
+
+    unsigned long long sent = simulator.getStatistics().linesSent;
+    writeAll( resultFd, std::string( reinterpret_cast<const char *>( &sent ), sizeof( sent ) ) );
+
+    while ( read( controlFd, &control, 1 ) > 0 );
+
+    simulator.stop();
+}
+
+/**
+ * Reads a value (in kiB or count) from /proc/self/status.
+ *
+ * @param key Key of the line, e.g. "VmRSS" or "Threads".
+ * @return Value, or 0 if the key wasn't found.
+*/
+unsigned long long readProcStatus( std::string key )
+{
+    std::ifstream status( "/proc/self/status" );
+    std::string line;
+
+    while ( std::getline( status, line ) )
+    {
+        if ( line.compare( 0, key.length() + 1, key + ":" ) == 0 )
+        {
+            return std::stoull( line.substr( key.length() + 1 ) );
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Gets the CPU time the process has used so far.
+ *
+ * @return User + system time in seconds.
+*/
+double getCpuSeconds()
+{
+    rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1e6;
+}
+
+/**
+ * Renders the options and metrics as JSON.
+ *
+ * @param options Benchmark options.
+ * @param metrics Measured metrics.
+ * @return JSON document.
+*/
+std::string renderJson( const Options & options, const std::vector<Metric> & metrics )
+{
+    std::ostringstream json;
+    json << "{\n  \"options\": { \"devices\": " << options.devices << ", \"rate\": " << options.rate << ", \"size\": " << options.size << ", \"duration\": " << options.duration << ", \"config\": [";
+
+    for ( std::size_t index = 0; index < options.configOverrides.size(); index++ )
+    {
+        json << ( index > 0 ? ", " : "" ) << "\"" << options.configOverrides[index] << "\"";
+    }
+
+    json << "] },\n  \"metrics\": {";
+
+    for ( std::size_t index = 0; index < metrics.size(); index++ )
+    {
+        char value[64];
+        snprintf( value, sizeof( value ), "%.3f", metrics[index].value );
+        json << ( index > 0 ? "," : "" ) << "\n    \"" << metrics[index].key << "\": " << value;
+    }
+
+    json << "\n  }\n}\n";
+
+    return json.str();
+}
+
+/**
+ * Reads the metrics of a previously saved result.
+ *
+ * @param file Path of the JSON file.
+ * @return Mapping between metric keys and values.
+*/
+std::map<std::string, double> readBaseline( std::string file )
+{
+    std::ifstream input( file );
+
+    if ( !input.is_open() )
+    {
+        throw std::runtime_error( "Couldn't open baseline \"" + file + "\"." );
+    }
+
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    std::string json = buffer.str();
+    std::map<std::string, double> baseline;
+
+    for ( std::string const & key : METRIC_ORDER )
+    {
+        std::size_t position = json.find( "\"" + key + "\":" );
+
+        if ( position != std::string::npos )
+        {
+            baseline[key] = std::stod( json.substr( position + key.length() + 3 ) );
+        }
+    }
+
+    return baseline;
+}
+
+/**
+ * Compares the metrics against a baseline, and prints the comparison.
+ *
+ * @param metrics Measured metrics.
+ * @param baseline Metrics of the baseline.
+ * @param tolerance Allowed change for the worse, in percent.
+ * @return Number of regressions.
+*/
+unsigned int compareWithBaseline( const std::vector<Metric> & metrics, std::map<std::string, double> & baseline, double tolerance )
+{
+    unsigned int regressions = 0;
+
+    std::cerr << "Comparison with baseline (tolerance " << tolerance << " %):" << std::endl;
+
+    for ( Metric const & metric : metrics )
+    {
+        if ( baseline.find( metric.key ) == baseline.end() )
+        {
+            continue;
+        }
+
+        double before = baseline[metric.key];
+        double change = before != 0 ? ( metric.value - before ) / std::fabs( before ) * 100 : ( metric.value == 0 ? 0 : 100 );
+        bool worse = metric.higherIsBetter ? change < -tolerance : change > tolerance;
+
+        if ( worse )
+        {
+            regressions++;
+        }
+
+        char line[256];
+        snprintf( line, sizeof( line ), "\t%-24s %14.3f -> %14.3f  %+8.1f %%  %s", metric.key.c_str(), before, metric.value, change, worse ? "REGRESSION" : "ok" );
+        std::cerr << line << std::endl;
+    }
+
+    return regressions;
+}
+
+/**
+ * Parses the command line options.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 4, 1000, 64, 5.0, {}, "", "", 10.0 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--rate" ) options.rate = parseUnsignedOption( name, value );
+        else if ( name == "--size" ) options.size = parseUnsignedOption( name, value );
+        else if ( name == "--duration" ) options.duration = parseDoubleOption( name, value );
+        else if ( name == "--set" ) options.configOverrides.push_back( value );
+        else if ( name == "--output" ) options.outputFile = value;
+        else if ( name == "--baseline" ) options.baselineFile = value;
+        else if ( name == "--tolerance" ) options.tolerance = parseDoubleOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.rate == 0 || options.duration <= 0 )
+    {
+        throw std::invalid_argument( "Devices, rate and duration must be > 0." );
+    }
+
+    return options;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means there were regressions (or the arguments are invalid).
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    // Config files; Scanning stays off, so only the farm's devices get added and real hardware is never touched
+    BenchFixture fixture( "farm", options.configOverrides );
+
+    // Device farm; The output buffers are big enough that lines only get lost in the gateway
+    DeviceSimulator simulator;
+    DeviceBehaviour behaviour;
+    behaviour.telemetryRate = options.rate;
+    behaviour.telemetrySize = options.size;
+    behaviour.outputBufferSize = 1024 * 1024;
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            simulator.addDevice( "farm" + std::to_string( index ), behaviour );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    int controlPipe[2];
+    int resultPipe[2];
+
+    if ( pipe( controlPipe ) != 0 || pipe( resultPipe ) != 0 )
+    {
+        std::cerr << "Couldn't create pipes: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    pid_t farm = fork();
+
+    if ( farm == 0 )
+    {
+        close( controlPipe[1] );
+        runFarm( simulator, options, controlPipe[0], resultPipe[1] );
+        _exit( 0 );
+    }
+
+    close( controlPipe[0] );
+    close( resultPipe[1] );
+
+    // Startup: Constructing and starting the gateway, and adding all devices (including the "getid" handshake)
+    Clock::time_point startupBegin = Clock::now();
+    BenchGateway * gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    gateway->start();
+
+    for ( DeviceSimulator::VirtualDevicePointer const & device : simulator.getDevices() )
+    {
+        if ( !gateway->addSerialDevice( device->getPort() ) )
+        {
+            std::cerr << "Couldn't add device on " << device->getPort() << std::endl;
+        }
+    }
+
+    double startupMilliseconds = std::chrono::duration<double, std::milli>( Clock::now() - startupBegin ).count();
+
+    // Streaming
+    double cpuBegin = getCpuSeconds();
+    Clock::time_point streamBegin = Clock::now();
+    unsigned long long threadsPeak = readProcStatus( "Threads" );
+    writeAll( controlPipe[1], "g" );
+
+    Clock::time_point streamEnd = streamBegin + std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) );
+
+    while ( Clock::now() < streamEnd )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+        unsigned long long threads = readProcStatus( "Threads" );
+        threadsPeak = threads > threadsPeak ? threads : threadsPeak;
+    }
+
+    unsigned long long sent = 0;
+    read( resultPipe[0], &sent, sizeof( sent ) );
+
+    // Give the gateway up to a second to deliver what's still in flight
+    for ( unsigned int wait = 0; wait < 100 && gateway->received < sent; wait++ )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    double streamSeconds = std::chrono::duration<double>( Clock::now() - streamBegin ).count();
+    double cpuSeconds = getCpuSeconds() - cpuBegin;
+    unsigned long long received = gateway->received;
+    unsigned long long rssPeak = readProcStatus( "VmHWM" );
+    LatencyHistogramSnapshot latency;
+    gateway->latency.addTo( latency );
+
+    gateway->stop();
+
+    while ( !gateway->isEveryReadLoopQuitted() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    delete gateway;
+    close( controlPipe[1] );
+    waitpid( farm, nullptr, 0 );
+
+    std::vector<Metric> metrics = {
+        { "throughput_lines_per_s", received / streamSeconds, true },
+        { "lost_lines", static_cast<double>( sent > received ? sent - received : 0 ), false },
+        { "latency_p50_us", static_cast<double>( latency.getPercentile( 50 ) ), false },
+        { "latency_p99_us", static_cast<double>( latency.getPercentile( 99 ) ), false },
+        { "latency_p999_us", static_cast<double>( latency.getPercentile( 99.9 ) ), false },
+        { "startup_ms", startupMilliseconds, false },
+        { "cpu_percent", cpuSeconds / streamSeconds * 100, false },
+        { "threads_peak", static_cast<double>( threadsPeak ), false },
+        { "rss_peak_kib", static_cast<double>( rssPeak ), false }
+    };
+
+    std::string json = renderJson( options, metrics );
+    std::cout << json;
+
+    if ( !options.outputFile.empty() )
+    {
+        std::ofstream( options.outputFile ) << json;
+    }
+
+    if ( !options.baselineFile.empty() )
+    {
+        try
+        {
+            std::map<std::string, double> baseline = readBaseline( options.baselineFile );
+
+            if ( compareWithBaseline( metrics, baseline, options.tolerance ) > 0 )
+            {
+                return 2;
+            }
+        }
+        catch ( const std::exception & e )
+        {
+            std::cerr << e.what() << std::endl;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,447 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm> // std::max
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../src/EventBus.hpp"
+#include "../src/LoopbackTransport.hpp"
+
+/**
+ * event-bus-bench application
+ * File: event-bus-bench.cpp
+ * Purpose: Measures fanning every message out to three consumers (e.g. MQTT, a local database and an alarm checker), which run on their own threads.
+ *          The devices are loopback ports with simulated firmware in the same process, which send their lines as fast as the gateway takes them.
+ *          Runs once with "messageCallback" copying every message onto a queue per consumer, once with the consumers reading the event bus,
+ *          and once more with the event bus while the alarm checker takes <slowDelay> per message; It falls behind, and holds the gateway up.
+ *          Prints the throughput (until every consumer got every message), the mean and maximum lag of every consumer (sampled every ms),
+ *          and how often publishing stalled.
+ *          Usage: event-bus-bench [--devices <n>] [--lines <linesPerDevice>] [--capacity <events>] [--slow-delay <us>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: event-bus-bench [--devices <n>] [--lines <linesPerDevice>] [--capacity <events>] [--slow-delay <us>]";
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    unsigned long long lines; // Per device
+    unsigned int capacity; // Events on the ring of the event bus
+    unsigned int slowDelay; // µs per message of the slow consumer
+};
+
+/**
+ * Consumer struct
+ * Purpose: Holds what a consumer got so far; Either it reads a queue of copies, or the event bus.
+*/
+struct Consumer
+{
+    std::string name;
+    unsigned int delay; // µs per message
+    std::atomic<unsigned long long> received;
+    unsigned long long lagSum; // Messages queued, or events not released yet, summed up over the samples
+    unsigned long long maxLag;
+    unsigned long long contentBytes; // Keeps the reads from being optimized away
+    std::deque<SerialMessage> copies;
+    std::mutex mutex;
+    std::condition_variable copyQueued;
+    EventBus::EventConsumerPointer eventConsumer; // nullptr if the consumer reads copies
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway which copies every message onto the queue of every consumer, unless they read the event bus.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    std::vector<Consumer *> copyingConsumers;
+
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        for ( Consumer * consumer : copyingConsumers )
+        {
+            std::lock_guard<std::mutex> lock( consumer->mutex );
+            consumer->copies.push_back( serialMessage );
+            consumer->copyQueued.notify_one();
+        }
+    }
+};
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 8, 20000, EventBus::DEFAULT_CAPACITY, 20 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--lines" ) options.lines = parseUnsignedOption( name, value );
+        else if ( name == "--capacity" ) options.capacity = parseUnsignedOption( name, value );
+        else if ( name == "--slow-delay" ) options.slowDelay = parseUnsignedOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.lines == 0 || options.capacity == 0 )
+    {
+        throw std::invalid_argument( "Devices, lines and capacity must be > 0." );
+    }
+
+    return options;
+}
+
+/**
+ * Simulates the work of a consumer on a single message; Spins, since sleeping is far coarser than a few µs.
+ *
+ * @param delay Time in µs.
+*/
+void work( unsigned int delay )
+{
+    if ( delay == 0 )
+    {
+        return;
+    }
+
+    Clock::time_point end = Clock::now() + std::chrono::microseconds( delay );
+
+    while ( Clock::now() < end );
+}
+
+/**
+ * Loop of a consumer which reads copies from its queue.
+ *
+ * @param consumer Consumer.
+ * @param stop Set once the run is over.
+*/
+void runCopyingConsumer( Consumer * consumer, const std::atomic_bool & stop )
+{
+    std::unique_lock<std::mutex> lock( consumer->mutex );
+
+    while ( !stop )
+    {
+        if ( consumer->copies.empty() )
+        {
+            consumer->copyQueued.wait_for( lock, std::chrono::milliseconds( 10 ) );
+
+            continue;
+        }
+
+        SerialMessage serialMessage = std::move( consumer->copies.front() );
+        consumer->copies.pop_front();
+        lock.unlock();
+
+        consumer->contentBytes += serialMessage.getContent().size();
+        work( consumer->delay );
+        consumer->received++;
+
+        lock.lock();
+    }
+}
+
+/**
+ * Loop of a consumer which reads the event bus in place.
+ *
+ * @param eventBus Event bus of the gateway.
+ * @param consumer Consumer.
+ * @param stop Set once the run is over.
+*/
+void runEventBusConsumer( EventBus * eventBus, Consumer * consumer, const std::atomic_bool & stop )
+{
+    while ( !stop )
+    {
+        unsigned long long end = eventBus->waitForEvents( consumer->eventConsumer, std::chrono::milliseconds( 10 ) );
+
+        for ( unsigned long long sequence = consumer->eventConsumer->cursor; sequence < end; sequence++ )
+        {
+            const GatewayEvent & event = eventBus->getEvent( sequence );
+
+            if ( event.type == GatewayEventType::MESSAGE )
+            {
+                consumer->contentBytes += event.content.size();
+                work( consumer->delay );
+                consumer->received++;
+            }
+        }
+
+        eventBus->release( consumer->eventConsumer, end );
+    }
+}
+
+/**
+ * Simulated firmware of a single device: Answers "getid", and sends its lines once the go flag is set.
+ *
+ * @param loopbackPort Port of the device.
+ * @param deviceId ID to answer "getid" with.
+ * @param lines Number of lines to be sent.
+ * @param go Set once all devices are added.
+*/
+void runFirmware( LoopbackTransportFactory::LoopbackPortPointer loopbackPort, std::string deviceId, unsigned long long lines, const std::atomic_bool & go )
+{
+    std::string command;
+
+    while ( !go && !loopbackPort->isDisconnected() )
+    {
+        if ( loopbackPort->readFromGateway( command, 10 ) && command == "getid" )
+        {
+            loopbackPort->writeToGateway( "id:" + deviceId + "\n" );
+        }
+    }
+
+    for ( unsigned long long line = 0; line < lines; line++ )
+    {
+        if ( !loopbackPort->writeToGateway( "telemetry:" + std::to_string( line ) + ",21.5,48.2,1013.25\n" ) )
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * Runs the benchmark with one way of fanning out, and prints the results.
+ *
+ * @param name Name of the run, to be printed.
+ * @param useEventBus Whether the consumers read the event bus, instead of copies.
+ * @param slowDelay Time in µs the alarm checker takes per message.
+ * @param options Benchmark options.
+*/
+void runFanOut( std::string name, bool useEventBus, unsigned int slowDelay, const Options & options )
+{
+    BenchFixture fixture( "event-bus", { "INBOUND_QUEUE_CAPACITY=1024", "EVENT_BUS_CAPACITY=" + std::to_string( useEventBus ? options.capacity : 0 ) } );
+
+    LoopbackTransportFactory * loopbackTransportFactory = new LoopbackTransportFactory();
+    BenchGateway * gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    gateway->useSerialTransportFactory( loopbackTransportFactory );
+
+    std::vector<std::string> consumerNames = { "mqtt", "database", "alarms" };
+    std::vector<Consumer *> consumers;
+    std::vector<std::thread> consumerThreads;
+    std::atomic_bool stop( false );
+
+    for ( std::string const & consumerName : consumerNames )
+    {
+        Consumer * consumer = new Consumer();
+        consumer->name = consumerName;
+        consumer->delay = consumerName == "alarms" ? slowDelay : 0;
+        consumer->received = 0;
+        consumer->lagSum = 0;
+        consumer->maxLag = 0;
+        consumer->contentBytes = 0;
+
+        if ( useEventBus )
+        {
+            consumer->eventConsumer = gateway->getEventBusInstance()->addConsumer( consumerName );
+            consumerThreads.push_back( std::thread( runEventBusConsumer, gateway->getEventBusInstance(), consumer, std::cref( stop ) ) );
+        }
+        else
+        {
+            gateway->copyingConsumers.push_back( consumer );
+            consumerThreads.push_back( std::thread( runCopyingConsumer, consumer, std::cref( stop ) ) );
+        }
+
+        consumers.push_back( consumer );
+    }
+
+    std::atomic_bool go( false );
+    std::vector<std::thread> firmwares;
+
+    for ( unsigned int index = 0; index < options.devices; index++ )
+    {
+        std::string deviceId = "loop" + std::to_string( index );
+        firmwares.push_back( std::thread( runFirmware, loopbackTransportFactory->addPort( "/loopback/" + deviceId ), deviceId, options.lines, std::cref( go ) ) );
+    }
+
+    gateway->start();
+    unsigned int added = gateway->addNewSerialPorts( true );
+
+    // Streaming, until every consumer got every message (or nothing moved for a second)
+    unsigned long long expected = static_cast<unsigned long long>( added ) * options.lines;
+    Clock::time_point streamBegin = Clock::now();
+    go = true;
+
+    unsigned long long lastReceived = 0;
+    unsigned long long lagSamples = 0;
+    Clock::time_point lastProgress = streamBegin;
+
+    while ( Clock::now() - lastProgress < std::chrono::seconds( 1 ) )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        std::map<std::string, unsigned long long> lags = useEventBus ? gateway->getEventBusInstance()->getConsumerLags() : std::map<std::string, unsigned long long>();
+        unsigned long long received = 0;
+
+        // Sampled like a monitoring thread would do it, to spot a slow consumer
+        for ( Consumer * consumer : consumers )
+        {
+            unsigned long long lag = 0;
+
+            if ( useEventBus )
+            {
+                lag = lags[consumer->name];
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock( consumer->mutex );
+                lag = consumer->copies.size();
+            }
+
+            consumer->lagSum += lag;
+            consumer->maxLag = std::max( consumer->maxLag, lag );
+            received += consumer->received;
+        }
+
+        lagSamples++;
+
+        if ( received == expected * consumers.size() )
+        {
+            break;
+        }
+
+        if ( received != lastReceived )
+        {
+            lastReceived = received;
+            lastProgress = Clock::now();
+        }
+    }
+
+    double streamSeconds = std::chrono::duration<double>( Clock::now() - streamBegin ).count();
+    unsigned long long stallCount = useEventBus ? gateway->getEventBusInstance()->getStallCount() : 0;
+
+    std::cout << std::setw( 14 ) << name << ":  " << std::setw( 8 ) << static_cast<unsigned long long>( expected / streamSeconds ) << " messages/s";
+
+    for ( Consumer * consumer : consumers )
+    {
+        std::cout << "  " << consumer->name << " " << consumer->received << " (lag mean " << consumer->lagSum / std::max<unsigned long long>( lagSamples, 1 ) << ", max " << consumer->maxLag << ")";
+    }
+
+    std::cout << "  stalls " << stallCount << "  (devices added: " << added << ")" << std::endl;
+
+    stop = true;
+
+    for ( std::thread & consumerThread : consumerThreads )
+    {
+        consumerThread.join();
+    }
+
+    if ( useEventBus )
+    {
+        for ( Consumer * consumer : consumers )
+        {
+            gateway->getEventBusInstance()->removeConsumer( consumer->eventConsumer );
+        }
+    }
+
+    gateway->stop();
+
+    // Unplug every device, including those which didn't get added, so every firmware stops
+    for ( unsigned int index = 0; index < options.devices; index++ )
+    {
+        loopbackTransportFactory->removePort( "/loopback/loop" + std::to_string( index ) );
+    }
+
+    for ( std::thread & firmware : firmwares )
+    {
+        firmware.join();
+    }
+
+    delete gateway;
+
+    for ( Consumer * consumer : consumers )
+    {
+        delete consumer;
+    }
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode; 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    std::cout << options.devices << " devices, " << options.lines << " lines each, 3 consumers, event bus capacity " << options.capacity << std::endl;
+
+    runFanOut( "copies", false, 0, options );
+    runFanOut( "event bus", true, 0, options );
+    runFanOut( "slow consumer", true, options.slowDelay, options );
+
+    return 0;
+}
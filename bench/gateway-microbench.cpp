@@ -0,0 +1,323 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <stdlib.h> // malloc, free
+
+// C++ Standard Libraries
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <new> // std::bad_alloc
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+
+/**
+ * gateway-microbench application
+ * File: gateway-microbench.cpp
+ * Purpose: Measures the single-threaded cost of the gateway's hot helpers, as a baseline for optimizing them:
+ *          parseMessage over a realistic mix of lines, SerialMessage construction and copying, getSerialDeviceById/getSerialDeviceByPort
+ *          with 10 to 10k devices, and the virtual messageCallback dispatch. Prints ns/op and allocations/op (counted on the calling thread).
+ *          The private helpers are reached through the SerialPortGatewayProbe, which SerialPortGateway declares as friend.
+ *          Usage: gateway-microbench [<iterations>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: gateway-microbench [<iterations>]";
+
+// Variables
+thread_local unsigned long long allocationCount = 0; // Allocations of the current thread
+
+// Global allocation functions, which count every allocation of the current thread; Not inlined, so the compiler doesn't see malloc/free paired with new/delete
+__attribute__((noinline)) void * operator new( std::size_t size )
+{
+    allocationCount++;
+    void * pointer = malloc( size == 0 ? 1 : size );
+
+    if ( pointer == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+__attribute__((noinline)) void operator delete( void * pointer ) noexcept
+{
+    free( pointer );
+}
+
+__attribute__((noinline)) void operator delete( void * pointer, std::size_t ) noexcept
+{
+    free( pointer );
+}
+
+/**
+ * SerialPortGatewayProbe class
+ * Purpose: Test-friend hook; Forwards to the gateway's private helpers.
+*/
+class SerialPortGatewayProbe
+{
+public:
+    // Types
+    typedef SerialPortGateway::StringPair StringPair;
+
+    // Methods
+    static StringPair parseMessage( SerialPortGateway & gateway, const std::string & message, const std::string & delimiter )
+    {
+        return gateway.parseMessage( message, delimiter );
+    }
+
+    static bool hasSerialDeviceWithId( SerialPortGateway & gateway, const std::string & deviceId )
+    {
+        return gateway.getSerialDeviceById( deviceId ) != nullptr;
+    }
+
+    static bool hasSerialDeviceWithPort( SerialPortGateway & gateway, const std::string & serialPort )
+    {
+        return gateway.getSerialDeviceByPort( serialPort ) != nullptr;
+    }
+
+    /**
+     * Registers devices without opening their ports, so only the lookups are measured.
+    */
+    static void addUnopenedSerialDevices( SerialPortGateway & gateway, unsigned int devices )
+    {
+        for ( unsigned int index = 0; index < devices; index++ )
+        {
+            std::string deviceId = "device" + std::to_string( index );
+            ( * gateway.getSerialDevices() )[deviceId] = std::make_shared<SerialDevice>( "/dev/ttyBENCH" + std::to_string( index ) );
+        }
+    }
+
+    static void clearSerialDevices( SerialPortGateway & gateway )
+    {
+        gateway.getSerialDevices()->clear();
+    }
+
+    static void messageCallback( SerialPortGateway & gateway, SerialMessage serialMessage )
+    {
+        gateway.messageCallback( serialMessage );
+    }
+
+    static void runMessageCallback( SerialPortGateway & gateway, SerialMessage serialMessage, GatewayMetrics::DeviceMetricsPointer deviceMetrics )
+    {
+        deviceMetrics->changeInFlightCallbacks( 1 );
+        gateway.runMessageCallback( SerialPortGateway::CallbackType::MESSAGE, serialMessage.getDeviceId(), serialMessage, SchemaRecord(), std::chrono::steady_clock::now(), deviceMetrics, TraceContext() );
+    }
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway with a message callback which only counts, so the dispatch itself is measured.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    std::size_t received;
+
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        received = 0;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        received++;
+    }
+};
+
+/**
+ * Runs an operation "iterations" times (after a warm-up), and prints the time and the allocations per operation.
+ *
+ * @param name Name of the run, to be printed.
+ * @param iterations Number of operations.
+ * @param operation Function running a single operation (getting its index); Returns a value, which gets consumed so the operation can't be optimized away.
+*/
+template<typename Operation>
+void runMicrobenchmark( std::string name, unsigned long long iterations, Operation operation )
+{
+    volatile std::size_t sink = 0;
+
+    for ( unsigned long long index = 0; index < iterations / 10; index++ )
+    {
+        sink = sink + operation( index );
+    }
+
+    unsigned long long allocationsBefore = allocationCount;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    for ( unsigned long long index = 0; index < iterations; index++ )
+    {
+        sink = sink + operation( index );
+    }
+
+    double nanoseconds = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - begin ).count();
+    double allocations = static_cast<double>( allocationCount - allocationsBefore );
+
+    std::cout << "\t" << name << ": " << nanoseconds / iterations << " ns/op, " << allocations / iterations << " allocs/op" << std::endl;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    unsigned long long iterations = 1000000;
+
+    try
+    {
+        if ( argc > 2 )
+        {
+            throw std::invalid_argument( "Too many arguments." );
+        }
+
+        if ( argc > 1 )
+        {
+            iterations = parseUnsignedOption( "<iterations>", argv[1] );
+        }
+
+        if ( iterations == 0 )
+        {
+            throw std::invalid_argument( "Iterations must be > 0." );
+        }
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    BenchFixture fixture( "microbench" );
+
+    BenchGateway * gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+
+    std::cout << "Iterations: " << iterations << std::endl;
+
+    // parseMessage; The mix roughly follows what devices send: Mostly telemetry, some IDs and logs, and a few malformed lines
+    std::vector<std::string> lines = {
+        "telemetry:23.51,45.10,1013.25,0.98\n",
+        "telemetry:23.52,45.08,1013.24,0.97\n",
+        "telemetry:23.52,45.07,1013.26,0.97\r\n",
+        "telemetry:23.53,45.07,1013.25,0.96\n",
+        "id:sensor-0042\n",
+        "log:Calibration finished after 1532 ms, offset -0.0123, gain 1.0042, temperature 23.5 C\n",
+        "status:\n",
+        ":noType\n",
+        "noDelimiter\n",
+        "telemetry:23.54,45.0" // Truncated by a timeout
+    };
+    std::string delimiter = ":";
+
+    std::cout << "parseMessage (" << lines.size() << " line mix):" << std::endl;
+    runMicrobenchmark( "parseMessage", iterations, [&]( unsigned long long index )
+    {
+        SerialPortGatewayProbe::StringPair parsedMessage = SerialPortGatewayProbe::parseMessage( * gateway, lines[index % lines.size()], delimiter );
+        return parsedMessage.first.size() + parsedMessage.second.size();
+    } );
+
+    // SerialMessage
+    std::string deviceId = "sensor-0042";
+    std::string type = "telemetry";
+    std::string content = "23.51,45.10,1013.25,0.98";
+    SerialMessage serialMessage( deviceId, 1548000000000ULL, type, content );
+
+    std::cout << "SerialMessage:" << std::endl;
+    runMicrobenchmark( "construct (with timestamp)", iterations, [&]( unsigned long long index )
+    {
+        SerialMessage message( deviceId, 1548000000000ULL, type, content );
+        return static_cast<std::size_t>( message.getTimestamp() );
+    } );
+    runMicrobenchmark( "construct (system timestamp)", iterations, [&]( unsigned long long index )
+    {
+        SerialMessage message( deviceId, type, content );
+        return static_cast<std::size_t>( message.getTimestamp() );
+    } );
+    runMicrobenchmark( "copy", iterations, [&]( unsigned long long index )
+    {
+        SerialMessage copy = serialMessage;
+        return static_cast<std::size_t>( copy.getTimestamp() );
+    } );
+
+    // Lookups
+    for ( unsigned int devices : { 10, 100, 1000, 10000 } )
+    {
+        SerialPortGatewayProbe::addUnopenedSerialDevices( * gateway, devices );
+
+        std::vector<std::string> deviceIds;
+        std::vector<std::string> ports;
+
+        for ( unsigned int index = 0; index < devices; index++ )
+        {
+            deviceIds.push_back( "device" + std::to_string( ( index * 7919 ) % devices ) ); // Spread over the map, not in insertion order
+            ports.push_back( "/dev/ttyBENCH" + std::to_string( ( index * 7919 ) % devices ) );
+        }
+
+        unsigned long long lookups = devices >= 1000 ? iterations / ( devices / 100 ) : iterations; // The port lookup is linear; Keeps the run time in bounds
+
+        std::cout << "Lookups (" << devices << " devices):" << std::endl;
+        runMicrobenchmark( "getSerialDeviceById", iterations, [&]( unsigned long long index )
+        {
+            return static_cast<std::size_t>( SerialPortGatewayProbe::hasSerialDeviceWithId( * gateway, deviceIds[index % devices] ) );
+        } );
+        runMicrobenchmark( "getSerialDeviceByPort", lookups, [&]( unsigned long long index )
+        {
+            return static_cast<std::size_t>( SerialPortGatewayProbe::hasSerialDeviceWithPort( * gateway, ports[index % devices] ) );
+        } );
+
+        SerialPortGatewayProbe::clearSerialDevices( * gateway );
+    }
+
+    // Callback dispatch
+    GatewayMetrics::DeviceMetricsPointer deviceMetrics = std::make_shared<DeviceMetrics>( deviceId );
+
+    std::cout << "messageCallback:" << std::endl;
+    runMicrobenchmark( "virtual call", iterations, [&]( unsigned long long index )
+    {
+        SerialPortGatewayProbe::messageCallback( * gateway, serialMessage );
+        return gateway->received;
+    } );
+    runMicrobenchmark( "runMessageCallback (metrics, tracing off)", iterations, [&]( unsigned long long index )
+    {
+        SerialPortGatewayProbe::runMessageCallback( * gateway, serialMessage, deviceMetrics );
+        return gateway->received;
+    } );
+
+    delete gateway;
+
+    return 0;
+}
@@ -0,0 +1,392 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+// C Standard Libraries
+#include <unistd.h> // fork, pipe, read, write, close
+#include <sys/wait.h> // waitpid
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm> // std::max
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * handover-bench application
+ * File: handover-bench.cpp
+ * Purpose: Measures what replacing a running gateway costs, against virtual devices (served by a forked child process) which stream telemetry
+ *          and reset on open, like Arduinos do on DTR, needing <bootDelay> to boot. Each device numbers its telemetry lines, so gaps show lost lines.
+ *          The replacement is done twice: Once as a restart (the old gateway stops, and a new one adds every port again), and once as a handover
+ *          (the new gateway takes the devices over from the old one via "HANDOVER_SOCKET"; Both run in this process, but the descriptors still go through the socket).
+ *          Prints per run the median and maximum downtime per device (the longest time without a line), and the lines lost and received twice.
+ *          Usage: handover-bench [--devices <n>] [--boot-delay <ms>] [--rate <linesPerSecondPerDevice>] [--duration <seconds>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: handover-bench [--devices <n>] [--boot-delay <ms>] [--rate <linesPerSecondPerDevice>] [--duration <seconds>]";
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    unsigned int bootDelay; // ms
+    unsigned int rate; // Lines per second, per device
+    double duration; // Seconds of streaming before, and after the replacement
+};
+
+struct DeviceTrack
+{
+    unsigned long long lastSequence;
+    Clock::time_point lastTime;
+    double maxGap; // ms
+    unsigned long long lost;
+    unsigned long long duplicated;
+};
+
+/**
+ * SequenceTracker class
+ * Purpose: Tracks the telemetry sequence numbers of every device, across the gateways which receive them.
+*/
+class SequenceTracker
+{
+private:
+    // Variables
+    std::map<std::string, DeviceTrack> tracks;
+    std::mutex mutex;
+
+public:
+    // Methods
+    void record( std::string deviceId, unsigned long long sequence )
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        Clock::time_point now = Clock::now();
+        std::map<std::string, DeviceTrack>::iterator it = tracks.find( deviceId );
+
+        if ( it == tracks.end() )
+        {
+            tracks[deviceId] = DeviceTrack{ sequence, now, 0, 0, 0 };
+
+            return;
+        }
+
+        DeviceTrack & track = it->second;
+
+        if ( sequence <= track.lastSequence )
+        {
+            track.duplicated++;
+
+            return;
+        }
+
+        track.lost += sequence - track.lastSequence - 1;
+        track.maxGap = std::max( track.maxGap, std::chrono::duration<double, std::milli>( now - track.lastTime ).count() );
+        track.lastSequence = sequence;
+        track.lastTime = now;
+    }
+
+    std::map<std::string, DeviceTrack> getTracks()
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+
+        return tracks;
+    }
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway which hands the sequence numbers of the telemetry lines it receives to a tracker.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+private:
+    // Variables
+    SequenceTracker * tracker;
+
+public:
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath, SequenceTracker * tracker ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        this->tracker = tracker;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        if ( serialMessage.getType() == "telemetry" )
+        {
+            tracker->record( serialMessage.getDeviceId(), std::stoull( serialMessage.getContent() ) ); // Stops at the ","
+        }
+    }
+};
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 8, 1500, 50, 2 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--boot-delay" ) options.bootDelay = parseUnsignedOption( name, value );
+        else if ( name == "--rate" ) options.rate = parseUnsignedOption( name, value );
+        else if ( name == "--duration" ) options.duration = parseDoubleOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.rate == 0 || options.duration <= 0 )
+    {
+        throw std::invalid_argument( "Devices, rate and duration must be > 0." );
+    }
+
+    return options;
+}
+
+/**
+ * Stops a gateway, and waits for its read loops to quit.
+ *
+ * @param gateway Gateway to be stopped.
+*/
+void stopGateway( BenchGateway * gateway )
+{
+    gateway->stop();
+
+    while ( !gateway->isEveryReadLoopQuitted() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+}
+
+/**
+ * Streams telemetry to one gateway, replaces it by another, streams on, and prints the downtime and lost lines.
+ *
+ * @param name Name of the replacement, to be printed.
+ * @param handover Whether the new gateway takes the devices over, or adds them anew.
+ * @param ports Ports of the devices.
+ * @param options Benchmark options.
+ * @param controlFd Write end of the control pipe; "g" starts the telemetry, "s" stops it.
+*/
+void runReplacement( std::string name, bool handover, const std::vector<std::string> & ports, const Options & options, int controlFd )
+{
+    BenchFixture fixture( "handover", { "ADAPTIVE_HANDSHAKE=1", "LOG_LEVEL=OFF" } );
+    std::string socketFile = fixture.getPath( "handover.sock" );
+
+    if ( handover )
+    {
+        fixture.appendConfigLine( "HANDOVER_SOCKET=" + socketFile );
+    }
+
+    SequenceTracker tracker;
+    unsigned int failed = 0;
+    BenchGateway * oldGateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory(), &tracker );
+    oldGateway->start();
+
+    for ( std::string const & port : ports )
+    {
+        if ( !oldGateway->addSerialDevice( port, true ) )
+        {
+            failed++;
+        }
+    }
+
+    write( controlFd, "g", 1 );
+    std::this_thread::sleep_for( std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) ) );
+
+    BenchGateway * newGateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory(), &tracker );
+    Clock::time_point replacementBegin = Clock::now();
+
+    if ( handover )
+    {
+        newGateway->start();
+
+        while ( !oldGateway->isHandedOver() )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+    }
+    else
+    {
+        stopGateway( oldGateway ); // Closes the ports, so the devices reset when the new gateway opens them
+        newGateway->start();
+
+        // Like its scan would
+        for ( std::string const & port : ports )
+        {
+            if ( !newGateway->addSerialDevice( port, true ) )
+            {
+                failed++;
+            }
+        }
+    }
+
+    double replacementMilliseconds = std::chrono::duration<double, std::milli>( Clock::now() - replacementBegin ).count();
+
+    delete oldGateway;
+
+    std::this_thread::sleep_for( std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) ) );
+    write( controlFd, "s", 1 );
+    stopGateway( newGateway );
+    delete newGateway;
+
+    std::vector<double> downtimes;
+    unsigned long long lost = 0;
+    unsigned long long duplicated = 0;
+
+    for ( std::pair<const std::string, DeviceTrack> const & entry : tracker.getTracks() )
+    {
+        downtimes.push_back( entry.second.maxGap );
+        lost += entry.second.lost;
+        duplicated += entry.second.duplicated;
+    }
+
+    std::sort( downtimes.begin(), downtimes.end() );
+
+    std::cout << std::setw( 9 ) << name << ":  replacement " << std::setw( 6 ) << static_cast<unsigned int>( replacementMilliseconds ) << " ms  ";
+
+    if ( downtimes.empty() )
+    {
+        std::cout << "no telemetry received";
+    }
+    else
+    {
+        std::cout << "downtime median " << std::setw( 6 ) << static_cast<unsigned int>( downtimes[downtimes.size() / 2] ) << " ms  "
+                  << "max " << std::setw( 6 ) << static_cast<unsigned int>( downtimes.back() ) << " ms  "
+                  << "lines lost " << std::setw( 5 ) << lost << "  received twice " << duplicated;
+    }
+
+    std::cout << "  (failed: " << failed << ")" << std::endl;
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode; 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    DeviceSimulator simulator;
+    std::vector<std::string> ports;
+    DeviceBehaviour behaviour;
+    behaviour.telemetryRate = options.rate;
+    behaviour.bootDelay = options.bootDelay;
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            ports.push_back( simulator.addDevice( "handover" + std::to_string( index ), behaviour )->getPort() );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    // The devices get served by a child process, so the gateway's threads don't share a scheduler with them
+    int controlPipe[2];
+
+    if ( pipe( controlPipe ) != 0 )
+    {
+        std::cerr << "Couldn't create pipe: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    pid_t farm = fork();
+
+    if ( farm == 0 )
+    {
+        char control;
+        close( controlPipe[1] );
+        simulator.start();
+
+        while ( read( controlPipe[0], &control, 1 ) > 0 )
+        {
+            simulator.setTelemetryActive( control == 'g' );
+        }
+
+        simulator.stop();
+        _exit( 0 );
+    }
+
+    close( controlPipe[0] );
+
+    std::cout << options.devices << " devices, boot delay " << options.bootDelay << " ms, " << options.rate << " lines/s each" << std::endl;
+
+    runReplacement( "restart", false, ports, options, controlPipe[1] );
+    runReplacement( "handover", true, ports, options, controlPipe[1] );
+
+    close( controlPipe[1] );
+    waitpid( farm, nullptr, 0 );
+
+    return 0;
+}
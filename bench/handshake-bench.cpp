@@ -0,0 +1,308 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <unistd.h> // fork, pipe, read, close
+#include <sys/wait.h> // waitpid
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <algorithm> // std::sort
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * handshake-bench application
+ * File: handshake-bench.cpp
+ * Purpose: Measures how long it takes to register a device, from opening its port until it's added, against virtual devices which reset on open
+ *          (like Arduinos do on DTR) and need a while to boot. The boot delays are spread evenly between <bootDelay> - <jitter> and <bootDelay> + <jitter>.
+ *          Every device gets added in a few rounds (the gateway gets stopped in between, which closes the ports), once with the fixed
+ *          "WAIT_BEFORE_COMMUNICATION" sleep, once with the adaptive handshake, and once with the adaptive handshake while the modem lines of every port are held;
+ *          The adaptive handshake learns the boot delay in the first round, and with held lines, the devices only reset in the first round.
+ *          Prints the median, 90th percentile and maximum time-to-registered per round, and the time it took to add all devices.
+ *          Usage: handshake-bench [--devices <n>] [--boot-delay <ms>] [--jitter <ms>] [--boot-message <line>] [--wait <ms>] [--rounds <n>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: handshake-bench [--devices <n>] [--boot-delay <ms>] [--jitter <ms>] [--boot-message <line>] [--wait <ms>] [--rounds <n>]";
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    unsigned int bootDelay; // ms
+    unsigned int jitter; // ms
+    std::string bootMessage; // Empty means the devices stay silent after booting
+    unsigned int wait; // ms; WAIT_BEFORE_COMMUNICATION of the fixed handshake
+    unsigned int rounds;
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway which ignores all messages.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+public:
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+    }
+};
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 20, 300, 100, "", 500, 3 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--boot-delay" ) options.bootDelay = parseUnsignedOption( name, value );
+        else if ( name == "--jitter" ) options.jitter = parseUnsignedOption( name, value );
+        else if ( name == "--boot-message" ) options.bootMessage = value;
+        else if ( name == "--wait" ) options.wait = parseUnsignedOption( name, value );
+        else if ( name == "--rounds" ) options.rounds = parseUnsignedOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.rounds == 0 || options.jitter > options.bootDelay )
+    {
+        throw std::invalid_argument( "Devices and rounds must be > 0, and the jitter must not exceed the boot delay." );
+    }
+
+    return options;
+}
+
+/**
+ * Gets a percentile of a sorted list of durations.
+ *
+ * @param durations Sorted durations.
+ * @param percentile Percentile, e.g. 50.
+ * @return Duration at the percentile.
+*/
+double getPercentile( const std::vector<double> & durations, double percentile )
+{
+    std::size_t index = static_cast<std::size_t>( percentile / 100 * ( durations.size() - 1 ) + 0.5 );
+
+    return durations[index];
+}
+
+/**
+ * Adds every device in a few rounds, with one handshake configuration, and prints the results per round.
+ *
+ * @param name Name of the handshake, to be printed.
+ * @param configLines Config lines of the handshake.
+ * @param resetControl Reset control of every port, e.g. "hold"; Empty means the default.
+ * @param ports Ports of the devices.
+ * @param options Benchmark options.
+*/
+void runHandshake( std::string name, std::vector<std::string> configLines, std::string resetControl, const std::vector<std::string> & ports, const Options & options )
+{
+    configLines.insert( configLines.begin(), "LOG_LEVEL=OFF" );
+    BenchFixture fixture( "handshake", configLines );
+
+    if ( !resetControl.empty() )
+    {
+        std::string resetControls;
+
+        for ( std::string const & port : ports )
+        {
+            resetControls += port + "=" + resetControl + "\n";
+        }
+
+        fixture.appendConfigLine( "RESET_CONTROL_FILE=" + fixture.writeFile( "reset-control.txt", resetControls ) );
+    }
+
+    BenchGateway * gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+
+    for ( unsigned int round = 1; round <= options.rounds; round++ )
+    {
+        std::vector<double> durations;
+        unsigned int failed = 0;
+
+        gateway->start();
+        Clock::time_point roundBegin = Clock::now();
+
+        // One after another, like the scan does
+        for ( std::string const & port : ports )
+        {
+            Clock::time_point begin = Clock::now();
+
+            if ( gateway->addSerialDevice( port, true ) )
+            {
+                durations.push_back( std::chrono::duration<double, std::milli>( Clock::now() - begin ).count() );
+            }
+            else
+            {
+                failed++;
+            }
+        }
+
+        double totalMilliseconds = std::chrono::duration<double, std::milli>( Clock::now() - roundBegin ).count();
+        std::sort( durations.begin(), durations.end() );
+
+        std::cout << std::setw( 10 ) << name << "  round " << round << ":  ";
+
+        if ( durations.empty() )
+        {
+            std::cout << "no device registered";
+        }
+        else
+        {
+            std::cout << "median " << std::setw( 6 ) << static_cast<unsigned int>( getPercentile( durations, 50 ) ) << " ms  "
+                      << "p90 " << std::setw( 6 ) << static_cast<unsigned int>( getPercentile( durations, 90 ) ) << " ms  "
+                      << "max " << std::setw( 6 ) << static_cast<unsigned int>( durations.back() ) << " ms  "
+                      << "all devices " << std::setw( 7 ) << static_cast<unsigned int>( totalMilliseconds ) << " ms";
+        }
+
+        std::cout << "  (failed: " << failed << ")" << std::endl;
+
+        gateway->stop(); // Closes the ports, so the devices reset again when they get opened in the next round
+
+        while ( !gateway->isEveryReadLoopQuitted() )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        }
+    }
+
+    delete gateway;
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode; 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    DeviceSimulator simulator;
+    std::vector<std::string> ports;
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            DeviceBehaviour behaviour;
+            behaviour.telemetryRate = 0;
+            behaviour.bootMessage = options.bootMessage;
+            behaviour.bootDelay = options.bootDelay - options.jitter + ( options.devices > 1 ? 2 * options.jitter * index / ( options.devices - 1 ) : options.jitter );
+
+            ports.push_back( simulator.addDevice( "boot" + std::to_string( index ), behaviour )->getPort() );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    // The devices get served by a child process, so the gateway's threads don't share a scheduler with them
+    int controlPipe[2];
+
+    if ( pipe( controlPipe ) != 0 )
+    {
+        std::cerr << "Couldn't create pipe: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    pid_t farm = fork();
+
+    if ( farm == 0 )
+    {
+        char control;
+        close( controlPipe[1] );
+        simulator.start();
+
+        while ( read( controlPipe[0], &control, 1 ) > 0 );
+
+        simulator.stop();
+        _exit( 0 );
+    }
+
+    close( controlPipe[0] );
+
+    std::cout << options.devices << " devices, boot delay " << options.bootDelay - options.jitter << " - " << options.bootDelay + options.jitter << " ms"
+              << ( options.bootMessage.empty() ? "" : ", boot message \"" + options.bootMessage + "\"" ) << std::endl;
+
+    runHandshake( "fixed", { "WAIT_BEFORE_COMMUNICATION=" + std::to_string( options.wait ) }, "", ports, options );
+    runHandshake( "adaptive", { "WAIT_BEFORE_COMMUNICATION=" + std::to_string( options.wait ), "ADAPTIVE_HANDSHAKE=1" }, "", ports, options );
+    runHandshake( "hold", { "WAIT_BEFORE_COMMUNICATION=" + std::to_string( options.wait ), "ADAPTIVE_HANDSHAKE=1" }, "hold", ports, options ); // Last, since the lines stay held afterwards
+
+    close( controlPipe[1] );
+    waitpid( farm, nullptr, 0 );
+
+    return 0;
+}
@@ -0,0 +1,310 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <unistd.h> // fork, pipe, read, write, close
+#include <sys/wait.h> // waitpid
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * latency-bench application
+ * File: latency-bench.cpp
+ * Purpose: Measures the end-to-end latency (firmware write until message callback) of small telemetry lines per latency profile (See LatencyProfile),
+ *          against virtual devices on ptys, which get served by a forked child process. Every profile gets its own gateway with "LATENCY_PROFILE=<profile>";
+ *          The devices are added, stream for a warm-up period which isn't recorded, and then for the duration.
+ *          Prints p50, p99 and the maximum latency per profile. On ptys, only the read timeout takes effect: The gateway skips ASYNC_LOW_LATENCY and
+ *          the latency timer, which ptys don't have, and VMIN/VTIME get set, but don't change when the gateway's non-blocking reads wake up.
+ *          Usage: latency-bench [--devices <n>] [--rate <linesPerSecondPerDevice>] [--size <bytesPerLine>] [--warmup <seconds>] [--duration <seconds>] [--profile <profile>]...
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: latency-bench [--devices <n>] [--rate <linesPerSecondPerDevice>] [--size <bytesPerLine>] [--warmup <seconds>] [--duration <seconds>] [--profile <profile>]...";
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    unsigned int rate; // Lines per second, per device
+    unsigned int size; // Bytes per line, including the newline
+    double warmup; // Seconds of streaming which aren't recorded
+    double duration; // Seconds of streaming which are recorded
+    std::vector<std::string> profiles;
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway which records the end-to-end latency of every streamed line, once recording is active.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    LatencyHistogram latency; // µs
+    std::atomic<bool> recording;
+
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        recording = false;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        // Content: "<sequence>,<steady clock ns when written>,<padding>"
+        std::string content = serialMessage.getContent();
+        std::size_t first = content.find( ',' );
+
+        if ( !recording || serialMessage.getType() != "telemetry" || first == std::string::npos )
+        {
+            return;
+        }
+
+        unsigned long long writeTime = std::stoull( content.substr( first + 1 ) );
+        unsigned long long now = std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+
+        latency.record( now > writeTime ? ( now - writeTime ) / 1000 : 0 );
+    }
+};
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 4, 50, 32, 1, 5, {} };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--rate" ) options.rate = parseUnsignedOption( name, value );
+        else if ( name == "--size" ) options.size = parseUnsignedOption( name, value );
+        else if ( name == "--warmup" ) options.warmup = parseDoubleOption( name, value );
+        else if ( name == "--duration" ) options.duration = parseDoubleOption( name, value );
+        else if ( name == "--profile" ) options.profiles.push_back( value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.rate == 0 || options.duration <= 0 || options.warmup < 0 )
+    {
+        throw std::invalid_argument( "Devices, rate and duration must be > 0, and the warm-up must not be negative." );
+    }
+
+    if ( options.profiles.empty() )
+    {
+        // "low" only differs from "default" on real ttys
+        options.profiles = { "default", "low", "read_timeout=20" };
+    }
+
+    return options;
+}
+
+/**
+ * Sleeps for a number of seconds.
+ *
+ * @param seconds Seconds to sleep.
+*/
+void sleepSeconds( double seconds )
+{
+    std::this_thread::sleep_for( std::chrono::microseconds( static_cast<long long>( seconds * 1e6 ) ) );
+}
+
+/**
+ * Streams telemetry from all devices to a gateway with one latency profile, and prints the results.
+ *
+ * @param profile Latency profile, as in "LATENCY_PROFILE".
+ * @param ports Ports of the devices.
+ * @param options Benchmark options.
+ * @param controlFd Write end of the control pipe; "g" starts the telemetry, "s" stops it.
+*/
+void runProfile( std::string profile, const std::vector<std::string> & ports, const Options & options, int controlFd )
+{
+    BenchFixture fixture( "latency", { "LOG_LEVEL=OFF", "LATENCY_PROFILE=" + profile } );
+
+    BenchGateway * gateway;
+
+    try
+    {
+        gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    }
+    catch ( const Exception & e )
+    {
+        std::cout << std::setw( 36 ) << profile << "  " << e.what() << std::endl;
+
+        return;
+    }
+
+    unsigned int failed = 0;
+    gateway->start();
+
+    for ( std::string const & port : ports )
+    {
+        if ( !gateway->addSerialDevice( port, true ) )
+        {
+            failed++;
+        }
+    }
+
+    write( controlFd, "g", 1 );
+    sleepSeconds( options.warmup );
+    gateway->recording = true;
+    sleepSeconds( options.duration );
+    gateway->recording = false;
+    write( controlFd, "s", 1 );
+
+    LatencyHistogramSnapshot latency;
+    gateway->latency.addTo( latency );
+
+    gateway->stop();
+
+    while ( !gateway->isEveryReadLoopQuitted() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    delete gateway;
+
+    std::cout << std::setw( 36 ) << profile << "  lines " << std::setw( 7 ) << latency.getCount()
+              << "  p50 " << std::setw( 8 ) << latency.getPercentile( 50 ) << " us"
+              << "  p99 " << std::setw( 8 ) << latency.getPercentile( 99 ) << " us"
+              << "  max " << std::setw( 8 ) << latency.getMax() << " us"
+              << "  (failed: " << failed << ")" << std::endl;
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode; 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    DeviceSimulator simulator;
+    std::vector<std::string> ports;
+    DeviceBehaviour behaviour;
+    behaviour.telemetryRate = options.rate;
+    behaviour.telemetrySize = options.size;
+    behaviour.outputBufferSize = 1024 * 1024;
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            ports.push_back( simulator.addDevice( "latency" + std::to_string( index ), behaviour )->getPort() );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    // The devices get served by a child process, so the gateway's threads don't share a scheduler with them
+    int controlPipe[2];
+
+    if ( pipe( controlPipe ) != 0 )
+    {
+        std::cerr << "Couldn't create pipe: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    pid_t farm = fork();
+
+    if ( farm == 0 )
+    {
+        char control;
+        close( controlPipe[1] );
+        simulator.start();
+
+        while ( read( controlPipe[0], &control, 1 ) > 0 )
+        {
+            simulator.setTelemetryActive( control == 'g' );
+        }
+
+        simulator.stop();
+        _exit( 0 );
+    }
+
+    close( controlPipe[0] );
+
+    std::cout << options.devices << " devices, " << options.rate << " lines/s of " << options.size << " bytes each, " << options.duration << " s per profile" << std::endl;
+
+    for ( std::string const & profile : options.profiles )
+    {
+        runProfile( profile, ports, options, controlPipe[1] );
+    }
+
+    close( controlPipe[1] );
+    waitpid( farm, nullptr, 0 );
+
+    return 0;
+}
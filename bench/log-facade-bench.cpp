@@ -0,0 +1,135 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C++ Standard Libraries
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include "../src/StructuredLogger.hpp"
+#include "../dependencies/Logger/src/Logger.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+
+/**
+ * log-facade-bench application
+ * File: log-facade-bench.cpp
+ * Purpose: Measures the cost of a hot-path log call ("Delivered message ...") with console and file output turned off:
+ *          Once built eagerly as it used to be, and once via the StructuredLogger with the level disabled and enabled.
+ *          Usage: log-facade-bench [<iterations>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: log-facade-bench [<iterations>]";
+
+/**
+ * Runs a log call "numIterations" times and prints the average cost per call.
+ *
+ * @param name Name of the run, to be printed.
+ * @param numIterations Number of calls.
+ * @param log Function doing a single log call.
+ * @return Nanoseconds per call.
+*/
+template<typename LogFunction>
+double runBenchmark( std::string name, unsigned int numIterations, LogFunction log )
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    for ( unsigned int iteration = 0; iteration < numIterations; iteration++ )
+    {
+        log( iteration );
+    }
+
+    double nanoseconds = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - begin ).count() / numIterations;
+
+    std::cout << name << ": " << nanoseconds << " ns/call" << std::endl;
+
+    return nanoseconds;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    unsigned int numIterations = 1000000;
+
+    try
+    {
+        if ( argc > 2 )
+        {
+            throw std::invalid_argument( "Too many arguments." );
+        }
+
+        if ( argc > 1 )
+        {
+            numIterations = parseUnsignedOption( "<iterations>", argv[1] );
+        }
+
+        if ( numIterations == 0 )
+        {
+            throw std::invalid_argument( "Iterations must be > 0." );
+        }
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    BenchFixture fixture( "log-facade", {}, false );
+    Logger logger( "Bench", fixture.getDirectory(), false, false, true );
+    StructuredLogger structuredLogger( &logger, nullptr, LogLevel::WARN );
+    StructuredLogger * log = &structuredLogger;
+
+    std::string message = "led:255";
+    std::string deviceId = "SerialKiller";
+    std::size_t bytesWritten = message.length() + 1;
+
+    double eager = runBenchmark( "Eager string building", numIterations, [&]( unsigned int iteration )
+    {
+        logger.writeInfo( std::string( "Delivered message \"" + message + "\" to device with ID \"" + deviceId + "\" (Bytes written: " + std::to_string( bytesWritten ) + "/" + std::to_string( message.length() + 1 ) + ")." ) );
+    } );
+
+    double disabled = runBenchmark( "StructuredLogger, level disabled", numIterations, [&]( unsigned int iteration )
+    {
+        SPG_LOG_INFO( log, "Delivered message", logField( "message", message ), logField( "deviceId", deviceId ), logField( "bytesWritten", bytesWritten ), logField( "bytesExpected", message.length() + 1 ) );
+    } );
+
+    structuredLogger.setLevel( LogLevel::INFO );
+
+    double enabled = runBenchmark( "StructuredLogger, level enabled", numIterations, [&]( unsigned int iteration )
+    {
+        SPG_LOG_INFO( log, "Delivered message", logField( "message", message ), logField( "deviceId", deviceId ), logField( "bytesWritten", bytesWritten ), logField( "bytesExpected", message.length() + 1 ) );
+    } );
+
+    std::cout << "Disabled call: " << eager / disabled << "x cheaper than eager string building. Enabled call: " << enabled / eager << "x the cost of eager string building." << std::endl;
+
+    return 0;
+}
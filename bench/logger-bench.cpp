@@ -0,0 +1,158 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C++ Standard Libraries
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../src/AsyncLogger.hpp"
+#include "../dependencies/Logger/src/Logger.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+
+/**
+ * logger-bench application
+ * File: logger-bench.cpp
+ * Purpose: Measures how many log messages per second the gateway's hot paths can emit with file logging active,
+ *          once with the synchronous Logger and once with the AsyncLogger.
+ *          Usage: logger-bench [<threads> [<messagesPerThread>]]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: logger-bench [<threads> [<messagesPerThread>]]";
+
+/**
+ * Runs "numThreads" threads which each log "numMessages" delivery messages via the given function, and measures the throughput.
+ *
+ * @param name Name of the run, to be printed.
+ * @param numThreads Number of threads logging concurrently.
+ * @param numMessages Number of messages per thread.
+ * @param log Function to log a single message.
+ * @return Messages per second.
+*/
+template<typename LogFunction>
+double runBenchmark( std::string name, unsigned int numThreads, unsigned int numMessages, LogFunction log )
+{
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    for ( unsigned int threadIndex = 0; threadIndex < numThreads; threadIndex++ )
+    {
+        threads.push_back( std::thread( [threadIndex, numMessages, &log]()
+        {
+            std::string deviceId = "device" + std::to_string( threadIndex );
+
+            for ( unsigned int messageIndex = 0; messageIndex < numMessages; messageIndex++ )
+            {
+                std::string message = "led:" + std::to_string( messageIndex );
+                log( std::string( "Delivered message \"" + message + "\" to device with ID \"" + deviceId + "\" (Bytes written: " + std::to_string( message.length() + 1 ) + "/" + std::to_string( message.length() + 1 ) + ")." ) );
+            }
+        } ) );
+    }
+
+    for ( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count();
+    double messagesPerSecond = numThreads * numMessages / seconds;
+
+    std::cout << name << ": " << static_cast<unsigned long long>( messagesPerSecond ) << " messages/s (" << seconds << " s)" << std::endl;
+
+    return messagesPerSecond;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    unsigned int numThreads = 8;
+    unsigned int numMessages = 50000;
+
+    try
+    {
+        if ( argc > 3 )
+        {
+            throw std::invalid_argument( "Too many arguments." );
+        }
+
+        if ( argc > 1 )
+        {
+            numThreads = parseUnsignedOption( "<threads>", argv[1] );
+        }
+
+        if ( argc > 2 )
+        {
+            numMessages = parseUnsignedOption( "<messagesPerThread>", argv[2] );
+        }
+
+        if ( numThreads == 0 || numMessages == 0 )
+        {
+            throw std::invalid_argument( "Threads and messages per thread must be > 0." );
+        }
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    BenchFixture fixture( "logger", {}, false );
+    std::string logPath = fixture.getDirectory();
+
+    std::cout << "Log path: " << logPath << ", threads: " << numThreads << ", messages per thread: " << numMessages << std::endl;
+
+    Logger logger( "Sync", logPath, false, true, true );
+    double syncRate = runBenchmark( "Logger (sync)", numThreads, numMessages, [&logger]( const std::string & message )
+    {
+        logger.writeInfo( message );
+    } );
+
+    AsyncLogger asyncLogger( "Async", logPath, false, true, 65536 );
+    asyncLogger.start();
+    double asyncRate = runBenchmark( "AsyncLogger", numThreads, numMessages, [&asyncLogger]( const std::string & message )
+    {
+        asyncLogger.writeInfo( message );
+    } );
+
+    std::chrono::steady_clock::time_point flushBegin = std::chrono::steady_clock::now();
+    asyncLogger.stop();
+    double flushSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - flushBegin ).count();
+
+    unsigned long long numDropped = asyncLogger.getDroppedCount();
+    std::cout << "AsyncLogger flush on stop: " << flushSeconds << " s, dropped: " << numDropped << " of " << numThreads * numMessages << std::endl;
+    std::cout << "Speedup: " << asyncRate / syncRate << "x" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../src/LoopbackTransport.hpp"
+
+/**
+ * loopback-bench application
+ * File: loopback-bench.cpp
+ * Purpose: Measures the gateway's own ceiling, without the tty layer: The devices are loopback ports with simulated firmware in the same process,
+ *          which get discovered, answer the ID handshake, and then send their lines as fast as the gateway takes them.
+ *          Runs once with the message workers, and once with inbound queues. Prints the startup time (discovery and handshakes),
+ *          the throughput in messages per second, and the latency from writing a line until its message callback.
+ *          Usage: loopback-bench [<devices> [<linesPerDevice> [<inboundQueueCapacity>]]]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: loopback-bench [<devices> [<linesPerDevice> [<inboundQueueCapacity>]]]";
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway which only counts its messages, and records their latency.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    LatencyHistogram latency; // µs
+    std::atomic<unsigned long long> received;
+
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        received = 0;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        // Content: "<steady clock ns when written>"
+        unsigned long long writeTime = std::stoull( serialMessage.getContent() );
+        unsigned long long now = std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+
+        latency.record( now > writeTime ? ( now - writeTime ) / 1000 : 0 );
+        received++;
+    }
+};
+
+/**
+ * Simulated firmware of a single device: Answers "getid", and sends its lines once the go flag is set.
+ *
+ * @param loopbackPort Port of the device.
+ * @param deviceId ID to answer "getid" with.
+ * @param lines Number of lines to be sent.
+ * @param go Set once all devices are added.
+*/
+void runFirmware( LoopbackTransportFactory::LoopbackPortPointer loopbackPort, std::string deviceId, unsigned long long lines, const std::atomic_bool & go )
+{
+    std::string command;
+
+    while ( !go && !loopbackPort->isDisconnected() )
+    {
+        if ( loopbackPort->readFromGateway( command, 10 ) && command == "getid" )
+        {
+            loopbackPort->writeToGateway( "id:" + deviceId + "\n" );
+        }
+    }
+
+    for ( unsigned long long line = 0; line < lines; line++ )
+    {
+        unsigned long long now = std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+
+        if ( !loopbackPort->writeToGateway( "bench:" + std::to_string( now ) + "\n" ) )
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * Runs the benchmark with one gateway configuration, and prints the results.
+ *
+ * @param name Name of the run, to be printed.
+ * @param devices Number of devices.
+ * @param linesPerDevice Number of lines every device sends.
+ * @param inboundQueueCapacity Capacity of the inbound queues; 0 means the message workers process the messages.
+*/
+void runBenchmark( std::string name, unsigned int devices, unsigned long long linesPerDevice, unsigned int inboundQueueCapacity )
+{
+    BenchFixture fixture( "loopback", { "INBOUND_QUEUE_CAPACITY=" + std::to_string( inboundQueueCapacity ), "INBOUND_OVERFLOW_POLICY=block" } );
+
+    LoopbackTransportFactory * loopbackTransportFactory = new LoopbackTransportFactory();
+    BenchGateway * gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    gateway->useSerialTransportFactory( loopbackTransportFactory );
+
+    std::atomic_bool go( false );
+    std::vector<std::thread> firmwares;
+
+    for ( unsigned int index = 0; index < devices; index++ )
+    {
+        std::string deviceId = "loop" + std::to_string( index );
+        firmwares.push_back( std::thread( runFirmware, loopbackTransportFactory->addPort( "/loopback/" + deviceId ), deviceId, linesPerDevice, std::cref( go ) ) );
+    }
+
+    // Startup: Discovery and handshakes
+    Clock::time_point startupBegin = Clock::now();
+    gateway->start();
+    unsigned int added = gateway->addNewSerialPorts( true );
+    double startupMilliseconds = std::chrono::duration<double, std::milli>( Clock::now() - startupBegin ).count();
+
+    // Streaming, until every line got delivered (or nothing moved for a second)
+    unsigned long long expected = static_cast<unsigned long long>( added ) * linesPerDevice;
+    Clock::time_point streamBegin = Clock::now();
+    go = true;
+
+    unsigned long long lastReceived = 0;
+    Clock::time_point lastProgress = streamBegin;
+
+    while ( gateway->received < expected && Clock::now() - lastProgress < std::chrono::seconds( 1 ) )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+
+        if ( gateway->received != lastReceived )
+        {
+            lastReceived = gateway->received;
+            lastProgress = Clock::now();
+        }
+    }
+
+    double streamSeconds = std::chrono::duration<double>( Clock::now() - streamBegin ).count();
+    unsigned long long received = gateway->received;
+    LatencyHistogramSnapshot latency;
+    gateway->latency.addTo( latency );
+
+    gateway->stop();
+
+    // Unplug every device, including those which didn't get added, so every firmware stops
+    for ( unsigned int index = 0; index < devices; index++ )
+    {
+        loopbackTransportFactory->removePort( "/loopback/loop" + std::to_string( index ) );
+    }
+
+    for ( std::thread & firmware : firmwares )
+    {
+        firmware.join();
+    }
+
+    while ( !gateway->isEveryReadLoopQuitted() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    delete gateway;
+
+    std::cout << name << ":" << std::endl
+              << "\tadded " << added << " of " << devices << " devices in " << startupMilliseconds << " ms" << std::endl
+              << "\tdelivered " << received << " of " << expected << " messages in " << streamSeconds << " s (" << static_cast<unsigned long long>( received / streamSeconds ) << " messages/s)" << std::endl
+              << "\tlatency p50 " << latency.getPercentile( 50 ) << " us, p99 " << latency.getPercentile( 99 ) << " us, p99.9 " << latency.getPercentile( 99.9 ) << " us, max " << latency.getMax() << " us" << std::endl;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    unsigned int devices = 8;
+    unsigned long long linesPerDevice = 20000;
+    unsigned int inboundQueueCapacity = 1024;
+
+    try
+    {
+        if ( argc > 4 )
+        {
+            throw std::invalid_argument( "Too many arguments." );
+        }
+
+        if ( argc > 1 )
+        {
+            devices = parseUnsignedOption( "<devices>", argv[1] );
+        }
+
+        if ( argc > 2 )
+        {
+            linesPerDevice = parseUnsignedOption( "<linesPerDevice>", argv[2] );
+        }
+
+        if ( argc > 3 )
+        {
+            inboundQueueCapacity = parseUnsignedOption( "<inboundQueueCapacity>", argv[3] );
+        }
+
+        if ( devices == 0 || linesPerDevice == 0 || inboundQueueCapacity == 0 )
+        {
+            throw std::invalid_argument( "Devices, lines per device and inbound queue capacity must be > 0." );
+        }
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    std::cout << "Devices: " << devices << ", lines per device: " << linesPerDevice << std::endl;
+
+    runBenchmark( "Message workers", devices, linesPerDevice, 0 );
+    runBenchmark( "Inbound queues (capacity " + std::to_string( inboundQueueCapacity ) + ", block)", devices, linesPerDevice, inboundQueueCapacity );
+
+    return 0;
+}
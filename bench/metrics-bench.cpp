@@ -0,0 +1,157 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../src/GatewayMetrics.hpp"
+#include "BenchOptions.hpp"
+
+/**
+ * metrics-bench application
+ * File: metrics-bench.cpp
+ * Purpose: Measures what counting a received line (counter + latency histogram) costs on the hot path,
+ *          once with the sharded DeviceMetrics and once with plain atomics shared by all threads.
+ *          Only the counters of DeviceMetrics are sharded; Its histogram isn't, since in the gateway only one thread records a device's latencies.
+ *          So with several threads, the difference shows the counters' contention.
+ *          Usage: metrics-bench [<threads> [<linesPerThread>]]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: metrics-bench [<threads> [<linesPerThread>]]";
+
+/**
+ * Runs "numThreads" threads which each count "numLines" lines via the given function, and measures the time per line.
+ *
+ * @param name Name of the run, to be printed.
+ * @param numThreads Number of threads counting concurrently.
+ * @param numLines Number of lines per thread.
+ * @param count Function to count a single line.
+ * @return Nanoseconds per line and thread.
+*/
+template<typename CountFunction>
+double runBenchmark( std::string name, unsigned int numThreads, unsigned int numLines, CountFunction count )
+{
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    for ( unsigned int threadIndex = 0; threadIndex < numThreads; threadIndex++ )
+    {
+        threads.push_back( std::thread( [numLines, &count]()
+        {
+            for ( unsigned int lineIndex = 0; lineIndex < numLines; lineIndex++ )
+            {
+                count( 24, 50 + lineIndex % 1000 );
+            }
+        } ) );
+    }
+
+    for ( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count();
+    double nanosecondsPerLine = seconds * 1e9 / numLines;
+
+    std::cout << name << ": " << nanosecondsPerLine << " ns/line (" << seconds << " s)" << std::endl;
+
+    return nanosecondsPerLine;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    unsigned int numThreads = 8;
+    unsigned int numLines = 2000000;
+
+    try
+    {
+        if ( argc > 3 )
+        {
+            throw std::invalid_argument( "Too many arguments." );
+        }
+
+        if ( argc > 1 )
+        {
+            numThreads = parseUnsignedOption( "<threads>", argv[1] );
+        }
+
+        if ( argc > 2 )
+        {
+            numLines = parseUnsignedOption( "<linesPerThread>", argv[2] );
+        }
+
+        if ( numThreads == 0 || numLines == 0 )
+        {
+            throw std::invalid_argument( "Threads and lines per thread must be > 0." );
+        }
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    std::cout << "Threads: " << numThreads << ", lines per thread: " << numLines << std::endl;
+
+    std::atomic<unsigned long long> bytesReceived( 0 );
+    std::atomic<unsigned long long> linesReceived( 0 );
+    LatencyHistogram sharedHistogram;
+    double sharedTime = runBenchmark( "Shared atomics", numThreads, numLines, [&]( std::size_t bytes, unsigned long long latency )
+    {
+        bytesReceived.fetch_add( bytes, std::memory_order_relaxed );
+        linesReceived.fetch_add( 1, std::memory_order_relaxed );
+        sharedHistogram.record( latency );
+    } );
+
+    DeviceMetrics deviceMetrics( "bench" );
+    double shardedTime = runBenchmark( "DeviceMetrics (sharded)", numThreads, numLines, [&deviceMetrics]( std::size_t bytes, unsigned long long latency )
+    {
+        deviceMetrics.addReceived( bytes );
+        deviceMetrics.recordReadToCallbackLatency( latency );
+    } );
+
+    std::chrono::steady_clock::time_point snapshotBegin = std::chrono::steady_clock::now();
+    DeviceMetricsSnapshot snapshot = deviceMetrics.getSnapshot();
+    double snapshotMicroseconds = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - snapshotBegin ).count();
+
+    std::cout << "Snapshot: " << snapshotMicroseconds << " us, lines: " << snapshot.linesReceived << " of " << static_cast<unsigned long long>( numThreads ) * numLines
+              << ", p50: " << snapshot.readToCallbackLatency.getPercentile( 50 ) << " us, p99: " << snapshot.readToCallbackLatency.getPercentile( 99 ) << " us" << std::endl;
+    std::cout << "Speedup: " << sharedTime / shardedTime << "x" << std::endl;
+
+    return 0;
+}
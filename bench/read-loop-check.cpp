@@ -0,0 +1,253 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C++ Standard Libraries
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * read-loop-check application
+ * File: read-loop-check.cpp
+ * Purpose: Checks that deleting devices never takes the gateway down while their read loops are blocked in reading; The ports get closed
+ *          underneath the reads, which the serial Library reports by throwing. Every round adds all virtual devices, and deletes them all at once
+ *          (one thread per device), while they idle or stream. Every third round, each device gets added again right after deleting it, and
+ *          deleted once more, so a read loop may still be running when its device ID is taken again.
+ *          Afterwards every read loop has to quit, and no device may be left. Exitcode 1 if one didn't, a crash ends the check anyway.
+ *          Usage: read-loop-check [--devices <n>] [--rounds <n>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    unsigned int rounds;
+};
+
+/**
+ * CheckGateway class
+ * Purpose: Gateway which ignores the messages.
+*/
+class CheckGateway final : public SerialPortGateway
+{
+public:
+    // Constructors
+    CheckGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath ) {}
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage ) {}
+};
+
+// Constants
+const std::string USAGE = "Usage: read-loop-check [--devices <n>] [--rounds <n>]";
+const unsigned int TELEMETRY_RATE = 1000; // Lines per second while streaming, so the reads are busy when the ports get closed
+const std::chrono::seconds QUIT_TIMEOUT( 5 );
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 8, 12 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--rounds" ) options.rounds = parseUnsignedOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.rounds == 0 )
+    {
+        throw std::invalid_argument( "Devices and rounds must be > 0." );
+    }
+
+    return options;
+}
+
+/**
+ * Deletes every device at once, one thread per device.
+ *
+ * @param gateway Gateway the devices got added to.
+ * @param devices The devices.
+ * @param addAgain Whether every device gets added again right after deleting it, and deleted once more.
+*/
+void deleteDevices( CheckGateway & gateway, const std::vector<DeviceSimulator::VirtualDevicePointer> & devices, bool addAgain )
+{
+    std::vector<std::thread> threads;
+
+    for ( DeviceSimulator::VirtualDevicePointer const & device : devices )
+    {
+        threads.emplace_back( [&gateway, device, addAgain]()
+        {
+            gateway.deleteSerialDevice( device->getDeviceId() );
+
+            if ( addAgain && gateway.addSerialDevice( device->getPort(), true ) )
+            {
+                gateway.deleteSerialDevice( device->getDeviceId() );
+            }
+        } );
+    }
+
+    for ( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+}
+
+/**
+ * Waits until every read loop quitted, and no device is left.
+ *
+ * @param gateway Gateway the devices got deleted from.
+ * @return Returns true if it happened within the timeout.
+*/
+bool waitForReadLoops( CheckGateway & gateway )
+{
+    Clock::time_point deadline = Clock::now() + QUIT_TIMEOUT;
+
+    while ( !gateway.isEveryReadLoopQuitted() || !gateway.getDeviceIds().empty() )
+    {
+        if ( Clock::now() >= deadline )
+        {
+            return false;
+        }
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+    }
+
+    return true;
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode; 1 means a read loop didn't quit (or a device was left), 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    DeviceSimulator simulator;
+    DeviceBehaviour behaviour;
+    behaviour.telemetryRate = TELEMETRY_RATE;
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            simulator.addDevice( "readloop" + std::to_string( index ), behaviour );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    BenchFixture fixture( "read-loop-check", { "ADAPTIVE_HANDSHAKE=1", "LOG_LEVEL=OFF" } );
+    CheckGateway * gateway = new CheckGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    bool passed = true;
+
+    simulator.start();
+    gateway->start();
+
+    for ( unsigned int round = 1; round <= options.rounds && passed; round++ )
+    {
+        bool streaming = round % 2 == 0;
+        bool addAgain = round % 3 == 0;
+        unsigned int added = 0;
+
+        simulator.setTelemetryActive( streaming );
+
+        for ( DeviceSimulator::VirtualDevicePointer const & device : simulator.getDevices() )
+        {
+            if ( gateway->addSerialDevice( device->getPort(), true ) )
+            {
+                added++;
+            }
+        }
+
+        // Lets the read loops get into reading
+        std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+
+        Clock::time_point deleteBegin = Clock::now();
+        deleteDevices( * gateway, simulator.getDevices(), addAgain );
+        bool quitted = waitForReadLoops( * gateway );
+        double quitMilliseconds = std::chrono::duration<double, std::milli>( Clock::now() - deleteBegin ).count();
+
+        std::cout << "round " << std::setw( 3 ) << round << ( streaming ? "  streaming" : "  idle     " ) << ( addAgain ? "  added again" : "             " )
+                  << "  added " << added << "/" << options.devices << "  read loops " << ( quitted ? "quitted" : "NOT QUITTED" )
+                  << " after " << static_cast<unsigned int>( quitMilliseconds ) << " ms" << std::endl;
+
+        passed = quitted;
+    }
+
+    gateway->stop();
+    delete gateway;
+    simulator.stop();
+
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+
+    return passed ? 0 : 1;
+}
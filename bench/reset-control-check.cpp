@@ -0,0 +1,190 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <stdlib.h> // posix_openpt, grantpt, unlockpt, ptsname
+#include <fcntl.h> // open, O_RDWR, O_NOCTTY, O_NONBLOCK
+#include <unistd.h> // close
+#include <termios.h> // tcgetattr, tcsetattr, HUPCL
+#include <cstring> // strerror
+#include <cerrno>
+
+// C++ Standard Libraries
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <stdexcept> // std::runtime_error
+
+#include "../src/SerialLibraryTransport.hpp"
+
+/**
+ * reset-control-check application
+ * File: reset-control-check.cpp
+ * Purpose: Checks how the serial transport treats the modem lines for every reset control, on a pty; The pty keeps its termios flags between
+ *          the opens, since the check holds its master side open. "reset" has to leave HUPCL set, "hold" and "release" have to clear it, so the
+ *          lines stay asserted after closing. Only the first open after HUPCL was set (like after plugging a device in) may report a reset.
+ *          Prints every step, and fails (exitcode 1) on any mismatch.
+ *          Usage: reset-control-check
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Types
+struct Step
+{
+    std::string name;
+    ResetControl resetControl;
+    bool setHupcl; // Sets HUPCL before opening, like a freshly plugged in device has it
+    bool expectedHupcl; // After closing
+    bool expectedReset;
+};
+
+/**
+ * Gets whether HUPCL is set on a tty. Throws std::runtime_error if the tty can't be read.
+ *
+ * @param port Path to the tty.
+ * @return Whether HUPCL is set.
+*/
+bool hasHupcl( std::string port )
+{
+    termios settings;
+    int fd = open( port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+    if ( fd < 0 || tcgetattr( fd, &settings ) != 0 )
+    {
+        std::string error = strerror( errno );
+
+        if ( fd >= 0 )
+        {
+            close( fd );
+        }
+
+        throw std::runtime_error( "Couldn't read the termios flags of " + port + ": " + error );
+    }
+
+    close( fd );
+
+    return ( settings.c_cflag & HUPCL ) != 0;
+}
+
+/**
+ * Sets HUPCL on a tty. Throws std::runtime_error if the tty can't be written.
+ *
+ * @param port Path to the tty.
+*/
+void setHupcl( std::string port )
+{
+    termios settings;
+    int fd = open( port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK );
+    bool written = fd >= 0 && tcgetattr( fd, &settings ) == 0;
+
+    if ( written )
+    {
+        settings.c_cflag |= HUPCL;
+        written = tcsetattr( fd, TCSANOW, &settings ) == 0;
+    }
+
+    std::string error = strerror( errno );
+
+    if ( fd >= 0 )
+    {
+        close( fd );
+    }
+
+    if ( !written )
+    {
+        throw std::runtime_error( "Couldn't set HUPCL on " + port + ": " + error );
+    }
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode.
+*/
+int main( int argc, char* argv[] )
+{
+    int masterFd = posix_openpt( O_RDWR | O_NOCTTY );
+
+    if ( masterFd < 0 || grantpt( masterFd ) != 0 || unlockpt( masterFd ) != 0 )
+    {
+        std::cerr << "Couldn't create pty: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    std::string port = ptsname( masterFd );
+
+    // ptys start without HUPCL, unlike real ttys
+    std::vector<Step> steps = {
+        { "reset", ResetControl::RESET_ON_OPEN, true, true, true },
+        { "hold (first open)", ResetControl::HOLD_LINES, false, false, true },
+        { "hold", ResetControl::HOLD_LINES, false, false, false },
+        { "release", ResetControl::RELEASE_LINES, false, false, false },
+        { "release (first open)", ResetControl::RELEASE_LINES, true, false, true },
+        { "release", ResetControl::RELEASE_LINES, false, false, false }
+    };
+
+    bool passed = true;
+
+    std::cout << "pty: " << port << std::endl;
+
+    for ( Step const & step : steps )
+    {
+        bool reset;
+        bool hupcl;
+
+        try
+        {
+            if ( step.setHupcl )
+            {
+                setHupcl( port );
+            }
+
+            SerialLibraryTransport transport( port, 115200, serial::Timeout::simpleTimeout( 100 ), serial::eightbits, serial::parity_none, serial::stopbits_one, serial::flowcontrol_none, step.resetControl, LatencyProfile() );
+
+            reset = transport.hasResetDevice();
+            transport.close();
+
+            hupcl = hasHupcl( port );
+        }
+        catch ( const std::exception & e )
+        {
+            std::cout << "FAILED: " << step.name << ": " << e.what() << std::endl;
+            passed = false;
+
+            continue;
+        }
+
+        bool stepPassed = reset == step.expectedReset && hupcl == step.expectedHupcl;
+        passed = stepPassed && passed;
+
+        std::cout << "\t" << std::left << std::setw( 22 ) << step.name << std::right
+                  << "HUPCL " << ( hupcl ? "set    " : "cleared" ) << " (expected " << ( step.expectedHupcl ? "set" : "cleared" ) << ")  "
+                  << "reset " << ( reset ? "yes" : "no " ) << " (expected " << ( step.expectedReset ? "yes" : "no" ) << ")"
+                  << ( stepPassed ? "" : "  MISMATCH" ) << std::endl;
+    }
+
+    close( masterFd );
+
+    std::cout << ( passed ? "PASSED" : "FAILED" ) << std::endl;
+
+    return passed ? 0 : 1;
+}
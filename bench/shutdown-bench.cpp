@@ -0,0 +1,296 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+// C Standard Libraries
+#include <unistd.h> // fork, pipe, read, write, close
+#include <sys/wait.h> // waitpid
+#include <sys/resource.h> // getrlimit, setrlimit
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <iostream>
+#include <iomanip> // std::setw
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * shutdown-bench application
+ * File: shutdown-bench.cpp
+ * Purpose: Measures how long stopping a gateway takes, against virtual devices (served by a forked child process).
+ *          The gateway gets stopped in three situations: With idle devices (the read loops wait for data), with every device streaming telemetry,
+ *          and with streaming devices whose callbacks take <callbackDelay> each, behind inbound queues; There the queued messages can't be processed
+ *          within the stop timeout, so they get dropped. Prints per situation how long "stop" took, what got dropped, how many threads were still running
+ *          at the deadline, and how long the destructor took to wait for them.
+ *          Usage: shutdown-bench [--devices <n>] [--rate <linesPerSecondPerDevice>] [--timeout <ms>] [--callback-delay <ms>] [--duration <seconds>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: shutdown-bench [--devices <n>] [--rate <linesPerSecondPerDevice>] [--timeout <ms>] [--callback-delay <ms>] [--duration <seconds>]";
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    unsigned int rate; // Lines per second, per device
+    unsigned int timeout; // ms; STOP_TIMEOUT
+    unsigned int callbackDelay; // ms
+    double duration; // Seconds of streaming before the gateway gets stopped
+};
+
+/**
+ * BenchGateway class
+ * Purpose: Gateway whose callbacks take a fixed time.
+*/
+class BenchGateway final : public SerialPortGateway
+{
+private:
+    // Variables
+    unsigned int callbackDelay; // ms
+
+public:
+    // Constructors
+    BenchGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath, unsigned int callbackDelay ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        this->callbackDelay = callbackDelay;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        if ( callbackDelay > 0 )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( callbackDelay ) );
+        }
+    }
+};
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 256, 10, 1000, 250, 2 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--rate" ) options.rate = parseUnsignedOption( name, value );
+        else if ( name == "--timeout" ) options.timeout = parseUnsignedOption( name, value );
+        else if ( name == "--callback-delay" ) options.callbackDelay = parseUnsignedOption( name, value );
+        else if ( name == "--duration" ) options.duration = parseDoubleOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.rate == 0 || options.duration <= 0 )
+    {
+        throw std::invalid_argument( "Devices, rate and duration must be > 0." );
+    }
+
+    return options;
+}
+
+/**
+ * Raises the limit of open files as far as allowed; The simulator needs two per device, and the gateway three.
+ *
+ * @param devices Number of devices.
+*/
+void raiseFileLimit( unsigned int devices )
+{
+    rlimit limit;
+
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 && limit.rlim_cur < limit.rlim_max )
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &limit );
+    }
+
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 && limit.rlim_cur < 5 * devices + 32 )
+    {
+        std::cerr << "Warning: The limit of open files (" << limit.rlim_cur << ") is too low for " << devices << " devices." << std::endl;
+    }
+}
+
+/**
+ * Adds every device to a gateway, lets the devices stream (or idle) for a while, stops the gateway, and prints how it went.
+ *
+ * @param name Name of the situation, to be printed.
+ * @param configLines Additional config lines.
+ * @param streaming Whether the devices stream telemetry meanwhile.
+ * @param callbackDelay Time in ms every callback takes.
+ * @param ports Ports of the devices.
+ * @param options Benchmark options.
+ * @param controlFd Write end of the control pipe; "g" starts the telemetry, "s" stops it.
+*/
+void runShutdown( std::string name, std::vector<std::string> configLines, bool streaming, unsigned int callbackDelay, const std::vector<std::string> & ports, const Options & options, int controlFd )
+{
+    std::vector<std::string> lines = { "ADAPTIVE_HANDSHAKE=1", "LOG_LEVEL=OFF", "STOP_TIMEOUT=" + std::to_string( options.timeout ) };
+    lines.insert( lines.end(), configLines.begin(), configLines.end() );
+
+    BenchFixture fixture( "shutdown", lines );
+
+    unsigned int failed = 0;
+    BenchGateway * gateway = new BenchGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory(), callbackDelay );
+    gateway->start();
+
+    for ( std::string const & port : ports )
+    {
+        if ( !gateway->addSerialDevice( port, true ) )
+        {
+            failed++;
+        }
+    }
+
+    if ( streaming )
+    {
+        write( controlFd, "g", 1 );
+    }
+
+    std::this_thread::sleep_for( std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) ) );
+
+    StopReport stopReport = gateway->stop();
+
+    if ( streaming )
+    {
+        write( controlFd, "s", 1 );
+    }
+
+    Clock::time_point deleteBegin = Clock::now();
+    delete gateway; // Waits for the threads which were still running at the deadline
+    double deleteMilliseconds = std::chrono::duration<double, std::milli>( Clock::now() - deleteBegin ).count();
+
+    std::cout << std::setw( 14 ) << name << ":  stop " << std::setw( 5 ) << stopReport.elapsed << " ms " << ( stopReport.complete ? "(complete)  " : "(timed out) " )
+              << "dropped messages " << std::setw( 5 ) << stopReport.inboundDropped << "  callbacks " << stopReport.callbacksDropped
+              << "  threads running " << std::setw( 3 ) << stopReport.threadsRunning << "  delete " << std::setw( 4 ) << static_cast<unsigned int>( deleteMilliseconds ) << " ms"
+              << "  (failed: " << failed << ")" << std::endl;
+}
+
+/**
+ * Main function.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Exitcode; 2 means the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    raiseFileLimit( options.devices );
+
+    DeviceSimulator simulator;
+    std::vector<std::string> ports;
+    DeviceBehaviour behaviour;
+    behaviour.telemetryRate = options.rate;
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            ports.push_back( simulator.addDevice( "shutdown" + std::to_string( index ), behaviour )->getPort() );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    // The devices get served by a child process, so the gateway's threads don't share a scheduler with them
+    int controlPipe[2];
+
+    if ( pipe( controlPipe ) != 0 )
+    {
+        std::cerr << "Couldn't create pipe: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    pid_t farm = fork();
+
+    if ( farm == 0 )
+    {
+        char control;
+        close( controlPipe[1] );
+        simulator.start();
+
+        while ( read( controlPipe[0], &control, 1 ) > 0 )
+        {
+            simulator.setTelemetryActive( control == 'g' );
+        }
+
+        simulator.stop();
+        _exit( 0 );
+    }
+
+    close( controlPipe[0] );
+
+    std::cout << options.devices << " devices, " << options.rate << " lines/s each, stop timeout " << options.timeout << " ms" << std::endl;
+
+    runShutdown( "idle", {}, false, 0, ports, options, controlPipe[1] );
+    runShutdown( "streaming", {}, true, 0, ports, options, controlPipe[1] );
+    runShutdown( "slow callbacks", { "INBOUND_QUEUE_CAPACITY=64" }, true, options.callbackDelay, ports, options, controlPipe[1] );
+
+    close( controlPipe[1] );
+    waitpid( farm, nullptr, 0 );
+
+    return 0;
+}
@@ -0,0 +1,527 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <unistd.h> // fork, pipe, read, write
+#include <dirent.h> // opendir, readdir, closedir
+#include <sys/wait.h> // waitpid
+#include <cstdio> // snprintf
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm> // std::max_element
+#include <thread>
+#include <chrono>
+
+#include "../src/SerialPortGateway.hpp"
+#include "BenchFixture.hpp"
+#include "BenchOptions.hpp"
+#include "../sim/DeviceSimulator.hpp"
+
+/**
+ * soak-bench application
+ * File: soak-bench.cpp
+ * Purpose: Runs a SerialPortGateway for a long time against flapping devices, and checks that its resources stay bounded.
+ *          The devices are virtual devices on ptys (See DeviceSimulator), served by a forked child process; They stream telemetry, and disconnect
+ *          and reconnect at random (the pty gets closed, and a new one gets linked to the same path). The gateway gets the devices added again,
+ *          like its scan loop would. Samples thread count, RSS, open fds and the sizes of the gateway's device maps, and writes them as CSV time series.
+ *          Every series gets split into three windows (after a warm-up); If the mean grows significantly from the first to the second AND
+ *          from the second to the third window, the growth is considered unbounded and the run fails. The device maps must never hold more
+ *          entries than there are devices, and must be empty once the gateway got stopped (e.g. no states of deleted devices); Otherwise the run fails as well.
+ *          Usage: soak-bench [--devices <n>] [--duration <seconds>] [--interval <seconds>] [--rate <linesPerSecondPerDevice>]
+ *                            [--disconnect-interval <ms>] [--reconnect-delay <ms>] [--set <CONFIG_KEY>=<value>]... [--output <file>] [--tolerance <percent>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Constants
+const std::string USAGE = "Usage: soak-bench [--devices <n>] [--duration <seconds>] [--interval <seconds>] [--rate <linesPerSecondPerDevice>]\n"
+                          "                  [--disconnect-interval <ms>] [--reconnect-delay <ms>] [--set <CONFIG_KEY>=<value>]... [--output <file>] [--tolerance <percent>]";
+
+// Types
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+    unsigned int devices;
+    double duration; // Seconds
+    double interval; // Seconds between two samples
+    unsigned int rate; // Lines per second, per device
+    unsigned int disconnectInterval; // ms, mean time between two disconnects of a device
+    unsigned int reconnectDelay; // ms
+    std::vector<std::string> configOverrides; // Additional lines for the gateway's config file
+    std::string outputFile;
+    double tolerance; // Percent
+};
+
+struct Series
+{
+    std::string key;
+    double slack; // Absolute growth between two windows which is still considered noise
+    double bound; // Maximum of any sample; 0 means unbounded
+    std::vector<double> values;
+};
+
+/**
+ * CountingGateway class
+ * Purpose: Gateway which only counts its messages.
+*/
+class CountingGateway final : public SerialPortGateway
+{
+public:
+    // Variables
+    std::atomic<unsigned long long> received;
+
+    // Constructors
+    CountingGateway( std::string configFile, std::string hardwareWhitelistFile, std::string logPath ) : SerialPortGateway( configFile, hardwareWhitelistFile, "", logPath )
+    {
+        received = 0;
+    }
+
+protected:
+    // Methods
+    void messageCallback( SerialMessage serialMessage )
+    {
+        received++;
+    }
+};
+
+/**
+ * SerialPortGatewayProbe class
+ * Purpose: Test-friend hook; Reads the sizes of the gateway's internal maps.
+*/
+class SerialPortGatewayProbe
+{
+public:
+    // Methods
+    static std::size_t getSerialDeviceCount( SerialPortGateway & gateway )
+    {
+        std::lock_guard<std::mutex> lock( gateway.serialDevicesMutex );
+
+        return gateway.getSerialDevices()->size();
+    }
+
+    static std::size_t getReadLoopStateCount( SerialPortGateway & gateway )
+    {
+        std::lock_guard<std::mutex> lock( gateway.readLoopStatesMutex );
+
+        return gateway.getReadLoopStates()->size();
+    }
+
+    static std::size_t getInboundQueueCount( SerialPortGateway & gateway )
+    {
+        std::lock_guard<std::mutex> lock( gateway.inboundQueuesMutex );
+
+        return gateway.inboundQueues.size();
+    }
+};
+
+/**
+ * Runs the device farm; Gets executed in the forked child process, so the gateway's process only holds its own fds.
+ * Reports readiness with a byte on the ready pipe, and runs until the control pipe gets closed.
+ *
+ * @param options Benchmark options.
+ * @param directory Directory for the devices' links.
+ * @param controlFd Read end of the control pipe.
+ * @param readyFd Write end of the ready pipe.
+*/
+void runFarm( const Options & options, std::string directory, int controlFd, int readyFd )
+{
+    DeviceSimulator simulator( 1, 1 );
+    DeviceBehaviour behaviour;
+    behaviour.telemetryRate = options.rate;
+    behaviour.disconnectInterval = options.disconnectInterval;
+    behaviour.reconnectDelay = options.reconnectDelay;
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            simulator.addDevice( "soak" + std::to_string( index ), behaviour, directory + "/tty" + std::to_string( index ) );
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return;
+    }
+
+    simulator.setTelemetryActive( true );
+    simulator.start();
+
+    char control = 'r';
+
+    if ( write( readyFd, &control, 1 ) != 1 )
+    {
+        simulator.stop();
+
+        return;
+    }
+
+    while ( read( controlFd, &control, 1 ) > 0 );
+
+    simulator.stop();
+}
+
+/**
+ * Reads a value (in kiB or count) from /proc/self/status.
+ *
+ * @param key Key of the line, e.g. "VmRSS" or "Threads".
+ * @return Value, or 0 if the key wasn't found.
+*/
+unsigned long long readProcStatus( std::string key )
+{
+    std::ifstream status( "/proc/self/status" );
+    std::string line;
+
+    while ( std::getline( status, line ) )
+    {
+        if ( line.compare( 0, key.length() + 1, key + ":" ) == 0 )
+        {
+            return std::stoull( line.substr( key.length() + 1 ) );
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Counts the open file descriptors of the process.
+ *
+ * @return Number of open fds (without the one used for counting).
+*/
+unsigned long long countOpenFds()
+{
+    DIR * directory = opendir( "/proc/self/fd" );
+    unsigned long long count = 0;
+
+    if ( directory == nullptr )
+    {
+        return 0;
+    }
+
+    while ( dirent * entry = readdir( directory ) )
+    {
+        if ( entry->d_name[0] != '.' )
+        {
+            count++;
+        }
+    }
+
+    closedir( directory );
+
+    return count - 1; // The directory itself
+}
+
+/**
+ * Gets the mean of a part of a series.
+ *
+ * @param values Values of the series.
+ * @param begin Index of the first value.
+ * @param end Index after the last value.
+ * @return Mean, or 0 if the part is empty.
+*/
+double getMean( const std::vector<double> & values, std::size_t begin, std::size_t end )
+{
+    double sum = 0;
+
+    for ( std::size_t index = begin; index < end; index++ )
+    {
+        sum += values[index];
+    }
+
+    return end > begin ? sum / ( end - begin ) : 0;
+}
+
+/**
+ * Checks the series for unbounded growth, and prints a summary for every series.
+ * The samples after the warm-up (the first quarter) get split into three windows; A series grows unbounded
+ * if its mean grows by more than the slack (and the tolerance) from the first to the second, and from the second to the third window.
+ * A series with a bound fails if any of its samples exceeds it.
+ *
+ * @param series All sampled series.
+ * @param tolerance Allowed growth between two windows, in percent.
+ * @return Number of growing (or exceeding) series.
+*/
+unsigned int checkGrowth( const std::vector<Series> & series, double tolerance )
+{
+    unsigned int growing = 0;
+
+    std::cerr << "Growth (window means after warm-up, tolerance " << tolerance << " %):" << std::endl;
+
+    for ( Series const & entry : series )
+    {
+        std::size_t begin = entry.values.size() / 4;
+        std::size_t window = ( entry.values.size() - begin ) / 3;
+
+        if ( window == 0 )
+        {
+            std::cerr << "\t" << entry.key << ": Not enough samples" << std::endl;
+            continue;
+        }
+
+        double first = getMean( entry.values, begin, begin + window );
+        double second = getMean( entry.values, begin + window, begin + 2 * window );
+        double third = getMean( entry.values, begin + 2 * window, begin + 3 * window );
+        double maximum = entry.values.empty() ? 0 : * std::max_element( entry.values.begin(), entry.values.end() );
+        bool grows = second - first > entry.slack + first * tolerance / 100 && third - second > entry.slack + second * tolerance / 100;
+        bool exceeds = entry.bound > 0 && maximum > entry.bound;
+
+        if ( grows || exceeds )
+        {
+            growing++;
+        }
+
+        char line[256];
+        snprintf( line, sizeof( line ), "\t%-20s %14.1f -> %14.1f -> %14.1f  max %8.0f  %s", entry.key.c_str(), first, second, third, maximum, exceeds ? "EXCEEDS BOUND" : ( grows ? "GROWING" : "bounded" ) );
+        std::cerr << line << std::endl;
+    }
+
+    return growing;
+}
+
+/**
+ * Parses the command line options.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options = { 8, 60.0, 1.0, 20, 2000, 500, {}, "", 10.0 };
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 == argc )
+        {
+            throw std::invalid_argument( "Missing value for \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+
+        if ( name == "--devices" ) options.devices = parseUnsignedOption( name, value );
+        else if ( name == "--duration" ) options.duration = parseDoubleOption( name, value );
+        else if ( name == "--interval" ) options.interval = parseDoubleOption( name, value );
+        else if ( name == "--rate" ) options.rate = parseUnsignedOption( name, value );
+        else if ( name == "--disconnect-interval" ) options.disconnectInterval = parseUnsignedOption( name, value );
+        else if ( name == "--reconnect-delay" ) options.reconnectDelay = parseUnsignedOption( name, value );
+        else if ( name == "--set" ) options.configOverrides.push_back( value );
+        else if ( name == "--output" ) options.outputFile = value;
+        else if ( name == "--tolerance" ) options.tolerance = parseDoubleOption( name, value );
+        else throw std::invalid_argument( "Unknown option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.duration <= 0 || options.interval <= 0 )
+    {
+        throw std::invalid_argument( "Devices, duration and interval must be > 0." );
+    }
+
+    return options;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing, 2 means a series grew unbounded, exceeded its bound or the arguments are invalid.
+*/
+int main( int argc, char* argv[] )
+{
+    Options options;
+
+    if ( isUsageRequested( argc, argv ) )
+    {
+        std::cout << USAGE << std::endl;
+
+        return 0;
+    }
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        std::cerr << e.what() << std::endl << USAGE << std::endl;
+
+        return 2;
+    }
+
+    // Config files; Scanning stays off, so only the farm's devices get added and real hardware is never touched.
+    // Logging is off, as the handshakes of streaming devices fail now and then (which is part of the soak)
+    std::vector<std::string> configLines = { "LOG_LEVEL=OFF" };
+    configLines.insert( configLines.end(), options.configOverrides.begin(), options.configOverrides.end() );
+
+    BenchFixture fixture( "soak", configLines );
+
+    int controlPipe[2];
+    int readyPipe[2];
+
+    if ( pipe( controlPipe ) != 0 || pipe( readyPipe ) != 0 )
+    {
+        std::cerr << "Couldn't create pipes: " << strerror( errno ) << std::endl;
+
+        return 1;
+    }
+
+    pid_t farm = fork();
+
+    if ( farm == 0 )
+    {
+        close( controlPipe[1] );
+        close( readyPipe[0] );
+        runFarm( options, fixture.getDirectory(), controlPipe[0], readyPipe[1] );
+        _exit( 0 );
+    }
+
+    close( controlPipe[0] );
+    close( readyPipe[1] );
+
+    char ready;
+
+    if ( read( readyPipe[0], &ready, 1 ) != 1 )
+    {
+        std::cerr << "The device farm couldn't be started." << std::endl;
+        close( controlPipe[1] );
+        waitpid( farm, nullptr, 0 );
+
+        return 1;
+    }
+
+    close( readyPipe[0] );
+
+    std::vector<std::string> ports;
+
+    for ( unsigned int index = 0; index < options.devices; index++ )
+    {
+        ports.push_back( fixture.getPath( "tty" + std::to_string( index ) ) );
+    }
+
+    CountingGateway * gateway = new CountingGateway( fixture.getConfigFile(), fixture.getWhitelistFile(), fixture.getDirectory() );
+    gateway->start();
+
+    std::vector<Series> series = {
+        { "threads", 2.0, 0, {} },
+        { "rss_kib", 1024.0, 0, {} },
+        { "fds", 2.0, 0, {} },
+        { "serial_devices", 1.0, static_cast<double>( options.devices ), {} },
+        { "read_loop_states", 1.0, static_cast<double>( options.devices ), {} },
+        { "inbound_queues", 1.0, static_cast<double>( options.devices ), {} }
+    };
+
+    std::ofstream outputFile;
+    std::ostream * output = &std::cout;
+
+    if ( !options.outputFile.empty() )
+    {
+        outputFile.open( options.outputFile );
+        output = &outputFile;
+    }
+
+    * output << "elapsed_s,threads,rss_kib,fds,serial_devices,read_loop_states,inbound_queues,connected_devices,reconnects,lines_received" << std::endl;
+
+    Clock::time_point begin = Clock::now();
+    Clock::time_point end = begin + std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) );
+    Clock::time_point nextSample = begin;
+
+    while ( Clock::now() < end )
+    {
+        // Add the devices which are (back) on their port, like the scan loop would
+        std::set<std::string> connectedPorts;
+
+        for ( std::pair<const std::string, std::string> const & mapping : gateway->getDeviceIdToSerialPortMappings() )
+        {
+            connectedPorts.insert( mapping.second );
+        }
+
+        for ( std::string const & port : ports )
+        {
+            if ( connectedPorts.find( port ) == connectedPorts.end() )
+            {
+                gateway->addSerialDevice( port, true );
+            }
+        }
+
+        if ( Clock::now() >= nextSample )
+        {
+            GatewayMetricsSnapshot metrics = gateway->getMetricsSnapshot();
+            unsigned long long connected = 0;
+            unsigned long long reconnects = 0;
+
+            for ( std::pair<const std::string, DeviceMetricsSnapshot> const & device : metrics.devices )
+            {
+                connected += device.second.connected ? 1 : 0;
+                reconnects += device.second.reconnects;
+            }
+
+            std::vector<double> values = {
+                static_cast<double>( readProcStatus( "Threads" ) ),
+                static_cast<double>( readProcStatus( "VmRSS" ) ),
+                static_cast<double>( countOpenFds() ),
+                static_cast<double>( SerialPortGatewayProbe::getSerialDeviceCount( * gateway ) ),
+                static_cast<double>( SerialPortGatewayProbe::getReadLoopStateCount( * gateway ) ),
+                static_cast<double>( SerialPortGatewayProbe::getInboundQueueCount( * gateway ) )
+            };
+
+            * output << std::chrono::duration<double>( Clock::now() - begin ).count();
+
+            for ( std::size_t index = 0; index < values.size(); index++ )
+            {
+                series[index].values.push_back( values[index] );
+                * output << "," << values[index];
+            }
+
+            * output << "," << connected << "," << reconnects << "," << gateway->received << std::endl;
+
+            nextSample += std::chrono::microseconds( static_cast<long long>( options.interval * 1e6 ) );
+        }
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    }
+
+    gateway->stop();
+
+    while ( !gateway->isEveryReadLoopQuitted() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    // Every device got deleted by stopping, so no state of them may be left behind
+    std::size_t remainingReadLoopStates = SerialPortGatewayProbe::getReadLoopStateCount( * gateway );
+    std::size_t remainingSerialDevices = SerialPortGatewayProbe::getSerialDeviceCount( * gateway );
+    std::size_t remainingInboundQueues = SerialPortGatewayProbe::getInboundQueueCount( * gateway );
+    bool leftBehind = remainingReadLoopStates > 0 || remainingSerialDevices > 0 || remainingInboundQueues > 0;
+
+    std::cerr << "Left behind after stopping: " << remainingSerialDevices << " serial devices, " << remainingReadLoopStates << " read loop states, "
+              << remainingInboundQueues << " inbound queues" << ( leftBehind ? "  LEAKED" : "" ) << std::endl;
+
+    delete gateway;
+    close( controlPipe[1] );
+    waitpid( farm, nullptr, 0 );
+
+    return checkGrowth( series, options.tolerance ) > 0 || leftBehind ? 2 : 0;
+}
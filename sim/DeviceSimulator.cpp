@@ -0,0 +1,171 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "DeviceSimulator.hpp"
+
+// C Standard Libraries
+#include <poll.h> // poll
+
+// C++ Standard Libraries
+#include <algorithm> // std::min
+#include <chrono>
+
+const unsigned int DeviceSimulator::MAX_POLL_TIMEOUT;
+
+DeviceSimulator::DeviceSimulator( unsigned int threadCount, unsigned int seed )
+{
+    if ( threadCount == 0 )
+    {
+        throw Exception( "Number of simulator threads must be > 0." );
+    }
+
+    this->threadCount = threadCount;
+    this->seed = seed;
+    this->running = false;
+    this->telemetryActive = false;
+}
+
+DeviceSimulator::~DeviceSimulator()
+{
+    stop();
+}
+
+DeviceSimulator::VirtualDevicePointer DeviceSimulator::addDevice( std::string deviceId, DeviceBehaviour behaviour, std::string linkPath )
+{
+    if ( running )
+    {
+        throw Exception( "Devices can't be added while the simulator is running." );
+    }
+
+    VirtualDevicePointer device = std::make_shared<VirtualDevice>( deviceId, behaviour, linkPath, seed + static_cast<unsigned int>( devices.size() ) );
+    devices.push_back( device );
+
+    return device;
+}
+
+void DeviceSimulator::start()
+{
+    if ( running )
+    {
+        return;
+    }
+
+    running = true;
+
+    for ( unsigned int index = 0; index < threadCount && index < devices.size(); index++ )
+    {
+        threads.push_back( std::thread( &DeviceSimulator::runLoop, this, index ) );
+    }
+}
+
+void DeviceSimulator::stop()
+{
+    running = false;
+
+    for ( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+
+    threads.clear();
+}
+
+void DeviceSimulator::runLoop( unsigned int firstDevice )
+{
+    typedef VirtualDevice::Clock Clock;
+
+    std::vector<VirtualDevice *> ownDevices;
+    std::vector<pollfd> pollDescriptors;
+    std::vector<VirtualDevice *> polledDevices;
+
+    for ( std::size_t index = firstDevice; index < devices.size(); index += threadCount )
+    {
+        ownDevices.push_back( devices[index].get() );
+    }
+
+    while ( running )
+    {
+        Clock::time_point now = Clock::now();
+        Clock::time_point deadline = now + std::chrono::milliseconds( MAX_POLL_TIMEOUT );
+        bool telemetry = telemetryActive;
+
+        pollDescriptors.clear();
+        polledDevices.clear();
+
+        for ( VirtualDevice * device : ownDevices )
+        {
+            device->tick( now, telemetry );
+            deadline = std::min( deadline, device->getNextDeadline() );
+
+            if ( device->getMasterFd() >= 0 && !device->isStalled( now ) )
+            {
+                pollDescriptors.push_back( { device->getMasterFd(), static_cast<short>( POLLIN | ( device->hasPendingOutput() ? POLLOUT : 0 ) ), 0 } );
+                polledDevices.push_back( device );
+            }
+        }
+
+        // Round up, so a deadline less than 1 ms away doesn't turn into a busy loop
+        long long timeout = std::chrono::duration_cast<std::chrono::microseconds>( deadline - Clock::now() ).count();
+        timeout = timeout > 0 ? ( timeout + 999 ) / 1000 : 0;
+
+        if ( poll( pollDescriptors.data(), pollDescriptors.size(), static_cast<int>( timeout ) ) <= 0 )
+        {
+            continue;
+        }
+
+        for ( std::size_t index = 0; index < pollDescriptors.size(); index++ )
+        {
+            if ( pollDescriptors[index].revents & POLLIN )
+            {
+                polledDevices[index]->handleInput();
+            }
+
+            if ( pollDescriptors[index].revents & POLLOUT )
+            {
+                polledDevices[index]->flushOutput();
+            }
+        }
+    }
+}
+
+void DeviceSimulator::setTelemetryActive( bool telemetryActive )
+{
+    this->telemetryActive = telemetryActive;
+}
+
+std::vector<DeviceSimulator::VirtualDevicePointer> DeviceSimulator::getDevices()
+{
+    return this->devices;
+}
+
+DeviceStatistics DeviceSimulator::getStatistics()
+{
+    DeviceStatistics total = {};
+
+    for ( VirtualDevicePointer const & device : devices )
+    {
+        DeviceStatistics statistics = device->getStatistics();
+        total.linesSent += statistics.linesSent;
+        total.linesDropped += statistics.linesDropped;
+        total.bytesWritten += statistics.bytesWritten;
+        total.commandsReceived += statistics.commandsReceived;
+        total.disconnects += statistics.disconnects;
+        total.garbageInjections += statistics.garbageInjections;
+        total.stalls += statistics.stalls;
+    }
+
+    return total;
+}
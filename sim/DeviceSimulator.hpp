@@ -0,0 +1,126 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef DEVICESIMULATOR_HPP
+#define DEVICESIMULATOR_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <memory> // std::shared_ptr
+#include <atomic>
+#include <thread>
+
+#include "VirtualDevice.hpp"
+#include "../dependencies/Exception/src/Exception.hpp"
+
+/**
+ * DeviceSimulator class
+ * File: DeviceSimulator.hpp
+ * Purpose: Defines a simulator which drives any number of virtual devices.
+ *          The devices are split between a few threads, each of which serves its devices with a single poll() loop;
+ *          So hundreds of devices don't need hundreds of threads, and the simulator's scheduling doesn't distort the measurements much.
+ *          Devices are added before starting the simulator. The simulator doesn't start threads before start(), so it may be forked after adding them.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class DeviceSimulator
+{
+public:
+    // Types
+    typedef std::shared_ptr<VirtualDevice> VirtualDevicePointer;
+
+private:
+    // Constants
+    static const unsigned int MAX_POLL_TIMEOUT = 50; // ms; Bounds how late a change of telemetryActive or running is noticed
+
+    // Variables
+    std::vector<VirtualDevicePointer> devices;
+    unsigned int threadCount;
+    unsigned int seed;
+    std::vector<std::thread> threads;
+    std::atomic_bool running;
+    std::atomic_bool telemetryActive;
+
+    // Methods
+    /**
+     * Serves every threadCount-th device, starting at the given one, until the simulator gets stopped.
+     *
+     * @param firstDevice Index of the first device to be served.
+    */
+    void runLoop( unsigned int firstDevice );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param threadCount Number of threads serving the devices.
+     * @param seed Seed for the faults; Every device gets its own seed derived from it.
+    */
+    DeviceSimulator( unsigned int threadCount = 1, unsigned int seed = 1 );
+
+    // Destructors
+    /**
+     * Default destructor; Stops the simulator.
+    */
+    ~DeviceSimulator();
+
+    // Methods
+    /**
+     * Adds a device; Its pty is opened right away. Throws Exception if the simulator is running, or the pty can't be opened.
+     *
+     * @param deviceId ID of the device.
+     * @param behaviour Behaviour of the device.
+     * @param linkPath Path of a symlink which always points to the device's current pty. May be "".
+     * @return The device.
+    */
+    VirtualDevicePointer addDevice( std::string deviceId, DeviceBehaviour behaviour, std::string linkPath = "" );
+
+    /**
+     * Starts the threads serving the devices.
+    */
+    void start();
+
+    /**
+     * Stops the threads serving the devices, and waits for them. The ptys stay open until the simulator gets destroyed.
+    */
+    void stop();
+
+    /**
+     * Sets whether the devices send telemetry; They answer commands either way. Initially, telemetry is inactive.
+     *
+     * @param telemetryActive Whether the devices send telemetry.
+    */
+    void setTelemetryActive( bool telemetryActive );
+
+    /**
+     * Gets the devices.
+     *
+     * @return The devices, in the order they got added.
+    */
+    std::vector<VirtualDevicePointer> getDevices();
+
+    /**
+     * Gets the sum of all devices' statistics.
+     *
+     * @return Statistics.
+    */
+    DeviceStatistics getStatistics();
+};
+
+#endif // DEVICESIMULATOR_HPP
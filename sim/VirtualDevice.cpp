@@ -0,0 +1,674 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "VirtualDevice.hpp"
+
+// C Standard Libraries
+#include <stdlib.h> // posix_openpt, grantpt, unlockpt, ptsname_r
+#include <fcntl.h> // O_RDWR, O_NOCTTY, O_NONBLOCK
+#include <unistd.h> // read, write, close, symlink, unlink
+#include <termios.h> // cfmakeraw, tcgetattr, tcsetattr, cfgetospeed
+#include <sys/inotify.h> // inotify_init1, inotify_add_watch, inotify_event
+#include <cerrno>
+#include <cstring> // strerror
+
+// C++ Standard Libraries
+#include <algorithm> // std::min, std::max
+#include <limits>
+
+const unsigned int VirtualDevice::BAUD_FALLBACK_TIMEOUT;
+const unsigned int VirtualDevice::LINE_SLICE;
+
+DeviceBehaviour::DeviceBehaviour()
+{
+    commandGetId = "getid";
+    messageTypeId = "id";
+    messageDelimiter = ':';
+    telemetryType = "telemetry";
+    telemetryRate = 10;
+    telemetrySize = 64;
+    burstLength = 1;
+    outputBufferSize = 4096;
+    disconnectInterval = 0;
+    reconnectDelay = 1000;
+    garbageInterval = 0;
+    garbageLength = 16;
+    stallInterval = 0;
+    stallDuration = 500;
+    bootDelay = 0;
+    bootMessage = "";
+    baudRate = 0;
+    maxBaudRate = 0;
+    commandSetBaud = "setbaud";
+}
+
+VirtualDevice::VirtualDevice( std::string deviceId, DeviceBehaviour behaviour, std::string linkPath, unsigned int seed )
+{
+    if ( behaviour.burstLength == 0 )
+    {
+        throw Exception( "Burst length must be > 0." );
+    }
+
+    this->deviceId = deviceId;
+    this->behaviour = behaviour;
+    this->linkPath = linkPath;
+    this->masterFd = -1;
+    this->slaveFd = -1;
+    this->openWatchFd = -1;
+    this->booting = false;
+    this->linesHeld = false;
+    this->gatewayOpens = 0;
+    this->outputOffset = 0;
+    this->random.seed( seed );
+    this->telemetryRunning = false;
+    this->sequence = 0;
+    this->linesSent = 0;
+    this->linesDropped = 0;
+    this->bytesWritten = 0;
+    this->commandsReceived = 0;
+    this->disconnects = 0;
+    this->garbageInjections = 0;
+    this->stalls = 0;
+
+    Clock::time_point now = Clock::now();
+    this->nextDisconnect = scheduleFault( now, behaviour.disconnectInterval );
+    this->nextGarbage = scheduleFault( now, behaviour.garbageInterval );
+    this->nextStall = scheduleFault( now, behaviour.stallInterval );
+    this->nextTelemetry = now;
+    this->stallEnd = now;
+    this->bootEnd = now;
+    this->reconnectTime = now;
+    this->lineFreeAt = now;
+
+    openPty();
+}
+
+VirtualDevice::~VirtualDevice()
+{
+    closePty();
+
+    if ( !linkPath.empty() )
+    {
+        unlink( linkPath.c_str() );
+    }
+}
+
+void VirtualDevice::openPty()
+{
+    char slaveName[128];
+    int master = posix_openpt( O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+    if ( master < 0 )
+    {
+        throw Exception( "Couldn't open pty for virtual device \"" + deviceId + "\": " + strerror( errno ) );
+    }
+
+    if ( grantpt( master ) != 0 || unlockpt( master ) != 0 || ptsname_r( master, slaveName, sizeof( slaveName ) ) != 0 )
+    {
+        std::string error = strerror( errno );
+        close( master );
+
+        throw Exception( "Couldn't unlock pty for virtual device \"" + deviceId + "\": " + error );
+    }
+
+    int slave = open( slaveName, O_RDWR | O_NOCTTY );
+
+    if ( slave < 0 )
+    {
+        std::string error = strerror( errno );
+        close( master );
+
+        throw Exception( "Couldn't open pty slave for virtual device \"" + deviceId + "\": " + error );
+    }
+
+    // No echo and no line editing, before any gateway gets to open the port; HUPCL like a real tty has by default (ptys don't)
+    termios settings;
+    tcgetattr( slave, &settings );
+    cfmakeraw( &settings );
+    settings.c_cflag |= HUPCL;
+    tcsetattr( slave, TCSANOW, &settings );
+
+    // Added after opening the slave, so only the gateway's opens and closes are reported
+    int openWatch = -1;
+
+    if ( behaviour.bootDelay > 0 )
+    {
+        openWatch = inotify_init1( IN_NONBLOCK );
+
+        if ( openWatch < 0 || inotify_add_watch( openWatch, slaveName, IN_OPEN | IN_CLOSE ) < 0 )
+        {
+            std::string error = strerror( errno );
+
+            if ( openWatch >= 0 )
+            {
+                close( openWatch );
+            }
+
+            close( slave );
+            close( master );
+
+            throw Exception( "Couldn't watch the pty of virtual device \"" + deviceId + "\": " + error );
+        }
+    }
+
+    if ( !linkPath.empty() )
+    {
+        unlink( linkPath.c_str() );
+
+        if ( symlink( slaveName, linkPath.c_str() ) != 0 )
+        {
+            std::string error = strerror( errno );
+
+            if ( openWatch >= 0 )
+            {
+                close( openWatch );
+            }
+
+            close( slave );
+            close( master );
+
+            throw Exception( "Couldn't link \"" + linkPath + "\" to the pty of virtual device \"" + deviceId + "\": " + error );
+        }
+    }
+
+    masterFd = master;
+    slaveFd = slave;
+    openWatchFd = openWatch;
+    booting = false;
+    linesHeld = false; // Like a freshly plugged in device
+    gatewayOpens = 0;
+    resetBaudRate();
+    port = slaveName;
+    input.clear();
+    output.clear();
+    outputOffset = 0;
+}
+
+void VirtualDevice::closePty()
+{
+    if ( masterFd >= 0 )
+    {
+        close( masterFd );
+        close( slaveFd );
+    }
+
+    if ( openWatchFd >= 0 )
+    {
+        close( openWatchFd );
+    }
+
+    masterFd = -1;
+    slaveFd = -1;
+    openWatchFd = -1;
+}
+
+void VirtualDevice::checkOpened( Clock::time_point now )
+{
+    if ( openWatchFd < 0 )
+    {
+        return;
+    }
+
+    alignas( inotify_event ) char events[512];
+    ssize_t length;
+    bool reset = false;
+
+    while ( ( length = read( openWatchFd, events, sizeof( events ) ) ) > 0 )
+    {
+        for ( ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event * event = reinterpret_cast<const inotify_event *>( events + offset );
+
+            if ( event->mask & IN_OPEN )
+            {
+                if ( gatewayOpens == 0 && !linesHeld )
+                {
+                    reset = true; // DTR got asserted
+                }
+
+                gatewayOpens++;
+            }
+
+            if ( ( event->mask & IN_CLOSE ) && gatewayOpens > 0 && --gatewayOpens == 0 )
+            {
+                // Ptys have no modem lines; Emulated like a tty, whose lines drop on the last close unless the gateway cleared HUPCL
+                termios settings;
+                linesHeld = tcgetattr( slaveFd, &settings ) == 0 && ( settings.c_cflag & HUPCL ) == 0;
+            }
+
+            offset += sizeof( inotify_event ) + event->len;
+        }
+    }
+
+    if ( reset )
+    {
+        char buffer[512];
+
+        // Reset: Whatever was received or not sent yet is lost
+        while ( read( masterFd, buffer, sizeof( buffer ) ) > 0 )
+        {
+        }
+
+        input.clear();
+        output.clear();
+        outputOffset = 0;
+        resetBaudRate();
+        booting = true;
+        bootEnd = now + std::chrono::milliseconds( behaviour.bootDelay );
+    }
+}
+
+VirtualDevice::Clock::time_point VirtualDevice::scheduleFault( Clock::time_point now, unsigned int interval )
+{
+    if ( interval == 0 )
+    {
+        return Clock::time_point::max();
+    }
+
+    std::exponential_distribution<double> distribution( 1.0 / interval );
+
+    return now + std::chrono::microseconds( static_cast<long long>( distribution( random ) * 1000 ) );
+}
+
+void VirtualDevice::tick( Clock::time_point now, bool telemetryActive )
+{
+    if ( masterFd < 0 )
+    {
+        if ( now < reconnectTime )
+        {
+            return;
+        }
+
+        try
+        {
+            openPty();
+        }
+        catch ( const Exception & )
+        {
+            reconnectTime = now + std::chrono::seconds( 1 );
+
+            return;
+        }
+
+        nextTelemetry = now;
+    }
+
+    checkOpened( now );
+
+    if ( now >= baudFallback )
+    {
+        resetBaudRate(); // Nothing arrived at the new rate; The gateway didn't follow
+    }
+
+    if ( booting )
+    {
+        if ( now < bootEnd )
+        {
+            return;
+        }
+
+        booting = false;
+        nextTelemetry = now;
+
+        if ( !behaviour.bootMessage.empty() )
+        {
+            output += behaviour.bootMessage + "\n";
+        }
+    }
+
+    if ( now < stallEnd )
+    {
+        return;
+    }
+
+    if ( telemetryActive && !telemetryRunning )
+    {
+        nextTelemetry = now;
+    }
+
+    telemetryRunning = telemetryActive && behaviour.telemetryRate > 0;
+
+    if ( now >= nextDisconnect )
+    {
+        closePty();
+        disconnects++;
+
+        reconnectTime = now + std::chrono::milliseconds( behaviour.reconnectDelay );
+        nextDisconnect = scheduleFault( reconnectTime, behaviour.disconnectInterval );
+
+        return;
+    }
+
+    if ( now >= nextStall )
+    {
+        stalls++;
+
+        stallEnd = now + std::chrono::milliseconds( behaviour.stallDuration );
+        nextStall = scheduleFault( stallEnd, behaviour.stallInterval );
+        nextTelemetry = stallEnd; // Whatever was due during the stall never gets sent, instead of coming as a burst afterwards
+
+        return;
+    }
+
+    if ( now >= nextGarbage )
+    {
+        std::uniform_int_distribution<int> byteDistribution( 0, 255 );
+
+        for ( unsigned int index = 0; index < behaviour.garbageLength; index++ )
+        {
+            output.push_back( static_cast<char>( byteDistribution( random ) ) );
+        }
+
+        garbageInjections++;
+        nextGarbage = scheduleFault( now, behaviour.garbageInterval );
+    }
+
+    if ( telemetryRunning )
+    {
+        std::chrono::nanoseconds burstInterval( 1000000000ULL * behaviour.burstLength / behaviour.telemetryRate );
+
+        // Catch up with everything that's due; A late tick results in a burst, like a device which got held up
+        while ( nextTelemetry <= now )
+        {
+            for ( unsigned int index = 0; index < behaviour.burstLength; index++ )
+            {
+                queueTelemetry();
+            }
+
+            nextTelemetry += burstInterval;
+        }
+    }
+
+    flushOutput();
+}
+
+void VirtualDevice::queueTelemetry()
+{
+    unsigned long long timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+    std::string line = behaviour.telemetryType + behaviour.messageDelimiter + std::to_string( sequence++ ) + "," + std::to_string( timestamp ) + ",";
+
+    if ( line.length() + 1 < behaviour.telemetrySize )
+    {
+        line.append( behaviour.telemetrySize - line.length() - 1, 'x' );
+    }
+
+    line.push_back( '\n' );
+    linesSent++;
+
+    // While switching the baud rate, the device waits for its output to drain (like Serial.flush() before Serial.begin())
+    if ( pendingBaudRate > 0 || output.length() - outputOffset + line.length() > behaviour.outputBufferSize )
+    {
+        linesDropped++;
+
+        return;
+    }
+
+    output += line;
+}
+
+void VirtualDevice::resetBaudRate()
+{
+    currentBaudRate = behaviour.baudRate;
+    pendingBaudRate = 0;
+    baudFallback = Clock::time_point::max();
+}
+
+bool VirtualDevice::isLineMatched()
+{
+    if ( behaviour.baudRate == 0 )
+    {
+        return true;
+    }
+
+    termios settings;
+
+    if ( tcgetattr( slaveFd, &settings ) != 0 )
+    {
+        return false;
+    }
+
+    switch ( cfgetospeed( &settings ) )
+    {
+        case B1200: return currentBaudRate == 1200;
+        case B2400: return currentBaudRate == 2400;
+        case B4800: return currentBaudRate == 4800;
+        case B9600: return currentBaudRate == 9600;
+        case B19200: return currentBaudRate == 19200;
+        case B38400: return currentBaudRate == 38400;
+        case B57600: return currentBaudRate == 57600;
+        case B115200: return currentBaudRate == 115200;
+        case B230400: return currentBaudRate == 230400;
+        case B460800: return currentBaudRate == 460800;
+        case B921600: return currentBaudRate == 921600;
+        default: return false;
+    }
+}
+
+void VirtualDevice::handleCommand( std::string command )
+{
+    commandsReceived++;
+    baudFallback = Clock::time_point::max(); // The gateway talks at the current rate
+
+    std::string setBaudPrefix = behaviour.commandSetBaud + behaviour.messageDelimiter;
+    unsigned long requestedBaudRate = 0;
+
+    if ( behaviour.maxBaudRate > 0 && command.compare( 0, setBaudPrefix.length(), setBaudPrefix ) == 0 )
+    {
+        try
+        {
+            requestedBaudRate = std::stoul( command.substr( setBaudPrefix.length() ) );
+        }
+        catch ( const std::exception & )
+        {
+            requestedBaudRate = 0;
+        }
+    }
+
+    if ( requestedBaudRate > 0 && requestedBaudRate <= behaviour.maxBaudRate )
+    {
+        output += command + "\n";
+        pendingBaudRate = static_cast<unsigned int>( requestedBaudRate );
+    }
+    else if ( command == behaviour.commandGetId )
+    {
+        output += behaviour.messageTypeId + behaviour.messageDelimiter + deviceId + "\n";
+    }
+    else
+    {
+        output += "echo" + std::string( 1, behaviour.messageDelimiter ) + command + "\n";
+    }
+}
+
+void VirtualDevice::handleInput()
+{
+    char buffer[512];
+    ssize_t length;
+    Clock::time_point now = Clock::now();
+
+    // The gateway may write right after opening; The reset has to come first
+    checkOpened( now );
+
+    bool garbled = !isLineMatched();
+
+    while ( masterFd >= 0 && ( length = read( masterFd, buffer, sizeof( buffer ) ) ) > 0 )
+    {
+        if ( ( booting && now < bootEnd ) || garbled )
+        {
+            continue; // Deaf while booting; At another rate, the bytes are framing errors
+        }
+
+        input.append( buffer, length );
+    }
+
+    std::size_t newline;
+
+    while ( ( newline = input.find( '\n' ) ) != std::string::npos )
+    {
+        std::string command = input.substr( 0, newline );
+        input.erase( 0, newline + 1 );
+
+        if ( !command.empty() && command.back() == '\r' )
+        {
+            command.pop_back();
+        }
+
+        if ( !command.empty() )
+        {
+            handleCommand( command );
+        }
+    }
+
+    // A gateway never sends lines this long; Don't let noise grow the buffer
+    if ( input.length() > 4096 )
+    {
+        input.clear();
+    }
+
+    flushOutput();
+}
+
+void VirtualDevice::flushOutput()
+{
+    Clock::time_point now = Clock::now();
+    std::size_t budget = std::numeric_limits<std::size_t>::max();
+    std::size_t sent = 0;
+    bool garbled = false;
+
+    if ( behaviour.baudRate > 0 && outputOffset < output.length() )
+    {
+        if ( now < lineFreeAt )
+        {
+            return;
+        }
+
+        garbled = !isLineMatched();
+        budget = std::max( 1u, currentBaudRate * LINE_SLICE / 10000 ); // 10 bits per byte
+    }
+
+    while ( masterFd >= 0 && outputOffset < output.length() && sent < budget )
+    {
+        std::size_t length = std::min( output.length() - outputOffset, budget - sent );
+        std::string noise;
+        const char * data = output.data() + outputOffset;
+
+        if ( garbled )
+        {
+            noise.assign( length, '\xF0' ); // What a receiver at another rate makes of it, minus the newlines
+            data = noise.data();
+        }
+
+        ssize_t written = write( masterFd, data, length );
+
+        if ( written <= 0 )
+        {
+            break;
+        }
+
+        outputOffset += written;
+        bytesWritten += written;
+        sent += written;
+    }
+
+    if ( behaviour.baudRate > 0 && sent > 0 )
+    {
+        // Time the line needs for what got written; Slack of a late flush is carried over for one slice at most
+        lineFreeAt = std::max( lineFreeAt, now - std::chrono::milliseconds( LINE_SLICE ) ) + std::chrono::nanoseconds( 10000000000ULL * sent / currentBaudRate );
+    }
+
+    if ( pendingBaudRate > 0 && outputOffset == output.length() )
+    {
+        currentBaudRate = pendingBaudRate;
+        pendingBaudRate = 0;
+        baudFallback = now + std::chrono::milliseconds( BAUD_FALLBACK_TIMEOUT );
+    }
+
+    if ( outputOffset == output.length() )
+    {
+        output.clear();
+        outputOffset = 0;
+    }
+    else if ( outputOffset > behaviour.outputBufferSize )
+    {
+        output.erase( 0, outputOffset );
+        outputOffset = 0;
+    }
+}
+
+bool VirtualDevice::hasPendingOutput()
+{
+    return outputOffset < output.length() && Clock::now() >= lineFreeAt;
+}
+
+bool VirtualDevice::isStalled( Clock::time_point now )
+{
+    return now < stallEnd;
+}
+
+VirtualDevice::Clock::time_point VirtualDevice::getNextDeadline()
+{
+    if ( masterFd < 0 )
+    {
+        return reconnectTime;
+    }
+
+    if ( booting )
+    {
+        return bootEnd;
+    }
+
+    if ( stallEnd > Clock::now() )
+    {
+        return stallEnd;
+    }
+
+    Clock::time_point deadline = std::min( std::min( nextDisconnect, baudFallback ), std::min( nextStall, nextGarbage ) );
+
+    if ( outputOffset < output.length() && behaviour.baudRate > 0 )
+    {
+        deadline = std::min( deadline, lineFreeAt );
+    }
+
+    return telemetryRunning ? std::min( deadline, nextTelemetry ) : deadline;
+}
+
+int VirtualDevice::getMasterFd()
+{
+    return this->masterFd;
+}
+
+std::string VirtualDevice::getDeviceId()
+{
+    return this->deviceId;
+}
+
+std::string VirtualDevice::getPort()
+{
+    return linkPath.empty() ? this->port : this->linkPath;
+}
+
+DeviceStatistics VirtualDevice::getStatistics()
+{
+    DeviceStatistics statistics;
+    statistics.linesSent = linesSent;
+    statistics.linesDropped = linesDropped;
+    statistics.bytesWritten = bytesWritten;
+    statistics.commandsReceived = commandsReceived;
+    statistics.disconnects = disconnects;
+    statistics.garbageInjections = garbageInjections;
+    statistics.stalls = stalls;
+
+    return statistics;
+}
@@ -0,0 +1,279 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef VIRTUALDEVICE_HPP
+#define VIRTUALDEVICE_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <random> // std::mt19937, std::exponential_distribution
+
+#include "../dependencies/Exception/src/Exception.hpp"
+
+/**
+ * DeviceBehaviour struct
+ * Purpose: Describes how a virtual device behaves: Its protocol (like the ArduinoStreamCommander's), its telemetry and the faults it injects.
+ *          All intervals of faults are means; The actual intervals are exponentially distributed. An interval of 0 disables the fault.
+*/
+struct DeviceBehaviour
+{
+    std::string commandGetId; // Command which gets answered with the device ID
+    std::string messageTypeId; // Message type of the answer
+    char messageDelimiter;
+    std::string telemetryType; // Message type of telemetry lines
+    unsigned int telemetryRate; // Lines per second; 0 disables telemetry
+    unsigned int telemetrySize; // Bytes per line, including the newline; Lines never get shorter than their header
+    unsigned int burstLength; // Lines which get sent back-to-back; 1 means periodic. The rate stays the average.
+    unsigned int outputBufferSize; // Bytes; Telemetry beyond is dropped (like a UART without flow control), answers never are
+    unsigned int disconnectInterval; // ms
+    unsigned int reconnectDelay; // ms until the device shows up again (with a new pty)
+    unsigned int garbageInterval; // ms
+    unsigned int garbageLength; // Random bytes per injection
+    unsigned int stallInterval; // ms
+    unsigned int stallDuration; // ms the device neither reads nor writes
+    unsigned int bootDelay; // ms the device neither reads nor writes after a gateway opened the port, like an Arduino which resets on DTR; 0 means it doesn't reset
+    std::string bootMessage; // Line the device sends once it has booted (without the newline); Empty means none
+    unsigned int baudRate; // Baud rate the device starts with; Its output is limited to what the line carries (10 bits per byte), and garbled if the gateway's rate differs. 0 means no line gets emulated
+    unsigned int maxBaudRate; // Highest baud rate the device switches to when asked; 0 means it doesn't know the command
+    std::string commandSetBaud; // Command which asks the device to switch ("<command><delimiter><rate>"); Confirmed with the same line, before it switches
+
+    /**
+     * Default constructor; A well-behaved device which sends 10 lines per second.
+    */
+    DeviceBehaviour();
+};
+
+/**
+ * DeviceStatistics struct
+ * Purpose: Holds what a virtual device (or many of them) did so far.
+*/
+struct DeviceStatistics
+{
+    unsigned long long linesSent; // Telemetry lines, including dropped ones
+    unsigned long long linesDropped; // Telemetry lines which didn't fit into the output buffer
+    unsigned long long bytesWritten;
+    unsigned long long commandsReceived;
+    unsigned long long disconnects;
+    unsigned long long garbageInjections;
+    unsigned long long stalls;
+};
+
+/**
+ * VirtualDevice class
+ * File: VirtualDevice.hpp
+ * Purpose: Defines a device which lives on a pty, and behaves like a device running the ArduinoStreamCommander:
+ *          It answers the command to get the device ID with its ID, echoes every other command ("echo:<command>"), and sends telemetry,
+ *          periodically or in bursts. Every telemetry line is pinned with the time it got generated (steady clock, in ns),
+ *          so a gateway on the same host can measure the latency: "<telemetryType><delimiter><sequence>,<timestamp>,<padding>".
+ *          Faults get injected as configured: Disconnects (the pty is closed, and a new one opened after a delay), garbage bytes and stalls.
+ *          A device with a boot delay resets whenever a gateway opens its pty (noticed via inotify): Everything buffered is lost, and it stays deaf and mute until it has booted.
+ *          Like a real tty, it doesn't reset if the gateway closed the pty with HUPCL cleared the last time, since the modem lines stay asserted then.
+ *          A device with a baud rate emulates the line: It sends no faster than the line carries, and the gateway only sees noise (and it doesn't understand the gateway)
+ *          unless the pty is set to its rate. Asked to switch, it confirms at the old rate, and falls back if no command arrives at the new rate within a second.
+ *          The device is driven by a DeviceSimulator, and must only be used by one thread at a time; Just the statistics may be read by any thread.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class VirtualDevice
+{
+public:
+    // Types
+    typedef std::chrono::steady_clock Clock;
+
+private:
+    // Constants
+    static const unsigned int BAUD_FALLBACK_TIMEOUT = 1000; // ms
+    static const unsigned int LINE_SLICE = 10; // ms of line time written at once
+
+    // Variables
+    std::string deviceId;
+    DeviceBehaviour behaviour;
+    std::string linkPath;
+    std::string port;
+    int masterFd;
+    int slaveFd; // Kept open, so the master doesn't see a hangup while no gateway has the port open
+    int openWatchFd; // inotify; Reports when a gateway opens or closes the pty. -1 if the device doesn't reset
+    std::string input;
+    std::string output;
+    std::size_t outputOffset;
+    std::mt19937 random;
+    bool telemetryRunning;
+    unsigned long long sequence;
+    Clock::time_point nextTelemetry;
+    Clock::time_point nextDisconnect;
+    Clock::time_point reconnectTime;
+    Clock::time_point nextGarbage;
+    Clock::time_point nextStall;
+    Clock::time_point stallEnd;
+    Clock::time_point bootEnd;
+    bool booting;
+    bool linesHeld; // Whether the last gateway closed the pty with HUPCL cleared, so opening it again doesn't reset the device
+    unsigned int gatewayOpens; // Descriptors a gateway has open on the pty; Only the first one asserts DTR, and closing the last one drops it
+    unsigned int currentBaudRate;
+    unsigned int pendingBaudRate; // Rate to switch to once the confirmation is out; 0 if none
+    Clock::time_point baudFallback; // When the device falls back to its initial rate, unless a command arrives; max() if it doesn't
+    Clock::time_point lineFreeAt; // When the emulated line has carried everything written so far
+    std::atomic<unsigned long long> linesSent;
+    std::atomic<unsigned long long> linesDropped;
+    std::atomic<unsigned long long> bytesWritten;
+    std::atomic<unsigned long long> commandsReceived;
+    std::atomic<unsigned long long> disconnects;
+    std::atomic<unsigned long long> garbageInjections;
+    std::atomic<unsigned long long> stalls;
+
+    // Methods
+    /**
+     * Opens a new pty, and points the link (if any) to it. Throws Exception if that fails.
+    */
+    void openPty();
+
+    /**
+     * Closes the pty; For the gateway, the device got disconnected.
+    */
+    void closePty();
+
+    /**
+     * Resets the device, if a gateway opened the pty since the last check while the modem lines weren't held.
+     *
+     * @param now Current time.
+    */
+    void checkOpened( Clock::time_point now );
+
+    /**
+     * Gets the time of the next occurrence of a fault.
+     *
+     * @param now Current time.
+     * @param interval Mean interval in ms; 0 means never.
+     * @return Time of the next occurrence.
+    */
+    Clock::time_point scheduleFault( Clock::time_point now, unsigned int interval );
+
+    /**
+     * Queues a telemetry line, unless the output buffer is full.
+    */
+    void queueTelemetry();
+
+    /**
+     * Handles a command received from the gateway.
+     *
+     * @param command Command, without the newline.
+    */
+    void handleCommand( std::string command );
+
+    /**
+     * Resets the baud rate to the initial one, like after a reset.
+    */
+    void resetBaudRate();
+
+    /**
+     * Gets whether the gateway's side of the pty is set to the device's baud rate; Always true if no line gets emulated.
+     *
+     * @return Whether the baud rates match.
+    */
+    bool isLineMatched();
+
+public:
+    // Constructors
+    /**
+     * Default constructor; Opens the pty. Throws Exception if that fails.
+     *
+     * @param deviceId ID of the device.
+     * @param behaviour Behaviour of the device.
+     * @param linkPath Path of a symlink which always points to the device's current pty, since every reconnect gets a new one. May be "".
+     * @param seed Seed for the intervals of faults and the garbage bytes.
+    */
+    VirtualDevice( std::string deviceId, DeviceBehaviour behaviour, std::string linkPath, unsigned int seed );
+
+    // Destructors
+    /**
+     * Default destructor; Closes the pty, and removes the link.
+    */
+    ~VirtualDevice();
+
+    // Methods
+    /**
+     * Advances the device to the current time: Reconnects, injects due faults, and queues due telemetry.
+     *
+     * @param now Current time.
+     * @param telemetryActive Whether telemetry may be sent; Once it's activated, the schedule starts at that point in time.
+    */
+    void tick( Clock::time_point now, bool telemetryActive );
+
+    /**
+     * Reads and handles the commands available on the pty.
+    */
+    void handleInput();
+
+    /**
+     * Writes as much of the output buffer to the pty as possible without blocking.
+    */
+    void flushOutput();
+
+    /**
+     * Gets whether there's output waiting for the pty to become writable.
+     *
+     * @return Whether there's output pending.
+    */
+    bool hasPendingOutput();
+
+    /**
+     * Gets whether the device is stalled at the moment.
+     *
+     * @param now Current time.
+     * @return Whether the device is stalled.
+    */
+    bool isStalled( Clock::time_point now );
+
+    /**
+     * Gets the point in time at which the device needs to be ticked next.
+     *
+     * @return Time of the next event.
+    */
+    Clock::time_point getNextDeadline();
+
+    /**
+     * Gets the master side of the pty.
+     *
+     * @return File descriptor, or -1 while disconnected.
+    */
+    int getMasterFd();
+
+    /**
+     * Gets the ID of the device.
+     *
+     * @return Device ID.
+    */
+    std::string getDeviceId();
+
+    /**
+     * Gets the port a gateway should open; The link, if there's one, otherwise the current pty.
+     *
+     * @return Path of the port.
+    */
+    std::string getPort();
+
+    /**
+     * Gets what the device did so far. May be called by any thread.
+     *
+     * @return Statistics.
+    */
+    DeviceStatistics getStatistics();
+};
+
+#endif // VIRTUALDEVICE_HPP
@@ -0,0 +1,280 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// C Standard Libraries
+#include <signal.h> // sigaction, SIGINT, SIGTERM
+#include <sys/resource.h> // getrlimit, setrlimit
+
+// C++ Standard Libraries
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <chrono>
+
+#include "DeviceSimulator.hpp"
+
+/**
+ * serial-device-sim application
+ * File: serial-device-sim.cpp
+ * Purpose: Spawns virtual devices on ptys, which behave like devices running the ArduinoStreamCommander, to load-test a gateway without hardware.
+ *          Prints "<deviceId> <port>" per device (and writes the ports to a file, if wanted), then runs until interrupted or the duration is over,
+ *          and prints the statistics periodically.
+ *          Usage: serial-device-sim [--devices <n>] [--id-prefix <prefix>] [--threads <n>] [--link-dir <directory>] [--ports-file <file>]
+ *                                   [--getid <command>] [--id-type <type>] [--delimiter <char>] [--type <telemetryType>]
+ *                                   [--rate <linesPerSecond>] [--size <bytes>] [--burst <lines>] [--buffer <bytes>] [--start-after <seconds>]
+ *                                   [--disconnect-every <ms>] [--reconnect-after <ms>] [--garbage-every <ms>] [--garbage-length <bytes>]
+ *                                   [--stall-every <ms>] [--stall-for <ms>] [--boot-delay <ms>] [--boot-message <line>]
+ *                                   [--baud <rate>] [--max-baud <rate>] [--setbaud <command>]
+ *                                   [--seed <n>] [--duration <seconds>] [--report-every <seconds>]
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0 20.01.2019
+*/
+
+// Types
+struct Options
+{
+    unsigned int devices;
+    std::string idPrefix;
+    unsigned int threads;
+    std::string linkDirectory;
+    std::string portsFile;
+    DeviceBehaviour behaviour;
+    double startAfter; // Seconds until telemetry starts, e.g. to let the gateway add all devices first
+    unsigned int seed;
+    double duration; // Seconds; 0 means until interrupted
+    double reportInterval; // Seconds
+};
+
+// Variables
+volatile sig_atomic_t interrupted = 0;
+
+/**
+ * Handles SIGINT and SIGTERM.
+ *
+ * @param signal Signal number.
+*/
+void handleSignal( int signal )
+{
+    interrupted = 1;
+}
+
+/**
+ * Parses the command line options. Throws std::invalid_argument if they're invalid.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return Options.
+*/
+Options parseOptions( int argc, char* argv[] )
+{
+    Options options;
+    options.devices = 1;
+    options.idPrefix = "sim";
+    options.threads = 1;
+    options.startAfter = 0;
+    options.seed = 1;
+    options.duration = 0;
+    options.reportInterval = 5;
+
+    for ( int index = 1; index < argc; index += 2 )
+    {
+        std::string name = argv[index];
+
+        if ( index + 1 >= argc )
+        {
+            throw std::invalid_argument( "Missing value for option \"" + name + "\"." );
+        }
+
+        std::string value = argv[index + 1];
+        DeviceBehaviour & behaviour = options.behaviour;
+
+        if ( name == "--devices" ) options.devices = std::stoul( value );
+        else if ( name == "--id-prefix" ) options.idPrefix = value;
+        else if ( name == "--threads" ) options.threads = std::stoul( value );
+        else if ( name == "--link-dir" ) options.linkDirectory = value;
+        else if ( name == "--ports-file" ) options.portsFile = value;
+        else if ( name == "--getid" ) behaviour.commandGetId = value;
+        else if ( name == "--id-type" ) behaviour.messageTypeId = value;
+        else if ( name == "--delimiter" && value.length() == 1 ) behaviour.messageDelimiter = value[0];
+        else if ( name == "--type" ) behaviour.telemetryType = value;
+        else if ( name == "--rate" ) behaviour.telemetryRate = std::stoul( value );
+        else if ( name == "--size" ) behaviour.telemetrySize = std::stoul( value );
+        else if ( name == "--burst" ) behaviour.burstLength = std::stoul( value );
+        else if ( name == "--buffer" ) behaviour.outputBufferSize = std::stoul( value );
+        else if ( name == "--start-after" ) options.startAfter = std::stod( value );
+        else if ( name == "--disconnect-every" ) behaviour.disconnectInterval = std::stoul( value );
+        else if ( name == "--reconnect-after" ) behaviour.reconnectDelay = std::stoul( value );
+        else if ( name == "--garbage-every" ) behaviour.garbageInterval = std::stoul( value );
+        else if ( name == "--garbage-length" ) behaviour.garbageLength = std::stoul( value );
+        else if ( name == "--stall-every" ) behaviour.stallInterval = std::stoul( value );
+        else if ( name == "--stall-for" ) behaviour.stallDuration = std::stoul( value );
+        else if ( name == "--boot-delay" ) behaviour.bootDelay = std::stoul( value );
+        else if ( name == "--boot-message" ) behaviour.bootMessage = value;
+        else if ( name == "--baud" ) behaviour.baudRate = std::stoul( value );
+        else if ( name == "--max-baud" ) behaviour.maxBaudRate = std::stoul( value );
+        else if ( name == "--setbaud" ) behaviour.commandSetBaud = value;
+        else if ( name == "--seed" ) options.seed = std::stoul( value );
+        else if ( name == "--duration" ) options.duration = std::stod( value );
+        else if ( name == "--report-every" ) options.reportInterval = std::stod( value );
+        else throw std::invalid_argument( "Unknown or invalid option \"" + name + "\"." );
+    }
+
+    if ( options.devices == 0 || options.reportInterval <= 0 )
+    {
+        throw std::invalid_argument( "Devices and report interval must be > 0." );
+    }
+
+    return options;
+}
+
+/**
+ * Raises the limit of open files as far as allowed; Every device needs two of them (three with a boot delay).
+ *
+ * @param devices Number of devices.
+*/
+void raiseFileLimit( unsigned int devices )
+{
+    rlimit limit;
+
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 && limit.rlim_cur < limit.rlim_max )
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &limit );
+    }
+
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 && limit.rlim_cur < 2 * devices + 16 )
+    {
+        std::cerr << "Warning: The limit of open files (" << limit.rlim_cur << ") is too low for " << devices << " devices." << std::endl;
+    }
+}
+
+/**
+ * Prints the statistics, and the rates since the last report.
+ *
+ * @param statistics Current statistics.
+ * @param last Statistics of the last report; Gets the current ones assigned.
+ * @param seconds Seconds since the last report.
+*/
+void printStatistics( const DeviceStatistics & statistics, DeviceStatistics & last, double seconds )
+{
+    std::cerr << "lines sent " << statistics.linesSent << " (" << static_cast<unsigned long long>( ( statistics.linesSent - last.linesSent ) / seconds ) << "/s)"
+              << ", dropped " << statistics.linesDropped
+              << ", bytes written " << statistics.bytesWritten << " (" << static_cast<unsigned long long>( ( statistics.bytesWritten - last.bytesWritten ) / seconds ) << "/s)"
+              << ", commands " << statistics.commandsReceived
+              << ", disconnects " << statistics.disconnects
+              << ", garbage " << statistics.garbageInjections
+              << ", stalls " << statistics.stalls << std::endl;
+
+    last = statistics;
+}
+
+/**
+ * Main function.
+ *
+ * @return Returns the exitcode. 0 means success, 1 means there was an error while executing.
+*/
+int main( int argc, char* argv[] )
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Options options;
+
+    try
+    {
+        options = parseOptions( argc, argv );
+    }
+    catch ( const std::exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    raiseFileLimit( options.devices );
+
+    struct sigaction action = {};
+    action.sa_handler = handleSignal;
+    sigaction( SIGINT, &action, nullptr );
+    sigaction( SIGTERM, &action, nullptr );
+
+    DeviceSimulator simulator( options.threads, options.seed );
+    std::ofstream portsFile;
+
+    if ( !options.portsFile.empty() )
+    {
+        portsFile.open( options.portsFile );
+    }
+
+    try
+    {
+        for ( unsigned int index = 0; index < options.devices; index++ )
+        {
+            std::string deviceId = options.idPrefix + std::to_string( index );
+            std::string linkPath = options.linkDirectory.empty() ? "" : options.linkDirectory + "/" + deviceId;
+            DeviceSimulator::VirtualDevicePointer device = simulator.addDevice( deviceId, options.behaviour, linkPath );
+
+            std::cout << deviceId << " " << device->getPort() << std::endl;
+
+            if ( portsFile.is_open() )
+            {
+                portsFile << device->getPort() << std::endl;
+            }
+        }
+    }
+    catch ( const Exception & e )
+    {
+        std::cerr << e.what() << std::endl;
+
+        return 1;
+    }
+
+    portsFile.close();
+    simulator.start();
+
+    Clock::time_point begin = Clock::now();
+    Clock::time_point telemetryStart = begin + std::chrono::microseconds( static_cast<long long>( options.startAfter * 1e6 ) );
+    Clock::time_point end = begin + std::chrono::microseconds( static_cast<long long>( options.duration * 1e6 ) );
+    Clock::time_point lastReport = begin;
+    DeviceStatistics last = {};
+    bool telemetryActive = false;
+
+    while ( !interrupted && ( options.duration == 0 || Clock::now() < end ) )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        Clock::time_point now = Clock::now();
+
+        if ( !telemetryActive && now >= telemetryStart )
+        {
+            telemetryActive = true;
+            simulator.setTelemetryActive( true );
+        }
+
+        double seconds = std::chrono::duration<double>( now - lastReport ).count();
+
+        if ( seconds >= options.reportInterval )
+        {
+            printStatistics( simulator.getStatistics(), last, seconds );
+            lastReport = now;
+        }
+    }
+
+    simulator.stop();
+    printStatistics( simulator.getStatistics(), last, std::chrono::duration<double>( Clock::now() - lastReport ).count() );
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "AllocationTracker.hpp"
+
+thread_local AllocationStage AllocationTracker::currentStage = AllocationStage::UNTRACKED;
+std::atomic<unsigned long long> AllocationTracker::allocations[static_cast<std::size_t>( AllocationStage::COUNT )];
+std::atomic<unsigned long long> AllocationTracker::bytes[static_cast<std::size_t>( AllocationStage::COUNT )];
+
+void AllocationTracker::recordAllocation( std::size_t size )
+{
+    std::size_t stage = static_cast<std::size_t>( currentStage );
+
+    allocations[stage].fetch_add( 1, std::memory_order_relaxed );
+    bytes[stage].fetch_add( size, std::memory_order_relaxed );
+}
+
+void AllocationTracker::setCurrentStage( AllocationStage stage )
+{
+    currentStage = stage;
+}
+
+AllocationStage AllocationTracker::getCurrentStage()
+{
+    return currentStage;
+}
+
+AllocationSnapshot AllocationTracker::getSnapshot()
+{
+    AllocationSnapshot snapshot;
+
+    for ( std::size_t stage = 0; stage < static_cast<std::size_t>( AllocationStage::COUNT ); stage++ )
+    {
+        snapshot.allocations[stage] = allocations[stage].load( std::memory_order_relaxed );
+        snapshot.bytes[stage] = bytes[stage].load( std::memory_order_relaxed );
+    }
+
+    return snapshot;
+}
+
+void AllocationTracker::reset()
+{
+    for ( std::size_t stage = 0; stage < static_cast<std::size_t>( AllocationStage::COUNT ); stage++ )
+    {
+        allocations[stage].store( 0, std::memory_order_relaxed );
+        bytes[stage].store( 0, std::memory_order_relaxed );
+    }
+}
+
+bool AllocationTracker::isCompiledIn()
+{
+    return SERIALPORTGATEWAY_ALLOCATION_CHECK != 0;
+}
+
+const char * AllocationTracker::getStageName( AllocationStage stage )
+{
+    switch ( stage )
+    {
+        case AllocationStage::UNTRACKED:
+            return "untracked";
+        case AllocationStage::READ:
+            return "read";
+        case AllocationStage::PROCESS:
+            return "process";
+        case AllocationStage::DISPATCH:
+            return "dispatch";
+        case AllocationStage::CALLBACK:
+            return "callback";
+        case AllocationStage::SEND:
+            return "send";
+        default:
+            return "unknown";
+    }
+}
+
+AllocationStageScope::AllocationStageScope( AllocationStage stage )
+{
+    previousStage = AllocationTracker::getCurrentStage();
+    AllocationTracker::setCurrentStage( stage );
+}
+
+AllocationStageScope::~AllocationStageScope()
+{
+    AllocationTracker::setCurrentStage( previousStage );
+}
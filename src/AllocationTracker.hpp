@@ -0,0 +1,166 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef ALLOCATIONTRACKER_HPP
+#define ALLOCATIONTRACKER_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+
+// Whether the pipeline marks its allocation stages at all (0 = off, 1 = on). Only meant for the allocation check build (See "make alloccheck");
+// Otherwise every SPG_ALLOCATION_STAGE gets removed entirely.
+#ifndef SERIALPORTGATEWAY_ALLOCATION_CHECK
+#define SERIALPORTGATEWAY_ALLOCATION_CHECK 0
+#endif
+
+// Attributes every allocation of the current thread to the given stage, until the end of the enclosing scope.
+// Usage: SPG_ALLOCATION_STAGE( AllocationStage::PROCESS );
+#if SERIALPORTGATEWAY_ALLOCATION_CHECK
+#define SPG_ALLOCATION_STAGE( stage ) AllocationStageScope allocationStageScope( stage )
+#else
+#define SPG_ALLOCATION_STAGE( stage ) do {} while ( false )
+#endif
+
+/**
+ * AllocationStage enum
+ * Purpose: Lists the stages of the message pipeline allocations get attributed to.
+*/
+enum class AllocationStage : unsigned char
+{
+    UNTRACKED, // Everything outside of the message pipeline (setup, discovery, logging, ...)
+    READ, // "readLoop": Reading a line, and handing it over to the message worker or the inbound queue
+    PROCESS, // "processMessage": Parsing, building the SerialMessage, schema extraction
+    DISPATCH, // Handing the callback over to the dispatcher, and running it (delivery loop, message workers, isolated lane)
+    CALLBACK, // The message callbacks themselves
+    SEND, // "sendMessageToSerialDevice" and its send worker
+    COUNT // Number of stages
+};
+
+/**
+ * AllocationSnapshot struct
+ * Purpose: Contains the allocations per stage at one point in time.
+*/
+struct AllocationSnapshot
+{
+    unsigned long long allocations[static_cast<std::size_t>( AllocationStage::COUNT )];
+    unsigned long long bytes[static_cast<std::size_t>( AllocationStage::COUNT )];
+};
+
+/**
+ * AllocationTracker class
+ * File: AllocationTracker.hpp
+ * Purpose: Defines the counters for the allocation check: Counting allocation hooks (operator new, installed by the check's binary) report every allocation,
+ *          which gets attributed to the stage the allocating thread is in. The stages get marked in the pipeline via SPG_ALLOCATION_STAGE.
+ *          Everything is static, so the hooks can use it before main and without a gateway; The counters are plain atomics (relaxed),
+ *          which are zero-initialized before any constructor runs.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class AllocationTracker
+{
+private:
+    // Variables
+    static thread_local AllocationStage currentStage;
+    static std::atomic<unsigned long long> allocations[static_cast<std::size_t>( AllocationStage::COUNT )];
+    static std::atomic<unsigned long long> bytes[static_cast<std::size_t>( AllocationStage::COUNT )];
+
+public:
+    // Methods
+    /**
+     * Counts an allocation for the current thread's stage. Gets called by the counting allocation hooks; Must not allocate itself.
+     *
+     * @param size Size of the allocation in bytes.
+    */
+    static void recordAllocation( std::size_t size );
+
+    /**
+     * Sets the current thread's stage.
+     *
+     * @param stage Stage to be set.
+    */
+    static void setCurrentStage( AllocationStage stage );
+
+    /**
+     * Gets the current thread's stage.
+     *
+     * @return Current stage.
+    */
+    static AllocationStage getCurrentStage();
+
+    /**
+     * Gets the allocations per stage, counted since the last reset.
+     *
+     * @return Snapshot of the counters.
+    */
+    static AllocationSnapshot getSnapshot();
+
+    /**
+     * Resets all counters.
+    */
+    static void reset();
+
+    /**
+     * Gets whether the stages got compiled into the gateway (SERIALPORTGATEWAY_ALLOCATION_CHECK); Otherwise everything counts as UNTRACKED.
+     *
+     * @return Whether the stages got compiled in.
+    */
+    static bool isCompiledIn();
+
+    /**
+     * Gets the name of a stage.
+     *
+     * @param stage Stage to get the name for.
+     * @return Name of the stage.
+    */
+    static const char * getStageName( AllocationStage stage );
+};
+
+/**
+ * AllocationStageScope class
+ * File: AllocationTracker.hpp
+ * Purpose: Defines a guard, which sets the current thread's stage and restores the previous one at the end of the scope, so stages can be nested.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class AllocationStageScope
+{
+private:
+    // Variables
+    AllocationStage previousStage;
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param stage Stage to be entered.
+    */
+    AllocationStageScope( AllocationStage stage );
+
+    // Destructors
+    /**
+     * Destructor; Restores the previous stage.
+    */
+    ~AllocationStageScope();
+
+    AllocationStageScope( const AllocationStageScope & ) = delete;
+    AllocationStageScope & operator=( const AllocationStageScope & ) = delete;
+};
+
+#endif // ALLOCATIONTRACKER_HPP
@@ -0,0 +1,327 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "AsyncLogger.hpp"
+
+// C Standard Libraries
+#include <cstdio> // snprintf
+#include <cstring> // std::memcpy, std::strerror
+#include <cerrno> // errno, EINTR
+#include <ctime> // std::time_t, localtime_r, strftime
+#include <fcntl.h> // open
+#include <unistd.h> // write, close, STDOUT_FILENO
+
+const std::size_t AsyncLogger::DEFAULT_CAPACITY;
+const std::size_t AsyncLogger::BATCH_SIZE;
+const unsigned int AsyncLogger::FLUSH_INTERVAL;
+const std::string AsyncLogger::TRUNCATION_MARK = "[...]";
+
+AsyncLogger::AsyncLogger( std::string name, std::string logPath, bool consoleOutput, bool fileOutput, std::size_t capacity )
+{
+    this->name = name;
+    this->logPath = logPath;
+    this->consoleOutput = consoleOutput;
+    this->fileOutput = fileOutput;
+    this->fileDescriptor = -1;
+    this->enqueuePosition = 0;
+    this->dequeuePosition = 0;
+    this->writtenPosition = 0;
+    this->droppedCount = 0;
+    this->started = false;
+
+    // Round up to a power of two, so the slot of a position can be determined by masking
+    this->capacity = 2;
+
+    while ( this->capacity < capacity )
+    {
+        this->capacity *= 2;
+    }
+
+    records.reset( new LogRecord[this->capacity] );
+
+    for ( std::size_t position = 0; position < this->capacity; position++ )
+    {
+        records[position].sequence = position;
+    }
+
+    openLogFile();
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+
+    if ( fileDescriptor != -1 )
+    {
+        close( fileDescriptor );
+    }
+}
+
+void AsyncLogger::openLogFile()
+{
+    if ( !fileOutput )
+    {
+        return;
+    }
+
+    std::string fileName = logPath + "/" + name + ".log";
+    fileDescriptor = open( fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644 );
+
+    if ( fileDescriptor == -1 )
+    {
+        throw Exception( "Couldn't open log file \"" + fileName + "\": " + std::string( std::strerror( errno ) ) );
+    }
+}
+
+void AsyncLogger::start()
+{
+    if ( isStarted() )
+    {
+        return;
+    }
+
+    started = true;
+    writerThread = std::thread( &AsyncLogger::writeLoop, this );
+}
+
+void AsyncLogger::stop()
+{
+    if ( !isStarted() )
+    {
+        return;
+    }
+
+    started = false;
+
+    if ( writerThread.joinable() )
+    {
+        writerThread.join();
+    }
+}
+
+void AsyncLogger::flush()
+{
+    std::size_t targetPosition = enqueuePosition.load( std::memory_order_acquire );
+
+    while ( isStarted() && writtenPosition.load( std::memory_order_acquire ) < targetPosition )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+}
+
+bool AsyncLogger::isStarted()
+{
+    return this->started;
+}
+
+bool AsyncLogger::enqueue( LogType type, const std::string & message )
+{
+    // Bounded multi-producer queue: A producer claims a slot by advancing the enqueue position,
+    // but only if the slot's sequence tells that the writer thread has already released it.
+    std::size_t position = enqueuePosition.load( std::memory_order_relaxed );
+    LogRecord * record;
+
+    while ( true )
+    {
+        record = &records[position & ( capacity - 1 )];
+        std::size_t sequence = record->sequence.load( std::memory_order_acquire );
+        std::ptrdiff_t difference = static_cast<std::ptrdiff_t>( sequence ) - static_cast<std::ptrdiff_t>( position );
+
+        if ( difference == 0 )
+        {
+            if ( enqueuePosition.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+            {
+                break;
+            }
+        }
+        else if ( difference < 0 )
+        {
+            droppedCount.fetch_add( 1, std::memory_order_relaxed );
+
+            return false;
+        }
+        else
+        {
+            position = enqueuePosition.load( std::memory_order_relaxed );
+        }
+    }
+
+    std::chrono::system_clock::duration durationSinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    record->timestamp = std::chrono::duration_cast<std::chrono::milliseconds>( durationSinceEpoch ).count();
+    record->type = type;
+
+    std::size_t length = message.length();
+
+    if ( length > sizeof( record->text ) )
+    {
+        length = sizeof( record->text ) - TRUNCATION_MARK.length();
+        std::memcpy( record->text + length, TRUNCATION_MARK.c_str(), TRUNCATION_MARK.length() );
+        std::memcpy( record->text, message.c_str(), length );
+        length = sizeof( record->text );
+    }
+    else
+    {
+        std::memcpy( record->text, message.c_str(), length );
+    }
+
+    record->length = static_cast<unsigned short>( length );
+    record->sequence.store( position + 1, std::memory_order_release );
+
+    return true;
+}
+
+void AsyncLogger::writeLoop()
+{
+    std::string batch;
+    batch.reserve( BATCH_SIZE + sizeof( LogRecord::text ) + 64 );
+
+    while ( isStarted() )
+    {
+        if ( drain( batch ) == 0 )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( FLUSH_INTERVAL ) );
+        }
+    }
+
+    // Flush everything which got enqueued until the logger was stopped
+    drain( batch );
+}
+
+std::size_t AsyncLogger::drain( std::string & batch )
+{
+    std::size_t numRecords = 0;
+
+    while ( true )
+    {
+        LogRecord & record = records[dequeuePosition & ( capacity - 1 )];
+
+        if ( record.sequence.load( std::memory_order_acquire ) != dequeuePosition + 1 )
+        {
+            break; // Slot not filled (yet)
+        }
+
+        appendRecord( record, batch );
+
+        // Release the slot for the next lap of the producers
+        record.sequence.store( dequeuePosition + capacity, std::memory_order_release );
+        dequeuePosition++;
+        numRecords++;
+
+        if ( batch.length() >= BATCH_SIZE )
+        {
+            writeBatch( batch );
+        }
+    }
+
+    writeBatch( batch );
+    writtenPosition.store( dequeuePosition, std::memory_order_release );
+
+    return numRecords;
+}
+
+void AsyncLogger::appendRecord( const LogRecord & record, std::string & batch )
+{
+    std::time_t seconds = static_cast<std::time_t>( record.timestamp / 1000 );
+    std::tm localTime;
+    char timeBuffer[32];
+
+    localtime_r( &seconds, &localTime );
+    std::size_t timeLength = strftime( timeBuffer, sizeof( timeBuffer ), "%Y-%m-%d %H:%M:%S", &localTime );
+
+    batch.append( "[" );
+    batch.append( timeBuffer, timeLength );
+
+    char milliseconds[8];
+    int millisecondsLength = snprintf( milliseconds, sizeof( milliseconds ), ".%03llu", record.timestamp % 1000 );
+    batch.append( milliseconds, millisecondsLength );
+
+    switch ( record.type )
+    {
+        case LogType::INFO:
+            batch.append( "] [INFO] [" );
+            break;
+        case LogType::WARN:
+            batch.append( "] [WARN] [" );
+            break;
+        case LogType::ERROR:
+            batch.append( "] [ERROR] [" );
+            break;
+    }
+
+    batch.append( name );
+    batch.append( "] " );
+    batch.append( record.text, record.length );
+    batch.append( "\n" );
+}
+
+void AsyncLogger::writeBatch( std::string & batch )
+{
+    if ( batch.empty() )
+    {
+        return;
+    }
+
+    int fileDescriptors[] = { consoleOutput ? STDOUT_FILENO : -1, fileDescriptor };
+
+    for ( int fd : fileDescriptors )
+    {
+        if ( fd == -1 )
+        {
+            continue;
+        }
+
+        std::size_t bytesWritten = 0;
+
+        while ( bytesWritten < batch.length() )
+        {
+            ssize_t result = write( fd, batch.c_str() + bytesWritten, batch.length() - bytesWritten );
+
+            if ( result < 0 )
+            {
+                if ( errno == EINTR )
+                {
+                    continue;
+                }
+
+                break; // Nowhere left to report this to; The batch is lost for this output
+            }
+
+            bytesWritten += result;
+        }
+    }
+
+    batch.clear();
+}
+
+void AsyncLogger::writeInfo( const std::string & message )
+{
+    enqueue( LogType::INFO, message );
+}
+
+void AsyncLogger::writeWarn( const std::string & message )
+{
+    enqueue( LogType::WARN, message );
+}
+
+void AsyncLogger::writeError( const std::string & message )
+{
+    enqueue( LogType::ERROR, message );
+}
+
+unsigned long long AsyncLogger::getDroppedCount()
+{
+    return this->droppedCount;
+}
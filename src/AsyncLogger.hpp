@@ -0,0 +1,198 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef ASYNCLOGGER_HPP
+#define ASYNCLOGGER_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic
+#include <string>
+#include <memory> // std::unique_ptr
+#include <thread> // std::thread, std::this_thread::sleep_for
+#include <chrono>
+
+#include "../dependencies/Exception/src/Exception.hpp"
+
+/**
+ * AsyncLogger class
+ * File: AsyncLogger.hpp
+ * Purpose: Defines a logger which doesn't block the calling thread with any I/O.
+ *          Log messages get copied into fixed-size records on a pre-allocated, lock-free ring buffer.
+ *          A background thread formats those records and writes them in large batches to the console and/or the log file.
+ *          If the ring buffer is full, the message gets dropped and counted instead of blocking the caller.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class AsyncLogger
+{
+public:
+    // Types
+    enum class LogType : unsigned char
+    {
+        INFO,
+        WARN,
+        ERROR
+    };
+
+private:
+    // Types
+    struct LogRecord
+    {
+        std::atomic<std::size_t> sequence; // Ticket of the ring slot; tells producers and the consumer whether the slot is free or filled
+        unsigned long long timestamp;
+        LogType type;
+        unsigned short length;
+        char text[256];
+    };
+
+    // Constants
+    static const std::size_t DEFAULT_CAPACITY = 8192; // Records
+    static const std::size_t BATCH_SIZE = 65536; // Bytes
+    static const unsigned int FLUSH_INTERVAL = 10; // ms
+    static const std::string TRUNCATION_MARK;
+
+    // Variables
+    std::string name;
+    std::string logPath;
+    bool consoleOutput;
+    bool fileOutput;
+    int fileDescriptor;
+    std::size_t capacity;
+    std::unique_ptr<LogRecord[]> records;
+    std::atomic<std::size_t> enqueuePosition;
+    std::size_t dequeuePosition; // Only accessed by the writer thread
+    std::atomic<std::size_t> writtenPosition; // Position up to which all records have been written out
+    std::atomic<unsigned long long> droppedCount;
+    std::atomic_bool started;
+    std::thread writerThread;
+
+    // Methods
+    /**
+     * Opens the log file, if file output is active.
+    */
+    void openLogFile();
+
+    /**
+     * Tries to put a message onto the ring buffer.
+     *
+     * @param type Type of the message.
+     * @param message Message to be logged.
+     * @return Whether the message could be enqueued, or got dropped because the ring buffer is full.
+    */
+    bool enqueue( LogType type, const std::string & message );
+
+    /**
+     * Loop of the background thread; Drains the ring buffer and writes the records in batches until the logger is stopped.
+    */
+    void writeLoop();
+
+    /**
+     * Moves all records currently on the ring buffer into the batch, and writes the batch whenever it's full or the ring buffer is drained.
+     *
+     * @param batch Buffer to be used for the batch. Gets cleared after every write.
+     * @return Number of records written.
+    */
+    std::size_t drain( std::string & batch );
+
+    /**
+     * Writes a batch to all active outputs, and clears it afterwards.
+     *
+     * @param batch Batch to be written.
+    */
+    void writeBatch( std::string & batch );
+
+    /**
+     * Formats a record and appends it to the batch.
+     *
+     * @param record Record to be formatted.
+     * @param batch Batch to append to.
+    */
+    void appendRecord( const LogRecord & record, std::string & batch );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param name Name of the logger, which gets prepended to each message and is used as log file name.
+     * @param logPath Directory to which the log file should be written.
+     * @param consoleOutput Whether to write to the console (stdout).
+     * @param fileOutput Whether to write to a log file.
+     * @param capacity Number of records the ring buffer can hold. Gets rounded up to a power of two.
+    */
+    AsyncLogger( std::string name, std::string logPath, bool consoleOutput = true, bool fileOutput = false, std::size_t capacity = DEFAULT_CAPACITY );
+
+    // Destructors
+    /**
+     * Destructor; stops the logger, which flushes all pending records.
+    */
+    ~AsyncLogger();
+
+    // Methods
+    /**
+     * Starts the background writer thread.
+    */
+    void start();
+
+    /**
+     * Stops the background writer thread, after all pending records have been written.
+    */
+    void stop();
+
+    /**
+     * Blocks until every record enqueued so far has been written out.
+     * Returns immediately if the logger is not started.
+    */
+    void flush();
+
+    /**
+     * Gets whether the logger is started.
+     *
+     * @return Whether the logger is started or not.
+    */
+    bool isStarted();
+
+    /**
+     * Logs an info message.
+     *
+     * @param message Message to be logged. Messages longer than a record get truncated.
+    */
+    void writeInfo( const std::string & message );
+
+    /**
+     * Logs a warning.
+     *
+     * @param message Message to be logged. Messages longer than a record get truncated.
+    */
+    void writeWarn( const std::string & message );
+
+    /**
+     * Logs an error.
+     *
+     * @param message Message to be logged. Messages longer than a record get truncated.
+    */
+    void writeError( const std::string & message );
+
+    /**
+     * Gets how many messages have been dropped, because the ring buffer was full.
+     *
+     * @return Number of dropped messages.
+    */
+    unsigned long long getDroppedCount();
+};
+
+#endif // ASYNCLOGGER_HPP
@@ -0,0 +1,47 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "BootDelayTracker.hpp"
+
+const double BootDelayTracker::WEIGHT = 0.25;
+
+void BootDelayTracker::record( std::string hardwareId, unsigned int delay )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    DelayMap::iterator it = delays.find( hardwareId );
+
+    if ( it == delays.end() )
+    {
+        delays[hardwareId] = delay;
+    }
+    else
+    {
+        it->second += WEIGHT * ( delay - it->second );
+    }
+}
+
+unsigned int BootDelayTracker::getTypicalDelay( std::string hardwareId )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    DelayMap::iterator it = delays.find( hardwareId );
+
+    if ( it == delays.end() )
+    {
+        return 0;
+    }
+
+    return static_cast<unsigned int>( it->second + 0.5 );
+}
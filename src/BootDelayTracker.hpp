@@ -0,0 +1,67 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef BOOTDELAYTRACKER_HPP
+#define BOOTDELAYTRACKER_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <map>
+#include <mutex> // std::mutex, std::lock_guard
+
+/**
+ * BootDelayTracker class
+ * File: BootDelayTracker.hpp
+ * Purpose: Defines a tracker which learns how long devices of a kind (by hardware ID) typically take after the port got opened, until they answer.
+ *          Every observed delay moves the typical delay of its hardware ID a quarter of the way (exponentially weighted moving average),
+ *          so a single slow boot doesn't throw it off, while a changed firmware is learned within a few reconnects.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class BootDelayTracker
+{
+private:
+    // Types
+    typedef std::map<std::string, double> DelayMap; // first value: hardwareId, second value: typical delay in ms
+
+    // Constants
+    static const double WEIGHT; // Weight of a new observation
+
+    // Variables
+    DelayMap delays;
+    std::mutex mutex;
+
+public:
+    // Methods
+    /**
+     * Records an observed boot delay.
+     *
+     * @param hardwareId Hardware ID of the device; May be empty, for devices without one.
+     * @param delay Time in ms from opening the port until the device answered.
+    */
+    void record( std::string hardwareId, unsigned int delay );
+
+    /**
+     * Gets the typical boot delay of a hardware ID.
+     *
+     * @param hardwareId Hardware ID of the device.
+     * @return Time in ms; 0 if nothing has been observed yet.
+    */
+    unsigned int getTypicalDelay( std::string hardwareId );
+};
+
+#endif // BOOTDELAYTRACKER_HPP
@@ -0,0 +1,212 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "CallbackDispatcher.hpp"
+
+CallbackDispatcher::CallbackDispatcher( unsigned int callbackBudget, unsigned int slowStreakLength, unsigned int isolatedThreadCount, StructuredLogger * structuredLoggerInstance )
+{
+    if ( slowStreakLength == 0 )
+    {
+        throw Exception( "Slow streak length must be > 0." );
+    }
+
+    if ( isolatedThreadCount == 0 )
+    {
+        throw Exception( "Number of isolated threads must be > 0." );
+    }
+
+    if ( structuredLoggerInstance == nullptr )
+    {
+        throw Exception( "Structured logger instance must not be null." );
+    }
+
+    this->callbackBudget = static_cast<unsigned long long>( callbackBudget ) * 1000;
+    this->slowStreakLength = slowStreakLength;
+    this->isolatedThreadCount = isolatedThreadCount;
+    this->structuredLoggerInstance = structuredLoggerInstance;
+    this->started = false;
+}
+
+CallbackDispatcher::~CallbackDispatcher()
+{
+    stop();
+}
+
+void CallbackDispatcher::start()
+{
+    std::lock_guard<std::mutex> lock( isolatedQueueMutex );
+
+    if ( started )
+    {
+        return;
+    }
+
+    started = true;
+
+    for ( unsigned int index = 0; index < isolatedThreadCount; index++ )
+    {
+        threads.spawn( std::bind( &CallbackDispatcher::isolatedLoop, this ) );
+    }
+}
+
+void CallbackDispatcher::markStopped()
+{
+    {
+        std::lock_guard<std::mutex> lock( isolatedQueueMutex );
+        started = false;
+    }
+
+    isolatedQueueCondition.notify_all();
+}
+
+void CallbackDispatcher::stop()
+{
+    markStopped();
+    threads.join();
+}
+
+std::size_t CallbackDispatcher::stop( SteadyTimePoint deadline )
+{
+    markStopped();
+    threads.join( deadline ); // Meanwhile the worker threads drain the queue
+
+    std::size_t dropped;
+
+    {
+        std::lock_guard<std::mutex> lock( isolatedQueueMutex );
+        dropped = isolatedQueue.size();
+        isolatedQueue.clear(); // The worker threads quit after their current callback
+    }
+
+    if ( dropped > 0 )
+    {
+        SPG_LOG_WARN( structuredLoggerInstance, "Dropped queued callbacks of the isolated lane", logField( "dropped", dropped ) );
+    }
+
+    return dropped;
+}
+
+void CallbackDispatcher::dispatch( DeviceMetricsPointer deviceMetrics, Callback callback )
+{
+    if ( deviceMetrics->isIsolated() && enqueueIsolated( deviceMetrics, callback ) )
+    {
+        return;
+    }
+
+    runCallback( deviceMetrics, callback );
+}
+
+bool CallbackDispatcher::enqueueIsolated( DeviceMetricsPointer deviceMetrics, Callback callback )
+{
+    {
+        std::lock_guard<std::mutex> lock( isolatedQueueMutex );
+
+        if ( !started )
+        {
+            return false;
+        }
+
+        isolatedQueue.push_back( IsolatedCallback{ deviceMetrics, callback } );
+    }
+
+    isolatedQueueCondition.notify_one();
+
+    return true;
+}
+
+void CallbackDispatcher::isolatedLoop()
+{
+    SPG_ALLOCATION_STAGE( AllocationStage::DISPATCH );
+
+    while ( true )
+    {
+        IsolatedCallback isolatedCallback;
+
+        {
+            std::unique_lock<std::mutex> lock( isolatedQueueMutex );
+            isolatedQueueCondition.wait( lock, [this]() { return !started || !isolatedQueue.empty(); } );
+
+            if ( isolatedQueue.empty() ) // Stopped, and nothing left to run
+            {
+                return;
+            }
+
+            isolatedCallback = isolatedQueue.front();
+            isolatedQueue.pop_front();
+        }
+
+        runCallback( isolatedCallback.deviceMetrics, isolatedCallback.callback );
+    }
+}
+
+void CallbackDispatcher::run( DeviceMetricsPointer deviceMetrics, const Callback & callback )
+{
+    timeCallback( deviceMetrics, callback );
+}
+
+int CallbackDispatcher::timeCallback( DeviceMetricsPointer deviceMetrics, const Callback & callback )
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    callback();
+
+    unsigned long long callbackTime = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - begin ).count();
+    bool slow = callbackBudget > 0 && callbackTime > callbackBudget;
+
+    if ( slow )
+    {
+        SPG_LOG_DEBUG( structuredLoggerInstance, "Slow callback", logField( "deviceId", deviceMetrics->getDeviceId() ), logField( "callbackTimeUs", callbackTime ), logField( "budgetUs", callbackBudget ) );
+    }
+
+    return deviceMetrics->recordCallbackTime( callbackTime, slow );
+}
+
+void CallbackDispatcher::runCallback( DeviceMetricsPointer deviceMetrics, const Callback & callback )
+{
+    SPG_ALLOCATION_STAGE( AllocationStage::DISPATCH );
+
+    int streak = timeCallback( deviceMetrics, callback );
+
+    if ( callbackBudget == 0 )
+    {
+        return;
+    }
+
+    if ( !deviceMetrics->isIsolated() && streak >= static_cast<int>( slowStreakLength ) )
+    {
+        deviceMetrics->setIsolated( true );
+
+        SPG_LOG_WARN( structuredLoggerInstance, "Callbacks consistently over budget; Moving device to the isolated lane", logField( "deviceId", deviceMetrics->getDeviceId() ), logField( "budgetUs", callbackBudget ) );
+    }
+    else if ( deviceMetrics->isIsolated() && streak <= -static_cast<int>( slowStreakLength ) )
+    {
+        deviceMetrics->setIsolated( false );
+
+        SPG_LOG_INFO( structuredLoggerInstance, "Callbacks within budget again; Moving device back to the fast lane", logField( "deviceId", deviceMetrics->getDeviceId() ) );
+    }
+}
+
+std::size_t CallbackDispatcher::getIsolatedQueueDepth()
+{
+    std::lock_guard<std::mutex> lock( isolatedQueueMutex );
+
+    return isolatedQueue.size();
+}
+
+std::size_t CallbackDispatcher::getRunningThreads()
+{
+    return threads.getSize();
+}
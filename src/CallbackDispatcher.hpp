@@ -0,0 +1,187 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef CALLBACKDISPATCHER_HPP
+#define CALLBACKDISPATCHER_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic_bool
+#include <string>
+#include <deque>
+#include <functional> // std::function
+#include <chrono>
+#include <mutex> // std::mutex, std::lock_guard, std::unique_lock
+#include <condition_variable> // std::condition_variable
+
+#include "GatewayMetrics.hpp"
+#include "StructuredLogger.hpp"
+#include "AllocationTracker.hpp"
+#include "ThreadGroup.hpp"
+#include "../dependencies/Exception/src/Exception.hpp"
+
+/**
+ * CallbackDispatcher class
+ * File: CallbackDispatcher.hpp
+ * Purpose: Defines the dispatcher which runs the message callbacks, and keeps devices with slow callbacks from slowing down the others.
+ *          Every callback gets timed and recorded in the metrics of its device. If a callback takes longer than the callback budget, it's flagged as slow.
+ *          Callbacks normally run on the fast lane, i.e. right away on the dispatching thread (a worker processing the device's messages).
+ *          A device whose callbacks are over budget several times in a row gets moved to the isolated lane: A fixed number of worker threads,
+ *          which run the callbacks of all isolated devices one after another. So blocking callbacks (e.g. a publish waiting for a broker) don't
+ *          hold up the messages of the devices sharing a worker with them; Once the device's callbacks are within budget again for as many times
+ *          in a row, it gets moved back to the fast lane.
+ *          The threads of the isolated lane belong to the dispatcher, so stopping it can wait for them; The destructor waits for every one of them.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class CallbackDispatcher
+{
+public:
+    // Types
+    typedef std::function<void()> Callback;
+    typedef GatewayMetrics::DeviceMetricsPointer DeviceMetricsPointer;
+    typedef std::chrono::steady_clock::time_point SteadyTimePoint;
+
+private:
+    // Types
+    struct IsolatedCallback
+    {
+        DeviceMetricsPointer deviceMetrics;
+        Callback callback;
+    };
+
+    // Variables
+    unsigned long long callbackBudget; // µs; 0 means that slow callbacks aren't detected
+    unsigned int slowStreakLength;
+    unsigned int isolatedThreadCount;
+    StructuredLogger * structuredLoggerInstance;
+    std::deque<IsolatedCallback> isolatedQueue;
+    std::mutex isolatedQueueMutex;
+    std::condition_variable isolatedQueueCondition;
+    bool started; // Guarded by isolatedQueueMutex
+    ThreadGroup threads; // Threads of the isolated lane; Last, so they're joined before anything they use gets destroyed
+
+    // Methods
+    /**
+     * Runs a callback and times it; Afterwards decides which lane the device's next callbacks run on.
+     *
+     * @param deviceMetrics Metrics of the device the callback belongs to.
+     * @param callback Callback to be run.
+    */
+    void runCallback( DeviceMetricsPointer deviceMetrics, const Callback & callback );
+
+    /**
+     * Runs a callback, times it, and records the time in the metrics of its device.
+     *
+     * @param deviceMetrics Metrics of the device the callback belongs to.
+     * @param callback Callback to be run.
+     * @return Streak of the device after this callback (See DeviceMetrics::recordCallbackTime).
+    */
+    int timeCallback( DeviceMetricsPointer deviceMetrics, const Callback & callback );
+
+    /**
+     * Loop of the isolated lane's worker threads; Runs queued callbacks until the dispatcher is stopped and the queue is drained.
+    */
+    void isolatedLoop();
+
+    /**
+     * Puts a callback on the isolated lane's queue.
+     *
+     * @param deviceMetrics Metrics of the device the callback belongs to.
+     * @param callback Callback to be run.
+     * @return Whether the callback could be queued; False if the dispatcher is not started.
+    */
+    bool enqueueIsolated( DeviceMetricsPointer deviceMetrics, Callback callback );
+
+    /**
+     * Marks the dispatcher as stopped, and wakes up the worker threads of the isolated lane; They quit once the queue is drained.
+    */
+    void markStopped();
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param callbackBudget Time in ms a callback may take before it counts as slow. 0 means that slow callbacks aren't detected (and no device gets isolated).
+     * @param slowStreakLength Number of consecutive slow callbacks before a device gets isolated, respectively consecutive callbacks within budget before it gets released.
+     * @param isolatedThreadCount Number of worker threads of the isolated lane.
+     * @param structuredLoggerInstance Logger to report devices being isolated or released.
+    */
+    CallbackDispatcher( unsigned int callbackBudget, unsigned int slowStreakLength, unsigned int isolatedThreadCount, StructuredLogger * structuredLoggerInstance );
+
+    // Destructors
+    /**
+     * Destructor; stops the dispatcher, and waits for every callback.
+    */
+    ~CallbackDispatcher();
+
+    // Methods
+    /**
+     * Starts the worker threads of the isolated lane.
+    */
+    void start();
+
+    /**
+     * Stops the worker threads of the isolated lane, and waits for them. Callbacks which are already queued get run before.
+     * Callbacks dispatched while the dispatcher is stopped run on the fast lane.
+    */
+    void stop();
+
+    /**
+     * Stops the worker threads of the isolated lane, and waits for them until the deadline.
+     * Callbacks which are already queued get run until then; Those still queued at the deadline get dropped.
+     * A callback which is running at the deadline can't be cancelled; Its thread stays running (See "getRunningThreads").
+     *
+     * @param deadline Point in time until which the callbacks are waited for.
+     * @return Number of dropped callbacks.
+    */
+    std::size_t stop( SteadyTimePoint deadline );
+
+    /**
+     * Runs a callback of a device on the lane the device is currently assigned to. On the fast lane, it runs in the calling thread, and this blocks
+     * until it returned; On the isolated lane, it gets queued, and this returns right away.
+     *
+     * @param deviceMetrics Metrics of the device the callback belongs to.
+     * @param callback Callback to be run.
+    */
+    void dispatch( DeviceMetricsPointer deviceMetrics, Callback callback );
+
+    /**
+     * Runs a callback of a device in the calling thread, and times it. Blocks until the callback returned.
+     * Used if the caller already runs on a thread of the device's own; The device doesn't change lanes then.
+     *
+     * @param deviceMetrics Metrics of the device the callback belongs to.
+     * @param callback Callback to be run.
+    */
+    void run( DeviceMetricsPointer deviceMetrics, const Callback & callback );
+
+    /**
+     * Gets the number of callbacks waiting for a worker of the isolated lane.
+     *
+     * @return Queue depth.
+    */
+    std::size_t getIsolatedQueueDepth();
+
+    /**
+     * Gets the number of worker threads of the isolated lane which are still running.
+     *
+     * @return Number of threads.
+    */
+    std::size_t getRunningThreads();
+};
+
+#endif // CALLBACKDISPATCHER_HPP
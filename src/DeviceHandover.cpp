@@ -0,0 +1,434 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "DeviceHandover.hpp"
+
+// C Standard Libraries
+#include <cstring> // std::strerror, std::memset, std::memcpy, std::strncpy
+#include <cerrno> // errno, EINTR
+#include <poll.h> // poll
+#include <unistd.h> // close, unlink
+#include <sys/socket.h> // socket, bind, listen, accept4, connect, sendmsg, recvmsg
+#include <sys/un.h> // sockaddr_un
+
+const unsigned int DeviceHandover::POLL_INTERVAL;
+const unsigned int DeviceHandover::RECORD_TIMEOUT;
+const std::size_t DeviceHandover::MAX_RECORD_SIZE;
+const char DeviceHandover::RECORD_DEVICE = 'D';
+const char DeviceHandover::RECORD_END = 'E';
+const char DeviceHandover::RECORD_CONFIRM = 'C';
+
+DeviceHandover::DeviceHandover( std::string socketPath, DeviceProvider deviceProvider, CompletionCallback completionCallback )
+{
+    if ( socketPath.empty() )
+    {
+        throw Exception( "Socket path of the device handover must not be empty." );
+    }
+
+    if ( !deviceProvider || !completionCallback )
+    {
+        throw Exception( "Device provider and completion callback of the device handover must not be empty." );
+    }
+
+    this->socketPath = socketPath;
+    this->deviceProvider = deviceProvider;
+    this->completionCallback = completionCallback;
+    this->socketDescriptor = -1;
+    this->started = false;
+    this->handedOver = false;
+}
+
+DeviceHandover::~DeviceHandover()
+{
+    stop();
+}
+
+void DeviceHandover::start()
+{
+    if ( isStarted() || isHandedOver() )
+    {
+        return;
+    }
+
+    sockaddr_un address;
+    std::memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+
+    if ( socketPath.length() >= sizeof( address.sun_path ) )
+    {
+        throw Exception( "Socket path of the device handover is too long: \"" + socketPath + "\"" );
+    }
+
+    std::strncpy( address.sun_path, socketPath.c_str(), sizeof( address.sun_path ) - 1 );
+
+    socketDescriptor = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+
+    if ( socketDescriptor == -1 )
+    {
+        throw Exception( "Couldn't create Unix socket for the device handover: " + std::string( std::strerror( errno ) ) );
+    }
+
+    unlink( socketPath.c_str() ); // Remove a stale socket of a previous run (or the one of the process the devices got taken over from)
+
+    if ( bind( socketDescriptor, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) == -1 || listen( socketDescriptor, 1 ) == -1 )
+    {
+        std::string error = std::strerror( errno );
+        close( socketDescriptor );
+        socketDescriptor = -1;
+
+        throw Exception( "Couldn't listen on Unix socket \"" + socketPath + "\" for the device handover: " + error );
+    }
+
+    started = true;
+    serverThread = std::thread( &DeviceHandover::serveLoop, this );
+}
+
+void DeviceHandover::stop()
+{
+    started = false;
+
+    // Also joins a thread which ended on its own after a handover
+    if ( serverThread.joinable() && serverThread.get_id() != std::this_thread::get_id() )
+    {
+        serverThread.join();
+    }
+
+    closeSocket();
+}
+
+bool DeviceHandover::isStarted()
+{
+    return this->started;
+}
+
+bool DeviceHandover::isHandedOver()
+{
+    return this->handedOver;
+}
+
+void DeviceHandover::closeSocket()
+{
+    if ( socketDescriptor != -1 )
+    {
+        close( socketDescriptor );
+        socketDescriptor = -1;
+
+        // The successor listens on the same path by now
+        if ( !isHandedOver() )
+        {
+            unlink( socketPath.c_str() );
+        }
+    }
+}
+
+void DeviceHandover::serveLoop()
+{
+    pollfd pollDescriptor = { socketDescriptor, POLLIN, 0 };
+
+    while ( isStarted() && !isHandedOver() )
+    {
+        if ( poll( &pollDescriptor, 1, POLL_INTERVAL ) <= 0 || !( pollDescriptor.revents & POLLIN ) )
+        {
+            continue; // Timeout or EINTR; Check whether we got stopped
+        }
+
+        int clientDescriptor = accept4( socketDescriptor, nullptr, nullptr, SOCK_CLOEXEC );
+
+        if ( clientDescriptor != -1 )
+        {
+            handOver( clientDescriptor );
+        }
+    }
+}
+
+void DeviceHandover::handOver( int clientDescriptor )
+{
+    std::vector<HandoverDevice> devices;
+
+    // Closing the connection without a device tells the successor to start the regular way
+    if ( !deviceProvider( devices ) )
+    {
+        close( clientDescriptor );
+        completionCallback( devices, false );
+
+        return;
+    }
+
+    bool sent = true;
+
+    for ( HandoverDevice & device : devices )
+    {
+        std::string record( 1, RECORD_DEVICE );
+        appendField( record, device.deviceId );
+        appendField( record, device.port );
+        appendField( record, device.serialParameters );
+        appendField( record, device.partialLine );
+
+        sent = sent && sendRecord( clientDescriptor, record, device.fd );
+
+        // The successor holds its own descriptor now (or nobody needs it anymore)
+        if ( device.fd >= 0 )
+        {
+            close( device.fd );
+            device.fd = -1;
+        }
+    }
+
+    std::string endRecord( 1, RECORD_END );
+    appendField( endRecord, std::to_string( devices.size() ) );
+    sent = sent && sendRecord( clientDescriptor, endRecord, -1 );
+
+    std::string confirmRecord;
+    int fd = -1;
+    bool confirmed = sent && receiveRecord( clientDescriptor, confirmRecord, fd, RECORD_TIMEOUT ) && confirmRecord == std::string( 1, RECORD_CONFIRM );
+
+    if ( fd >= 0 )
+    {
+        close( fd );
+    }
+
+    close( clientDescriptor );
+
+    // Before the callback, so the socket file is left to the successor, whenever the callback stops serving
+    handedOver = confirmed;
+    completionCallback( devices, confirmed );
+}
+
+bool DeviceHandover::takeOver( std::string socketPath, std::vector<HandoverDevice> & devices, unsigned int timeout )
+{
+    devices.clear();
+
+    sockaddr_un address;
+    std::memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+
+    if ( socketPath.length() >= sizeof( address.sun_path ) )
+    {
+        return false;
+    }
+
+    std::strncpy( address.sun_path, socketPath.c_str(), sizeof( address.sun_path ) - 1 );
+
+    int socketDescriptor = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+
+    if ( socketDescriptor == -1 )
+    {
+        return false;
+    }
+
+    // Fails right away if there's no socket file, or nobody listens on it anymore
+    if ( connect( socketDescriptor, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) == -1 )
+    {
+        close( socketDescriptor );
+
+        return false;
+    }
+
+    bool complete = false;
+
+    while ( true )
+    {
+        std::string record;
+        int fd = -1;
+
+        if ( !receiveRecord( socketDescriptor, record, fd, timeout ) || record.empty() )
+        {
+            if ( fd >= 0 )
+            {
+                close( fd );
+            }
+
+            break;
+        }
+
+        std::size_t offset = 1;
+
+        if ( record[0] == RECORD_DEVICE )
+        {
+            HandoverDevice device;
+            device.fd = fd;
+            devices.push_back( device ); // Right away, so the descriptor gets closed if anything fails
+
+            if ( !readField( record, offset, devices.back().deviceId ) || !readField( record, offset, devices.back().port )
+                || !readField( record, offset, devices.back().serialParameters ) || !readField( record, offset, devices.back().partialLine ) )
+            {
+                break;
+            }
+        }
+        else
+        {
+            std::string count;
+
+            if ( fd >= 0 )
+            {
+                close( fd );
+            }
+
+            complete = record[0] == RECORD_END && readField( record, offset, count ) && count == std::to_string( devices.size() );
+
+            break;
+        }
+    }
+
+    // Only confirmed once every descriptor is held; Otherwise the running process keeps serving the devices
+    if ( complete )
+    {
+        complete = sendRecord( socketDescriptor, std::string( 1, RECORD_CONFIRM ), -1 );
+    }
+
+    close( socketDescriptor );
+
+    if ( !complete )
+    {
+        for ( HandoverDevice const & device : devices )
+        {
+            if ( device.fd >= 0 )
+            {
+                close( device.fd );
+            }
+        }
+
+        devices.clear();
+    }
+
+    return complete;
+}
+
+void DeviceHandover::appendField( std::string & record, const std::string & value )
+{
+    std::uint32_t length = static_cast<std::uint32_t>( value.length() );
+
+    record.append( reinterpret_cast<const char *>( &length ), sizeof( length ) );
+    record.append( value );
+}
+
+bool DeviceHandover::readField( const std::string & record, std::size_t & offset, std::string & value )
+{
+    std::uint32_t length;
+
+    if ( offset + sizeof( length ) > record.length() )
+    {
+        return false;
+    }
+
+    std::memcpy( &length, record.data() + offset, sizeof( length ) );
+    offset += sizeof( length );
+
+    if ( length > record.length() - offset )
+    {
+        return false;
+    }
+
+    value = record.substr( offset, length );
+    offset += length;
+
+    return true;
+}
+
+bool DeviceHandover::sendRecord( int socketDescriptor, const std::string & record, int fd )
+{
+    if ( record.length() > MAX_RECORD_SIZE )
+    {
+        return false;
+    }
+
+    iovec data = { const_cast<char *>( record.data() ), record.length() };
+    char control[CMSG_SPACE( sizeof( int ) )];
+    std::memset( control, 0, sizeof( control ) );
+
+    msghdr message;
+    std::memset( &message, 0, sizeof( message ) );
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+
+    if ( fd >= 0 )
+    {
+        message.msg_control = control;
+        message.msg_controllen = sizeof( control );
+
+        cmsghdr * controlHeader = CMSG_FIRSTHDR( &message );
+        controlHeader->cmsg_level = SOL_SOCKET;
+        controlHeader->cmsg_type = SCM_RIGHTS;
+        controlHeader->cmsg_len = CMSG_LEN( sizeof( int ) );
+        std::memcpy( CMSG_DATA( controlHeader ), &fd, sizeof( int ) );
+    }
+
+    ssize_t result;
+
+    do
+    {
+        result = sendmsg( socketDescriptor, &message, MSG_NOSIGNAL );
+    }
+    while ( result < 0 && errno == EINTR );
+
+    return result == static_cast<ssize_t>( record.length() );
+}
+
+bool DeviceHandover::receiveRecord( int socketDescriptor, std::string & record, int & fd, unsigned int timeout )
+{
+    fd = -1;
+
+    pollfd pollDescriptor = { socketDescriptor, POLLIN, 0 };
+    int numReady;
+
+    do
+    {
+        numReady = poll( &pollDescriptor, 1, static_cast<int>( timeout ) );
+    }
+    while ( numReady < 0 && errno == EINTR );
+
+    if ( numReady <= 0 )
+    {
+        return false;
+    }
+
+    record.resize( MAX_RECORD_SIZE );
+    iovec data = { &record[0], record.length() };
+    char control[CMSG_SPACE( sizeof( int ) )];
+
+    msghdr message;
+    std::memset( &message, 0, sizeof( message ) );
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof( control );
+
+    ssize_t result;
+
+    do
+    {
+        result = recvmsg( socketDescriptor, &message, MSG_CMSG_CLOEXEC );
+    }
+    while ( result < 0 && errno == EINTR );
+
+    if ( result <= 0 )
+    {
+        return false; // Error, or the other side closed the connection
+    }
+
+    record.resize( result );
+
+    for ( cmsghdr * controlHeader = CMSG_FIRSTHDR( &message ); controlHeader != nullptr; controlHeader = CMSG_NXTHDR( &message, controlHeader ) )
+    {
+        if ( controlHeader->cmsg_level == SOL_SOCKET && controlHeader->cmsg_type == SCM_RIGHTS && controlHeader->cmsg_len == CMSG_LEN( sizeof( int ) ) )
+        {
+            std::memcpy( &fd, CMSG_DATA( controlHeader ), sizeof( int ) );
+        }
+    }
+
+    return ( message.msg_flags & ( MSG_TRUNC | MSG_CTRUNC ) ) == 0;
+}
@@ -0,0 +1,195 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef DEVICEHANDOVER_HPP
+#define DEVICEHANDOVER_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic_bool
+#include <string>
+#include <vector>
+#include <functional> // std::function
+#include <thread> // std::thread
+#include <cstdint>
+
+#include "../dependencies/Exception/src/Exception.hpp"
+
+/**
+ * HandoverDevice struct
+ * Purpose: Holds what a gateway process passes on to the next one for a device it served.
+*/
+struct HandoverDevice
+{
+    std::string deviceId;
+    std::string port;
+    std::string serialParameters; // Declaration of the line settings in effect (See "SerialParameters::toString"); The device may run at an escalated rate
+    std::string partialLine; // What got read of a line which hasn't been completed yet
+    int fd; // Descriptor of the tty; Keeps it open in between, so the modem lines don't drop and nothing buffered by the driver gets discarded. Only held,
+            // since the serial Library opens the port by its path; If the tty gets closed by everyone anyway, the lines only stay up with HUPCL cleared
+};
+
+/**
+ * DeviceHandover class
+ * File: DeviceHandover.hpp
+ * Purpose: Defines the handover of the devices from a running gateway process to its successor (e.g. during an upgrade), without the ports ever getting closed.
+ *          The running process listens on a Unix domain socket (SOCK_SEQPACKET). A new process connects to it, and gets one record per device,
+ *          with the tty's descriptor attached (SCM_RIGHTS), followed by an end record with the number of devices; It confirms once it holds every descriptor.
+ *          Serving a handover is done by a background thread, one connection after another; A confirmed handover ends serving, and leaves the socket file to the successor.
+ *          Record format: Type (1 byte), and per field its length (uint32) followed by the bytes; Device records carry the device ID, the port, the serial parameters and the partial line.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class DeviceHandover
+{
+public:
+    // Types
+    typedef std::function<bool( std::vector<HandoverDevice> & )> DeviceProvider; // Returns false if the devices couldn't be stopped; The handover gets aborted then
+    typedef std::function<void( const std::vector<HandoverDevice> &, bool )> CompletionCallback; // Second value: Whether the successor confirmed the handover
+
+    // Constants
+    static const unsigned int RECORD_TIMEOUT = 5000; // ms; How long either side waits for the next record (the running process has to stop reading first)
+
+private:
+    // Constants
+    static const unsigned int POLL_INTERVAL = 250; // ms; How often the background thread checks whether it got stopped
+    static const std::size_t MAX_RECORD_SIZE = 256 * 1024; // Bytes
+    static const char RECORD_DEVICE;
+    static const char RECORD_END;
+    static const char RECORD_CONFIRM;
+
+    // Variables
+    std::string socketPath;
+    DeviceProvider deviceProvider;
+    CompletionCallback completionCallback;
+    int socketDescriptor;
+    std::atomic_bool started;
+    std::atomic_bool handedOver;
+    std::thread serverThread;
+
+    // Methods
+    /**
+     * Loop of the background thread; Accepts and serves handovers until it got stopped, or a handover got confirmed.
+    */
+    void serveLoop();
+
+    /**
+     * Hands the devices over to a successor, and waits for its confirmation.
+     *
+     * @param clientDescriptor Socket descriptor of the successor. Gets closed afterwards.
+    */
+    void handOver( int clientDescriptor );
+
+    /**
+     * Closes the listening socket; The socket file gets removed, unless a successor took over.
+    */
+    void closeSocket();
+
+    /**
+     * Appends a field as length (uint32) followed by its bytes.
+     *
+     * @param record Record to append to.
+     * @param value Field to be appended.
+    */
+    static void appendField( std::string & record, const std::string & value );
+
+    /**
+     * Reads a field written by "appendField".
+     *
+     * @param record Record to read from.
+     * @param offset Offset of the field; Gets moved behind it.
+     * @param value String to read into.
+     * @return Whether the field could be read completely.
+    */
+    static bool readField( const std::string & record, std::size_t & offset, std::string & value );
+
+    /**
+     * Sends a record, with a descriptor attached.
+     *
+     * @param socketDescriptor Socket to send on.
+     * @param record Record to be sent.
+     * @param fd Descriptor to be attached; -1 for none.
+     * @return Whether the record got sent.
+    */
+    static bool sendRecord( int socketDescriptor, const std::string & record, int fd );
+
+    /**
+     * Receives a record, and the descriptor attached to it.
+     *
+     * @param socketDescriptor Socket to receive from.
+     * @param record Gets the record assigned.
+     * @param fd Gets the attached descriptor assigned; -1 if there's none.
+     * @param timeout Time in ms to wait for the record.
+     * @return Whether a record got received.
+    */
+    static bool receiveRecord( int socketDescriptor, std::string & record, int & fd, unsigned int timeout );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param socketPath Path of the Unix domain socket to listen on.
+     * @param deviceProvider Function which stops serving the devices, and returns them; Called once per handover, from the background thread. The descriptors get closed after they got sent.
+     *                       If it fails, the successor gets no devices, and the completion callback gets told the handover wasn't confirmed.
+     * @param completionCallback Function which gets told whether the handover got confirmed; If not, the devices should be served again.
+    */
+    DeviceHandover( std::string socketPath, DeviceProvider deviceProvider, CompletionCallback completionCallback );
+
+    // Destructors
+    /**
+     * Destructor; stops serving handovers.
+    */
+    ~DeviceHandover();
+
+    // Methods
+    /**
+     * Opens the listening socket, and starts serving handovers in a background thread. Throws an Exception if the socket can't be opened.
+    */
+    void start();
+
+    /**
+     * Stops serving handovers, and closes the listening socket.
+    */
+    void stop();
+
+    /**
+     * Gets whether handovers are served.
+     *
+     * @return Whether handovers are served or not.
+    */
+    bool isStarted();
+
+    /**
+     * Gets whether a successor took the devices over.
+     *
+     * @return Whether the handover got confirmed.
+    */
+    bool isHandedOver();
+
+    /**
+     * Takes the devices over from the process listening on a socket, if there is one.
+     *
+     * @param socketPath Path of the Unix domain socket the running process listens on.
+     * @param devices Gets the devices assigned; The caller owns their descriptors.
+     * @param timeout Time in ms to wait for every record.
+     * @return Whether the devices got taken over; False if nobody listens, or the handover failed (then no descriptors are left open).
+    */
+    static bool takeOver( std::string socketPath, std::vector<HandoverDevice> & devices, unsigned int timeout );
+};
+
+#endif // DEVICEHANDOVER_HPP
@@ -0,0 +1,184 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "DeviceIdentityCache.hpp"
+
+#include <cstdio> // std::rename
+#include <limits>
+
+const std::string DeviceIdentityCache::MAGIC = "SPGIDC";
+const std::uint8_t DeviceIdentityCache::FORMAT_VERSION = 2;
+
+DeviceIdentityCache::DeviceIdentityCache( std::string file )
+{
+    this->file = file;
+}
+
+void DeviceIdentityCache::writeString( std::ofstream & fileStream, const std::string & value )
+{
+    std::uint16_t length = static_cast<std::uint16_t>( value.length() );
+
+    fileStream.write( reinterpret_cast<const char *>( &length ), sizeof( length ) );
+    fileStream.write( value.data(), length );
+}
+
+bool DeviceIdentityCache::readString( std::ifstream & fileStream, std::string & value )
+{
+    std::uint16_t length;
+
+    if ( !fileStream.read( reinterpret_cast<char *>( &length ), sizeof( length ) ) )
+    {
+        return false;
+    }
+
+    value.resize( length );
+
+    return length == 0 || static_cast<bool>( fileStream.read( &value[0], length ) );
+}
+
+bool DeviceIdentityCache::save()
+{
+    std::string temporaryFile = file + ".tmp";
+    std::ofstream fileStream( temporaryFile, std::ofstream::binary | std::ofstream::trunc );
+
+    if ( !fileStream.is_open() )
+    {
+        return false;
+    }
+
+    std::uint32_t count = static_cast<std::uint32_t>( identities.size() );
+
+    fileStream.write( MAGIC.data(), MAGIC.length() );
+    fileStream.write( reinterpret_cast<const char *>( &FORMAT_VERSION ), sizeof( FORMAT_VERSION ) );
+    fileStream.write( reinterpret_cast<const char *>( &count ), sizeof( count ) );
+
+    for ( IdentityMap::value_type const & entry : identities )
+    {
+        writeString( fileStream, entry.first );
+        writeString( fileStream, entry.second );
+    }
+
+    fileStream.close();
+
+    if ( fileStream.fail() )
+    {
+        std::remove( temporaryFile.c_str() );
+
+        return false;
+    }
+
+    return std::rename( temporaryFile.c_str(), file.c_str() ) == 0; // Atomic, so readers see either the old or the new cache
+}
+
+bool DeviceIdentityCache::load()
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    identities.clear();
+
+    std::ifstream fileStream( file, std::ifstream::binary );
+
+    if ( !fileStream.is_open() )
+    {
+        return true; // No cache yet
+    }
+
+    std::string magic( MAGIC.length(), '\0' );
+    std::uint8_t formatVersion;
+    std::uint32_t count;
+
+    if ( !fileStream.read( &magic[0], magic.length() ) || magic != MAGIC
+        || !fileStream.read( reinterpret_cast<char *>( &formatVersion ), sizeof( formatVersion ) ) || formatVersion != FORMAT_VERSION
+        || !fileStream.read( reinterpret_cast<char *>( &count ), sizeof( count ) ) )
+    {
+        return false;
+    }
+
+    IdentityMap loadedIdentities;
+
+    for ( std::uint32_t index = 0; index < count; index++ )
+    {
+        std::string key;
+        std::string deviceId;
+
+        if ( !readString( fileStream, key ) || !readString( fileStream, deviceId ) )
+        {
+            return false; // Truncated; Rather start empty than trust a partial cache
+        }
+
+        loadedIdentities[key] = deviceId;
+    }
+
+    identities.swap( loadedIdentities );
+
+    return true;
+}
+
+std::string DeviceIdentityCache::lookup( std::string key )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    IdentityMap::iterator it = identities.find( key );
+
+    if ( it == identities.end() )
+    {
+        return "";
+    }
+
+    return it->second;
+}
+
+bool DeviceIdentityCache::store( std::string key, std::string deviceId )
+{
+    if ( key.length() > std::numeric_limits<std::uint16_t>::max() || deviceId.length() > std::numeric_limits<std::uint16_t>::max() )
+    {
+        return true; // Can't be stored; The device just doesn't get the fast path
+    }
+
+    std::lock_guard<std::mutex> lock( mutex );
+    IdentityMap::iterator it = identities.find( key );
+
+    if ( it != identities.end() && it->second == deviceId )
+    {
+        return true;
+    }
+
+    identities[key] = deviceId;
+
+    return save();
+}
+
+bool DeviceIdentityCache::evict( std::string key )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    if ( identities.erase( key ) == 0 )
+    {
+        return true;
+    }
+
+    return save();
+}
+
+std::size_t DeviceIdentityCache::getSize()
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    return identities.size();
+}
+
+std::string DeviceIdentityCache::getFile()
+{
+    return this->file;
+}
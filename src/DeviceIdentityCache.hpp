@@ -0,0 +1,135 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef DEVICEIDENTITYCACHE_HPP
+#define DEVICEIDENTITYCACHE_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <map>
+#include <mutex> // std::mutex, std::lock_guard
+#include <fstream>
+#include <cstdint>
+
+/**
+ * DeviceIdentityCache class
+ * File: DeviceIdentityCache.hpp
+ * Purpose: Defines a persistent cache which maps the identity of a port (its path, its device path in sysfs, and its hardware ID, including VID:PID and the USB serial number) to the ID the device answered with.
+ *          A device whose identity is cached can be registered right away, without waiting for it and asking for its ID first.
+ *          The cache is kept in memory and written to a compact binary file on every change; The file is replaced atomically, so a crash never leaves a half-written cache behind.
+ *          File format: Magic "SPGIDC", format version (1 byte; 2 since the keys contain the device path), number of entries (uint32), and per entry the key and the device ID, each as length (uint16) followed by the bytes.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class DeviceIdentityCache
+{
+private:
+    // Types
+    typedef std::map<std::string, std::string> IdentityMap; // first value: identity key, second value: deviceId
+
+    // Constants
+    static const std::string MAGIC;
+    static const std::uint8_t FORMAT_VERSION;
+
+    // Variables
+    std::string file;
+    IdentityMap identities;
+    std::mutex mutex;
+
+    // Methods
+    /**
+     * Writes all entries to the cache file. Must be called while holding the lock.
+     *
+     * @return Whether the file could be written.
+    */
+    bool save();
+
+    /**
+     * Writes a string as length (uint16) followed by its bytes.
+     *
+     * @param fileStream Stream to write to.
+     * @param value String to be written.
+    */
+    static void writeString( std::ofstream & fileStream, const std::string & value );
+
+    /**
+     * Reads a string written by "writeString".
+     *
+     * @param fileStream Stream to read from.
+     * @param value String to read into.
+     * @return Whether the string could be read completely.
+    */
+    static bool readString( std::ifstream & fileStream, std::string & value );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param file Path to the cache file; Doesn't need to exist yet.
+    */
+    DeviceIdentityCache( std::string file );
+
+    // Methods
+    /**
+     * Loads the cache file. A missing file counts as empty cache.
+     *
+     * @return Whether the file could be loaded; False if it is unreadable or corrupt, in which case the cache stays empty.
+    */
+    bool load();
+
+    /**
+     * Looks up the device ID cached for an identity.
+     *
+     * @param key Identity key of the port.
+     * @return Cached device ID; Empty if there's none.
+    */
+    std::string lookup( std::string key );
+
+    /**
+     * Caches the device ID of an identity, and writes the cache file if anything changed.
+     *
+     * @param key Identity key of the port.
+     * @param deviceId Device ID the device answered with.
+     * @return Whether the cache file could be written (or didn't need to be).
+    */
+    bool store( std::string key, std::string deviceId );
+
+    /**
+     * Removes an identity from the cache, and writes the cache file if anything changed.
+     *
+     * @param key Identity key of the port.
+     * @return Whether the cache file could be written (or didn't need to be).
+    */
+    bool evict( std::string key );
+
+    /**
+     * Gets the number of cached identities.
+     *
+     * @return Number of entries.
+    */
+    std::size_t getSize();
+
+    /**
+     * Gets the path to the cache file.
+     *
+     * @return Path to the cache file.
+    */
+    std::string getFile();
+};
+
+#endif // DEVICEIDENTITYCACHE_HPP
@@ -0,0 +1,295 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "EventBus.hpp"
+
+// C++ Standard Libraries
+#include <algorithm> // std::min, std::find
+#include <thread> // std::this_thread::yield
+
+EventBus::EventBus( std::size_t capacity )
+{
+    this->nextSequence = 0;
+    this->gatingSequence = 0;
+    this->stallCount = 0;
+    this->waitingPublishers = 0;
+    this->waitingConsumers = 0;
+    this->closed = false;
+
+    // Round up to a power of two, so the slot of a sequence can be determined by masking
+    this->capacity = 2;
+
+    while ( this->capacity < capacity )
+    {
+        this->capacity *= 2;
+    }
+
+    slots.reset( new Slot[this->capacity] );
+
+    for ( std::size_t index = 0; index < this->capacity; index++ )
+    {
+        slots[index].published = 0;
+        slots[index].event.content.reserve( RESERVED_CONTENT_LENGTH );
+    }
+}
+
+unsigned long long EventBus::publishMessage( const std::string & deviceId, unsigned long long timestamp, const std::string & messageType, const std::string & content )
+{
+    return publish( GatewayEventType::MESSAGE, timestamp, deviceId, "", messageType, content );
+}
+
+unsigned long long EventBus::publishDeviceAdded( const std::string & deviceId, const std::string & serialPort )
+{
+    return publish( GatewayEventType::DEVICE_ADDED, getTimestamp(), deviceId, serialPort, "", "" );
+}
+
+unsigned long long EventBus::publishDeviceDeleted( const std::string & deviceId, const std::string & serialPort )
+{
+    return publish( GatewayEventType::DEVICE_DELETED, getTimestamp(), deviceId, serialPort, "", "" );
+}
+
+unsigned long long EventBus::publish( GatewayEventType type, unsigned long long timestamp, const std::string & deviceId, const std::string & serialPort, const std::string & messageType, const std::string & content )
+{
+    unsigned long long sequence = nextSequence.fetch_add( 1 );
+
+    Slot & slot = slots[sequence & ( capacity - 1 )];
+    unsigned long long previousLap = sequence >= capacity ? sequence - capacity + 1 : 0;
+
+    if ( !waitForSlot( sequence ) )
+    {
+        return sequence; // Closed; Nobody reads it anymore
+    }
+
+    // Without consumers, nobody gates the slot; The publisher of the previous lap may still be writing it
+    while ( slot.published.load( std::memory_order_acquire ) != previousLap )
+    {
+        if ( closed )
+        {
+            return sequence;
+        }
+
+        std::this_thread::yield();
+    }
+
+    // Assigning keeps the capacity of the slot's strings, so this only allocates while the ring warms up
+    GatewayEvent & event = slot.event;
+    event.sequence = sequence;
+    event.type = type;
+    event.timestamp = timestamp;
+    event.deviceId = deviceId;
+    event.serialPort = serialPort;
+    event.messageType = messageType;
+    event.content = content;
+
+    slot.published.store( sequence + 1 );
+
+    if ( waitingConsumers.load() > 0 )
+    {
+        std::lock_guard<std::mutex> lock( waitMutex );
+        eventPublished.notify_all();
+    }
+
+    return sequence;
+}
+
+bool EventBus::waitForSlot( unsigned long long sequence )
+{
+    // The slot was last used by the event one lap earlier, which every consumer must have released;
+    // The cursors only get looked at once the last seen slowest one doesn't suffice anymore, about once per lap
+    if ( sequence < gatingSequence.load( std::memory_order_acquire ) + capacity )
+    {
+        return true;
+    }
+
+    unsigned long long minimumCursor = getMinimumCursor();
+    gatingSequence.store( minimumCursor, std::memory_order_release );
+
+    if ( sequence < minimumCursor + capacity )
+    {
+        return true;
+    }
+
+    stallCount.fetch_add( 1, std::memory_order_relaxed );
+    waitingPublishers.fetch_add( 1 );
+
+    std::unique_lock<std::mutex> lock( waitMutex );
+
+    while ( !closed )
+    {
+        minimumCursor = getMinimumCursor();
+        gatingSequence.store( minimumCursor, std::memory_order_release );
+
+        if ( sequence < minimumCursor + capacity )
+        {
+            break;
+        }
+
+        eventReleased.wait( lock );
+    }
+
+    waitingPublishers.fetch_sub( 1 );
+
+    return !closed;
+}
+
+unsigned long long EventBus::getMinimumCursor()
+{
+    std::lock_guard<std::mutex> lock( consumersMutex );
+    unsigned long long minimumCursor = nextSequence.load();
+
+    for ( EventConsumerPointer const & consumer : consumers )
+    {
+        minimumCursor = std::min( minimumCursor, consumer->cursor.load() );
+    }
+
+    return minimumCursor;
+}
+
+unsigned long long EventBus::getPublishedEnd( unsigned long long cursor )
+{
+    // Publishers may finish out of order, but a consumer only gets the events up to the first gap
+    unsigned long long end = cursor;
+
+    while ( end < cursor + capacity && slots[end & ( capacity - 1 )].published.load( std::memory_order_acquire ) == end + 1 )
+    {
+        end++;
+    }
+
+    return end;
+}
+
+unsigned long long EventBus::getTimestamp()
+{
+    std::chrono::system_clock::duration durationSinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>( durationSinceEpoch ).count();
+}
+
+EventBus::EventConsumerPointer EventBus::addConsumer( std::string name )
+{
+    EventConsumerPointer consumer = std::make_shared<EventConsumer>();
+    consumer->name = name;
+
+    std::lock_guard<std::mutex> lock( consumersMutex );
+    consumer->cursor = nextSequence.load(); // Every sequence before has been claimed already, so the consumer doesn't gate its slot
+
+    consumers.push_back( consumer );
+
+    return consumer;
+}
+
+void EventBus::removeConsumer( const EventConsumerPointer & consumer )
+{
+    {
+        std::lock_guard<std::mutex> lock( consumersMutex );
+        std::vector<EventConsumerPointer>::iterator it = std::find( consumers.begin(), consumers.end(), consumer );
+
+        if ( it != consumers.end() )
+        {
+            consumers.erase( it );
+        }
+    }
+
+    std::lock_guard<std::mutex> lock( waitMutex );
+    eventReleased.notify_all();
+}
+
+unsigned long long EventBus::waitForEvents( const EventConsumerPointer & consumer, std::chrono::milliseconds timeout )
+{
+    unsigned long long cursor = consumer->cursor.load( std::memory_order_relaxed );
+    unsigned long long end = getPublishedEnd( cursor );
+
+    if ( end > cursor || closed )
+    {
+        return end;
+    }
+
+    waitingConsumers.fetch_add( 1 );
+
+    {
+        std::unique_lock<std::mutex> lock( waitMutex );
+        eventPublished.wait_for( lock, timeout, [&]()
+        {
+            end = getPublishedEnd( cursor );
+
+            return end > cursor || closed;
+        } );
+    }
+
+    waitingConsumers.fetch_sub( 1 );
+
+    return end;
+}
+
+const GatewayEvent & EventBus::getEvent( unsigned long long sequence ) const
+{
+    return slots[sequence & ( capacity - 1 )].event;
+}
+
+void EventBus::release( const EventConsumerPointer & consumer, unsigned long long sequence )
+{
+    consumer->cursor.store( sequence );
+
+    if ( waitingPublishers.load() > 0 )
+    {
+        std::lock_guard<std::mutex> lock( waitMutex );
+        eventReleased.notify_all();
+    }
+}
+
+void EventBus::close()
+{
+    std::lock_guard<std::mutex> lock( waitMutex );
+    closed = true;
+    eventReleased.notify_all();
+    eventPublished.notify_all();
+}
+
+unsigned long long EventBus::getHead()
+{
+    return nextSequence.load();
+}
+
+unsigned long long EventBus::getLag( const EventConsumerPointer & consumer )
+{
+    unsigned long long cursor = consumer->cursor.load();
+    unsigned long long head = nextSequence.load();
+
+    return head > cursor ? head - cursor : 0;
+}
+
+std::map<std::string, unsigned long long> EventBus::getConsumerLags()
+{
+    std::map<std::string, unsigned long long> lags;
+    std::lock_guard<std::mutex> lock( consumersMutex );
+
+    for ( EventConsumerPointer const & consumer : consumers )
+    {
+        lags[consumer->name] = getLag( consumer );
+    }
+
+    return lags;
+}
+
+unsigned long long EventBus::getStallCount()
+{
+    return stallCount.load();
+}
+
+std::size_t EventBus::getCapacity()
+{
+    return capacity;
+}
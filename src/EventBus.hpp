@@ -0,0 +1,279 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef EVENTBUS_HPP
+#define EVENTBUS_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic
+#include <string>
+#include <vector>
+#include <map>
+#include <memory> // std::unique_ptr, std::shared_ptr
+#include <mutex> // std::mutex, std::unique_lock
+#include <condition_variable> // std::condition_variable
+#include <chrono>
+
+/**
+ * GatewayEventType enum
+ * Purpose: Lists the kinds of events the gateway publishes on its event bus.
+*/
+enum class GatewayEventType : unsigned char
+{
+    MESSAGE, // A device sent a message; Published right before its callback gets dispatched
+    DEVICE_ADDED, // A device got registered (or taken over); Published before its read loop starts
+    DEVICE_DELETED // A device got deleted; Its read loop has quit
+};
+
+/**
+ * GatewayEvent struct
+ * Purpose: Holds a single event on the ring of the event bus. Consumers read it in place, so it's only valid until they release it.
+*/
+struct GatewayEvent
+{
+    unsigned long long sequence; // Increases by one with every published event, starting at 0
+    GatewayEventType type;
+    unsigned long long timestamp; // ms since epoch
+    std::string deviceId;
+    std::string serialPort; // Only set for DEVICE_ADDED and DEVICE_DELETED
+    std::string messageType; // Only set for MESSAGE
+    std::string content; // Only set for MESSAGE
+};
+
+/**
+ * EventConsumer struct
+ * Purpose: Holds the cursor of a consumer registered on the event bus.
+*/
+struct EventConsumer
+{
+    std::atomic<unsigned long long> cursor; // Sequence of the next event to be read; Every event before got released
+    char padding[64 - sizeof( std::atomic<unsigned long long> )]; // Keeps the cursors of different consumers on different cache lines
+    std::string name;
+};
+
+/**
+ * EventBus class
+ * File: EventBus.hpp
+ * Purpose: Defines an in-process event bus (after the LMAX Disruptor): A single pre-allocated ring of gateway events, which several consumers
+ *          read at their own pace, each with its own cursor, instead of every consumer getting its own copy of every message.
+ *          Publishers claim the next sequence number, fill the slot in place, and mark it as published; The strings of a slot keep their
+ *          capacity, so once the ring warmed up, publishing doesn't allocate. A slot only gets reused once every consumer released it;
+ *          Until then the publisher waits, so a consumer which falls behind by the capacity holds the gateway up (like the "block" overflow policy).
+ *          How far a consumer fell behind is the gap between its cursor and the head, which makes slow consumers easy to spot.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class EventBus
+{
+public:
+    // Types
+    typedef std::shared_ptr<EventConsumer> EventConsumerPointer;
+
+    // Constants
+    static const std::size_t DEFAULT_CAPACITY = 4096; // Events
+    static const std::size_t RESERVED_CONTENT_LENGTH = 64; // Bytes every slot reserves for the message content upfront
+
+private:
+    // Types
+    struct Slot
+    {
+        std::atomic<unsigned long long> published; // Sequence + 1 once the event is completely written
+        GatewayEvent event;
+    };
+
+    // Variables
+    std::size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<unsigned long long> nextSequence; // Head; Next sequence to be claimed by a publisher
+    std::atomic<unsigned long long> gatingSequence; // Cursor of the slowest consumer, as last seen by a publisher; Never ahead of it
+    std::atomic<unsigned long long> stallCount;
+    std::atomic<unsigned int> waitingPublishers;
+    std::atomic<unsigned int> waitingConsumers;
+    std::atomic_bool closed;
+    std::vector<EventConsumerPointer> consumers;
+    std::mutex consumersMutex;
+    std::mutex waitMutex; // Only locked by publishers and consumers which wait
+    std::condition_variable eventReleased;
+    std::condition_variable eventPublished;
+
+    // Methods
+    /**
+     * Publishes an event; Waits while the slot for it hasn't been released by every consumer yet.
+     *
+     * @param type Type of the event.
+     * @param timestamp Timestamp in ms since epoch.
+     * @param deviceId Device ID the event is about.
+     * @param serialPort Port of the device; Empty for messages.
+     * @param messageType Message type; Empty for device events.
+     * @param content Message content; Empty for device events.
+     * @return Sequence number of the event.
+    */
+    unsigned long long publish( GatewayEventType type, unsigned long long timestamp, const std::string & deviceId, const std::string & serialPort, const std::string & messageType, const std::string & content );
+
+    /**
+     * Waits until every consumer released the slot of a sequence, or the bus got closed.
+     *
+     * @param sequence Claimed sequence.
+     * @return Whether the slot may be written.
+    */
+    bool waitForSlot( unsigned long long sequence );
+
+    /**
+     * Gets the cursor of the slowest consumer; The head, if there is no consumer.
+     *
+     * @return Sequence of the oldest event which hasn't been released by every consumer.
+    */
+    unsigned long long getMinimumCursor();
+
+    /**
+     * Gets the sequence up to which events are published without a gap.
+     *
+     * @param cursor Sequence to start at.
+     * @return Sequence of the first event which isn't published yet.
+    */
+    unsigned long long getPublishedEnd( unsigned long long cursor );
+
+    /**
+     * Gets the current time of the system clock.
+     *
+     * @return Time in ms since epoch.
+    */
+    static unsigned long long getTimestamp();
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param capacity Number of events the ring holds. Gets rounded up to a power of two.
+    */
+    EventBus( std::size_t capacity = DEFAULT_CAPACITY );
+
+    // Methods
+    /**
+     * Publishes a message of a device.
+     *
+     * @param deviceId Device ID the message is coming from.
+     * @param timestamp Timestamp of the message in ms since epoch.
+     * @param messageType Type of the message.
+     * @param content Content of the message.
+     * @return Sequence number of the event.
+    */
+    unsigned long long publishMessage( const std::string & deviceId, unsigned long long timestamp, const std::string & messageType, const std::string & content );
+
+    /**
+     * Publishes that a device got added.
+     *
+     * @param deviceId Device ID of the device.
+     * @param serialPort Port of the device.
+     * @return Sequence number of the event.
+    */
+    unsigned long long publishDeviceAdded( const std::string & deviceId, const std::string & serialPort );
+
+    /**
+     * Publishes that a device got deleted.
+     *
+     * @param deviceId Device ID of the device.
+     * @param serialPort Port of the device.
+     * @return Sequence number of the event.
+    */
+    unsigned long long publishDeviceDeleted( const std::string & deviceId, const std::string & serialPort );
+
+    /**
+     * Registers a consumer. It starts at the head, so it reads every event published from now on.
+     *
+     * @param name Name of the consumer, e.g. for reporting its lag.
+     * @return Consumer; Only to be read by a single thread at a time.
+    */
+    EventConsumerPointer addConsumer( std::string name );
+
+    /**
+     * Unregisters a consumer, so the publishers don't wait for it anymore; Its events must not be read afterwards.
+     *
+     * @param consumer Consumer to be unregistered.
+    */
+    void removeConsumer( const EventConsumerPointer & consumer );
+
+    /**
+     * Waits until there are events for a consumer, the timeout passed, or the bus got closed. Events aren't copied:
+     * Every sequence from the consumer's cursor up to the returned one can be read with "getEvent", until it gets released.
+     *
+     * @param consumer Consumer to wait for.
+     * @param timeout Maximum time to wait.
+     * @return Sequence of the first event which isn't published yet; Equal to the cursor if there are none.
+    */
+    unsigned long long waitForEvents( const EventConsumerPointer & consumer, std::chrono::milliseconds timeout );
+
+    /**
+     * Gets a published event, which the consumer didn't release yet.
+     *
+     * @param sequence Sequence of the event.
+     * @return Reference to the event on the ring.
+    */
+    const GatewayEvent & getEvent( unsigned long long sequence ) const;
+
+    /**
+     * Releases every event of a consumer before a sequence, so the publishers may reuse their slots.
+     *
+     * @param consumer Consumer which read the events.
+     * @param sequence Sequence of the first event which wasn't read, usually what "waitForEvents" returned.
+    */
+    void release( const EventConsumerPointer & consumer, unsigned long long sequence );
+
+    /**
+     * Closes the bus; Waiting publishers and consumers return, and events which are published afterwards get dropped.
+    */
+    void close();
+
+    /**
+     * Gets the head, which is the sequence the next event gets.
+     *
+     * @return Sequence.
+    */
+    unsigned long long getHead();
+
+    /**
+     * Gets how far a consumer is behind the head.
+     *
+     * @param consumer Consumer.
+     * @return Number of events which the consumer didn't release yet, including those still being published.
+    */
+    unsigned long long getLag( const EventConsumerPointer & consumer );
+
+    /**
+     * Gets how far every consumer is behind the head.
+     *
+     * @return Mapping between consumer names and their lags.
+    */
+    std::map<std::string, unsigned long long> getConsumerLags();
+
+    /**
+     * Gets how often a publisher had to wait for a consumer, because the ring was full.
+     *
+     * @return Number of stalled publishes.
+    */
+    unsigned long long getStallCount();
+
+    /**
+     * Gets the number of events the ring holds.
+     *
+     * @return Capacity.
+    */
+    std::size_t getCapacity();
+};
+
+#endif // EVENTBUS_HPP
@@ -0,0 +1,585 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "GatewayMetrics.hpp"
+
+// C Standard Libraries
+#include <cmath> // std::ceil
+
+// C++ Standard Libraries
+#include <chrono>
+#include <new> // placement new
+#include <memory> // std::align
+
+const unsigned int LatencyHistogram::SUB_BUCKET_BITS;
+const std::size_t LatencyHistogram::SUB_BUCKET_COUNT;
+const unsigned int LatencyHistogram::MAX_VALUE_BITS;
+const unsigned long long LatencyHistogram::MAX_VALUE;
+const std::size_t LatencyHistogram::BUCKET_COUNT;
+const std::size_t DeviceMetrics::SHARD_COUNT;
+
+LatencyHistogramSnapshot::LatencyHistogramSnapshot()
+{
+    this->bucketCounts.assign( LatencyHistogram::BUCKET_COUNT, 0 );
+    this->count = 0;
+    this->sum = 0;
+    this->max = 0;
+}
+
+void LatencyHistogramSnapshot::merge( const LatencyHistogramSnapshot & other )
+{
+    for ( std::size_t index = 0; index < bucketCounts.size(); index++ )
+    {
+        bucketCounts[index] += other.bucketCounts[index];
+    }
+
+    count += other.count;
+    addTotals( other.sum, other.max );
+}
+
+void LatencyHistogramSnapshot::addBucketCount( std::size_t index, unsigned long long bucketCount )
+{
+    bucketCounts[index] += bucketCount;
+    count += bucketCount;
+}
+
+void LatencyHistogramSnapshot::addTotals( unsigned long long sum, unsigned long long max )
+{
+    this->sum += sum;
+
+    if ( max > this->max )
+    {
+        this->max = max;
+    }
+}
+
+unsigned long long LatencyHistogramSnapshot::getCount() const
+{
+    return this->count;
+}
+
+unsigned long long LatencyHistogramSnapshot::getSum() const
+{
+    return this->sum;
+}
+
+unsigned long long LatencyHistogramSnapshot::getMax() const
+{
+    return this->max;
+}
+
+double LatencyHistogramSnapshot::getMean() const
+{
+    if ( count == 0 )
+    {
+        return 0;
+    }
+
+    return static_cast<double>( sum ) / count;
+}
+
+unsigned long long LatencyHistogramSnapshot::getPercentile( double percentile ) const
+{
+    if ( count == 0 )
+    {
+        return 0;
+    }
+
+    // Rank of the value we're looking for (1-based)
+    unsigned long long rank = static_cast<unsigned long long>( std::ceil( percentile / 100.0 * count ) );
+
+    if ( rank < 1 )
+    {
+        rank = 1;
+    }
+
+    unsigned long long seen = 0;
+
+    for ( std::size_t index = 0; index < bucketCounts.size(); index++ )
+    {
+        seen += bucketCounts[index];
+
+        if ( seen >= rank )
+        {
+            // The bucket's bound can be larger than anything actually recorded
+            unsigned long long upperBound = LatencyHistogram::getBucketUpperBound( index );
+
+            return upperBound < max ? upperBound : max;
+        }
+    }
+
+    return max;
+}
+
+unsigned long long LatencyHistogramSnapshot::getCountAtOrBelow( unsigned long long value ) const
+{
+    unsigned long long result = 0;
+
+    for ( std::size_t index = 0; index < bucketCounts.size() && LatencyHistogram::getBucketUpperBound( index ) <= value; index++ )
+    {
+        result += bucketCounts[index];
+    }
+
+    return result;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    for ( std::atomic<unsigned long long> & bucket : buckets )
+    {
+        bucket = 0;
+    }
+
+    this->sum = 0;
+    this->max = 0;
+}
+
+void LatencyHistogram::record( unsigned long long value )
+{
+    if ( value > MAX_VALUE )
+    {
+        value = MAX_VALUE;
+    }
+
+    buckets[getBucketIndex( value )].fetch_add( 1, std::memory_order_relaxed );
+    sum.fetch_add( value, std::memory_order_relaxed );
+
+    unsigned long long currentMax = max.load( std::memory_order_relaxed );
+
+    while ( value > currentMax && !max.compare_exchange_weak( currentMax, value, std::memory_order_relaxed ) )
+    {
+        // currentMax got reloaded by compare_exchange_weak
+    }
+}
+
+void LatencyHistogram::addTo( LatencyHistogramSnapshot & snapshot ) const
+{
+    for ( std::size_t index = 0; index < BUCKET_COUNT; index++ )
+    {
+        unsigned long long bucketCount = buckets[index].load( std::memory_order_relaxed );
+
+        if ( bucketCount > 0 )
+        {
+            snapshot.addBucketCount( index, bucketCount );
+        }
+    }
+
+    snapshot.addTotals( sum.load( std::memory_order_relaxed ), max.load( std::memory_order_relaxed ) );
+}
+
+std::size_t LatencyHistogram::getBucketIndex( unsigned long long value )
+{
+    // Values below SUB_BUCKET_COUNT get a bucket each.
+    // Above that, the exponent (position of the highest bit) selects a group of SUB_BUCKET_COUNT buckets,
+    // and the SUB_BUCKET_BITS bits right below the highest bit select the bucket inside of that group.
+    if ( value < SUB_BUCKET_COUNT )
+    {
+        return static_cast<std::size_t>( value );
+    }
+
+    unsigned int highestBit = 63 - __builtin_clzll( value );
+    unsigned int shift = highestBit - SUB_BUCKET_BITS;
+
+    return ( shift + 1 ) * SUB_BUCKET_COUNT + static_cast<std::size_t>( ( value >> shift ) - SUB_BUCKET_COUNT );
+}
+
+unsigned long long LatencyHistogram::getBucketUpperBound( std::size_t index )
+{
+    if ( index < SUB_BUCKET_COUNT )
+    {
+        return index;
+    }
+
+    unsigned int shift = static_cast<unsigned int>( index / SUB_BUCKET_COUNT - 1 );
+    unsigned long long subBucket = SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT;
+
+    return ( ( subBucket + 1 ) << shift ) - 1;
+}
+
+DeviceMetrics::DeviceMetrics( std::string deviceId )
+{
+    this->deviceId = deviceId;
+    this->connected = false;
+    this->reconnects = 0;
+    this->rxOverruns = 0;
+    this->rxBufferOverruns = 0;
+    this->framingErrors = 0;
+    this->parityErrors = 0;
+    this->slowStreak = 0;
+    this->isolated = false;
+
+    // Align the first shard to a cache line; The shards' size is a multiple of it, so every other shard is aligned as well
+    std::size_t size = sizeof( Shard ) * SHARD_COUNT + alignof( Shard );
+    shardMemory.reset( new unsigned char[size] );
+    void * memory = shardMemory.get();
+    std::align( alignof( Shard ), sizeof( Shard ) * SHARD_COUNT, memory, size );
+
+    this->shards = static_cast<Shard *>( memory );
+    this->histograms = new DeviceHistograms();
+
+    for ( std::size_t index = 0; index < SHARD_COUNT; index++ )
+    {
+        Shard * shard = new ( &shards[index] ) Shard(); // Shard is trivially destructible, so there's nothing to destroy later on
+        shard->bytesReceived = 0;
+        shard->linesReceived = 0;
+        shard->bytesSent = 0;
+        shard->linesSent = 0;
+        shard->parseFailures = 0;
+        shard->shortWrites = 0;
+        shard->inFlightCallbacks = 0;
+        shard->pendingSends = 0;
+        shard->slowCallbacks = 0;
+        shard->inboundQueued = 0;
+        shard->inboundDropped = 0;
+        shard->inboundConflated = 0;
+    }
+}
+
+DeviceMetrics::~DeviceMetrics()
+{
+    delete histograms.load();
+}
+
+DeviceMetrics::Shard & DeviceMetrics::getShard()
+{
+    // Threads get their shard assigned round-robin on first use; A device is counted by about four threads at a time (its read loop, the thread
+    // processing its messages, its send worker, and those handing over messages to send), which mostly end up on different shards
+    static std::atomic<std::size_t> nextShard( 0 );
+    thread_local std::size_t shard = nextShard.fetch_add( 1, std::memory_order_relaxed ) & ( SHARD_COUNT - 1 );
+
+    return shards[shard];
+}
+
+std::string DeviceMetrics::getDeviceId() const
+{
+    return this->deviceId;
+}
+
+void DeviceMetrics::setPort( std::string port )
+{
+    std::lock_guard<std::mutex> lock( portMutex );
+
+    this->port = port;
+}
+
+std::string DeviceMetrics::getPort() const
+{
+    std::lock_guard<std::mutex> lock( portMutex );
+
+    return this->port;
+}
+
+void DeviceMetrics::setConnected( bool connected )
+{
+    this->connected = connected;
+}
+
+bool DeviceMetrics::isConnected() const
+{
+    return this->connected;
+}
+
+void DeviceMetrics::setIsolated( bool isolated )
+{
+    this->isolated = isolated;
+}
+
+bool DeviceMetrics::isIsolated() const
+{
+    return this->isolated;
+}
+
+void DeviceMetrics::addReceived( std::size_t bytes )
+{
+    Shard & shard = getShard();
+    shard.bytesReceived.fetch_add( bytes, std::memory_order_relaxed );
+    shard.linesReceived.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::addSent( std::size_t bytes )
+{
+    Shard & shard = getShard();
+    shard.bytesSent.fetch_add( bytes, std::memory_order_relaxed );
+    shard.linesSent.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::addParseFailure()
+{
+    getShard().parseFailures.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::addShortWrite()
+{
+    getShard().shortWrites.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::addReconnect()
+{
+    reconnects.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::addLineErrors( unsigned long long overruns, unsigned long long bufferOverruns, unsigned long long framingErrors, unsigned long long parityErrors )
+{
+    this->rxOverruns.fetch_add( overruns, std::memory_order_relaxed );
+    this->rxBufferOverruns.fetch_add( bufferOverruns, std::memory_order_relaxed );
+    this->framingErrors.fetch_add( framingErrors, std::memory_order_relaxed );
+    this->parityErrors.fetch_add( parityErrors, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::changeInFlightCallbacks( long long delta )
+{
+    getShard().inFlightCallbacks.fetch_add( delta, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::changePendingSends( long long delta )
+{
+    getShard().pendingSends.fetch_add( delta, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::changeInboundQueued( long long delta )
+{
+    getShard().inboundQueued.fetch_add( delta, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::addInboundDrop()
+{
+    getShard().inboundDropped.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::addInboundConflation()
+{
+    getShard().inboundConflated.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DeviceMetrics::recordReadToCallbackLatency( unsigned long long latency )
+{
+    if ( DeviceHistograms * deviceHistograms = histograms.load( std::memory_order_acquire ) )
+    {
+        deviceHistograms->readToCallbackLatency.record( latency );
+    }
+}
+
+void DeviceMetrics::recordSendLatency( unsigned long long latency )
+{
+    if ( DeviceHistograms * deviceHistograms = histograms.load( std::memory_order_acquire ) )
+    {
+        deviceHistograms->sendLatency.record( latency );
+    }
+}
+
+int DeviceMetrics::recordCallbackTime( unsigned long long callbackTime, bool slow )
+{
+    if ( DeviceHistograms * deviceHistograms = histograms.load( std::memory_order_acquire ) )
+    {
+        deviceHistograms->callbackTime.record( callbackTime );
+    }
+
+    if ( slow )
+    {
+        getShard().slowCallbacks.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    // A slow callback ends a streak of fast ones and vice versa
+    int streak = slowStreak.load( std::memory_order_relaxed );
+    int newStreak;
+
+    do
+    {
+        newStreak = slow ? ( streak > 0 ? streak + 1 : 1 ) : ( streak < 0 ? streak - 1 : -1 );
+    }
+    while ( !slowStreak.compare_exchange_weak( streak, newStreak, std::memory_order_relaxed ) );
+
+    return newStreak;
+}
+
+DeviceMetricsSnapshot DeviceMetrics::getSnapshot() const
+{
+    DeviceMetricsSnapshot snapshot;
+    snapshot.deviceId = getDeviceId();
+    snapshot.port = getPort();
+    snapshot.connected = isConnected();
+    snapshot.bytesReceived = 0;
+    snapshot.linesReceived = 0;
+    snapshot.bytesSent = 0;
+    snapshot.linesSent = 0;
+    snapshot.parseFailures = 0;
+    snapshot.shortWrites = 0;
+    snapshot.reconnects = reconnects.load( std::memory_order_relaxed );
+    snapshot.inFlightCallbacks = 0;
+    snapshot.pendingSends = 0;
+    snapshot.slowCallbacks = 0;
+    snapshot.inboundQueued = 0;
+    snapshot.inboundDropped = 0;
+    snapshot.inboundConflated = 0;
+    snapshot.isolated = isIsolated();
+    snapshot.outboundBuffered = 0; // Filled in by the gateway, which owns the outbound buffer
+    snapshot.outboundDropped = 0;
+    snapshot.outboundExpired = 0;
+    snapshot.outboundForwarded = 0;
+    snapshot.rxOverruns = rxOverruns.load( std::memory_order_relaxed );
+    snapshot.rxBufferOverruns = rxBufferOverruns.load( std::memory_order_relaxed );
+    snapshot.framingErrors = framingErrors.load( std::memory_order_relaxed );
+    snapshot.parityErrors = parityErrors.load( std::memory_order_relaxed );
+
+    // Gauges get incremented and decremented on different shards, so only their sum is meaningful
+    for ( std::size_t index = 0; index < SHARD_COUNT; index++ )
+    {
+        const Shard & shard = shards[index];
+        snapshot.bytesReceived += shard.bytesReceived.load( std::memory_order_relaxed );
+        snapshot.linesReceived += shard.linesReceived.load( std::memory_order_relaxed );
+        snapshot.bytesSent += shard.bytesSent.load( std::memory_order_relaxed );
+        snapshot.linesSent += shard.linesSent.load( std::memory_order_relaxed );
+        snapshot.parseFailures += shard.parseFailures.load( std::memory_order_relaxed );
+        snapshot.shortWrites += shard.shortWrites.load( std::memory_order_relaxed );
+        snapshot.inFlightCallbacks += shard.inFlightCallbacks.load( std::memory_order_relaxed );
+        snapshot.pendingSends += shard.pendingSends.load( std::memory_order_relaxed );
+        snapshot.slowCallbacks += shard.slowCallbacks.load( std::memory_order_relaxed );
+        snapshot.inboundQueued += shard.inboundQueued.load( std::memory_order_relaxed );
+        snapshot.inboundDropped += shard.inboundDropped.load( std::memory_order_relaxed );
+        snapshot.inboundConflated += shard.inboundConflated.load( std::memory_order_relaxed );
+    }
+
+    if ( const DeviceHistograms * deviceHistograms = histograms.load( std::memory_order_acquire ) )
+    {
+        deviceHistograms->readToCallbackLatency.addTo( snapshot.readToCallbackLatency );
+        deviceHistograms->sendLatency.addTo( snapshot.sendLatency );
+        deviceHistograms->callbackTime.addTo( snapshot.callbackTime );
+    }
+
+    // Relaxed loads of different shards can briefly see a decrement without its increment
+    if ( snapshot.inFlightCallbacks < 0 )
+    {
+        snapshot.inFlightCallbacks = 0;
+    }
+
+    if ( snapshot.pendingSends < 0 )
+    {
+        snapshot.pendingSends = 0;
+    }
+
+    if ( snapshot.inboundQueued < 0 )
+    {
+        snapshot.inboundQueued = 0;
+    }
+
+    return snapshot;
+}
+
+void DeviceMetrics::releaseHistograms()
+{
+    delete histograms.exchange( nullptr );
+}
+
+void DeviceMetrics::attachHistograms()
+{
+    if ( histograms.load() == nullptr )
+    {
+        histograms = new DeviceHistograms();
+    }
+}
+
+bool DeviceMetrics::hasHistograms() const
+{
+    return histograms.load() != nullptr;
+}
+
+GatewayMetrics::DeviceMetricsPointer GatewayMetrics::registerDevice( std::string deviceId, std::string port )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    DeviceMetricsPointer & metrics = deviceMetrics[deviceId];
+
+    if ( metrics == nullptr )
+    {
+        metrics = std::make_shared<DeviceMetrics>( deviceId );
+    }
+    else
+    {
+        metrics->addReconnect();
+        metrics->attachHistograms(); // Released while the device was gone (See "getSnapshot")
+    }
+
+    metrics->setPort( port );
+    metrics->setConnected( true );
+
+    return metrics;
+}
+
+void GatewayMetrics::unregisterDevice( std::string deviceId )
+{
+    if ( DeviceMetricsPointer metrics = getDeviceMetrics( deviceId ) )
+    {
+        metrics->setConnected( false );
+    }
+}
+
+GatewayMetrics::DeviceMetricsPointer GatewayMetrics::getDeviceMetrics( const std::string & deviceId ) const
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    DeviceMetricsMap::const_iterator it = deviceMetrics.find( deviceId );
+
+    if ( it != deviceMetrics.end() )
+    {
+        return it->second;
+    }
+
+    return nullptr;
+}
+
+GatewayMetricsSnapshot GatewayMetrics::getSnapshot()
+{
+    GatewayMetricsSnapshot snapshot;
+    std::vector<DeviceMetricsPointer> devices;
+
+    {
+        // Only copy the pointers while locked; Summing up the shards happens without holding the registry lock
+        std::lock_guard<std::mutex> lock( mutex );
+
+        for ( std::pair<const std::string, DeviceMetricsPointer> const & entry : deviceMetrics )
+        {
+            devices.push_back( entry.second );
+        }
+    }
+
+    std::chrono::system_clock::duration durationSinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    snapshot.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>( durationSinceEpoch ).count();
+    snapshot.schemaMismatchCount = 0;
+    snapshot.droppedLogCount = 0;
+    snapshot.isolatedQueueDepth = 0;
+
+    for ( DeviceMetricsPointer const & device : devices )
+    {
+        snapshot.devices[device->getDeviceId()] = device->getSnapshot();
+    }
+
+    devices.clear();
+
+    // The histograms of disconnected devices have been exported now; Every thread recording into them holds a pointer to their metrics
+    // (e.g. a queued callback or send), so once the registry's is the only one left, nobody can record into them anymore
+    std::lock_guard<std::mutex> lock( mutex );
+
+    for ( std::pair<const std::string, DeviceMetricsPointer> const & entry : deviceMetrics )
+    {
+        if ( !entry.second->isConnected() && entry.second.use_count() == 1 && entry.second->hasHistograms() )
+        {
+            std::atomic_thread_fence( std::memory_order_acquire ); // Pairs with the release of the last other pointer, after its last record
+            entry.second->releaseHistograms();
+        }
+    }
+
+    return snapshot;
+}
@@ -0,0 +1,558 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef GATEWAYMETRICS_HPP
+#define GATEWAYMETRICS_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic
+#include <string>
+#include <vector>
+#include <map>
+#include <memory> // std::shared_ptr
+#include <mutex> // std::mutex, std::lock_guard
+
+/**
+ * LatencyHistogramSnapshot class
+ * File: GatewayMetrics.hpp
+ * Purpose: Defines a point-in-time copy of a LatencyHistogram, which can be evaluated (percentiles, mean, buckets) without touching the live histogram.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class LatencyHistogramSnapshot
+{
+private:
+    // Variables
+    std::vector<unsigned long long> bucketCounts;
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+
+public:
+    // Constructors
+    /**
+     * Default constructor; creates an empty snapshot.
+    */
+    LatencyHistogramSnapshot();
+
+    // Methods
+    /**
+     * Adds the values of another snapshot to this one.
+     *
+     * @param other Snapshot to be merged.
+    */
+    void merge( const LatencyHistogramSnapshot & other );
+
+    /**
+     * Adds a single bucket's count (used while taking the snapshot).
+     *
+     * @param index Index of the bucket.
+     * @param bucketCount Number of values to add to the bucket.
+    */
+    void addBucketCount( std::size_t index, unsigned long long bucketCount );
+
+    /**
+     * Adds to the sum and the maximum of the recorded values (used while taking the snapshot).
+     *
+     * @param sum Sum of values to add.
+     * @param max Maximum value seen.
+    */
+    void addTotals( unsigned long long sum, unsigned long long max );
+
+    /**
+     * Gets the number of recorded values.
+     *
+     * @return Number of values.
+    */
+    unsigned long long getCount() const;
+
+    /**
+     * Gets the sum of all recorded values.
+     *
+     * @return Sum in µs.
+    */
+    unsigned long long getSum() const;
+
+    /**
+     * Gets the largest recorded value.
+     *
+     * @return Maximum in µs.
+    */
+    unsigned long long getMax() const;
+
+    /**
+     * Gets the mean of all recorded values.
+     *
+     * @return Mean in µs, or 0 if nothing has been recorded.
+    */
+    double getMean() const;
+
+    /**
+     * Gets the value below or at which the given percentage of recorded values lie.
+     * The result is the upper bound of the bucket containing the percentile, so it's accurate to the bucket resolution (~6%).
+     *
+     * @param percentile Percentile, 0 - 100 (e.g. 99.9).
+     * @return Value in µs, or 0 if nothing has been recorded.
+    */
+    unsigned long long getPercentile( double percentile ) const;
+
+    /**
+     * Gets how many recorded values are less than or equal to the given value.
+     *
+     * @param value Value in µs.
+     * @return Number of values (counted per bucket, so accurate to the bucket resolution).
+    */
+    unsigned long long getCountAtOrBelow( unsigned long long value ) const;
+};
+
+/**
+ * LatencyHistogram class
+ * File: GatewayMetrics.hpp
+ * Purpose: Defines a lock-free, HDR-style histogram for latencies in µs.
+ *          Buckets are log-linear: Every power of two is split into 16 linear sub-buckets, which keeps the relative error at ~6%
+ *          over the whole range (0 µs up to ~19 hours) with a fixed, small number of buckets.
+ *          Recording a value is a couple of relaxed atomic increments, and never allocates.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class LatencyHistogram
+{
+public:
+    // Constants
+    static const unsigned int SUB_BUCKET_BITS = 4;
+    static const std::size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const unsigned int MAX_VALUE_BITS = 36;
+    static const unsigned long long MAX_VALUE = ( 1ULL << MAX_VALUE_BITS ) - 1; // µs; Larger values are clamped
+    static const std::size_t BUCKET_COUNT = ( MAX_VALUE_BITS - SUB_BUCKET_BITS + 1 ) * SUB_BUCKET_COUNT;
+
+private:
+    // Variables
+    std::atomic<unsigned long long> buckets[BUCKET_COUNT];
+    std::atomic<unsigned long long> sum;
+    std::atomic<unsigned long long> max;
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+    */
+    LatencyHistogram();
+
+    // Methods
+    /**
+     * Records a value.
+     *
+     * @param value Value in µs.
+    */
+    void record( unsigned long long value );
+
+    /**
+     * Adds the current state of the histogram to a snapshot.
+     *
+     * @param snapshot Snapshot to add to.
+    */
+    void addTo( LatencyHistogramSnapshot & snapshot ) const;
+
+    /**
+     * Gets the index of the bucket a value falls into.
+     *
+     * @param value Value in µs.
+     * @return Bucket index.
+    */
+    static std::size_t getBucketIndex( unsigned long long value );
+
+    /**
+     * Gets the largest value which falls into a bucket.
+     *
+     * @param index Bucket index.
+     * @return Upper bound (inclusive) in µs.
+    */
+    static unsigned long long getBucketUpperBound( std::size_t index );
+};
+
+/**
+ * DeviceHistograms struct
+ * Purpose: Holds the latency histograms of a single device (~12 KiB). They aren't sharded, since each of them has a single writer:
+ *          The thread processing the device's messages (resp. an isolated lane worker), or the device's send worker.
+*/
+struct DeviceHistograms
+{
+    LatencyHistogram readToCallbackLatency;
+    LatencyHistogram sendLatency;
+    LatencyHistogram callbackTime;
+};
+
+/**
+ * DeviceMetricsSnapshot struct
+ * Purpose: Holds the aggregated metrics of a single device at the time the snapshot was taken.
+*/
+struct DeviceMetricsSnapshot
+{
+    std::string deviceId;
+    std::string port; // Port the device is (or was last) connected to
+    bool connected;
+    unsigned long long bytesReceived;
+    unsigned long long linesReceived;
+    unsigned long long bytesSent;
+    unsigned long long linesSent;
+    unsigned long long parseFailures; // Malformed messages and schema mismatches
+    unsigned long long shortWrites; // Writes which didn't write the whole message
+    unsigned long long reconnects; // How often the device has been added again after it got deleted
+    long long inFlightCallbacks; // Messages read, which haven't finished their callback yet
+    long long pendingSends; // Messages handed to "sendMessageToSerialDevice", which haven't been written yet
+    unsigned long long slowCallbacks; // Callbacks which took longer than the callback budget
+    long long inboundQueued; // Messages waiting in the device's inbound queue
+    unsigned long long inboundDropped; // Messages dropped, because the inbound queue was full
+    unsigned long long inboundConflated; // Messages replaced by a newer one of the same type, while waiting in the inbound queue
+    bool isolated; // Whether the device's callbacks currently run on the isolated lane
+    unsigned long long outboundBuffered; // Messages buffered while the device is absent
+    unsigned long long outboundDropped; // Buffered messages dropped, because the outbound buffer was full
+    unsigned long long outboundExpired; // Buffered messages dropped, because they waited longer than the TTL
+    unsigned long long outboundForwarded; // Buffered messages written to the device after it came back
+    unsigned long long rxOverruns; // Bytes the UART lost, because its FIFO wasn't emptied in time (as counted by the driver)
+    unsigned long long rxBufferOverruns; // Bytes the tty lost, because its buffer was full (as counted by the driver)
+    unsigned long long framingErrors; // Bytes received with a framing error (as counted by the driver)
+    unsigned long long parityErrors; // Bytes received with a parity error (as counted by the driver)
+    LatencyHistogramSnapshot readToCallbackLatency; // From "readline" returning until the message callback starts; µs
+    LatencyHistogramSnapshot sendLatency; // From "sendMessageToSerialDevice" until the write returned; µs
+    LatencyHistogramSnapshot callbackTime; // Time the message callbacks took; µs
+};
+
+/**
+ * GatewayMetricsSnapshot struct
+ * Purpose: Holds the metrics of all devices the gateway has seen so far, at the time the snapshot was taken.
+*/
+struct GatewayMetricsSnapshot
+{
+    unsigned long long timestamp; // ms since epoch
+    std::map<std::string, DeviceMetricsSnapshot> devices; // deviceId -> metrics
+    unsigned long long schemaMismatchCount;
+    unsigned long long droppedLogCount;
+    unsigned long long isolatedQueueDepth; // Callbacks waiting for a worker of the isolated lane
+    std::map<std::string, LatencyHistogramSnapshot> stageLatencies; // Stage name -> latency (µs); Empty if tracing is not active
+};
+
+/**
+ * DeviceMetrics class
+ * File: GatewayMetrics.hpp
+ * Purpose: Defines the live metrics of a single device.
+ *          All counters are split into cache-line aligned shards; Every thread updates only "its" shard (picked once per thread), so the hot paths
+ *          mostly don't share a cache line with other threads. The shards are only summed up when a snapshot is taken.
+ *          The latency histograms aren't sharded (See DeviceHistograms); They can be released once the device is gone, and get recorded into again
+ *          after they've been attached anew.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class DeviceMetrics
+{
+public:
+    // Constants
+    static const std::size_t SHARD_COUNT = 4; // Must be a power of two; A device has about four writers (See getShard)
+
+private:
+    // Types
+    struct alignas( 64 ) Shard
+    {
+        std::atomic<unsigned long long> bytesReceived;
+        std::atomic<unsigned long long> linesReceived;
+        std::atomic<unsigned long long> bytesSent;
+        std::atomic<unsigned long long> linesSent;
+        std::atomic<unsigned long long> parseFailures;
+        std::atomic<unsigned long long> shortWrites;
+        std::atomic<long long> inFlightCallbacks;
+        std::atomic<long long> pendingSends;
+        std::atomic<unsigned long long> slowCallbacks;
+        std::atomic<long long> inboundQueued;
+        std::atomic<unsigned long long> inboundDropped;
+        std::atomic<unsigned long long> inboundConflated;
+    };
+
+    // Variables
+    std::string deviceId;
+    std::string port;
+    std::atomic_bool connected;
+    std::atomic<unsigned long long> reconnects; // Rare; not sharded
+    std::atomic<unsigned long long> rxOverruns; // Only added by the read loop; not sharded
+    std::atomic<unsigned long long> rxBufferOverruns;
+    std::atomic<unsigned long long> framingErrors;
+    std::atomic<unsigned long long> parityErrors;
+    std::atomic<int> slowStreak; // > 0: Number of consecutive slow callbacks, < 0: Number of consecutive callbacks within budget
+    std::atomic_bool isolated;
+    std::unique_ptr<unsigned char[]> shardMemory; // Over-allocated, since "new" doesn't respect the shards' cache-line alignment (before C++17)
+    Shard * shards; // Points into shardMemory
+    std::atomic<DeviceHistograms *> histograms; // Owned; nullptr while released
+    mutable std::mutex portMutex;
+
+    // Methods
+    /**
+     * Gets the shard of the calling thread.
+     *
+     * @return Reference to the shard.
+    */
+    Shard & getShard();
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param deviceId Device ID the metrics belong to.
+    */
+    DeviceMetrics( std::string deviceId );
+
+    DeviceMetrics( const DeviceMetrics & ) = delete;
+    DeviceMetrics & operator=( const DeviceMetrics & ) = delete;
+
+    // Destructors
+    /**
+     * Destructor.
+    */
+    ~DeviceMetrics();
+
+    // Methods
+    /**
+     * Gets the device ID the metrics belong to.
+     *
+     * @return Device ID.
+    */
+    std::string getDeviceId() const;
+
+    /**
+     * Sets the port the device is connected to.
+     *
+     * @param port Serial port.
+    */
+    void setPort( std::string port );
+
+    /**
+     * Gets the port the device is (or was last) connected to.
+     *
+     * @return Serial port.
+    */
+    std::string getPort() const;
+
+    /**
+     * Sets whether the device is currently connected.
+     *
+     * @param connected Connected true/false.
+    */
+    void setConnected( bool connected );
+
+    /**
+     * Gets whether the device is currently connected.
+     *
+     * @return Connected?
+    */
+    bool isConnected() const;
+
+    /**
+     * Sets whether the device's callbacks run on the isolated lane.
+     *
+     * @param isolated Isolated true/false.
+    */
+    void setIsolated( bool isolated );
+
+    /**
+     * Gets whether the device's callbacks run on the isolated lane.
+     *
+     * @return Isolated?
+    */
+    bool isIsolated() const;
+
+    /**
+     * Counts a line read from the device.
+     *
+     * @param bytes Length of the line in bytes.
+    */
+    void addReceived( std::size_t bytes );
+
+    /**
+     * Counts a message written to the device.
+     *
+     * @param bytes Number of bytes written.
+    */
+    void addSent( std::size_t bytes );
+
+    /**
+     * Counts a message which couldn't be parsed, or didn't match its schema.
+    */
+    void addParseFailure();
+
+    /**
+     * Counts a write which didn't write the whole message.
+    */
+    void addShortWrite();
+
+    /**
+     * Counts a reconnect of the device.
+    */
+    void addReconnect();
+
+    /**
+     * Counts errors the driver noticed on the line since they got counted the last time.
+     *
+     * @param overruns Bytes lost, because the UART's FIFO wasn't emptied in time.
+     * @param bufferOverruns Bytes lost, because the tty's buffer was full.
+     * @param framingErrors Bytes received with a framing error.
+     * @param parityErrors Bytes received with a parity error.
+    */
+    void addLineErrors( unsigned long long overruns, unsigned long long bufferOverruns, unsigned long long framingErrors, unsigned long long parityErrors );
+
+    /**
+     * Changes the number of messages waiting for, or running, their callback.
+     *
+     * @param delta +1 when a message gets dispatched, -1 when its callback returned.
+    */
+    void changeInFlightCallbacks( long long delta );
+
+    /**
+     * Changes the number of messages waiting to be written.
+     *
+     * @param delta +1 when a message gets handed over for sending, -1 when it has been written (or failed).
+    */
+    void changePendingSends( long long delta );
+
+    /**
+     * Changes the number of messages waiting in the device's inbound queue.
+     *
+     * @param delta +1 when a message got queued, -1 when it got taken off the queue for processing.
+    */
+    void changeInboundQueued( long long delta );
+
+    /**
+     * Counts a message dropped, because the inbound queue was full.
+    */
+    void addInboundDrop();
+
+    /**
+     * Counts a queued message replaced by a newer one of the same type.
+    */
+    void addInboundConflation();
+
+    /**
+     * Records the latency from reading a line until its callback starts.
+     *
+     * @param latency Latency in µs.
+    */
+    void recordReadToCallbackLatency( unsigned long long latency );
+
+    /**
+     * Records the latency from handing a message over for sending until it has been written.
+     *
+     * @param latency Latency in µs.
+    */
+    void recordSendLatency( unsigned long long latency );
+
+    /**
+     * Records the time a message callback took, and whether it was over budget.
+     *
+     * @param callbackTime Time in µs.
+     * @param slow Whether the callback took longer than the callback budget.
+     * @return Streak of the device after this callback; > 0: Number of consecutive slow callbacks, < 0: Number of consecutive callbacks within budget.
+    */
+    int recordCallbackTime( unsigned long long callbackTime, bool slow );
+
+    /**
+     * Frees the latency histograms; Until they get attached again, latencies aren't recorded, and the snapshots' histograms are empty.
+     * Must only be called while nobody else records into the metrics (See GatewayMetrics::getSnapshot).
+    */
+    void releaseHistograms();
+
+    /**
+     * Attaches new (empty) latency histograms, if they got released.
+    */
+    void attachHistograms();
+
+    /**
+     * Checks whether the latency histograms are attached.
+     *
+     * @return True unless they got released.
+    */
+    bool hasHistograms() const;
+
+    /**
+     * Sums up all shards into a snapshot.
+     *
+     * @return Snapshot of the device's metrics.
+    */
+    DeviceMetricsSnapshot getSnapshot() const;
+};
+
+/**
+ * GatewayMetrics class
+ * File: GatewayMetrics.hpp
+ * Purpose: Defines the registry of all devices' metrics.
+ *          The metrics of a device are kept after it got deleted, so its counters keep growing monotonically across reconnects.
+ *          Only the latency histograms (the bulk of the memory) get freed, once a snapshot exported them; They start over when the device comes back.
+ *          The registry is only locked when a device gets registered/unregistered and when a snapshot is taken, never while counting.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class GatewayMetrics
+{
+public:
+    // Types
+    typedef std::shared_ptr<DeviceMetrics> DeviceMetricsPointer;
+
+private:
+    // Types
+    typedef std::map<std::string, DeviceMetricsPointer> DeviceMetricsMap; // first value: deviceId, second value: DeviceMetricsPointer
+
+    // Variables
+    DeviceMetricsMap deviceMetrics;
+    mutable std::mutex mutex;
+
+public:
+    // Methods
+    /**
+     * Registers a (newly) connected device. If the device has been registered before, this counts as a reconnect.
+     *
+     * @param deviceId Device ID of the device.
+     * @param port Serial port the device is connected to.
+     * @return Pointer to the device's metrics.
+    */
+    DeviceMetricsPointer registerDevice( std::string deviceId, std::string port );
+
+    /**
+     * Marks a device as disconnected. Its metrics are kept; Its latency histograms until the next snapshot (See "getSnapshot").
+     *
+     * @param deviceId Device ID of the device.
+    */
+    void unregisterDevice( std::string deviceId );
+
+    /**
+     * Gets the metrics of a device.
+     *
+     * @param deviceId Device ID of the device.
+     * @return Pointer to the device's metrics, or nullptr if the device has never been registered.
+    */
+    DeviceMetricsPointer getDeviceMetrics( const std::string & deviceId ) const;
+
+    /**
+     * Takes a snapshot of all devices' metrics.
+     * Afterwards the latency histograms of disconnected devices get freed, once nobody else holds their metrics anymore (so nobody can record
+     * into them); A disconnected device's histograms are in one snapshot, and empty in the following ones, until the device comes back.
+     *
+     * @return Snapshot (The gateway-wide fields are left at 0 and need to be filled by the caller).
+    */
+    GatewayMetricsSnapshot getSnapshot();
+};
+
+#endif // GATEWAYMETRICS_HPP
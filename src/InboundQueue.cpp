@@ -0,0 +1,221 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "InboundQueue.hpp"
+
+const std::size_t InboundQueue::NO_SLOT = static_cast<std::size_t>( -1 );
+
+InboundQueue::InboundQueue( std::size_t capacity, OverflowPolicy overflowPolicy )
+{
+    if ( capacity == 0 )
+    {
+        throw std::invalid_argument( "Inbound queue capacity must be > 0." );
+    }
+
+    this->capacity = capacity;
+    this->overflowPolicy = overflowPolicy;
+    this->head = 0;
+    this->size = 0;
+    this->closed = false;
+}
+
+PushResult InboundQueue::push( InboundMessage & message )
+{
+    std::unique_lock<std::mutex> lock( mutex );
+    PushResult result = PushResult::QUEUED;
+
+    if ( overflowPolicy == OverflowPolicy::BLOCK )
+    {
+        notFull.wait( lock, [this]() { return closed || size < capacity; } );
+    }
+
+    if ( closed )
+    {
+        return PushResult::CLOSED;
+    }
+
+    if ( overflowPolicy == OverflowPolicy::CONFLATE )
+    {
+        TypeIndex::iterator it = typeIndex.find( message.type );
+
+        if ( it != typeIndex.end() && it->second != NO_SLOT )
+        {
+            // Keep the position in the queue, so a type which gets updated constantly isn't starved by the others
+            std::swap( slots[it->second], message );
+
+            return PushResult::CONFLATED;
+        }
+    }
+
+    if ( size >= capacity ) // Never true for OverflowPolicy::BLOCK
+    {
+        removeOldest();
+        result = PushResult::DROPPED_OLDEST;
+    }
+
+    // The ring only grows until it reached the capacity (or the most messages queued at once); Unrolled first, so it can grow at the end
+    if ( size == slots.size() )
+    {
+        std::rotate( slots.begin(), slots.begin() + head, slots.end() );
+
+        for ( TypeIndex::value_type & entry : typeIndex )
+        {
+            if ( entry.second != NO_SLOT )
+            {
+                entry.second = ( entry.second + slots.size() - head ) % slots.size();
+            }
+        }
+
+        head = 0;
+        slots.emplace_back();
+    }
+
+    std::size_t slot = ( head + size ) % slots.size();
+    std::swap( slots[slot], message );
+    size++;
+
+    if ( overflowPolicy == OverflowPolicy::CONFLATE )
+    {
+        indexType( slots[slot].type, slot );
+    }
+
+    lock.unlock();
+    notEmpty.notify_one();
+
+    return result;
+}
+
+bool InboundQueue::pop( InboundMessage & message )
+{
+    std::unique_lock<std::mutex> lock( mutex );
+    notEmpty.wait( lock, [this]() { return closed || size > 0; } );
+
+    if ( size == 0 ) // Closed and drained
+    {
+        return false;
+    }
+
+    std::size_t slot = head;
+    removeOldest();
+    std::swap( message, slots[slot] );
+
+    lock.unlock();
+    notFull.notify_one();
+
+    return true;
+}
+
+void InboundQueue::removeOldest()
+{
+    if ( overflowPolicy == OverflowPolicy::CONFLATE )
+    {
+        TypeIndex::iterator it = typeIndex.find( slots[head].type );
+
+        if ( it != typeIndex.end() )
+        {
+            it->second = NO_SLOT;
+        }
+    }
+
+    head = ( head + 1 ) % slots.size();
+    size--;
+}
+
+void InboundQueue::indexType( const std::string & type, std::size_t slot )
+{
+    TypeIndex::iterator it = typeIndex.find( type );
+
+    if ( it != typeIndex.end() )
+    {
+        it->second = slot;
+
+        return;
+    }
+
+    // Types which aren't queued anymore only get dropped once there are many of them, e.g. after line noise
+    if ( typeIndex.size() >= 2 * slots.size() )
+    {
+        for ( it = typeIndex.begin(); it != typeIndex.end(); )
+        {
+            it = it->second == NO_SLOT ? typeIndex.erase( it ) : std::next( it );
+        }
+    }
+
+    typeIndex.emplace( type, slot );
+}
+
+void InboundQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        closed = true;
+    }
+
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
+
+std::size_t InboundQueue::discard()
+{
+    std::size_t discarded;
+
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        discarded = size;
+        head = 0;
+        size = 0;
+        typeIndex.clear();
+    }
+
+    notFull.notify_all();
+
+    return discarded;
+}
+
+std::size_t InboundQueue::getSize()
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    return size;
+}
+
+std::size_t InboundQueue::getCapacity()
+{
+    return this->capacity;
+}
+
+OverflowPolicy InboundQueue::getOverflowPolicy()
+{
+    return this->overflowPolicy;
+}
+
+OverflowPolicy InboundQueue::parseOverflowPolicy( std::string name )
+{
+    if ( name == "block" )
+    {
+        return OverflowPolicy::BLOCK;
+    }
+    else if ( name == "drop_oldest" )
+    {
+        return OverflowPolicy::DROP_OLDEST;
+    }
+    else if ( name == "conflate" )
+    {
+        return OverflowPolicy::CONFLATE;
+    }
+
+    throw std::invalid_argument( "Unknown inbound overflow policy \"" + name + "\". (Allowed: block, drop_oldest, conflate)" );
+}
@@ -0,0 +1,188 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef INBOUNDQUEUE_HPP
+#define INBOUNDQUEUE_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <utility> // std::swap
+#include <algorithm> // std::rotate
+#include <iterator> // std::next
+#include <unordered_map>
+#include <mutex> // std::mutex, std::unique_lock
+#include <condition_variable> // std::condition_variable
+#include <chrono>
+#include <stdexcept> // std::invalid_argument
+
+#include "StageTracer.hpp"
+
+/**
+ * OverflowPolicy enum
+ * Purpose: Lists what an inbound queue does with a new message while it's full.
+*/
+enum class OverflowPolicy
+{
+    BLOCK, // The reader waits until there's space again; Meanwhile the tty buffer fills up, and flow control (if any) pushes back on the device
+    DROP_OLDEST, // The oldest queued message gets dropped
+    CONFLATE // A queued message with the same type gets replaced by the new one; If there's none, the oldest queued message gets dropped
+};
+
+/**
+ * PushResult enum
+ * Purpose: Lists what happened to a message pushed onto an inbound queue.
+*/
+enum class PushResult
+{
+    QUEUED, // Queued; The queue got longer by one message
+    DROPPED_OLDEST, // Queued, but the oldest message got dropped for it
+    CONFLATED, // Replaced a queued message with the same type
+    CLOSED // Not queued, because the queue is closed
+};
+
+/**
+ * InboundMessage struct
+ * Purpose: Holds a message read from a device, until it gets processed.
+*/
+struct InboundMessage
+{
+    std::string message;
+    std::string type; // Only used for conflation
+    std::chrono::steady_clock::time_point readTime;
+    TraceContext traceContext;
+};
+
+/**
+ * InboundQueue class
+ * File: InboundQueue.hpp
+ * Purpose: Defines a bounded queue between the read loop of a device and the thread delivering its messages.
+ *          If the consumer falls behind, the queue doesn't grow beyond its capacity; Instead the overflow policy decides what happens.
+ *          With the conflating policy, at most one message per type is queued at any time, so a slow consumer always gets the latest value
+ *          of every type (e.g. telemetry gauges) instead of a growing backlog of outdated ones.
+ *          The messages live in a ring of slots, which only grows as far as needed (at most to the capacity). The slots get swapped with the pushed
+ *          and popped messages instead of being copied; So the strings keep their capacity, and once warmed up, pushing and popping don't allocate.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class InboundQueue
+{
+private:
+    // Types
+    typedef std::unordered_map<std::string, std::size_t> TypeIndex; // first value: message type, second value: slot of the queued message of that type, or NO_SLOT
+
+    // Constants
+    static const std::size_t NO_SLOT;
+
+    // Variables
+    std::size_t capacity;
+    OverflowPolicy overflowPolicy;
+    std::vector<InboundMessage> slots; // Ring of queued messages
+    std::size_t head; // Slot of the oldest queued message
+    std::size_t size; // Number of queued messages
+    TypeIndex typeIndex; // Only maintained for OverflowPolicy::CONFLATE; Types stay in it once seen (up to twice the ring's size), so indexing them doesn't allocate
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    // Methods
+    /**
+     * Removes the oldest queued message; Its slot keeps the message, until it gets swapped with the next one. Must be called while holding the lock.
+    */
+    void removeOldest();
+
+    /**
+     * Indexes the type of a newly queued message (OverflowPolicy::CONFLATE). Must be called while holding the lock.
+     *
+     * @param type Type of the message.
+     * @param slot Slot of the message.
+    */
+    void indexType( const std::string & type, std::size_t slot );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param capacity Maximum number of queued messages.
+     * @param overflowPolicy What to do with a new message while the queue is full.
+    */
+    InboundQueue( std::size_t capacity, OverflowPolicy overflowPolicy );
+
+    // Methods
+    /**
+     * Pushes a message onto the queue. With OverflowPolicy::BLOCK, this blocks while the queue is full.
+     *
+     * @param message Message to be queued; Gets swapped with the slot it's queued in, so it holds a message which left the queue afterwards
+     *                (whose buffers can be reused for the next message). Unchanged if the queue is closed.
+     * @return What happened to the message.
+    */
+    PushResult push( InboundMessage & message );
+
+    /**
+     * Pops the oldest message from the queue. Blocks until there's a message, or the queue got closed.
+     *
+     * @param message Gets swapped with the popped message; Its previous buffers get reused by the queue.
+     * @return True if a message got popped; False if the queue is closed and empty.
+    */
+    bool pop( InboundMessage & message );
+
+    /**
+     * Closes the queue; Wakes up a blocked reader, and lets the consumer stop once the queue is drained.
+    */
+    void close();
+
+    /**
+     * Drops every queued message; Once the queue is closed, the consumer stops right away.
+     *
+     * @return Number of dropped messages.
+    */
+    std::size_t discard();
+
+    /**
+     * Gets the number of queued messages.
+     *
+     * @return Number of queued messages.
+    */
+    std::size_t getSize();
+
+    /**
+     * Gets the capacity of the queue.
+     *
+     * @return Maximum number of queued messages.
+    */
+    std::size_t getCapacity();
+
+    /**
+     * Gets the overflow policy of the queue.
+     *
+     * @return Overflow policy.
+    */
+    OverflowPolicy getOverflowPolicy();
+
+    /**
+     * Parses the name of an overflow policy ("block", "drop_oldest", "conflate").
+     * Throws std::invalid_argument if the name is unknown.
+     *
+     * @param name Name of the policy.
+     * @return Overflow policy.
+    */
+    static OverflowPolicy parseOverflowPolicy( std::string name );
+};
+
+#endif // INBOUNDQUEUE_HPP
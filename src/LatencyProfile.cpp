@@ -0,0 +1,125 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "LatencyProfile.hpp"
+
+#include <sstream> // std::stringstream
+
+LatencyProfile::LatencyProfile()
+{
+    this->readTimeout = 250;
+    this->vmin = -1;
+    this->vtime = -1;
+    this->lowLatency = false;
+    this->latencyTimer = 0;
+}
+
+unsigned long LatencyProfile::parseSetting( const std::string & key, const std::string & value, unsigned long minimum, unsigned long maximum )
+{
+    std::size_t length = 0;
+    unsigned long number = 0;
+
+    try
+    {
+        number = std::stoul( value, &length );
+    }
+    catch ( const std::exception & e )
+    {
+        length = 0;
+    }
+
+    if ( value.empty() || length != value.length() || value[0] == '-' || number < minimum || number > maximum )
+    {
+        throw std::invalid_argument( "Malformed latency setting \"" + key + "=" + value + "\". (Allowed: " + std::to_string( minimum ) + " - " + std::to_string( maximum ) + ")" );
+    }
+
+    return number;
+}
+
+LatencyProfile LatencyProfile::parse( std::string declaration, LatencyProfile profile )
+{
+    std::stringstream stream( declaration );
+    std::string setting;
+
+    while ( std::getline( stream, setting, ',' ) )
+    {
+        if ( setting.empty() || setting == "default" )
+        {
+            continue;
+        }
+
+        if ( setting == "low" )
+        {
+            profile.lowLatency = true;
+            profile.latencyTimer = 1;
+
+            continue;
+        }
+
+        std::size_t separatorPosition = setting.find( '=' );
+        std::string key = setting.substr( 0, separatorPosition );
+        std::string value = separatorPosition == std::string::npos ? "" : setting.substr( separatorPosition + 1 );
+
+        if ( key == "read_timeout" ) profile.readTimeout = parseSetting( key, value, 1, 3600000 );
+        else if ( key == "vmin" ) profile.vmin = parseSetting( key, value, 0, 255 );
+        else if ( key == "vtime" ) profile.vtime = parseSetting( key, value, 0, 255 );
+        else if ( key == "low_latency" ) profile.lowLatency = parseSetting( key, value, 0, 1 ) == 1;
+        else if ( key == "latency_timer" ) profile.latencyTimer = parseSetting( key, value, 1, 255 );
+        else throw std::invalid_argument( "Unknown latency setting \"" + setting + "\". (Allowed: default, low, read_timeout, vmin, vtime, low_latency, latency_timer)" );
+    }
+
+    // The gateway polls a non-blocking descriptor, and the tty only takes VMIN into account for that while VTIME is 0 (as the serial Library leaves it);
+    // A line shorter than VMIN would then sit in the buffer until more bytes arrive
+    if ( profile.vmin > 1 && profile.vtime <= 0 )
+    {
+        throw std::invalid_argument( "Latency setting \"vmin=" + std::to_string( profile.vmin ) + "\" needs \"vtime\" > 0, since lines shorter than VMIN would be held back otherwise." );
+    }
+
+    return profile;
+}
+
+bool LatencyProfile::needsTtyConfiguration() const
+{
+    return vmin >= 0 || vtime >= 0 || lowLatency;
+}
+
+std::string LatencyProfile::toString() const
+{
+    std::stringstream declaration;
+    declaration << "read_timeout=" << readTimeout;
+
+    if ( vmin >= 0 )
+    {
+        declaration << ",vmin=" << vmin;
+    }
+
+    if ( vtime >= 0 )
+    {
+        declaration << ",vtime=" << vtime;
+    }
+
+    if ( lowLatency )
+    {
+        declaration << ",low_latency=1";
+    }
+
+    if ( latencyTimer > 0 )
+    {
+        declaration << ",latency_timer=" << latencyTimer;
+    }
+
+    return declaration.str();
+}
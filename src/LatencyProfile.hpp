@@ -0,0 +1,91 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef LATENCYPROFILE_HPP
+#define LATENCYPROFILE_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <stdexcept> // std::invalid_argument
+
+/**
+ * LatencyProfile struct
+ * File: LatencyProfile.hpp
+ * Purpose: Holds how a port gets tuned for latency; Every setting but the read timeout can be left as the driver/serial Library sets it.
+ *          Declared as comma separated settings, applied on top of a base profile, e.g. "low" or "read_timeout=50,vmin=1,vtime=0,latency_timer=2":
+ *          - "default": Leaves everything as it is
+ *          - "low": Shortcut for "low_latency=1,latency_timer=1"
+ *          - "read_timeout=<ms>": Time a read waits for a complete line (> 0)
+ *          - "vmin=<bytes>", "vtime=<ds>": VMIN/VTIME of the tty (0 - 255); The gateway reads non-blocking, so they don't change when it reads.
+ *            VMIN > 1 is only accepted with VTIME > 0, since a poll would wait for VMIN bytes otherwise
+ *          - "low_latency=<0|1>": The ASYNC_LOW_LATENCY serial flag; The driver pushes received bytes right away instead of deferring them
+ *          - "latency_timer=<ms>": Latency timer of FTDI chips (1 - 255, via sysfs); They hold back small amounts of data for up to 16 ms by default
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+struct LatencyProfile
+{
+    // Variables
+    unsigned int readTimeout; // ms
+    int vmin; // -1 means it's left as it is
+    int vtime; // Deciseconds; -1 means it's left as it is
+    bool lowLatency; // false means it's left as it is
+    unsigned int latencyTimer; // ms; 0 means it's left as it is
+
+    // Constructors
+    /**
+     * Default constructor; Leaves everything as it is, with a read timeout of 250 ms.
+    */
+    LatencyProfile();
+
+    // Methods
+    /**
+     * Parses the value of a setting. Throws std::invalid_argument if it isn't a number within the bounds.
+     *
+     * @param key Key of the setting, for the error message.
+     * @param value Value to be parsed.
+     * @param minimum Minimum allowed value.
+     * @param maximum Maximum allowed value.
+     * @return Parsed value.
+    */
+    static unsigned long parseSetting( const std::string & key, const std::string & value, unsigned long minimum, unsigned long maximum );
+
+    /**
+     * Parses a declaration, and applies it on top of a profile. Throws std::invalid_argument if it is malformed.
+     *
+     * @param declaration Comma separated settings, e.g. "low,read_timeout=20".
+     * @param profile Profile the declaration gets applied on.
+     * @return Resulting profile.
+    */
+    static LatencyProfile parse( std::string declaration, LatencyProfile profile );
+
+    /**
+     * Gets whether the tty needs to be configured (VMIN/VTIME or the serial flags), beyond what the serial Library does.
+     *
+     * @return Whether the tty needs to be configured.
+    */
+    bool needsTtyConfiguration() const;
+
+    /**
+     * Gets the declaration of the profile; Settings which are left as they are, are left out.
+     *
+     * @return Declaration, e.g. "read_timeout=250,low_latency=1".
+    */
+    std::string toString() const;
+};
+
+#endif // LATENCYPROFILE_HPP
@@ -0,0 +1,408 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "LoopbackTransport.hpp"
+#include "SerialDevice.hpp"
+
+// C++ Standard Libraries
+#include <algorithm> // std::min
+
+const std::size_t LoopbackTransportFactory::DEFAULT_CHANNEL_CAPACITY;
+
+LoopbackChannel::LoopbackChannel( std::size_t capacity )
+{
+    if ( capacity == 0 )
+    {
+        throw Exception( "Loopback channel capacity must be > 0." );
+    }
+
+    std::size_t roundedCapacity = 1;
+
+    while ( roundedCapacity < capacity )
+    {
+        roundedCapacity <<= 1;
+    }
+
+    this->buffer.resize( roundedCapacity );
+    this->mask = roundedCapacity - 1;
+    this->head = 0;
+    this->tail = 0;
+    this->closed = false;
+    this->interrupted = false;
+    this->readerWaiting = false;
+    this->writerWaiting = false;
+}
+
+void LoopbackChannel::wakeReader()
+{
+    // The writer publishes head before checking the flag, and the reader sets the flag before checking head (both sequentially consistent),
+    // so either the writer sees the parked reader, or the reader sees the new data
+    if ( readerWaiting )
+    {
+        std::lock_guard<std::mutex> lock( waitMutex );
+        readable.notify_one();
+    }
+}
+
+void LoopbackChannel::wakeWriter()
+{
+    if ( writerWaiting )
+    {
+        std::lock_guard<std::mutex> lock( waitMutex );
+        writable.notify_one();
+    }
+}
+
+bool LoopbackChannel::write( const char * data, std::size_t length )
+{
+    std::size_t capacity = mask + 1;
+    std::size_t written = 0;
+
+    while ( written < length )
+    {
+        if ( closed )
+        {
+            return false;
+        }
+
+        std::size_t currentHead = head.load( std::memory_order_relaxed );
+        std::size_t space = capacity - ( currentHead - tail );
+
+        if ( space == 0 )
+        {
+            writerWaiting = true;
+
+            {
+                std::unique_lock<std::mutex> lock( waitMutex );
+                writable.wait( lock, [this, capacity]() { return closed || head.load( std::memory_order_relaxed ) - tail < capacity; } );
+            }
+
+            writerWaiting = false;
+
+            continue;
+        }
+
+        std::size_t chunk = std::min( space, length - written );
+
+        for ( std::size_t index = 0; index < chunk; index++ )
+        {
+            buffer[( currentHead + index ) & mask] = data[written + index];
+        }
+
+        head = currentHead + chunk;
+        written += chunk;
+
+        wakeReader();
+    }
+
+    return true;
+}
+
+bool LoopbackChannel::readLine( std::string & line, std::chrono::steady_clock::time_point deadline )
+{
+    while ( true )
+    {
+        std::size_t currentTail = tail.load( std::memory_order_relaxed );
+        std::size_t currentHead = head;
+
+        if ( currentTail != currentHead )
+        {
+            bool newlineRead = false;
+
+            while ( currentTail != currentHead && !newlineRead )
+            {
+                char byte = buffer[currentTail & mask];
+                line.push_back( byte );
+                currentTail++;
+
+                newlineRead = byte == '\n';
+            }
+
+            tail = currentTail;
+            wakeWriter();
+
+            if ( newlineRead )
+            {
+                return true;
+            }
+
+            continue;
+        }
+
+        if ( closed || ( interrupted && interrupted.exchange( false ) ) ) // Only swapped once it got set, since this runs whenever the channel is empty
+        {
+            return false;
+        }
+
+        readerWaiting = true;
+        bool dataAvailable;
+
+        {
+            std::unique_lock<std::mutex> lock( waitMutex );
+            dataAvailable = readable.wait_until( lock, deadline, [this, currentTail]() { return closed || interrupted || head != currentTail; } );
+        }
+
+        readerWaiting = false;
+
+        if ( !dataAvailable )
+        {
+            return false;
+        }
+    }
+}
+
+void LoopbackChannel::interruptRead()
+{
+    interrupted = true;
+
+    std::lock_guard<std::mutex> lock( waitMutex );
+    readable.notify_all();
+}
+
+void LoopbackChannel::close()
+{
+    closed = true;
+
+    std::lock_guard<std::mutex> lock( waitMutex );
+    readable.notify_all();
+    writable.notify_all();
+}
+
+bool LoopbackChannel::isClosed()
+{
+    return this->closed;
+}
+
+LoopbackPort::LoopbackPort( std::string port, std::string hardwareId, std::size_t channelCapacity ) : toGateway( channelCapacity ), toDevice( channelCapacity )
+{
+    this->port = port;
+    this->hardwareId = hardwareId;
+}
+
+bool LoopbackPort::writeToGateway( const std::string & data )
+{
+    return toGateway.write( data.data(), data.length() );
+}
+
+bool LoopbackPort::readFromGateway( std::string & line, unsigned int timeout )
+{
+    line.clear();
+
+    if ( !toDevice.readLine( line, std::chrono::steady_clock::now() + std::chrono::milliseconds( timeout ) ) )
+    {
+        return false;
+    }
+
+    line.pop_back(); // Newline
+
+    if ( !line.empty() && line.back() == '\r' )
+    {
+        line.pop_back();
+    }
+
+    return true;
+}
+
+bool LoopbackPort::writeToDevice( const std::string & data )
+{
+    std::lock_guard<std::mutex> lock( gatewayWriteMutex );
+
+    return toDevice.write( data.data(), data.length() );
+}
+
+bool LoopbackPort::readFromDevice( std::string & line, std::chrono::steady_clock::time_point deadline )
+{
+    return toGateway.readLine( line, deadline );
+}
+
+void LoopbackPort::interruptReadFromDevice()
+{
+    toGateway.interruptRead();
+}
+
+void LoopbackPort::disconnect()
+{
+    toGateway.close();
+    toDevice.close();
+}
+
+bool LoopbackPort::isDisconnected()
+{
+    return toGateway.isClosed();
+}
+
+std::string LoopbackPort::getPort()
+{
+    return this->port;
+}
+
+std::string LoopbackPort::getHardwareId()
+{
+    return this->hardwareId;
+}
+
+LoopbackTransport::LoopbackTransport( std::shared_ptr<LoopbackPort> loopbackPort, serial::Timeout timeout )
+{
+    this->loopbackPort = loopbackPort;
+    this->readTimeout = std::chrono::milliseconds( timeout.read_timeout_constant );
+    this->closed = false;
+}
+
+void LoopbackTransport::readline( std::string & line )
+{
+    line.clear();
+
+    if ( !loopbackPort->readFromDevice( line, std::chrono::steady_clock::now() + readTimeout ) && loopbackPort->isDisconnected() && line.empty() )
+    {
+        if ( closed )
+        {
+            return;
+        }
+
+        throw serial::SerialException( "Loopback port got disconnected." );
+    }
+}
+
+void LoopbackTransport::interruptRead()
+{
+    loopbackPort->interruptReadFromDevice();
+}
+
+std::size_t LoopbackTransport::write( const std::string & data )
+{
+    if ( !loopbackPort->writeToDevice( data ) )
+    {
+        throw serial::SerialException( "Loopback port got disconnected." );
+    }
+
+    return data.length();
+}
+
+void LoopbackTransport::flush()
+{
+    // Written data is immediately visible to the device, so there's nothing to drain
+}
+
+void LoopbackTransport::setTimeout( serial::Timeout timeout )
+{
+    this->readTimeout = std::chrono::milliseconds( timeout.read_timeout_constant );
+}
+
+bool LoopbackTransport::hasResetDevice()
+{
+    return false; // There are no modem lines
+}
+
+void LoopbackTransport::setLineSettings( const SerialParameters & serialParameters )
+{
+    // There's no line, so there's nothing to set
+}
+
+LatencyProfile LoopbackTransport::getLatencyProfile()
+{
+    LatencyProfile latencyProfile; // Nothing to tune but the read timeout
+    latencyProfile.readTimeout = static_cast<unsigned int>( readTimeout.count() );
+
+    return latencyProfile;
+}
+
+serial::flowcontrol_t LoopbackTransport::getFlowControl()
+{
+    return serial::flowcontrol_hardware; // Both sides block while the other one doesn't keep up, like with RTS/CTS
+}
+
+bool LoopbackTransport::getLineErrorCounters( LineErrorCounters & counters )
+{
+    return false; // Nothing gets lost on the way
+}
+
+void LoopbackTransport::close()
+{
+    closed = true;
+    loopbackPort->disconnect();
+}
+
+LoopbackTransportFactory::LoopbackTransportFactory( std::size_t channelCapacity )
+{
+    this->channelCapacity = channelCapacity;
+}
+
+LoopbackTransportFactory::LoopbackPortPointer LoopbackTransportFactory::addPort( std::string port, std::string hardwareId )
+{
+    LoopbackPortPointer loopbackPort = std::make_shared<LoopbackPort>( port, hardwareId, channelCapacity );
+    std::lock_guard<std::mutex> lock( loopbackPortsMutex );
+    LoopbackPortMap::iterator it = loopbackPorts.find( port );
+
+    if ( it != loopbackPorts.end() )
+    {
+        it->second->disconnect();
+    }
+
+    loopbackPorts[port] = loopbackPort;
+
+    return loopbackPort;
+}
+
+void LoopbackTransportFactory::removePort( std::string port )
+{
+    std::lock_guard<std::mutex> lock( loopbackPortsMutex );
+    LoopbackPortMap::iterator it = loopbackPorts.find( port );
+
+    if ( it != loopbackPorts.end() )
+    {
+        it->second->disconnect();
+        loopbackPorts.erase( it );
+    }
+}
+
+std::vector<serial::PortInfo> LoopbackTransportFactory::listPorts()
+{
+    std::vector<serial::PortInfo> portInfos;
+    std::lock_guard<std::mutex> lock( loopbackPortsMutex );
+
+    for ( LoopbackPortMap::value_type const & entry : loopbackPorts )
+    {
+        serial::PortInfo portInfo;
+        portInfo.port = entry.first;
+        portInfo.description = "loopback";
+        portInfo.hardware_id = entry.second->getHardwareId();
+
+        portInfos.push_back( portInfo );
+    }
+
+    return portInfos;
+}
+
+bool LoopbackTransportFactory::hasPort( std::string port )
+{
+    std::lock_guard<std::mutex> lock( loopbackPortsMutex );
+    LoopbackPortMap::iterator it = loopbackPorts.find( port );
+
+    return it != loopbackPorts.end() && !it->second->isDisconnected();
+}
+
+SerialTransportFactory::SerialTransportPointer LoopbackTransportFactory::openTransport( SerialDevice & serialDevice )
+{
+    std::lock_guard<std::mutex> lock( loopbackPortsMutex );
+    LoopbackPortMap::iterator it = loopbackPorts.find( serialDevice.getPort() );
+
+    if ( it == loopbackPorts.end() || it->second->isDisconnected() )
+    {
+        throw serial::IOException( __FILE__, __LINE__, ( "No such loopback port: " + serialDevice.getPort() ).c_str() );
+    }
+
+    return std::make_shared<LoopbackTransport>( it->second, serialDevice.getTimeout() );
+}
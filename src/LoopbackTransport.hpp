@@ -0,0 +1,318 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef LOOPBACKTRANSPORT_HPP
+#define LOOPBACKTRANSPORT_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex> // std::mutex, std::lock_guard, std::unique_lock
+#include <condition_variable>
+#include <chrono>
+
+// wjwwood's serial Library (https://github.com/wjwwood/serial)
+#include "serial/serial.h"
+
+#include "SerialTransport.hpp"
+#include "../dependencies/Exception/src/Exception.hpp"
+
+/**
+ * LoopbackChannel class
+ * File: LoopbackTransport.hpp
+ * Purpose: Defines a lock-free single-producer/single-consumer byte ring, which carries the bytes of one direction of a loopback port.
+ *          Reading and writing never take a lock while there's data/space; Only a reader waiting for data, or a writer waiting for space,
+ *          parks on a condition variable, and the other side only takes the lock to wake it up if it actually is parked.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class LoopbackChannel
+{
+private:
+    // Variables
+    std::vector<char> buffer;
+    std::size_t mask; // capacity - 1; The capacity is a power of 2
+    std::atomic<std::size_t> head; // Number of bytes written so far; Only advanced by the writer
+    char padding[64]; // Keeps head and tail on separate cache lines, so reader and writer don't invalidate each other's
+    std::atomic<std::size_t> tail; // Number of bytes read so far; Only advanced by the reader
+    std::atomic_bool closed;
+    std::atomic_bool interrupted;
+    std::atomic_bool readerWaiting;
+    std::atomic_bool writerWaiting;
+    std::mutex waitMutex;
+    std::condition_variable readable;
+    std::condition_variable writable;
+
+    // Methods
+    /**
+     * Wakes up the reader, if it's parked.
+    */
+    void wakeReader();
+
+    /**
+     * Wakes up the writer, if it's parked.
+    */
+    void wakeWriter();
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param capacity Capacity in bytes; Gets rounded up to a power of 2.
+    */
+    LoopbackChannel( std::size_t capacity );
+
+    // Methods
+    /**
+     * Writes data; Blocks while the ring is full. Must only be called by one thread at a time.
+     *
+     * @param data Data to be written.
+     * @param length Length of the data.
+     * @return False if the channel got closed before everything got written.
+    */
+    bool write( const char * data, std::size_t length );
+
+    /**
+     * Reads up to and including the next newline, and appends it to the line. Must only be called by one thread at a time.
+     *
+     * @param line Gets the read bytes appended.
+     * @param deadline Point in time until which the newline is waited for.
+     * @return True if a newline got read; False if the deadline passed, the read got interrupted, or the channel got closed (line contains what got read until then).
+    */
+    bool readLine( std::string & line, std::chrono::steady_clock::time_point deadline );
+
+    /**
+     * Wakes up a parked reader, so it returns what it got so far; If the reader isn't parked, its next wait returns immediately.
+    */
+    void interruptRead();
+
+    /**
+     * Closes the channel; Wakes up a parked reader and writer.
+    */
+    void close();
+
+    /**
+     * Gets whether the channel is closed.
+     *
+     * @return Whether the channel is closed.
+    */
+    bool isClosed();
+};
+
+/**
+ * LoopbackPort class
+ * File: LoopbackTransport.hpp
+ * Purpose: Defines a virtual port with a device side, used by a simulated device in the same process, and a gateway side, used by the LoopbackTransport.
+ *          Each direction is a LoopbackChannel. The device side must be used by one thread (per direction);
+ *          Concurrent writes on the gateway side (e.g. sends to the device) are serialized, like serial::Serial does.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class LoopbackPort
+{
+private:
+    // Variables
+    std::string port;
+    std::string hardwareId;
+    LoopbackChannel toGateway;
+    LoopbackChannel toDevice;
+    std::mutex gatewayWriteMutex;
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param port Name of the port.
+     * @param hardwareId Hardware information as reported by the discovery, e.g. "USB VID:PID=2341:0042". May be "".
+     * @param channelCapacity Capacity of each direction, in bytes.
+    */
+    LoopbackPort( std::string port, std::string hardwareId, std::size_t channelCapacity );
+
+    // Methods
+    /**
+     * Device side: Writes data to the gateway; Blocks while the gateway doesn't keep up (like hardware flow control).
+     *
+     * @param data Data to be written.
+     * @return False if the port got disconnected.
+    */
+    bool writeToGateway( const std::string & data );
+
+    /**
+     * Device side: Reads a line written by the gateway.
+     *
+     * @param line Gets the line assigned, without the newline.
+     * @param timeout Timeout in ms.
+     * @return True if a complete line got read.
+    */
+    bool readFromGateway( std::string & line, unsigned int timeout );
+
+    /**
+     * Gateway side: Writes data to the device.
+     *
+     * @param data Data to be written.
+     * @return False if the port got disconnected.
+    */
+    bool writeToDevice( const std::string & data );
+
+    /**
+     * Gateway side: Reads up to and including the next newline written by the device.
+     *
+     * @param line Gets the read bytes appended.
+     * @param deadline Point in time until which the newline is waited for.
+     * @return True if a newline got read.
+    */
+    bool readFromDevice( std::string & line, std::chrono::steady_clock::time_point deadline );
+
+    /**
+     * Gateway side: Interrupts the read (See LoopbackChannel::interruptRead).
+    */
+    void interruptReadFromDevice();
+
+    /**
+     * Disconnects the port, from either side; Reads and writes fail afterwards.
+    */
+    void disconnect();
+
+    /**
+     * Gets whether the port got disconnected.
+     *
+     * @return Whether the port is disconnected.
+    */
+    bool isDisconnected();
+
+    /**
+     * Gets the name of the port.
+     *
+     * @return Name of the port.
+    */
+    std::string getPort();
+
+    /**
+     * Gets the hardware information of the port.
+     *
+     * @return Hardware information.
+    */
+    std::string getHardwareId();
+};
+
+/**
+ * LoopbackTransport class
+ * File: LoopbackTransport.hpp
+ * Purpose: Defines the gateway side of a loopback port as a transport. Reads time out like the serial Library's (read timeout constant).
+ *          Reading from or writing to a disconnected port throws serial::SerialException, like a tty which got unplugged; Reading after closing reads "".
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class LoopbackTransport : public SerialTransport
+{
+private:
+    // Variables
+    std::shared_ptr<LoopbackPort> loopbackPort;
+    std::chrono::milliseconds readTimeout;
+    std::atomic_bool closed;
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param loopbackPort Port to be used.
+     * @param timeout Timeout information; Only the read timeout constant is used.
+    */
+    LoopbackTransport( std::shared_ptr<LoopbackPort> loopbackPort, serial::Timeout timeout );
+
+    // Methods (See SerialTransport)
+    using SerialTransport::readline;
+    void readline( std::string & line );
+    void interruptRead();
+    std::size_t write( const std::string & data );
+    void flush();
+    void setTimeout( serial::Timeout timeout );
+    void setLineSettings( const SerialParameters & serialParameters );
+    bool hasResetDevice();
+    LatencyProfile getLatencyProfile();
+    serial::flowcontrol_t getFlowControl();
+    bool getLineErrorCounters( LineErrorCounters & counters );
+    void close();
+};
+
+/**
+ * LoopbackTransportFactory class
+ * File: LoopbackTransport.hpp
+ * Purpose: Defines a transport factory for loopback ports, so the whole gateway pipeline (discovery, ID handshake, framing, dispatching and callbacks)
+ *          can run in-process, without the tty layer; E.g. to measure the gateway's own ceiling, or on machines without any /dev/tty*.
+ *          Ports get added by whoever simulates the devices, and get discovered by the gateway like ttys.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class LoopbackTransportFactory : public SerialTransportFactory
+{
+public:
+    // Types
+    typedef std::shared_ptr<LoopbackPort> LoopbackPortPointer;
+    typedef std::map<std::string, LoopbackPortPointer> LoopbackPortMap; // first value: port, second value: LoopbackPortPointer
+
+private:
+    // Constants
+    static const std::size_t DEFAULT_CHANNEL_CAPACITY = 64 * 1024;
+
+    // Variables
+    std::size_t channelCapacity;
+    LoopbackPortMap loopbackPorts;
+    std::mutex loopbackPortsMutex;
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param channelCapacity Capacity of each direction of every port, in bytes.
+    */
+    LoopbackTransportFactory( std::size_t channelCapacity = DEFAULT_CHANNEL_CAPACITY );
+
+    // Methods
+    /**
+     * Adds a port; A port with the same name gets disconnected and replaced, like a device which got plugged in again.
+     *
+     * @param port Name of the port.
+     * @param hardwareId Hardware information as reported by the discovery, e.g. "USB VID:PID=2341:0042". May be "".
+     * @return The port; Its device side is to be used by the simulated device.
+    */
+    LoopbackPortPointer addPort( std::string port, std::string hardwareId = "" );
+
+    /**
+     * Removes and disconnects a port, like a device which got unplugged.
+     *
+     * @param port Name of the port.
+    */
+    void removePort( std::string port );
+
+    // Methods (See SerialTransportFactory)
+    std::vector<serial::PortInfo> listPorts();
+    bool hasPort( std::string port );
+    SerialTransportPointer openTransport( SerialDevice & serialDevice );
+};
+
+#endif // LOOPBACKTRANSPORT_HPP
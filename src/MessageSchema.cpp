@@ -0,0 +1,409 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "MessageSchema.hpp"
+
+// C Standard Libraries
+#include <cerrno> // errno, ERANGE
+#include <cstdlib> // std::strtol, std::strtoul, std::strtoll, std::strtoull, std::strtof, std::strtod
+#include <limits> // std::numeric_limits
+
+const std::string MessageSchema::FIELD_SEPARATOR = ",";
+const std::string MessageSchema::TYPE_SEPARATOR = ":";
+
+SchemaRecord::SchemaRecord()
+{
+    setSchema( nullptr );
+}
+
+void SchemaRecord::setSchema( const MessageSchema * schema )
+{
+    this->schema = schema;
+}
+
+const MessageSchema * SchemaRecord::getSchema() const
+{
+    return this->schema;
+}
+
+unsigned char * SchemaRecord::getData()
+{
+    return this->data;
+}
+
+const unsigned char * SchemaRecord::getData() const
+{
+    return this->data;
+}
+
+double SchemaRecord::getAsDouble( std::size_t index ) const
+{
+    switch ( schema->getFields().at( index ).type )
+    {
+        case FieldType::I32:
+            return get<std::int32_t>( index );
+        case FieldType::U32:
+            return get<std::uint32_t>( index );
+        case FieldType::I64:
+            return get<std::int64_t>( index );
+        case FieldType::U64:
+            return get<std::uint64_t>( index );
+        case FieldType::F32:
+            return get<float>( index );
+        case FieldType::F64:
+            return get<double>( index );
+    }
+
+    return 0;
+}
+
+MessageSchema::MessageSchema( std::string type, std::string declaration )
+{
+    if ( type.empty() )
+    {
+        throw std::invalid_argument( "Message type of a schema must not be empty." );
+    }
+
+    this->type = type;
+    this->recordSize = 0;
+    this->matchCount = 0;
+    this->mismatchCount = 0;
+
+    compile( declaration );
+}
+
+MessageSchema::~MessageSchema()
+{
+
+}
+
+void MessageSchema::compile( std::string declaration )
+{
+    std::size_t fieldBegin = 0;
+
+    while ( fieldBegin <= declaration.length() )
+    {
+        std::size_t fieldEnd = declaration.find( FIELD_SEPARATOR, fieldBegin );
+
+        if ( fieldEnd == std::string::npos )
+        {
+            fieldEnd = declaration.length();
+        }
+
+        std::string fieldDeclaration = declaration.substr( fieldBegin, fieldEnd - fieldBegin );
+        std::size_t typePosition = fieldDeclaration.find( TYPE_SEPARATOR );
+
+        if ( typePosition == std::string::npos || typePosition == 0 )
+        {
+            throw std::invalid_argument( "Malformed field \"" + fieldDeclaration + "\" in schema for message type \"" + type + "\"." );
+        }
+
+        SchemaField field;
+        field.name = fieldDeclaration.substr( 0, typePosition );
+        field.type = parseFieldType( fieldDeclaration.substr( typePosition + TYPE_SEPARATOR.length() ) );
+
+        if ( getFieldIndex( field.name ) != -1 )
+        {
+            throw std::invalid_argument( "Field \"" + field.name + "\" is declared twice in schema for message type \"" + type + "\"." );
+        }
+
+        // Align every field to its natural size, so the record can be mapped onto a plain struct
+        std::size_t fieldSize = getFieldTypeSize( field.type );
+        field.offset = ( recordSize + fieldSize - 1 ) / fieldSize * fieldSize;
+
+        if ( field.offset + fieldSize > SchemaRecord::MAX_SIZE )
+        {
+            throw std::invalid_argument( "Schema for message type \"" + type + "\" exceeds the maximum record size of " + std::to_string( SchemaRecord::MAX_SIZE ) + " bytes." );
+        }
+
+        recordSize = field.offset + fieldSize;
+        fields.push_back( field );
+
+        fieldBegin = fieldEnd + FIELD_SEPARATOR.length();
+    }
+}
+
+bool MessageSchema::parseValue( const char * begin, const char * end, FieldType type, unsigned char * destination )
+{
+    // strto* would skip leading whitespace and accept a sign for unsigned values, which we don't want to be valid
+    if ( begin == end || *begin == ' ' || *begin == '\t' )
+    {
+        return false;
+    }
+
+    if ( ( type == FieldType::U32 || type == FieldType::U64 ) && *begin == '-' )
+    {
+        return false;
+    }
+
+    char * parsedEnd = nullptr;
+    errno = 0;
+
+    switch ( type )
+    {
+        case FieldType::I32:
+        {
+            long long value = std::strtoll( begin, &parsedEnd, 10 );
+
+            if ( value < std::numeric_limits<std::int32_t>::min() || value > std::numeric_limits<std::int32_t>::max() )
+            {
+                return false;
+            }
+
+            std::int32_t result = static_cast<std::int32_t>( value );
+            std::memcpy( destination, &result, sizeof( result ) );
+
+            break;
+        }
+        case FieldType::U32:
+        {
+            unsigned long long value = std::strtoull( begin, &parsedEnd, 10 );
+
+            if ( value > std::numeric_limits<std::uint32_t>::max() )
+            {
+                return false;
+            }
+
+            std::uint32_t result = static_cast<std::uint32_t>( value );
+            std::memcpy( destination, &result, sizeof( result ) );
+
+            break;
+        }
+        case FieldType::I64:
+        {
+            std::int64_t result = std::strtoll( begin, &parsedEnd, 10 );
+            std::memcpy( destination, &result, sizeof( result ) );
+
+            break;
+        }
+        case FieldType::U64:
+        {
+            std::uint64_t result = std::strtoull( begin, &parsedEnd, 10 );
+            std::memcpy( destination, &result, sizeof( result ) );
+
+            break;
+        }
+        case FieldType::F32:
+        {
+            float result = std::strtof( begin, &parsedEnd );
+            std::memcpy( destination, &result, sizeof( result ) );
+
+            break;
+        }
+        case FieldType::F64:
+        {
+            double result = std::strtod( begin, &parsedEnd );
+            std::memcpy( destination, &result, sizeof( result ) );
+
+            break;
+        }
+    }
+
+    // The whole value (and nothing more) needs to be consumed
+    return errno != ERANGE && parsedEnd == end;
+}
+
+std::string MessageSchema::getType() const
+{
+    return this->type;
+}
+
+const std::vector<SchemaField> & MessageSchema::getFields() const
+{
+    return this->fields;
+}
+
+std::size_t MessageSchema::getFieldCount() const
+{
+    return this->fields.size();
+}
+
+int MessageSchema::getFieldIndex( std::string name ) const
+{
+    for ( std::size_t index = 0; index < fields.size(); index++ )
+    {
+        if ( fields[index].name == name )
+        {
+            return static_cast<int>( index );
+        }
+    }
+
+    return -1;
+}
+
+std::size_t MessageSchema::getRecordSize() const
+{
+    return this->recordSize;
+}
+
+bool MessageSchema::extract( const std::string & content, const std::string & fieldDelimiter, SchemaRecord & record )
+{
+    // Works directly on the content's buffer; The values are terminated either by the delimiter or by the terminating null character.
+    const char * position = content.c_str();
+    const char * contentEnd = position + content.length();
+    std::size_t delimiterLength = fieldDelimiter.length();
+    bool matched = true;
+
+    record.setSchema( this );
+
+    for ( std::size_t index = 0; index < fields.size(); index++ )
+    {
+        const char * valueEnd = position;
+
+        while ( valueEnd < contentEnd && content.compare( valueEnd - content.c_str(), delimiterLength, fieldDelimiter ) != 0 )
+        {
+            valueEnd++;
+        }
+
+        bool isLastField = ( index + 1 == fields.size() );
+
+        // Every field except the last one needs to be followed by a delimiter, and the last one by the end of the content
+        if ( isLastField != ( valueEnd == contentEnd ) || !parseValue( position, valueEnd, fields[index].type, record.getData() + fields[index].offset ) )
+        {
+            matched = false;
+
+            break;
+        }
+
+        position = valueEnd + delimiterLength;
+    }
+
+    if ( matched )
+    {
+        matchCount++;
+    }
+    else
+    {
+        mismatchCount++;
+    }
+
+    return matched;
+}
+
+unsigned long long MessageSchema::getMatchCount() const
+{
+    return this->matchCount;
+}
+
+unsigned long long MessageSchema::getMismatchCount() const
+{
+    return this->mismatchCount;
+}
+
+std::size_t MessageSchema::getFieldTypeSize( FieldType type )
+{
+    switch ( type )
+    {
+        case FieldType::I32:
+        case FieldType::U32:
+        case FieldType::F32:
+            return 4;
+        case FieldType::I64:
+        case FieldType::U64:
+        case FieldType::F64:
+            return 8;
+    }
+
+    return 0;
+}
+
+FieldType MessageSchema::parseFieldType( std::string name )
+{
+    if ( name == "i32" )
+    {
+        return FieldType::I32;
+    }
+    else if ( name == "u32" )
+    {
+        return FieldType::U32;
+    }
+    else if ( name == "i64" )
+    {
+        return FieldType::I64;
+    }
+    else if ( name == "u64" )
+    {
+        return FieldType::U64;
+    }
+    else if ( name == "f32" )
+    {
+        return FieldType::F32;
+    }
+    else if ( name == "f64" )
+    {
+        return FieldType::F64;
+    }
+
+    throw std::invalid_argument( "Unknown field type \"" + name + "\". (Allowed: i32, u32, i64, u64, f32, f64)" );
+}
+
+SchemaColumnBuffer::SchemaColumnBuffer( const MessageSchema * schema, std::size_t capacity )
+{
+    if ( schema == nullptr )
+    {
+        throw std::invalid_argument( "Schema of a column buffer must not be null." );
+    }
+
+    this->schema = schema;
+    this->capacity = capacity;
+    this->size = 0;
+
+    // Columns are laid out one after another in a single allocation, each column aligned to 8 bytes
+    std::size_t totalSize = 0;
+
+    for ( SchemaField const & field : schema->getFields() )
+    {
+        columnOffsets.push_back( totalSize );
+        totalSize += ( MessageSchema::getFieldTypeSize( field.type ) * capacity + 7 ) / 8 * 8;
+    }
+
+    buffer.reset( new unsigned char[totalSize > 0 ? totalSize : 1] );
+}
+
+bool SchemaColumnBuffer::append( const SchemaRecord & record )
+{
+    if ( size >= capacity || record.getSchema() != schema )
+    {
+        return false;
+    }
+
+    const std::vector<SchemaField> & fields = schema->getFields();
+
+    for ( std::size_t index = 0; index < fields.size(); index++ )
+    {
+        std::size_t fieldSize = MessageSchema::getFieldTypeSize( fields[index].type );
+        std::memcpy( buffer.get() + columnOffsets[index] + size * fieldSize, record.getData() + fields[index].offset, fieldSize );
+    }
+
+    size++;
+
+    return true;
+}
+
+std::size_t SchemaColumnBuffer::getSize() const
+{
+    return this->size;
+}
+
+std::size_t SchemaColumnBuffer::getCapacity() const
+{
+    return this->capacity;
+}
+
+void SchemaColumnBuffer::clear()
+{
+    this->size = 0;
+}
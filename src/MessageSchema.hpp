@@ -0,0 +1,368 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef MESSAGESCHEMA_HPP
+#define MESSAGESCHEMA_HPP
+
+// C Standard Libraries
+#include <cstdint> // std::int32_t, std::uint32_t, std::int64_t, std::uint64_t
+#include <cstring> // std::memcpy
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept> // std::invalid_argument
+
+/**
+ * FieldType enum
+ * Purpose: Lists all value types a field of a MessageSchema can have.
+*/
+enum class FieldType
+{
+    I32,
+    U32,
+    I64,
+    U64,
+    F32,
+    F64
+};
+
+class MessageSchema;
+
+/**
+ * SchemaRecord class
+ * File: MessageSchema.hpp
+ * Purpose: Defines a flat, fixed-size record which holds the extracted field values of a single message.
+ *          The values are stored at fixed offsets (see MessageSchema), so filling and copying a record never allocates.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class SchemaRecord
+{
+public:
+    // Constants
+    static const std::size_t MAX_SIZE = 128; // Bytes; Enough for 16 64-bit fields
+
+private:
+    // Variables
+    const MessageSchema * schema;
+    alignas( 8 ) unsigned char data[MAX_SIZE];
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+    */
+    SchemaRecord();
+
+    // Methods
+    /**
+     * Sets the schema the record has been filled by.
+     *
+     * @param schema Schema to be set.
+    */
+    void setSchema( const MessageSchema * schema );
+
+    /**
+     * Gets the schema the record has been filled by.
+     *
+     * @return Pointer to the schema, or nullptr if the record is empty.
+    */
+    const MessageSchema * getSchema() const;
+
+    /**
+     * Gets the raw record buffer.
+     *
+     * @return Pointer to the first byte of the record.
+    */
+    unsigned char * getData();
+
+    /**
+     * Gets the raw record buffer.
+     *
+     * @return Pointer to the first byte of the record.
+    */
+    const unsigned char * getData() const;
+
+    /**
+     * Gets the value of a field by its index.
+     * T must match the field's type (e.g. float for f32, std::uint32_t for u32).
+     *
+     * @param index Index of the field, as declared in the schema.
+     * @return The field's value.
+    */
+    template<typename T>
+    T get( std::size_t index ) const;
+
+    /**
+     * Gets the value of a field by its index, converted to double.
+     *
+     * @param index Index of the field, as declared in the schema.
+     * @return The field's value as double.
+    */
+    double getAsDouble( std::size_t index ) const;
+};
+
+/**
+ * SchemaField struct
+ * Purpose: Describes a single field of a MessageSchema, and where its value is stored inside a SchemaRecord.
+*/
+struct SchemaField
+{
+    std::string name;
+    FieldType type;
+    std::size_t offset;
+};
+
+/**
+ * MessageSchema class
+ * File: MessageSchema.hpp
+ * Purpose: Defines a compiled schema for a specific message type, which maps the (delimited) message content to named, typed fields.
+ *          A schema is declared like "temp:f32,hum:f32,pressure:u32" and gets compiled once into a fixed record layout.
+ *          Extracting the fields of a message afterwards works without any per-field allocations.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class MessageSchema
+{
+private:
+    // Constants
+    static const std::string FIELD_SEPARATOR;
+    static const std::string TYPE_SEPARATOR;
+
+    // Variables
+    std::string type;
+    std::vector<SchemaField> fields;
+    std::size_t recordSize;
+    std::atomic<unsigned long long> matchCount;
+    std::atomic<unsigned long long> mismatchCount;
+
+    // Methods
+    /**
+     * Compiles a schema declaration into the list of fields and their offsets.
+     *
+     * @param declaration Schema declaration, e.g. "temp:f32,hum:f32,pressure:u32".
+    */
+    void compile( std::string declaration );
+
+    /**
+     * Parses a single value and writes it to the given destination.
+     *
+     * @param begin Pointer to the first character of the value.
+     * @param end Pointer behind the last character of the value.
+     * @param type Type of the value.
+     * @param destination Where to write the parsed value to.
+     * @return Whether the value could be parsed or not.
+    */
+    static bool parseValue( const char * begin, const char * end, FieldType type, unsigned char * destination );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param type Message type the schema applies to.
+     * @param declaration Schema declaration, e.g. "temp:f32,hum:f32,pressure:u32".
+    */
+    MessageSchema( std::string type, std::string declaration );
+
+    // Destructors
+    /**
+     * Destructor.
+    */
+    ~MessageSchema();
+
+    // Methods
+    /**
+     * Gets the message type the schema applies to.
+     *
+     * @return Message type.
+    */
+    std::string getType() const;
+
+    /**
+     * Gets all fields of the schema, in declaration order.
+     *
+     * @return Reference to the field list.
+    */
+    const std::vector<SchemaField> & getFields() const;
+
+    /**
+     * Gets the number of fields in the schema.
+     *
+     * @return Number of fields.
+    */
+    std::size_t getFieldCount() const;
+
+    /**
+     * Gets the index of a field by its name.
+     *
+     * @param name Name of the field.
+     * @return Index of the field, or -1 if there is no such field.
+    */
+    int getFieldIndex( std::string name ) const;
+
+    /**
+     * Gets the size a record of this schema takes up.
+     *
+     * @return Record size in bytes.
+    */
+    std::size_t getRecordSize() const;
+
+    /**
+     * Extracts the fields from a message's content into a record.
+     * The values inside the content need to be in declaration order and separated by the field delimiter.
+     *
+     * @param content Content of the message.
+     * @param fieldDelimiter Delimiter separating the values inside the content.
+     * @param record Record to be filled.
+     * @return Whether the content matched the schema or not. If not, the record's content is undefined.
+    */
+    bool extract( const std::string & content, const std::string & fieldDelimiter, SchemaRecord & record );
+
+    /**
+     * Gets how many messages have matched the schema so far.
+     *
+     * @return Number of matching messages.
+    */
+    unsigned long long getMatchCount() const;
+
+    /**
+     * Gets how many messages have failed to match the schema so far.
+     *
+     * @return Number of failed messages.
+    */
+    unsigned long long getMismatchCount() const;
+
+    /**
+     * Gets the size of a value type.
+     *
+     * @param type Value type.
+     * @return Size in bytes.
+    */
+    static std::size_t getFieldTypeSize( FieldType type );
+
+    /**
+     * Parses a value type from its name (i32, u32, i64, u64, f32, f64).
+     *
+     * @param name Name of the value type.
+     * @return Value type. Throws std::invalid_argument if the name is unknown.
+    */
+    static FieldType parseFieldType( std::string name );
+};
+
+/**
+ * SchemaColumnBuffer class
+ * File: MessageSchema.hpp
+ * Purpose: Defines a struct-of-arrays buffer for records of a specific schema.
+ *          All columns are allocated once on construction, appending records afterwards never allocates.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class SchemaColumnBuffer
+{
+private:
+    // Variables
+    const MessageSchema * schema;
+    std::size_t capacity;
+    std::size_t size;
+    std::vector<std::size_t> columnOffsets;
+    std::unique_ptr<unsigned char[]> buffer;
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param schema Schema of the records to be stored.
+     * @param capacity Maximum number of records to be stored.
+    */
+    SchemaColumnBuffer( const MessageSchema * schema, std::size_t capacity );
+
+    // Methods
+    /**
+     * Appends a record to the columns.
+     *
+     * @param record Record to append. Must have been filled by the buffer's schema.
+     * @return Whether the record was appended, false if the buffer is full or the schema doesn't match.
+    */
+    bool append( const SchemaRecord & record );
+
+    /**
+     * Gets a column by the index of its field.
+     * T must match the field's type (e.g. float for f32, std::uint32_t for u32).
+     *
+     * @param index Index of the field, as declared in the schema.
+     * @return Pointer to the first value of the column. The column holds "getSize()" values.
+    */
+    template<typename T>
+    const T * getColumn( std::size_t index ) const;
+
+    /**
+     * Gets the number of records currently stored.
+     *
+     * @return Number of records.
+    */
+    std::size_t getSize() const;
+
+    /**
+     * Gets the maximum number of records which can be stored.
+     *
+     * @return Capacity in records.
+    */
+    std::size_t getCapacity() const;
+
+    /**
+     * Removes all records; the memory is kept for reuse.
+    */
+    void clear();
+};
+
+template<typename T>
+T SchemaRecord::get( std::size_t index ) const
+{
+    const SchemaField & field = schema->getFields().at( index );
+
+    if ( sizeof( T ) != MessageSchema::getFieldTypeSize( field.type ) )
+    {
+        throw std::invalid_argument( "Requested type doesn't match the size of field \"" + field.name + "\"." );
+    }
+
+    T value;
+    std::memcpy( &value, data + field.offset, sizeof( T ) );
+
+    return value;
+}
+
+template<typename T>
+const T * SchemaColumnBuffer::getColumn( std::size_t index ) const
+{
+    const SchemaField & field = schema->getFields().at( index );
+
+    if ( sizeof( T ) != MessageSchema::getFieldTypeSize( field.type ) )
+    {
+        throw std::invalid_argument( "Requested type doesn't match the size of field \"" + field.name + "\"." );
+    }
+
+    return reinterpret_cast<const T *>( buffer.get() + columnOffsets[index] );
+}
+
+#endif // MESSAGESCHEMA_HPP
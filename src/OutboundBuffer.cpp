@@ -0,0 +1,195 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "OutboundBuffer.hpp"
+
+// C++ Standard Libraries
+#include <iterator> // std::make_move_iterator
+
+OutboundBuffer::OutboundBuffer( std::size_t capacity, std::size_t byteCapacity, unsigned int ttl )
+{
+    this->capacity = capacity;
+    this->byteCapacity = byteCapacity;
+    this->ttl = std::chrono::milliseconds( ttl );
+}
+
+void OutboundBuffer::dropExpired( DeviceBuffer & deviceBuffer, std::chrono::steady_clock::time_point now )
+{
+    if ( ttl.count() == 0 )
+    {
+        return;
+    }
+
+    while ( !deviceBuffer.messages.empty() && now - deviceBuffer.messages.front().bufferTime > ttl )
+    {
+        dropOldest( deviceBuffer );
+        deviceBuffer.statistics.expired++;
+    }
+}
+
+void OutboundBuffer::dropOldest( DeviceBuffer & deviceBuffer )
+{
+    deviceBuffer.statistics.buffered--;
+    deviceBuffer.statistics.bufferedBytes -= deviceBuffer.messages.front().message.length();
+    deviceBuffer.messages.pop_front();
+}
+
+bool OutboundBuffer::append( DeviceBuffer & deviceBuffer, std::string message, std::chrono::steady_clock::time_point now )
+{
+    dropExpired( deviceBuffer, now );
+
+    if ( message.length() > byteCapacity )
+    {
+        deviceBuffer.statistics.dropped++;
+
+        return false;
+    }
+
+    while ( deviceBuffer.messages.size() >= capacity || deviceBuffer.statistics.bufferedBytes + message.length() > byteCapacity )
+    {
+        dropOldest( deviceBuffer );
+        deviceBuffer.statistics.dropped++;
+    }
+
+    deviceBuffer.statistics.buffered++;
+    deviceBuffer.statistics.bufferedBytes += message.length();
+    deviceBuffer.messages.push_back( OutboundMessage{ message, now } );
+
+    return true;
+}
+
+bool OutboundBuffer::store( std::string deviceId, std::string message )
+{
+    if ( !isActive() )
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock( mutex );
+
+    return append( deviceBuffers[deviceId], message, std::chrono::steady_clock::now() );
+}
+
+bool OutboundBuffer::storeWhileForwarding( const std::string & deviceId, const std::string & message )
+{
+    if ( !isActive() )
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock( mutex );
+    DeviceBufferMap::iterator it = deviceBuffers.find( deviceId );
+
+    if ( it == deviceBuffers.end() || !it->second.forwarding )
+    {
+        return false;
+    }
+
+    append( it->second, message, std::chrono::steady_clock::now() );
+
+    return true;
+}
+
+bool OutboundBuffer::startForwarding( std::string deviceId )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    DeviceBufferMap::iterator it = deviceBuffers.find( deviceId );
+
+    if ( it == deviceBuffers.end() || it->second.forwarding )
+    {
+        return false;
+    }
+
+    dropExpired( it->second, std::chrono::steady_clock::now() );
+    it->second.forwarding = !it->second.messages.empty();
+
+    return it->second.forwarding;
+}
+
+std::vector<OutboundMessage> OutboundBuffer::take( std::string deviceId )
+{
+    std::vector<OutboundMessage> messages;
+    std::lock_guard<std::mutex> lock( mutex );
+    DeviceBufferMap::iterator it = deviceBuffers.find( deviceId );
+
+    if ( it == deviceBuffers.end() || !it->second.forwarding )
+    {
+        return messages;
+    }
+
+    DeviceBuffer & deviceBuffer = it->second;
+    dropExpired( deviceBuffer, std::chrono::steady_clock::now() );
+
+    messages.assign( std::make_move_iterator( deviceBuffer.messages.begin() ), std::make_move_iterator( deviceBuffer.messages.end() ) );
+
+    deviceBuffer.messages.clear();
+    deviceBuffer.statistics.buffered = 0;
+    deviceBuffer.statistics.bufferedBytes = 0;
+    deviceBuffer.forwarding = !messages.empty(); // Checked under the same lock as "storeWhileForwarding", so no message gets left behind
+
+    return messages;
+}
+
+void OutboundBuffer::restore( std::string deviceId, const std::vector<OutboundMessage> & messages )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    DeviceBuffer & deviceBuffer = deviceBuffers[deviceId];
+
+    deviceBuffer.messages.insert( deviceBuffer.messages.begin(), messages.begin(), messages.end() );
+
+    for ( OutboundMessage const & outboundMessage : messages )
+    {
+        deviceBuffer.statistics.buffered++;
+        deviceBuffer.statistics.bufferedBytes += outboundMessage.message.length();
+    }
+
+    dropExpired( deviceBuffer, std::chrono::steady_clock::now() );
+
+    // Messages buffered meanwhile are newer, so the restored ones get dropped first
+    while ( deviceBuffer.messages.size() > capacity || deviceBuffer.statistics.bufferedBytes > byteCapacity )
+    {
+        dropOldest( deviceBuffer );
+        deviceBuffer.statistics.dropped++;
+    }
+
+    deviceBuffer.forwarding = false;
+}
+
+void OutboundBuffer::addForwarded( std::string deviceId, unsigned long long count )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    deviceBuffers[deviceId].statistics.forwarded += count;
+}
+
+OutboundBufferStatistics OutboundBuffer::getStatistics( std::string deviceId )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    DeviceBufferMap::iterator it = deviceBuffers.find( deviceId );
+
+    if ( it == deviceBuffers.end() )
+    {
+        return OutboundBufferStatistics{ 0, 0, 0, 0, 0 };
+    }
+
+    dropExpired( it->second, std::chrono::steady_clock::now() ); // So the gauges don't show messages which can't be forwarded anymore
+
+    return it->second.statistics;
+}
+
+bool OutboundBuffer::isActive()
+{
+    return capacity > 0;
+}
@@ -0,0 +1,189 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef OUTBOUNDBUFFER_HPP
+#define OUTBOUNDBUFFER_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <deque>
+#include <vector>
+#include <map>
+#include <mutex> // std::mutex, std::lock_guard
+#include <chrono>
+
+/**
+ * OutboundMessage struct
+ * Purpose: Holds a message for an absent device, until the device is back or the message expired.
+*/
+struct OutboundMessage
+{
+    std::string message;
+    std::chrono::steady_clock::time_point bufferTime;
+};
+
+/**
+ * OutboundBufferStatistics struct
+ * Purpose: Holds the buffer state and counters of a single device.
+*/
+struct OutboundBufferStatistics
+{
+    unsigned long long buffered; // Messages currently buffered
+    unsigned long long bufferedBytes; // Bytes currently buffered
+    unsigned long long dropped; // Messages dropped, because the buffer was full (or the message alone was too big)
+    unsigned long long expired; // Messages dropped, because they were buffered longer than the TTL
+    unsigned long long forwarded; // Messages written to the device after it came back
+};
+
+/**
+ * OutboundBuffer class
+ * File: OutboundBuffer.hpp
+ * Purpose: Defines a store-and-forward buffer for messages to devices which are absent (e.g. while they reconnect after a USB hiccup).
+ *          Every device ID gets its own buffer, bounded by a number of messages, a number of bytes, and the time a message may wait (TTL).
+ *          If a buffer is full, its oldest messages get dropped for the new one. Once the device is back, its messages get taken in one go,
+ *          so they can be written as a single burst. While a device's messages get forwarded, new messages for it get buffered behind them,
+ *          so they can't overtake the forwarded ones; If the device can't be written to, the taken messages get restored.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class OutboundBuffer
+{
+private:
+    // Types
+    struct DeviceBuffer
+    {
+        std::deque<OutboundMessage> messages;
+        OutboundBufferStatistics statistics;
+        bool forwarding; // Whether a thread forwards the messages right now
+    };
+
+    typedef std::map<std::string, DeviceBuffer> DeviceBufferMap; // first value: deviceId, second value: DeviceBuffer
+
+    // Variables
+    std::size_t capacity;
+    std::size_t byteCapacity;
+    std::chrono::milliseconds ttl;
+    DeviceBufferMap deviceBuffers;
+    std::mutex mutex;
+
+    // Methods
+    /**
+     * Drops the expired messages of a device. Must be called while holding the lock.
+     *
+     * @param deviceBuffer Buffer of the device.
+     * @param now Current point in time.
+    */
+    void dropExpired( DeviceBuffer & deviceBuffer, std::chrono::steady_clock::time_point now );
+
+    /**
+     * Removes the oldest message of a device, without counting it. Must be called while holding the lock.
+     *
+     * @param deviceBuffer Buffer of the device.
+    */
+    void dropOldest( DeviceBuffer & deviceBuffer );
+
+    /**
+     * Buffers a message, dropping the oldest messages if the buffer would exceed its capacity otherwise. Must be called while holding the lock.
+     *
+     * @param deviceBuffer Buffer of the device.
+     * @param message Message to be buffered.
+     * @param now Current point in time.
+     * @return Whether the message got buffered; False if the message alone is bigger than the byte capacity.
+    */
+    bool append( DeviceBuffer & deviceBuffer, std::string message, std::chrono::steady_clock::time_point now );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param capacity Maximum number of buffered messages per device; 0 means nothing gets buffered.
+     * @param byteCapacity Maximum number of buffered bytes per device.
+     * @param ttl Time in ms a message may be buffered; 0 means messages don't expire.
+    */
+    OutboundBuffer( std::size_t capacity, std::size_t byteCapacity, unsigned int ttl );
+
+    // Methods
+    /**
+     * Buffers a message for a device. Drops the device's oldest messages, if the buffer would exceed its capacity otherwise.
+     *
+     * @param deviceId Device ID the message is for.
+     * @param message Message to be buffered.
+     * @return Whether the message got buffered; False if buffering is not active, or the message alone is bigger than the byte capacity.
+    */
+    bool store( std::string deviceId, std::string message );
+
+    /**
+     * Buffers a message for a device, but only while the device's messages get forwarded; Otherwise it may be written right away.
+     *
+     * @param deviceId Device ID the message is for.
+     * @param message Message to be buffered.
+     * @return Whether the message got buffered (or dropped, because it alone is bigger than the byte capacity).
+    */
+    bool storeWhileForwarding( const std::string & deviceId, const std::string & message );
+
+    /**
+     * Starts forwarding the messages of a device; Afterwards, the caller has to take the messages until there are none left, or restore them.
+     *
+     * @param deviceId Device ID to forward the messages of.
+     * @return Whether the caller forwards the messages; False if there are none, or another thread forwards them already.
+    */
+    bool startForwarding( std::string deviceId );
+
+    /**
+     * Takes all (unexpired) buffered messages of a device, oldest first. Only returns messages while they get forwarded,
+     * and once there are none left, forwarding ends.
+     *
+     * @param deviceId Device ID to take the messages of.
+     * @return Buffered messages; Empty if there are none.
+    */
+    std::vector<OutboundMessage> take( std::string deviceId );
+
+    /**
+     * Puts messages, which have been taken but couldn't be written, back in front of the buffer, and ends forwarding.
+     * Drops the oldest messages, if the buffer would exceed its capacity otherwise.
+     *
+     * @param deviceId Device ID the messages are for.
+     * @param messages Messages as they got taken.
+    */
+    void restore( std::string deviceId, const std::vector<OutboundMessage> & messages );
+
+    /**
+     * Counts messages as forwarded, once they have been written to the device.
+     *
+     * @param deviceId Device ID the messages got written to.
+     * @param count Number of messages.
+    */
+    void addForwarded( std::string deviceId, unsigned long long count );
+
+    /**
+     * Gets the buffer state and counters of a device.
+     *
+     * @param deviceId Device ID to get the statistics of.
+     * @return Statistics; All zero if nothing has ever been buffered for the device.
+    */
+    OutboundBufferStatistics getStatistics( std::string deviceId );
+
+    /**
+     * Gets whether messages get buffered at all.
+     *
+     * @return Whether the capacity is > 0.
+    */
+    bool isActive();
+};
+
+#endif // OUTBOUNDBUFFER_HPP
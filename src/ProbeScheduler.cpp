@@ -0,0 +1,145 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ProbeScheduler.hpp"
+
+#include <algorithm> // std::find, std::min, std::max
+
+ProbeScheduler::ProbeScheduler( unsigned int backoff, unsigned int maxBackoff, unsigned int quarantineAfter )
+{
+    this->backoff = std::chrono::milliseconds( backoff );
+    this->maxBackoff = std::chrono::milliseconds( std::max( backoff, maxBackoff ) );
+    this->quarantineAfter = quarantineAfter;
+}
+
+bool ProbeScheduler::isDue( std::string port, std::string identity, std::chrono::steady_clock::time_point now )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    ProbeRecordMap::iterator it = probeRecords.find( port );
+
+    if ( it == probeRecords.end() )
+    {
+        return true;
+    }
+
+    if ( it->second.identity != identity )
+    {
+        probeRecords.erase( it ); // Another device got plugged in
+
+        return true;
+    }
+
+    return !it->second.quarantined && now >= it->second.nextProbe;
+}
+
+ProbeRecord ProbeScheduler::recordFailure( std::string port, std::string identity, std::chrono::steady_clock::time_point now )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    ProbeRecordMap::iterator it = probeRecords.find( port );
+
+    if ( it == probeRecords.end() || it->second.identity != identity )
+    {
+        ProbeRecord probeRecord = { port, identity, 0, false, now };
+        probeRecords[port] = probeRecord;
+        it = probeRecords.find( port );
+    }
+
+    ProbeRecord & probeRecord = it->second;
+    probeRecord.failures++;
+
+    if ( quarantineAfter > 0 && probeRecord.failures >= quarantineAfter )
+    {
+        probeRecord.quarantined = true;
+    }
+
+    // Doubles with every failure in a row; Stops doubling at the maximum, so it can't overflow
+    std::chrono::milliseconds delay = backoff;
+
+    for ( unsigned int failure = 1; failure < probeRecord.failures && delay < maxBackoff; failure++ )
+    {
+        delay *= 2;
+    }
+
+    probeRecord.nextProbe = now + std::min( delay, maxBackoff );
+
+    return probeRecord;
+}
+
+void ProbeScheduler::recordSuccess( std::string port )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    probeRecords.erase( port );
+}
+
+void ProbeScheduler::retain( const std::vector<std::string> & presentPorts )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    for ( ProbeRecordMap::iterator it = probeRecords.begin(); it != probeRecords.end(); )
+    {
+        if ( std::find( presentPorts.begin(), presentPorts.end(), it->first ) == presentPorts.end() )
+        {
+            it = probeRecords.erase( it );
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool ProbeScheduler::release( std::string port )
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    ProbeRecordMap::iterator it = probeRecords.find( port );
+
+    if ( it == probeRecords.end() || !it->second.quarantined )
+    {
+        return false;
+    }
+
+    probeRecords.erase( it );
+
+    return true;
+}
+
+std::vector<ProbeRecord> ProbeScheduler::getQuarantined()
+{
+    std::lock_guard<std::mutex> lock( mutex );
+    std::vector<ProbeRecord> quarantined;
+
+    for ( ProbeRecordMap::value_type const & entry : probeRecords )
+    {
+        if ( entry.second.quarantined )
+        {
+            quarantined.push_back( entry.second );
+        }
+    }
+
+    return quarantined;
+}
+
+std::size_t ProbeScheduler::getSize()
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    return probeRecords.size();
+}
+
+bool ProbeScheduler::isActive()
+{
+    return backoff.count() > 0;
+}
@@ -0,0 +1,140 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef PROBESCHEDULER_HPP
+#define PROBESCHEDULER_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex> // std::mutex, std::lock_guard
+#include <chrono>
+
+/**
+ * ProbeRecord struct
+ * Purpose: Holds the failed probes of a single port.
+*/
+struct ProbeRecord
+{
+    std::string port;
+    std::string identity; // What the system reports about the port (description and hardware ID); Changes when another device gets plugged in
+    unsigned int failures; // Failed probes in a row
+    bool quarantined; // Whether the port doesn't get probed by the scan anymore, until its identity changes
+    std::chrono::steady_clock::time_point nextProbe;
+};
+
+/**
+ * ProbeScheduler class
+ * File: ProbeScheduler.hpp
+ * Purpose: Defines a scheduler which decides whether the scan probes a port (opens it and asks for the device ID), based on how often probing it failed before.
+ *          After every failed probe, the port gets skipped for a while, twice as long as after the previous one (up to a maximum).
+ *          A port which failed too often in a row gets quarantined: The scan skips it until its identity changes, it disappears, or it gets released.
+ *          This keeps the scan from spending its time on ports which never answer, like built-in UARTs and modems.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class ProbeScheduler
+{
+private:
+    // Types
+    typedef std::map<std::string, ProbeRecord> ProbeRecordMap; // first value: port, second value: ProbeRecord
+
+    // Variables
+    std::chrono::milliseconds backoff;
+    std::chrono::milliseconds maxBackoff;
+    unsigned int quarantineAfter;
+    ProbeRecordMap probeRecords;
+    std::mutex mutex;
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param backoff Time in ms a port gets skipped after its first failed probe; 0 means every port gets probed by every scan.
+     * @param maxBackoff Maximum time in ms a port gets skipped.
+     * @param quarantineAfter Failed probes in a row after which a port gets quarantined; 0 means ports never get quarantined.
+    */
+    ProbeScheduler( unsigned int backoff, unsigned int maxBackoff, unsigned int quarantineAfter );
+
+    // Methods
+    /**
+     * Checks whether a port should be probed now. Forgets the failures of the port, if its identity changed.
+     *
+     * @param port Port to be checked.
+     * @param identity Current identity of the port.
+     * @param now Current point in time.
+     * @return Whether the port should be probed.
+    */
+    bool isDue( std::string port, std::string identity, std::chrono::steady_clock::time_point now );
+
+    /**
+     * Records a failed probe, and schedules the next one.
+     *
+     * @param port Port which failed.
+     * @param identity Current identity of the port.
+     * @param now Current point in time.
+     * @return Record of the port after the failure.
+    */
+    ProbeRecord recordFailure( std::string port, std::string identity, std::chrono::steady_clock::time_point now );
+
+    /**
+     * Records a successful probe; Forgets the failures of the port.
+     *
+     * @param port Port which succeeded.
+    */
+    void recordSuccess( std::string port );
+
+    /**
+     * Forgets the failures of every port which isn't present anymore; A device plugged in later on gets probed right away.
+     *
+     * @param presentPorts Ports currently present.
+    */
+    void retain( const std::vector<std::string> & presentPorts );
+
+    /**
+     * Releases a port from quarantine; Forgets its failures.
+     *
+     * @param port Port to be released.
+     * @return Whether the port was quarantined.
+    */
+    bool release( std::string port );
+
+    /**
+     * Gets the quarantined ports.
+     *
+     * @return Records of the quarantined ports, ordered by port.
+    */
+    std::vector<ProbeRecord> getQuarantined();
+
+    /**
+     * Gets the number of ports with failed probes.
+     *
+     * @return Number of records.
+    */
+    std::size_t getSize();
+
+    /**
+     * Gets whether failed ports get skipped at all.
+     *
+     * @return Whether the backoff is > 0.
+    */
+    bool isActive();
+};
+
+#endif // PROBESCHEDULER_HPP
@@ -0,0 +1,502 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "PrometheusExporter.hpp"
+
+// C Standard Libraries
+#include <cstdio> // snprintf
+#include <cmath> // std::floor, std::fabs
+#include <cstring> // std::strerror, std::memset, std::strncpy
+#include <cerrno> // errno, EINTR
+#include <poll.h> // poll
+#include <unistd.h> // close, unlink
+#include <sys/socket.h> // socket, bind, listen, accept4, recv, send
+#include <sys/un.h> // sockaddr_un
+#include <netinet/in.h> // sockaddr_in, htons, htonl, INADDR_LOOPBACK
+
+const std::string PrometheusExporter::METRIC_PREFIX = "serialportgateway_";
+const std::string PrometheusExporter::CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+const unsigned int PrometheusExporter::POLL_INTERVAL;
+const unsigned int PrometheusExporter::REQUEST_TIMEOUT;
+const std::size_t PrometheusExporter::MAX_REQUEST_SIZE;
+const std::vector<double> PrometheusExporter::LATENCY_BUCKETS = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+const std::vector<double> PrometheusExporter::LATENCY_PERCENTILES = { 50, 90, 99, 99.9 };
+
+PrometheusExporter::PrometheusExporter( SnapshotProvider snapshotProvider, std::string unixSocketPath, unsigned int port )
+{
+    if ( !snapshotProvider )
+    {
+        throw Exception( "Snapshot provider of the Prometheus exporter must not be empty." );
+    }
+
+    if ( unixSocketPath.empty() && port == 0 )
+    {
+        throw Exception( "Prometheus exporter needs either a Unix socket path or a port to listen on." );
+    }
+
+    if ( port > 65535 )
+    {
+        throw Exception( "Port of the Prometheus exporter must be <= 65535." );
+    }
+
+    this->snapshotProvider = snapshotProvider;
+    this->unixSocketPath = unixSocketPath;
+    this->port = port;
+    this->unixSocketDescriptor = -1;
+    this->tcpSocketDescriptor = -1;
+    this->started = false;
+}
+
+PrometheusExporter::~PrometheusExporter()
+{
+    stop();
+}
+
+int PrometheusExporter::openUnixSocket()
+{
+    sockaddr_un address;
+    std::memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+
+    if ( unixSocketPath.length() >= sizeof( address.sun_path ) )
+    {
+        throw Exception( "Unix socket path of the Prometheus exporter is too long: \"" + unixSocketPath + "\"" );
+    }
+
+    std::strncpy( address.sun_path, unixSocketPath.c_str(), sizeof( address.sun_path ) - 1 );
+
+    int socketDescriptor = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+    if ( socketDescriptor == -1 )
+    {
+        throw Exception( "Couldn't create Unix socket for the Prometheus exporter: " + std::string( std::strerror( errno ) ) );
+    }
+
+    unlink( unixSocketPath.c_str() ); // Remove a stale socket of a previous run
+
+    if ( bind( socketDescriptor, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) == -1 || listen( socketDescriptor, 16 ) == -1 )
+    {
+        std::string error = std::strerror( errno );
+        close( socketDescriptor );
+
+        throw Exception( "Couldn't listen on Unix socket \"" + unixSocketPath + "\" for the Prometheus exporter: " + error );
+    }
+
+    return socketDescriptor;
+}
+
+int PrometheusExporter::openTcpSocket()
+{
+    sockaddr_in address;
+    std::memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = htons( static_cast<unsigned short>( port ) );
+
+    int socketDescriptor = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+    if ( socketDescriptor == -1 )
+    {
+        throw Exception( "Couldn't create TCP socket for the Prometheus exporter: " + std::string( std::strerror( errno ) ) );
+    }
+
+    int reuseAddress = 1;
+    setsockopt( socketDescriptor, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof( reuseAddress ) );
+
+    if ( bind( socketDescriptor, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) == -1 || listen( socketDescriptor, 16 ) == -1 )
+    {
+        std::string error = std::strerror( errno );
+        close( socketDescriptor );
+
+        throw Exception( "Couldn't listen on 127.0.0.1:" + std::to_string( port ) + " for the Prometheus exporter: " + error );
+    }
+
+    return socketDescriptor;
+}
+
+void PrometheusExporter::closeSockets()
+{
+    if ( unixSocketDescriptor != -1 )
+    {
+        close( unixSocketDescriptor );
+        unlink( unixSocketPath.c_str() );
+        unixSocketDescriptor = -1;
+    }
+
+    if ( tcpSocketDescriptor != -1 )
+    {
+        close( tcpSocketDescriptor );
+        tcpSocketDescriptor = -1;
+    }
+}
+
+void PrometheusExporter::start()
+{
+    if ( isStarted() )
+    {
+        return;
+    }
+
+    try
+    {
+        if ( !unixSocketPath.empty() )
+        {
+            unixSocketDescriptor = openUnixSocket();
+        }
+
+        if ( port > 0 )
+        {
+            tcpSocketDescriptor = openTcpSocket();
+        }
+    }
+    catch ( ... )
+    {
+        closeSockets();
+
+        throw;
+    }
+
+    started = true;
+    serverThread = std::thread( &PrometheusExporter::serveLoop, this );
+}
+
+void PrometheusExporter::stop()
+{
+    if ( !isStarted() )
+    {
+        return;
+    }
+
+    started = false;
+
+    if ( serverThread.joinable() )
+    {
+        serverThread.join();
+    }
+
+    closeSockets();
+}
+
+bool PrometheusExporter::isStarted()
+{
+    return this->started;
+}
+
+void PrometheusExporter::serveLoop()
+{
+    pollfd pollDescriptors[] = { { unixSocketDescriptor, POLLIN, 0 }, { tcpSocketDescriptor, POLLIN, 0 } }; // poll ignores negative descriptors
+
+    while ( isStarted() )
+    {
+        int numReady = poll( pollDescriptors, 2, POLL_INTERVAL );
+
+        if ( numReady <= 0 )
+        {
+            continue; // Timeout or EINTR; Check whether we got stopped
+        }
+
+        for ( pollfd & pollDescriptor : pollDescriptors )
+        {
+            if ( pollDescriptor.fd == -1 || !( pollDescriptor.revents & POLLIN ) )
+            {
+                continue;
+            }
+
+            int clientDescriptor = accept4( pollDescriptor.fd, nullptr, nullptr, SOCK_CLOEXEC );
+
+            if ( clientDescriptor != -1 )
+            {
+                serveClient( clientDescriptor );
+            }
+        }
+    }
+}
+
+void PrometheusExporter::serveClient( int clientDescriptor )
+{
+    timeval timeout;
+    timeout.tv_sec = REQUEST_TIMEOUT / 1000;
+    timeout.tv_usec = ( REQUEST_TIMEOUT % 1000 ) * 1000;
+    setsockopt( clientDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+    setsockopt( clientDescriptor, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+    // Only the request line is of interest, but the whole header is read so the client doesn't get a reset
+    std::string request;
+    char buffer[1024];
+
+    while ( request.find( "\r\n\r\n" ) == std::string::npos && request.length() < MAX_REQUEST_SIZE )
+    {
+        ssize_t numRead = recv( clientDescriptor, buffer, sizeof( buffer ), 0 );
+
+        if ( numRead < 0 && errno == EINTR )
+        {
+            continue;
+        }
+
+        if ( numRead <= 0 )
+        {
+            break;
+        }
+
+        request.append( buffer, numRead );
+    }
+
+    std::size_t methodEnd = request.find( ' ' );
+    std::size_t pathEnd = methodEnd == std::string::npos ? std::string::npos : request.find_first_of( " ?\r\n", methodEnd + 1 );
+
+    if ( pathEnd == std::string::npos )
+    {
+        writeResponse( clientDescriptor, "400 Bad Request", "text/plain", "Bad Request\n" );
+    }
+    else if ( request.compare( 0, methodEnd, "GET" ) != 0 )
+    {
+        writeResponse( clientDescriptor, "405 Method Not Allowed", "text/plain", "Method Not Allowed\n" );
+    }
+    else
+    {
+        std::string path = request.substr( methodEnd + 1, pathEnd - methodEnd - 1 );
+
+        if ( path == "/metrics" || path == "/" )
+        {
+            writeResponse( clientDescriptor, "200 OK", CONTENT_TYPE, render( snapshotProvider() ) );
+        }
+        else
+        {
+            writeResponse( clientDescriptor, "404 Not Found", "text/plain", "Not Found\n" );
+        }
+    }
+
+    close( clientDescriptor );
+}
+
+void PrometheusExporter::writeResponse( int clientDescriptor, std::string status, std::string contentType, const std::string & body )
+{
+    std::string response = "HTTP/1.0 " + status + "\r\n"
+        + "Content-Type: " + contentType + "\r\n"
+        + "Content-Length: " + std::to_string( body.length() ) + "\r\n"
+        + "Connection: close\r\n\r\n"
+        + body;
+
+    std::size_t bytesWritten = 0;
+
+    while ( bytesWritten < response.length() )
+    {
+        ssize_t result = send( clientDescriptor, response.c_str() + bytesWritten, response.length() - bytesWritten, MSG_NOSIGNAL );
+
+        if ( result < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            return; // Client went away; Nothing to do about it
+        }
+
+        bytesWritten += result;
+    }
+}
+
+void PrometheusExporter::appendHeader( std::string & output, std::string name, std::string type, std::string help )
+{
+    output.append( "# HELP " + METRIC_PREFIX + name + " " + help + "\n" );
+    output.append( "# TYPE " + METRIC_PREFIX + name + " " + type + "\n" );
+}
+
+void PrometheusExporter::appendSample( std::string & output, std::string name, const std::string & labels, double value )
+{
+    char formattedValue[32];
+
+    // Counters (e.g. received bytes) have to stay exact, or rate() sees them standing still once they outgrow the printed digits
+    if ( value == std::floor( value ) && std::fabs( value ) < 1e18 )
+    {
+        snprintf( formattedValue, sizeof( formattedValue ), "%.0f", value );
+    }
+    else
+    {
+        snprintf( formattedValue, sizeof( formattedValue ), "%.17g", value );
+    }
+
+    output.append( METRIC_PREFIX );
+    output.append( name );
+
+    if ( !labels.empty() )
+    {
+        output.append( "{" );
+        output.append( labels );
+        output.append( "}" );
+    }
+
+    output.append( " " );
+    output.append( formattedValue );
+    output.append( "\n" );
+}
+
+template<typename T>
+void PrometheusExporter::appendDeviceMetric( std::string & output, std::string name, std::string type, std::string help, const std::map<std::string, DeviceMetricsSnapshot> & devices, T DeviceMetricsSnapshot::* member )
+{
+    appendHeader( output, name, type, help );
+
+    for ( std::pair<const std::string, DeviceMetricsSnapshot> const & entry : devices )
+    {
+        appendSample( output, name, getDeviceLabels( entry.second ), static_cast<double>( entry.second.*member ) );
+    }
+}
+
+void PrometheusExporter::appendLatency( std::string & output, std::string name, std::string help, const std::map<std::string, DeviceMetricsSnapshot> & devices, LatencyHistogramSnapshot DeviceMetricsSnapshot::* histogram )
+{
+    appendHeader( output, name + "_seconds", "histogram", help );
+
+    for ( std::pair<const std::string, DeviceMetricsSnapshot> const & entry : devices )
+    {
+        appendHistogramSamples( output, name, getDeviceLabels( entry.second ), entry.second.*histogram );
+    }
+
+    // Percentiles computed from the gateway's own (finer) histogram, for dashboards which don't do histogram_quantile
+    appendHeader( output, name + "_percentile_seconds", "gauge", help + " Percentiles since start." );
+
+    for ( std::pair<const std::string, DeviceMetricsSnapshot> const & entry : devices )
+    {
+        appendPercentileSamples( output, name, getDeviceLabels( entry.second ), entry.second.*histogram );
+    }
+}
+
+void PrometheusExporter::appendStageLatency( std::string & output, const std::map<std::string, LatencyHistogramSnapshot> & stageLatencies )
+{
+    if ( stageLatencies.empty() )
+    {
+        return; // Tracing is not active
+    }
+
+    std::string name = "stage_latency";
+    std::string help = "Time a message spent in a stage of the pipeline.";
+
+    appendHeader( output, name + "_seconds", "histogram", help );
+
+    for ( std::pair<const std::string, LatencyHistogramSnapshot> const & entry : stageLatencies )
+    {
+        appendHistogramSamples( output, name, "stage=\"" + escapeLabelValue( entry.first ) + "\"", entry.second );
+    }
+
+    appendHeader( output, name + "_percentile_seconds", "gauge", help + " Percentiles since start." );
+
+    for ( std::pair<const std::string, LatencyHistogramSnapshot> const & entry : stageLatencies )
+    {
+        appendPercentileSamples( output, name, "stage=\"" + escapeLabelValue( entry.first ) + "\"", entry.second );
+    }
+}
+
+void PrometheusExporter::appendHistogramSamples( std::string & output, std::string name, const std::string & labels, const LatencyHistogramSnapshot & latency )
+{
+    char bound[32];
+
+    for ( double bucket : LATENCY_BUCKETS )
+    {
+        snprintf( bound, sizeof( bound ), "%g", bucket );
+        unsigned long long bucketMicroseconds = static_cast<unsigned long long>( bucket * 1e6 + 0.5 );
+        appendSample( output, name + "_seconds_bucket", labels + ",le=\"" + bound + "\"", latency.getCountAtOrBelow( bucketMicroseconds ) );
+    }
+
+    appendSample( output, name + "_seconds_bucket", labels + ",le=\"+Inf\"", latency.getCount() );
+    appendSample( output, name + "_seconds_sum", labels, latency.getSum() / 1e6 );
+    appendSample( output, name + "_seconds_count", labels, latency.getCount() );
+}
+
+void PrometheusExporter::appendPercentileSamples( std::string & output, std::string name, const std::string & labels, const LatencyHistogramSnapshot & latency )
+{
+    char quantile[32];
+
+    for ( double percentile : LATENCY_PERCENTILES )
+    {
+        snprintf( quantile, sizeof( quantile ), "%g", percentile / 100 );
+        appendSample( output, name + "_percentile_seconds", labels + ",quantile=\"" + quantile + "\"", latency.getPercentile( percentile ) / 1e6 );
+    }
+}
+
+std::string PrometheusExporter::getDeviceLabels( const DeviceMetricsSnapshot & device )
+{
+    return "device=\"" + escapeLabelValue( device.deviceId ) + "\",port=\"" + escapeLabelValue( device.port ) + "\"";
+}
+
+std::string PrometheusExporter::escapeLabelValue( std::string value )
+{
+    std::string escaped;
+    escaped.reserve( value.length() );
+
+    for ( char character : value )
+    {
+        switch ( character )
+        {
+            case '\\':
+                escaped.append( "\\\\" );
+                break;
+            case '"':
+                escaped.append( "\\\"" );
+                break;
+            case '\n':
+                escaped.append( "\\n" );
+                break;
+            default:
+                escaped.push_back( character );
+        }
+    }
+
+    return escaped;
+}
+
+std::string PrometheusExporter::render( const GatewayMetricsSnapshot & snapshot )
+{
+    const std::map<std::string, DeviceMetricsSnapshot> & devices = snapshot.devices;
+    std::string output;
+    output.reserve( 4096 + devices.size() * 8192 );
+
+    appendDeviceMetric( output, "device_connected", "gauge", "Whether the device is currently connected (1) or not (0).", devices, &DeviceMetricsSnapshot::connected );
+    appendDeviceMetric( output, "received_bytes_total", "counter", "Bytes received from the device.", devices, &DeviceMetricsSnapshot::bytesReceived );
+    appendDeviceMetric( output, "received_lines_total", "counter", "Lines received from the device.", devices, &DeviceMetricsSnapshot::linesReceived );
+    appendDeviceMetric( output, "sent_bytes_total", "counter", "Bytes written to the device.", devices, &DeviceMetricsSnapshot::bytesSent );
+    appendDeviceMetric( output, "sent_lines_total", "counter", "Messages completely written to the device.", devices, &DeviceMetricsSnapshot::linesSent );
+    appendDeviceMetric( output, "parse_failures_total", "counter", "Malformed messages and schema mismatches.", devices, &DeviceMetricsSnapshot::parseFailures );
+    appendDeviceMetric( output, "short_writes_total", "counter", "Writes which didn't write the whole message.", devices, &DeviceMetricsSnapshot::shortWrites );
+    appendDeviceMetric( output, "reconnects_total", "counter", "How often the device has been added again after it got deleted.", devices, &DeviceMetricsSnapshot::reconnects );
+    appendDeviceMetric( output, "inflight_callbacks", "gauge", "Messages read which haven't finished their callback yet.", devices, &DeviceMetricsSnapshot::inFlightCallbacks );
+    appendDeviceMetric( output, "pending_sends", "gauge", "Messages waiting to be written to the device.", devices, &DeviceMetricsSnapshot::pendingSends );
+    appendDeviceMetric( output, "inbound_queued", "gauge", "Messages waiting in the device's inbound queue.", devices, &DeviceMetricsSnapshot::inboundQueued );
+    appendDeviceMetric( output, "inbound_dropped_total", "counter", "Messages dropped, because the inbound queue was full.", devices, &DeviceMetricsSnapshot::inboundDropped );
+    appendDeviceMetric( output, "inbound_conflated_total", "counter", "Messages replaced by a newer one of the same type, while waiting in the inbound queue.", devices, &DeviceMetricsSnapshot::inboundConflated );
+    appendDeviceMetric( output, "slow_callbacks_total", "counter", "Callbacks which took longer than the callback budget.", devices, &DeviceMetricsSnapshot::slowCallbacks );
+    appendDeviceMetric( output, "device_isolated", "gauge", "Whether the device's callbacks run on the isolated lane (1) or not (0).", devices, &DeviceMetricsSnapshot::isolated );
+    appendDeviceMetric( output, "outbound_buffered", "gauge", "Messages buffered while the device is absent.", devices, &DeviceMetricsSnapshot::outboundBuffered );
+    appendDeviceMetric( output, "outbound_dropped_total", "counter", "Buffered messages dropped, because the outbound buffer was full.", devices, &DeviceMetricsSnapshot::outboundDropped );
+    appendDeviceMetric( output, "outbound_expired_total", "counter", "Buffered messages dropped, because they waited longer than the TTL.", devices, &DeviceMetricsSnapshot::outboundExpired );
+    appendDeviceMetric( output, "outbound_forwarded_total", "counter", "Buffered messages written to the device after it came back.", devices, &DeviceMetricsSnapshot::outboundForwarded );
+    appendDeviceMetric( output, "rx_overruns_total", "counter", "Bytes the UART lost, because its FIFO wasn't emptied in time; Only for ports whose driver counts them.", devices, &DeviceMetricsSnapshot::rxOverruns );
+    appendDeviceMetric( output, "rx_buffer_overruns_total", "counter", "Bytes the tty lost, because its buffer was full; Only for ports whose driver counts them.", devices, &DeviceMetricsSnapshot::rxBufferOverruns );
+    appendDeviceMetric( output, "framing_errors_total", "counter", "Bytes received with a framing error; Only for ports whose driver counts them.", devices, &DeviceMetricsSnapshot::framingErrors );
+    appendDeviceMetric( output, "parity_errors_total", "counter", "Bytes received with a parity error; Only for ports whose driver counts them.", devices, &DeviceMetricsSnapshot::parityErrors );
+    appendLatency( output, "read_to_callback_latency", "Time from reading a line until its callback started.", devices, &DeviceMetricsSnapshot::readToCallbackLatency );
+    appendLatency( output, "send_latency", "Time from handing a message over for sending until it has been written.", devices, &DeviceMetricsSnapshot::sendLatency );
+    appendLatency( output, "callback_time", "Time the message callbacks took.", devices, &DeviceMetricsSnapshot::callbackTime );
+    appendStageLatency( output, snapshot.stageLatencies );
+
+    appendHeader( output, "schema_mismatches_total", "counter", "Messages which didn't match the schema of their type." );
+    appendSample( output, "schema_mismatches_total", "", snapshot.schemaMismatchCount );
+    appendHeader( output, "dropped_log_messages_total", "counter", "Log messages dropped by the async logger, because its buffer was full." );
+    appendSample( output, "dropped_log_messages_total", "", snapshot.droppedLogCount );
+    appendHeader( output, "isolated_queue_depth", "gauge", "Callbacks waiting for a worker of the isolated lane." );
+    appendSample( output, "isolated_queue_depth", "", snapshot.isolatedQueueDepth );
+
+    return output;
+}
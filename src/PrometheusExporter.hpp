@@ -0,0 +1,242 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef PROMETHEUSEXPORTER_HPP
+#define PROMETHEUSEXPORTER_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic_bool
+#include <string>
+#include <vector>
+#include <functional> // std::function
+#include <thread> // std::thread
+
+#include "GatewayMetrics.hpp"
+#include "../dependencies/Exception/src/Exception.hpp"
+
+/**
+ * PrometheusExporter class
+ * File: PrometheusExporter.hpp
+ * Purpose: Defines a minimal HTTP server which serves the gateway's metrics in the Prometheus text format (version 0.0.4).
+ *          It listens on a Unix domain socket and/or on 127.0.0.1:<port> (never on a public interface).
+ *          Every scrape renders a fresh metrics snapshot; Taking the snapshot only reads the per-thread counters,
+ *          so scrapes never block reading from or writing to devices. Scrapes are served one after another by a single background thread.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class PrometheusExporter
+{
+public:
+    // Types
+    typedef std::function<GatewayMetricsSnapshot()> SnapshotProvider;
+
+private:
+    // Constants
+    static const std::string METRIC_PREFIX;
+    static const std::string CONTENT_TYPE;
+    static const unsigned int POLL_INTERVAL = 250; // ms; How often the background thread checks whether it got stopped
+    static const unsigned int REQUEST_TIMEOUT = 1000; // ms; A client has this long to send its request
+    static const std::size_t MAX_REQUEST_SIZE = 8192; // Bytes
+    static const std::vector<double> LATENCY_BUCKETS; // Upper bounds of the exported histogram buckets, in seconds
+    static const std::vector<double> LATENCY_PERCENTILES;
+
+    // Variables
+    SnapshotProvider snapshotProvider;
+    std::string unixSocketPath;
+    unsigned int port;
+    int unixSocketDescriptor;
+    int tcpSocketDescriptor;
+    std::atomic_bool started;
+    std::thread serverThread;
+
+    // Methods
+    /**
+     * Creates and binds the listening Unix domain socket.
+     *
+     * @return Socket descriptor.
+    */
+    int openUnixSocket();
+
+    /**
+     * Creates and binds the listening TCP socket on 127.0.0.1.
+     *
+     * @return Socket descriptor.
+    */
+    int openTcpSocket();
+
+    /**
+     * Closes all listening sockets (and removes the Unix domain socket file).
+    */
+    void closeSockets();
+
+    /**
+     * Loop of the background thread; Accepts and serves connections until the exporter is stopped.
+    */
+    void serveLoop();
+
+    /**
+     * Reads the request of a client, and answers it.
+     *
+     * @param clientDescriptor Socket descriptor of the client. Gets closed afterwards.
+    */
+    void serveClient( int clientDescriptor );
+
+    /**
+     * Writes a complete response to a client.
+     *
+     * @param clientDescriptor Socket descriptor of the client.
+     * @param status HTTP status line, e.g. "200 OK".
+     * @param contentType Content type of the body.
+     * @param body Body of the response.
+    */
+    static void writeResponse( int clientDescriptor, std::string status, std::string contentType, const std::string & body );
+
+    /**
+     * Appends the HELP and TYPE lines of a metric.
+     *
+     * @param output Output to append to.
+     * @param name Name of the metric (without prefix).
+     * @param type Prometheus type (counter, gauge, histogram).
+     * @param help Description of the metric.
+    */
+    static void appendHeader( std::string & output, std::string name, std::string type, std::string help );
+
+    /**
+     * Appends a single sample line.
+     *
+     * @param output Output to append to.
+     * @param name Name of the metric (without prefix, but with suffixes like "_bucket").
+     * @param labels Rendered labels, without braces. May be empty.
+     * @param value Value of the sample.
+    */
+    static void appendSample( std::string & output, std::string name, const std::string & labels, double value );
+
+    /**
+     * Appends a metric with one sample per device.
+     *
+     * @param output Output to append to.
+     * @param name Name of the metric (without prefix).
+     * @param type Prometheus type (counter, gauge).
+     * @param help Description of the metric.
+     * @param devices Snapshots of all devices.
+     * @param member Member of DeviceMetricsSnapshot to be exported.
+    */
+    template<typename T>
+    static void appendDeviceMetric( std::string & output, std::string name, std::string type, std::string help, const std::map<std::string, DeviceMetricsSnapshot> & devices, T DeviceMetricsSnapshot::* member );
+
+    /**
+     * Appends a latency histogram as Prometheus histogram (in seconds), and its percentiles as separate gauge.
+     *
+     * @param output Output to append to.
+     * @param name Name of the metric (without prefix).
+     * @param help Description of the metric.
+     * @param devices Snapshots of all devices.
+     * @param histogram Member of DeviceMetricsSnapshot to be exported.
+    */
+    static void appendLatency( std::string & output, std::string name, std::string help, const std::map<std::string, DeviceMetricsSnapshot> & devices, LatencyHistogramSnapshot DeviceMetricsSnapshot::* histogram );
+
+    /**
+     * Appends the per-stage latencies of the stage tracer as Prometheus histogram (in seconds), and their percentiles as separate gauge.
+     * Nothing gets appended if tracing is not active.
+     *
+     * @param output Output to append to.
+     * @param stageLatencies Mapping between stage names and histograms.
+    */
+    static void appendStageLatency( std::string & output, const std::map<std::string, LatencyHistogramSnapshot> & stageLatencies );
+
+    /**
+     * Appends the bucket, sum and count samples of a single latency histogram.
+     *
+     * @param output Output to append to.
+     * @param name Name of the metric (without prefix and "_seconds").
+     * @param labels Rendered labels, without braces.
+     * @param latency Histogram to be exported.
+    */
+    static void appendHistogramSamples( std::string & output, std::string name, const std::string & labels, const LatencyHistogramSnapshot & latency );
+
+    /**
+     * Appends the percentile samples of a single latency histogram.
+     *
+     * @param output Output to append to.
+     * @param name Name of the metric (without prefix and "_percentile_seconds").
+     * @param labels Rendered labels, without braces.
+     * @param latency Histogram to be exported.
+    */
+    static void appendPercentileSamples( std::string & output, std::string name, const std::string & labels, const LatencyHistogramSnapshot & latency );
+
+    /**
+     * Renders the labels identifying a device.
+     *
+     * @param device Snapshot of the device.
+     * @return Labels, without braces.
+    */
+    static std::string getDeviceLabels( const DeviceMetricsSnapshot & device );
+
+    /**
+     * Escapes a label value (backslash, double-quote and newline).
+     *
+     * @param value Value to escape.
+     * @return Escaped value.
+    */
+    static std::string escapeLabelValue( std::string value );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param snapshotProvider Function which takes a metrics snapshot; Called once per scrape, from the exporter's thread.
+     * @param unixSocketPath Path of the Unix domain socket to listen on, or empty.
+     * @param port TCP port to listen on (127.0.0.1 only), or 0.
+    */
+    PrometheusExporter( SnapshotProvider snapshotProvider, std::string unixSocketPath, unsigned int port );
+
+    // Destructors
+    /**
+     * Destructor; stops the exporter.
+    */
+    ~PrometheusExporter();
+
+    // Methods
+    /**
+     * Opens the listening socket(s) and starts serving scrapes in a background thread.
+     * Throws an Exception if a socket can't be opened.
+    */
+    void start();
+
+    /**
+     * Stops serving scrapes, and closes the listening socket(s).
+    */
+    void stop();
+
+    /**
+     * Gets whether the exporter is started.
+     *
+     * @return Whether the exporter is started or not.
+    */
+    bool isStarted();
+
+    /**
+     * Renders a metrics snapshot in the Prometheus text format.
+     *
+     * @param snapshot Snapshot to render.
+     * @return Rendered metrics.
+    */
+    static std::string render( const GatewayMetricsSnapshot & snapshot );
+};
+
+#endif // PROMETHEUSEXPORTER_HPP
@@ -33,6 +33,12 @@ SerialDevice::SerialDevice(
     setParity( parity );
     setStopBits( stopBits );
     setFlowControl( flowControl );
+    setResetControl( ResetControl::RESET_ON_OPEN );
+    this->escalationBaudRate = 0;
+
+    LatencyProfile latencyProfile; // Leaves the port as it is
+    latencyProfile.readTimeout = timeout.read_timeout_constant;
+    setLatencyProfile( latencyProfile );
 }
 
 SerialDevice::~SerialDevice()
@@ -107,7 +113,14 @@ SerialDevice::StopBitsEnum SerialDevice::getStopBits()
 
 void SerialDevice::setFlowControl( FlowControlEnum flowControl )
 {
+    bool changed = getInstance() != nullptr && this->flowControl != flowControl;
     this->flowControl = flowControl;
+
+    // Applied to the open transport right away; Reopening it would reset many boards
+    if ( changed )
+    {
+        getInstance()->setLineSettings( getSerialParameters() );
+    }
 }
 
 SerialDevice::FlowControlEnum SerialDevice::getFlowControl()
@@ -115,6 +128,67 @@ SerialDevice::FlowControlEnum SerialDevice::getFlowControl()
     return this->flowControl;
 }
 
+void SerialDevice::setResetControl( ResetControl resetControl )
+{
+    this->resetControl = resetControl;
+}
+
+ResetControl SerialDevice::getResetControl()
+{
+    return this->resetControl;
+}
+
+void SerialDevice::setLatencyProfile( LatencyProfile latencyProfile )
+{
+    this->latencyProfile = latencyProfile;
+}
+
+LatencyProfile SerialDevice::getLatencyProfile()
+{
+    return this->latencyProfile;
+}
+
+void SerialDevice::setSerialParameters( SerialParameters serialParameters )
+{
+    setBaudRate( serialParameters.baudRate );
+    setByteSize( serialParameters.byteSize );
+    setParity( serialParameters.parity );
+    setStopBits( serialParameters.stopBits );
+    this->flowControl = serialParameters.flowControl; // Not via "setFlowControl"; The caller passes the line settings to the transport itself
+    this->escalationBaudRate = serialParameters.escalationBaudRate;
+}
+
+SerialParameters SerialDevice::getSerialParameters()
+{
+    SerialParameters serialParameters;
+    serialParameters.baudRate = getBaudRate();
+    serialParameters.byteSize = getByteSize();
+    serialParameters.parity = getParity();
+    serialParameters.stopBits = getStopBits();
+    serialParameters.flowControl = getFlowControl();
+    serialParameters.escalationBaudRate = this->escalationBaudRate;
+
+    return serialParameters;
+}
+
+ResetControl SerialDevice::parseResetControl( std::string name )
+{
+    if ( name == "reset" )
+    {
+        return ResetControl::RESET_ON_OPEN;
+    }
+    else if ( name == "hold" )
+    {
+        return ResetControl::HOLD_LINES;
+    }
+    else if ( name == "release" )
+    {
+        return ResetControl::RELEASE_LINES;
+    }
+
+    throw std::invalid_argument( "Unknown reset control \"" + name + "\". (Allowed: reset, hold, release)" );
+}
+
 void SerialDevice::setId( std::string id )
 {
     // if ( id.empty() )
@@ -130,7 +204,7 @@ std::string SerialDevice::getId()
     return this->id;
 }
 
-void SerialDevice::init()
+void SerialDevice::init( SerialTransportFactory * transportFactory )
 {
     // Only initialize if there is no instance present yet.
     if ( getInstance() != nullptr )
@@ -138,8 +212,8 @@ void SerialDevice::init()
         return;
     }
 
-    // Create a new Serial instance in conjunction with a smart pointer, and share the ownership with the SerialDevice afterwards.
-    SerialInstance instance = std::make_shared<Serial>( getPort(), getBaudRate(), getTimeout(), getByteSize(), getParity(), getStopBits(), getFlowControl() );
+    // Open a new transport (a smart pointer), and share the ownership with the SerialDevice afterwards.
+    SerialInstance instance = transportFactory->openTransport( * this );
     setInstance( instance );
 }
 
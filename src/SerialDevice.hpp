@@ -21,15 +21,19 @@
 #include <string>
 #include <memory>
 #include <exception>
+#include <stdexcept> // std::invalid_argument
 
 // wjwwood's serial Library (https://github.com/wjwwood/serial)
 #include "serial/serial.h"
 
+#include "SerialTransport.hpp"
+
 /**
  * SerialDevice class
  * File: SerialDevice.hpp
  * Purpose: Defines a container class which makes interacting between wjwwood's serial Library and the SerialPortGateway more easy and consistent.
- *          Also serves as a wrapper/interface, because the serial implementation is planned to be replaced in the near future by an own implementation.
+ *          Also serves as a wrapper/interface, because the serial implementation is planned to be replaced in the near future by an own implementation;
+ *          The communication goes through a SerialTransport, which gets opened by a SerialTransportFactory.
  *
  * @author Jan-Eric Schober
  * @version 1.0, 20.01.2019
@@ -43,8 +47,7 @@ public:
     typedef serial::parity_t ParityEnum;
     typedef serial::stopbits_t StopBitsEnum;
     typedef serial::flowcontrol_t FlowControlEnum;
-    typedef serial::Serial Serial;
-    typedef std::shared_ptr<Serial> SerialInstance;
+    typedef SerialTransportFactory::SerialTransportPointer SerialInstance;
 
 private:
     // Constants
@@ -59,6 +62,9 @@ private:
     ParityEnum parity;
     StopBitsEnum stopBits;
     FlowControlEnum flowControl;
+    ResetControl resetControl;
+    LatencyProfile latencyProfile;
+    unsigned int escalationBaudRate;
     std::string id;
     SerialInstance instance;
 
@@ -66,7 +72,7 @@ private:
     /**
      * Sets the SerialInstance to be used by/with the SerialDevice.
      *
-     * @param instance Instance to be set as the SerialDevice's serial communication interface of type SerialInstance (std::shared_ptr<Serial>).
+     * @param instance Instance to be set as the SerialDevice's serial communication interface of type SerialInstance (std::shared_ptr<SerialTransport>).
      * @return void
     */
     void setInstance( SerialInstance instance );
@@ -186,7 +192,8 @@ public:
     StopBitsEnum getStopBits();
 
     /**
-     * Sets the flow control configuration to be used for the connection.
+     * Sets the flow control configuration to be used for the connection; Applied to the transport right away if it is open, otherwise when the device gets initialized.
+     * Throws one of the serial Library's exceptions if the open port doesn't accept it. Whether the driver actually supports it can be checked via "SerialTransport::getFlowControl".
      *
      * @param flowControl Flow control configuration to be set.
     */
@@ -199,6 +206,57 @@ public:
     */
     FlowControlEnum getFlowControl();
 
+    /**
+     * Sets how the modem lines get treated when the port gets opened and closed; Takes effect the next time the device gets initialized.
+     *
+     * @param resetControl Reset control to be set.
+    */
+    void setResetControl( ResetControl resetControl );
+
+    /**
+     * Gets the reset control currently set.
+     *
+     * @return Current reset control.
+    */
+    ResetControl getResetControl();
+
+    /**
+     * Parses the name of a reset control. Throws std::invalid_argument if the name is unknown.
+     *
+     * @param name "reset", "hold" or "release".
+     * @return Reset control.
+    */
+    static ResetControl parseResetControl( std::string name );
+
+    /**
+     * Sets how the port gets tuned for latency; Takes effect the next time the device gets initialized. The read timeout is set via "setTimeout".
+     *
+     * @param latencyProfile Latency profile to be set.
+    */
+    void setLatencyProfile( LatencyProfile latencyProfile );
+
+    /**
+     * Gets the latency profile currently set.
+     *
+     * @return Current latency profile.
+    */
+    LatencyProfile getLatencyProfile();
+
+    /**
+     * Sets all line settings at once, and the baud rate the device gets asked to switch to; The line settings take effect the next time the device gets initialized,
+     * or when they get passed to the transport (See "SerialTransport::setLineSettings").
+     *
+     * @param serialParameters Serial parameters to be set.
+    */
+    void setSerialParameters( SerialParameters serialParameters );
+
+    /**
+     * Gets all line settings currently set, and the baud rate the device gets asked to switch to.
+     *
+     * @return Current serial parameters.
+    */
+    SerialParameters getSerialParameters();
+
     /**
      * Sets the ID of the serial device.
      *
@@ -215,8 +273,10 @@ public:
 
     /**
      * Initializes a serial instance if getInstance() == nullptr.
+     *
+     * @param transportFactory Factory which opens the transport to the port.
     */
-    void init();
+    void init( SerialTransportFactory * transportFactory );
 
     /**
      * Gets the SerialInstance currently set.
@@ -0,0 +1,467 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "SerialLibraryTransport.hpp"
+#include "SerialDevice.hpp"
+
+// C Standard Libraries
+#include <stdlib.h> // realpath
+#include <fcntl.h> // open
+#include <unistd.h> // close
+#include <poll.h> // poll
+#include <sys/eventfd.h> // eventfd, eventfd_read, eventfd_write
+#include <termios.h> // tcgetattr, tcsetattr, HUPCL, VMIN, VTIME, CRTSCTS, IXON, IXOFF
+#include <sys/ioctl.h> // ioctl, TIOCMBIC, TIOCGSERIAL, TIOCSSERIAL, TIOCGICOUNT
+#include <linux/serial.h> // serial_struct, serial_icounter_struct, ASYNC_LOW_LATENCY
+#include <climits> // PATH_MAX, INT_MAX
+#include <cerrno>
+
+// C++ Standard Libraries
+#include <fstream> // std::ofstream
+
+SerialLibraryTransport::SerialLibraryTransport(
+    std::string port,
+    unsigned int baudRate,
+    serial::Timeout timeout,
+    serial::bytesize_t byteSize,
+    serial::parity_t parity,
+    serial::stopbits_t stopBits,
+    serial::flowcontrol_t flowControl,
+    ResetControl resetControl,
+    LatencyProfile latencyProfile
+) : serial( "", baudRate, timeout, byteSize, parity, stopBits, flowControl )
+{
+    this->resetDevice = true;
+    this->latencyProfile.readTimeout = latencyProfile.readTimeout;
+    this->flowControl = serial::flowcontrol_none;
+    this->ttyFd = -1;
+    this->ttyFdOpened = false;
+    this->wakeFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    this->closed = false;
+    this->lineErrorCountersSupported = true;
+    serial.setPort( port );
+
+    if ( wakeFd < 0 )
+    {
+        throw serial::IOException( __FILE__, __LINE__, errno );
+    }
+
+    if ( resetControl == ResetControl::RESET_ON_OPEN && !latencyProfile.needsTtyConfiguration() && flowControl == serial::flowcontrol_none )
+    {
+        try
+        {
+            serial.open();
+        }
+        catch ( ... )
+        {
+            ::close( wakeFd );
+
+            throw;
+        }
+
+        applyLatencyTimer( port, latencyProfile.latencyTimer );
+
+        return;
+    }
+
+    int fd = ::open( port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+    if ( fd < 0 )
+    {
+        ::close( wakeFd );
+
+        throw serial::IOException( __FILE__, __LINE__, errno );
+    }
+
+    try
+    {
+        if ( resetControl != ResetControl::RESET_ON_OPEN )
+        {
+            holdModemLines( fd );
+        }
+
+        serial.open();
+
+        // After the serial Library's open as well, since it configures the tty itself
+        applyFlowControl( fd, flowControl );
+
+        // After the serial Library's open, since the driver asserts the lines on every open
+        if ( resetControl == ResetControl::RELEASE_LINES )
+        {
+            releaseModemLines( fd );
+        }
+
+        applyTtyLatency( fd, latencyProfile );
+    }
+    catch ( ... )
+    {
+        ::close( fd );
+        ::close( wakeFd );
+
+        if ( serial.isOpen() )
+        {
+            serial.close();
+        }
+
+        throw;
+    }
+
+    ::close( fd ); // Not the last descriptor of the tty, so this doesn't hang up
+    applyLatencyTimer( port, latencyProfile.latencyTimer );
+}
+
+SerialLibraryTransport::~SerialLibraryTransport()
+{
+    if ( !closed && ttyFd >= 0 )
+    {
+        ::close( ttyFd );
+    }
+
+    ::close( wakeFd );
+}
+
+void SerialLibraryTransport::holdModemLines( int fd )
+{
+    termios settings;
+
+    if ( tcgetattr( fd, &settings ) != 0 )
+    {
+        throw serial::IOException( __FILE__, __LINE__, errno );
+    }
+
+    // Cleared means the lines stayed as they were since the port got closed the last time, so opening it didn't produce an edge
+    this->resetDevice = ( settings.c_cflag & HUPCL ) != 0;
+    settings.c_cflag &= ~HUPCL;
+
+    if ( tcsetattr( fd, TCSANOW, &settings ) != 0 )
+    {
+        throw serial::IOException( __FILE__, __LINE__, errno );
+    }
+}
+
+void SerialLibraryTransport::releaseModemLines( int fd )
+{
+    int lines = this->flowControl == serial::flowcontrol_hardware ? TIOCM_DTR : TIOCM_DTR | TIOCM_RTS;
+
+    if ( ioctl( fd, TIOCMBIC, &lines ) != 0 && errno != ENOTTY ) // Ptys have no modem lines
+    {
+        throw serial::IOException( __FILE__, __LINE__, errno );
+    }
+}
+
+void SerialLibraryTransport::applyFlowControl( int fd, serial::flowcontrol_t requested )
+{
+    termios settings;
+    this->flowControl = requested; // Unless the tty tells otherwise
+
+    if ( requested == serial::flowcontrol_none || tcgetattr( fd, &settings ) != 0 )
+    {
+        return;
+    }
+
+    if ( requested == serial::flowcontrol_software )
+    {
+        settings.c_cc[VSTART] = 0x11; // DC1
+        settings.c_cc[VSTOP] = 0x13; // DC3
+        settings.c_iflag &= ~IXANY;
+
+        if ( tcsetattr( fd, TCSANOW, &settings ) != 0 || tcgetattr( fd, &settings ) != 0 )
+        {
+            return;
+        }
+    }
+
+    bool kept = requested == serial::flowcontrol_hardware ? ( settings.c_cflag & CRTSCTS ) != 0 : ( settings.c_iflag & ( IXON | IXOFF ) ) == ( IXON | IXOFF );
+
+    if ( !kept )
+    {
+        this->flowControl = serial::flowcontrol_none;
+    }
+}
+
+void SerialLibraryTransport::applyTtyLatency( int fd, const LatencyProfile & requested )
+{
+    termios settings;
+
+    if ( ( requested.vmin >= 0 || requested.vtime >= 0 ) && tcgetattr( fd, &settings ) == 0 )
+    {
+        if ( requested.vmin >= 0 )
+        {
+            settings.c_cc[VMIN] = static_cast<cc_t>( requested.vmin );
+        }
+
+        if ( requested.vtime >= 0 )
+        {
+            settings.c_cc[VTIME] = static_cast<cc_t>( requested.vtime );
+        }
+
+        if ( tcsetattr( fd, TCSANOW, &settings ) == 0 )
+        {
+            this->latencyProfile.vmin = requested.vmin;
+            this->latencyProfile.vtime = requested.vtime;
+        }
+    }
+
+    serial_struct serialInfo;
+
+    // Not supported by every driver (e.g. ptys and most USB CDC ACM devices)
+    if ( requested.lowLatency && ioctl( fd, TIOCGSERIAL, &serialInfo ) == 0 )
+    {
+        serialInfo.flags |= ASYNC_LOW_LATENCY;
+
+        if ( ioctl( fd, TIOCSSERIAL, &serialInfo ) == 0 )
+        {
+            this->latencyProfile.lowLatency = true;
+        }
+    }
+}
+
+void SerialLibraryTransport::applyLatencyTimer( std::string port, unsigned int latencyTimer )
+{
+    char devicePath[PATH_MAX];
+
+    // The port may be a link, e.g. /dev/serial/by-id/...; sysfs knows the tty by its name
+    if ( latencyTimer == 0 || realpath( port.c_str(), devicePath ) == nullptr )
+    {
+        return;
+    }
+
+    std::string deviceName = devicePath;
+    deviceName = deviceName.substr( deviceName.find_last_of( '/' ) + 1 );
+
+    // Only FTDI chips have it
+    std::ofstream latencyTimerFile( "/sys/class/tty/" + deviceName + "/device/latency_timer" );
+    latencyTimerFile << latencyTimer;
+    latencyTimerFile.close();
+
+    if ( latencyTimerFile.good() )
+    {
+        this->latencyProfile.latencyTimer = latencyTimer;
+    }
+}
+
+int SerialLibraryTransport::getTtyFd()
+{
+    // Opening the tty again after it got closed would assert the modem lines, and reset the device
+    if ( !ttyFdOpened && !closed )
+    {
+        ttyFd = ::open( serial.getPort().c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC );
+        ttyFdOpened = true;
+    }
+
+    return closed ? -1 : ttyFd;
+}
+
+void SerialLibraryTransport::readline( std::string & line )
+{
+    line.clear();
+
+    // The serial Library throws once its port got closed; The caller gets woken up instead, like by interruptRead
+    if ( closed )
+    {
+        return;
+    }
+
+    int fd;
+
+    {
+        std::lock_guard<std::mutex> lock( ttyFdMutex );
+        fd = getTtyFd();
+    }
+
+    if ( fd >= 0 )
+    {
+        std::uint32_t readTimeout = serial.getTimeout().read_timeout_constant;
+        pollfd pollFds[2] = { { fd, POLLIN, 0 }, { wakeFd, POLLIN, 0 } };
+        int ready = ::poll( pollFds, 2, readTimeout > INT_MAX ? -1 : static_cast<int>( readTimeout ) );
+
+        if ( ready == 0 )
+        {
+            return; // Nothing arrived within the read timeout
+        }
+
+        if ( ready > 0 && ( pollFds[1].revents & POLLIN ) != 0 )
+        {
+            // Once closed, it stays signalled, so a read which got the descriptor before it got closed doesn't wait on it
+            if ( !closed )
+            {
+                eventfd_t count;
+                eventfd_read( wakeFd, &count );
+            }
+
+            return;
+        }
+
+        // Readable, hung up, or interrupted by a signal; The serial Library reads (or reports the error) as usual
+    }
+
+    // Closed while polling; It may still get closed while reading, which the serial Library reports by throwing
+    if ( closed )
+    {
+        return;
+    }
+
+    serial.readline( line ); // Appends to the (cleared) buffer
+}
+
+void SerialLibraryTransport::interruptRead()
+{
+    eventfd_write( wakeFd, 1 );
+}
+
+std::size_t SerialLibraryTransport::write( const std::string & data )
+{
+    return serial.write( data );
+}
+
+void SerialLibraryTransport::flush()
+{
+    serial.flush();
+}
+
+void SerialLibraryTransport::setTimeout( serial::Timeout timeout )
+{
+    serial.setTimeout( timeout );
+}
+
+void SerialLibraryTransport::setLineSettings( const SerialParameters & serialParameters )
+{
+    serial.setBaudrate( serialParameters.baudRate );
+    serial.setBytesize( serialParameters.byteSize );
+    serial.setParity( serialParameters.parity );
+    serial.setStopbits( serialParameters.stopBits );
+    serial.setFlowcontrol( serialParameters.flowControl );
+    this->flowControl = serialParameters.flowControl;
+
+    // The serial Library resets VMIN/VTIME whenever it reconfigures the port, and doesn't complete the flow control
+    bool reapplyTtyLatency = latencyProfile.vmin >= 0 || latencyProfile.vtime >= 0;
+    LatencyProfile requested = latencyProfile;
+
+    if ( !reapplyTtyLatency && serialParameters.flowControl == serial::flowcontrol_none )
+    {
+        return;
+    }
+
+    latencyProfile.vmin = -1;
+    latencyProfile.vtime = -1;
+
+    int fd = ::open( serial.getPort().c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+    if ( fd >= 0 )
+    {
+        applyFlowControl( fd, serialParameters.flowControl );
+
+        if ( reapplyTtyLatency )
+        {
+            applyTtyLatency( fd, requested );
+        }
+
+        ::close( fd );
+    }
+}
+
+bool SerialLibraryTransport::hasResetDevice()
+{
+    return this->resetDevice;
+}
+
+LatencyProfile SerialLibraryTransport::getLatencyProfile()
+{
+    return this->latencyProfile;
+}
+
+serial::flowcontrol_t SerialLibraryTransport::getFlowControl()
+{
+    return this->flowControl;
+}
+
+bool SerialLibraryTransport::getLineErrorCounters( LineErrorCounters & counters )
+{
+    std::lock_guard<std::mutex> lock( ttyFdMutex );
+    int fd = getTtyFd();
+
+    if ( !lineErrorCountersSupported || fd < 0 )
+    {
+        return false;
+    }
+
+    serial_icounter_struct icount;
+
+    if ( ioctl( fd, TIOCGICOUNT, &icount ) != 0 )
+    {
+        // Drivers without counters (e.g. ptys) won't get any
+        if ( errno == EINVAL || errno == ENOTTY )
+        {
+            lineErrorCountersSupported = false;
+        }
+
+        return false;
+    }
+
+    counters.overruns = icount.overrun;
+    counters.bufferOverruns = icount.buf_overrun;
+    counters.framingErrors = icount.frame;
+    counters.parityErrors = icount.parity;
+
+    return true;
+}
+
+void SerialLibraryTransport::close()
+{
+    std::lock_guard<std::mutex> lock( ttyFdMutex );
+
+    if ( closed )
+    {
+        return;
+    }
+
+    // Wakes up a waiting read before its descriptor gets closed
+    closed = true;
+    interruptRead();
+
+    // First, so the serial Library's descriptor is the last one, and closing it hangs up as usual
+    if ( ttyFd >= 0 )
+    {
+        ::close( ttyFd );
+    }
+
+    serial.close();
+}
+
+std::vector<serial::PortInfo> SerialLibraryTransportFactory::listPorts()
+{
+    return serial::list_ports();
+}
+
+bool SerialLibraryTransportFactory::hasPort( std::string port )
+{
+    return static_cast<bool>( std::ifstream( port ) );
+}
+
+SerialTransportFactory::SerialTransportPointer SerialLibraryTransportFactory::openTransport( SerialDevice & serialDevice )
+{
+    return std::make_shared<SerialLibraryTransport>(
+        serialDevice.getPort(),
+        serialDevice.getBaudRate(),
+        serialDevice.getTimeout(),
+        serialDevice.getByteSize(),
+        serialDevice.getParity(),
+        serialDevice.getStopBits(),
+        serialDevice.getFlowControl(),
+        serialDevice.getResetControl(),
+        serialDevice.getLatencyProfile()
+    );
+}
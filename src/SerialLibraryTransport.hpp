@@ -0,0 +1,173 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef SERIALLIBRARYTRANSPORT_HPP
+#define SERIALLIBRARYTRANSPORT_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic> // std::atomic_bool
+#include <mutex> // std::mutex, std::lock_guard
+#include <fstream> // std::ifstream
+
+// wjwwood's serial Library (https://github.com/wjwwood/serial)
+#include "serial/serial.h"
+
+#include "SerialTransport.hpp"
+
+/**
+ * SerialLibraryTransport class
+ * File: SerialLibraryTransport.hpp
+ * Purpose: Defines a transport which talks to a tty via wjwwood's serial Library.
+ *          Unless the port resets on open (the default), the transport also opens the tty itself for a moment, to configure the modem lines;
+ *          The serial Library doesn't expose its file descriptor, but the termios settings and the modem lines belong to the tty, not to a descriptor.
+ *          The same goes for the latency settings; Those the port doesn't support are skipped (See "getLatencyProfile"), and for the flow control (See "getFlowControl").
+ *          Another descriptor of the tty gets opened on first use, and stays open as long as the transport; Reads wait on it together with an eventfd,
+ *          so they can be interrupted, and the error counters get read with it, so reading them doesn't open the tty every time.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class SerialLibraryTransport : public SerialTransport
+{
+private:
+    // Variables
+    serial::Serial serial;
+    bool resetDevice;
+    LatencyProfile latencyProfile; // Settings in effect
+    serial::flowcontrol_t flowControl; // In effect
+    int ttyFd; // Another descriptor of the tty, which reads wait on; -1 if it couldn't be opened, then reads can't be interrupted
+    bool ttyFdOpened; // Whether opening ttyFd has been tried; It gets opened on first use
+    int wakeFd; // eventfd, which wakes up a waiting read
+    std::atomic_bool closed;
+    bool lineErrorCountersSupported;
+    std::mutex ttyFdMutex;
+
+    // Methods
+    /**
+     * Clears HUPCL, so the modem lines stay asserted after closing the port, and checks whether they did since the last close. Throws serial::IOException on failure.
+     *
+     * @param fd Descriptor of the tty.
+    */
+    void holdModemLines( int fd );
+
+    /**
+     * Drops DTR and RTS; RTS stays asserted with hardware flow control, since the device wouldn't send anything otherwise. Throws serial::IOException on failure; Ports without modem lines are fine.
+     *
+     * @param fd Descriptor of the tty.
+    */
+    void releaseModemLines( int fd );
+
+    /**
+     * Completes the flow control the serial Library configured, and checks whether the tty kept it; Drivers silently drop what they don't support.
+     * Software flow control gets the standard XON/XOFF characters (DC1/DC3), and only XON resumes the output (no IXANY).
+     *
+     * @param fd Descriptor of the tty.
+     * @param requested Requested flow control.
+    */
+    void applyFlowControl( int fd, serial::flowcontrol_t requested );
+
+    /**
+     * Applies VMIN/VTIME and the ASYNC_LOW_LATENCY flag, as far as the tty supports them.
+     *
+     * @param fd Descriptor of the tty.
+     * @param requested Requested latency profile.
+    */
+    void applyTtyLatency( int fd, const LatencyProfile & requested );
+
+    /**
+     * Sets the latency timer of an FTDI chip via sysfs, if the port has one and it may be written.
+     *
+     * @param port Path to the serial port.
+     * @param latencyTimer Time in ms; 0 means it's left as it is.
+    */
+    void applyLatencyTimer( std::string port, unsigned int latencyTimer );
+
+    /**
+     * Gets the other descriptor of the tty, and opens it on first use. Must be called while holding ttyFdMutex.
+     *
+     * @return Descriptor; -1 if it couldn't be opened, or the transport got closed.
+    */
+    int getTtyFd();
+
+public:
+    // Constructors
+    /**
+     * Default constructor; Opens the port.
+     *
+     * @param port Path to the serial port to connect to.
+     * @param baudRate Baud rate to be used.
+     * @param timeout Timeout information to be used.
+     * @param byteSize Byte size to be used for communicating.
+     * @param parity Parity option to be used for communicating.
+     * @param stopBits Stop bit configuration for the connection.
+     * @param flowControl Flow control configuration for the connection.
+     * @param resetControl How the modem lines get treated.
+     * @param latencyProfile How the port gets tuned for latency; Only the settings the port supports get applied.
+    */
+    SerialLibraryTransport(
+        std::string port,
+        unsigned int baudRate,
+        serial::Timeout timeout,
+        serial::bytesize_t byteSize,
+        serial::parity_t parity,
+        serial::stopbits_t stopBits,
+        serial::flowcontrol_t flowControl,
+        ResetControl resetControl,
+        LatencyProfile latencyProfile
+    );
+
+    // Destructors
+    /**
+     * Destructor.
+    */
+    ~SerialLibraryTransport();
+
+    // Methods (See SerialTransport)
+    using SerialTransport::readline;
+    void readline( std::string & line );
+    void interruptRead();
+    std::size_t write( const std::string & data );
+    void flush();
+    void setTimeout( serial::Timeout timeout );
+    void setLineSettings( const SerialParameters & serialParameters );
+    bool hasResetDevice();
+    LatencyProfile getLatencyProfile();
+    serial::flowcontrol_t getFlowControl();
+    bool getLineErrorCounters( LineErrorCounters & counters );
+    void close();
+};
+
+/**
+ * SerialLibraryTransportFactory class
+ * File: SerialLibraryTransport.hpp
+ * Purpose: Defines the default transport factory, which discovers the ttys and opens them via wjwwood's serial Library.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class SerialLibraryTransportFactory : public SerialTransportFactory
+{
+public:
+    // Methods (See SerialTransportFactory)
+    std::vector<serial::PortInfo> listPorts();
+    bool hasPort( std::string port );
+    SerialTransportPointer openTransport( SerialDevice & serialDevice );
+};
+
+#endif // SERIALLIBRARYTRANSPORT_HPP
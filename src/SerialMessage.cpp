@@ -53,6 +53,14 @@ SerialMessage::~SerialMessage()
 
 }
 
+void SerialMessage::assign( const std::string & deviceId, const std::string & type, const std::string & content )
+{
+    this->deviceId = deviceId;
+    this->timestamp = getCurrentTimestamp();
+    this->type = type;
+    this->content = content;
+}
+
 void SerialMessage::setDeviceId( std::string deviceId )
 {
     this->deviceId = deviceId;
@@ -100,6 +100,16 @@ public:
     ~SerialMessage();
 
     // Methods
+    /**
+     * Sets the device ID, type and content, and the current timestamp; Like constructing the message anew, but the strings keep their capacity.
+     * So a message which gets reused for every message read doesn't allocate, once it has grown to the longest message.
+     *
+     * @param deviceId Device ID to be set.
+     * @param type Message type to be set.
+     * @param content Message content to be set.
+    */
+    void assign( const std::string & deviceId, const std::string & type, const std::string & content );
+
     /**
      * Sets the device ID from which the message is.
      *
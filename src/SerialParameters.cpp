@@ -0,0 +1,155 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "SerialParameters.hpp"
+
+#include <sstream> // std::stringstream
+
+SerialParameters::SerialParameters()
+{
+    this->baudRate = 9600;
+    this->byteSize = serial::eightbits;
+    this->parity = serial::parity_none;
+    this->stopBits = serial::stopbits_one;
+    this->flowControl = serial::flowcontrol_none;
+    this->escalationBaudRate = 0;
+}
+
+unsigned int SerialParameters::parseBaudRate( const std::string & key, const std::string & value, unsigned int minimum )
+{
+    std::size_t length = 0;
+    unsigned long baudRate = 0;
+
+    try
+    {
+        baudRate = std::stoul( value, &length );
+    }
+    catch ( const std::exception & e )
+    {
+        length = 0;
+    }
+
+    if ( value.empty() || length != value.length() || value[0] == '-' || baudRate < minimum || baudRate > 4000000 )
+    {
+        throw std::invalid_argument( "Malformed serial setting \"" + key + "=" + value + "\". (Allowed: " + std::to_string( minimum ) + " - 4000000)" );
+    }
+
+    return static_cast<unsigned int>( baudRate );
+}
+
+serial::flowcontrol_t SerialParameters::parseFlowControl( const std::string & name )
+{
+    if ( name == "none" ) return serial::flowcontrol_none;
+    else if ( name == "software" ) return serial::flowcontrol_software;
+    else if ( name == "hardware" ) return serial::flowcontrol_hardware;
+
+    throw std::invalid_argument( "Unknown flow control \"" + name + "\". (Allowed: none, software, hardware)" );
+}
+
+std::string SerialParameters::getFlowControlName( serial::flowcontrol_t flowControl )
+{
+    return flowControl == serial::flowcontrol_hardware ? "hardware" : ( flowControl == serial::flowcontrol_software ? "software" : "none" );
+}
+
+SerialParameters SerialParameters::parse( std::string declaration, SerialParameters parameters )
+{
+    std::stringstream stream( declaration );
+    std::string setting;
+
+    while ( std::getline( stream, setting, ',' ) )
+    {
+        if ( setting.empty() )
+        {
+            continue;
+        }
+
+        std::size_t separatorPosition = setting.find( '=' );
+        std::string key = setting.substr( 0, separatorPosition );
+        std::string value = separatorPosition == std::string::npos ? "" : setting.substr( separatorPosition + 1 );
+
+        if ( key == "baud" )
+        {
+            parameters.baudRate = parseBaudRate( key, value, 1 );
+        }
+        else if ( key == "escalate_baud" )
+        {
+            parameters.escalationBaudRate = parseBaudRate( key, value, 0 );
+        }
+        else if ( key == "format" )
+        {
+            std::string stopBits = value.length() >= 3 ? value.substr( 2 ) : "";
+
+            if ( value.length() < 3 || value[0] < '5' || value[0] > '8' || std::string( "NEOMS" ).find( value[1] ) == std::string::npos
+                || ( stopBits != "1" && stopBits != "1.5" && stopBits != "2" ) )
+            {
+                throw std::invalid_argument( "Malformed serial setting \"" + setting + "\". (Format: <5-8><N|E|O|M|S><1|1.5|2>, e.g. 8N1)" );
+            }
+
+            parameters.byteSize = static_cast<serial::bytesize_t>( value[0] - '0' );
+
+            switch ( value[1] )
+            {
+                case 'E': parameters.parity = serial::parity_even; break;
+                case 'O': parameters.parity = serial::parity_odd; break;
+                case 'M': parameters.parity = serial::parity_mark; break;
+                case 'S': parameters.parity = serial::parity_space; break;
+                default: parameters.parity = serial::parity_none; break;
+            }
+
+            parameters.stopBits = stopBits == "2" ? serial::stopbits_two : ( stopBits == "1.5" ? serial::stopbits_one_point_five : serial::stopbits_one );
+        }
+        else if ( key == "flowcontrol" )
+        {
+            try
+            {
+                parameters.flowControl = parseFlowControl( value );
+            }
+            catch ( const std::invalid_argument & e )
+            {
+                throw std::invalid_argument( "Malformed serial setting \"" + setting + "\". (Allowed: none, software, hardware)" );
+            }
+        }
+        else
+        {
+            throw std::invalid_argument( "Unknown serial setting \"" + setting + "\". (Allowed: baud, format, flowcontrol, escalate_baud)" );
+        }
+    }
+
+    return parameters;
+}
+
+bool SerialParameters::hasSameLineSettings( const SerialParameters & other ) const
+{
+    return baudRate == other.baudRate && byteSize == other.byteSize && parity == other.parity && stopBits == other.stopBits && flowControl == other.flowControl;
+}
+
+std::string SerialParameters::toString() const
+{
+    const char parityNames[] = { 'N', 'O', 'E', 'M', 'S' }; // In the order of serial::parity_t
+    std::stringstream declaration;
+
+    declaration << "baud=" << baudRate << ",format=" << static_cast<int>( byteSize ) << parityNames[parity]
+                << ( stopBits == serial::stopbits_two ? "2" : ( stopBits == serial::stopbits_one_point_five ? "1.5" : "1" ) )
+                << ",flowcontrol=" << getFlowControlName( flowControl );
+
+    if ( escalationBaudRate > 0 )
+    {
+        declaration << ",escalate_baud=" << escalationBaudRate;
+    }
+
+    return declaration.str();
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef SERIALPARAMETERS_HPP
+#define SERIALPARAMETERS_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <stdexcept> // std::invalid_argument
+
+// wjwwood's serial Library (https://github.com/wjwwood/serial)
+#include "serial/serial.h"
+
+/**
+ * SerialParameters struct
+ * File: SerialParameters.hpp
+ * Purpose: Holds the line settings of a port, and the baud rate the device gets asked to switch to after it answered with its ID.
+ *          Declared as comma separated settings, applied on top of a base, e.g. "baud=57600,format=7E1,flowcontrol=hardware,escalate_baud=115200":
+ *          - "baud=<rate>": Baud rate (> 0)
+ *          - "format=<byte size><parity><stop bits>": E.g. "8N1", "7E2" or "8O1.5"; Byte size 5 - 8, parity N(one), E(ven), O(dd), M(ark) or S(pace), stop bits 1, 1.5 or 2
+ *          - "flowcontrol=<none|software|hardware>": Flow control
+ *          - "escalate_baud=<rate>": Baud rate the device gets asked to switch to; 0 means it doesn't get asked
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+struct SerialParameters
+{
+    // Variables
+    unsigned int baudRate;
+    serial::bytesize_t byteSize;
+    serial::parity_t parity;
+    serial::stopbits_t stopBits;
+    serial::flowcontrol_t flowControl;
+    unsigned int escalationBaudRate; // 0 means the device doesn't get asked to switch
+
+    // Constructors
+    /**
+     * Default constructor; 9600 baud, 8N1, no flow control and no escalation.
+    */
+    SerialParameters();
+
+    // Methods
+    /**
+     * Parses a baud rate. Throws std::invalid_argument if it isn't a number within the bounds.
+     *
+     * @param key Key of the setting, for the error message.
+     * @param value Value to be parsed.
+     * @param minimum Minimum allowed value.
+     * @return Parsed baud rate.
+    */
+    static unsigned int parseBaudRate( const std::string & key, const std::string & value, unsigned int minimum );
+
+    /**
+     * Parses the name of a flow control. Throws std::invalid_argument if the name is unknown.
+     *
+     * @param name "none", "software" (XON/XOFF) or "hardware" (RTS/CTS).
+     * @return Flow control.
+    */
+    static serial::flowcontrol_t parseFlowControl( const std::string & name );
+
+    /**
+     * Gets the name of a flow control.
+     *
+     * @param flowControl Flow control.
+     * @return "none", "software" or "hardware".
+    */
+    static std::string getFlowControlName( serial::flowcontrol_t flowControl );
+
+    /**
+     * Parses a declaration, and applies it on top of the given parameters. Throws std::invalid_argument if it is malformed.
+     *
+     * @param declaration Comma separated settings, e.g. "baud=57600,format=8N1".
+     * @param parameters Parameters the declaration gets applied on.
+     * @return Resulting parameters.
+    */
+    static SerialParameters parse( std::string declaration, SerialParameters parameters );
+
+    /**
+     * Gets whether the line settings equal those of other parameters; The escalation baud rate isn't compared.
+     *
+     * @param other Parameters to compare with.
+     * @return Whether the line settings are equal.
+    */
+    bool hasSameLineSettings( const SerialParameters & other ) const;
+
+    /**
+     * Gets the declaration of the parameters.
+     *
+     * @return Declaration, e.g. "baud=9600,format=8N1,flowcontrol=none".
+    */
+    std::string toString() const;
+};
+
+#endif // SERIALPARAMETERS_HPP
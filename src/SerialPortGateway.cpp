@@ -16,10 +16,22 @@
 
 #include "SerialPortGateway.hpp"
 
+// C Standard Libraries
+#include <fcntl.h> // open, O_RDWR, O_NOCTTY, O_NONBLOCK, O_CLOEXEC
+#include <unistd.h> // close
+#include <climits> // PATH_MAX
+#include <cstdlib> // realpath
+#include <cstring> // std::strerror
+#include <cerrno> // errno
+
 const std::string SerialPortGateway::CHAR_SPACE = " ";
 const std::string SerialPortGateway::CHAR_NEWLINE = "\n";
 const std::string SerialPortGateway::CHAR_CARRIAGE_RETURN = "\r";
 const std::string SerialPortGateway::LIST_SEPARATOR = ",";
+const std::string SerialPortGateway::SCHEMA_TYPE_SEPARATOR = "=";
+const std::string SerialPortGateway::CHAR_COMMENT = "#";
+const unsigned int SerialPortGateway::MAX_HANDSHAKE_RETRY_INTERVAL = 1000;
+const std::size_t SerialPortGateway::WORKER_QUEUE_CAPACITY = 256;
 
 SerialPortGateway::SerialPortGateway(
     std::string configFile,
@@ -33,16 +45,67 @@ SerialPortGateway::SerialPortGateway(
     setSerialPortBlacklistFile( serialPortBlacklistFile );
     setLogPath( logPath );
     setStarted( false );
+    setAsyncLoggerInstance( nullptr );
+    setPrometheusExporterInstance( nullptr );
+    setDeviceHandoverInstance( nullptr );
+    setDeviceIdentityCacheInstance( nullptr );
+    setEventBusInstance( nullptr );
+    handoverActive = false;
+    handedOver = false;
+    stopping = false;
+    discardingInbound = false;
+    inboundDropped = 0;
+    identityVerificationCount = 0;
+    scanLoopRunning = false;
 
     initConfig();
     initLogger();
+    initTracer();
+    initCallbackDispatcher();
+    initWorkerPools();
+    initOutboundBuffer();
+    initEventBus();
+    initProbeScheduler();
+    initDeviceIdentityCache();
+    initSerialTransportFactory();
     loadHardwareWhitelist();
     loadSerialPortBlacklist();
+    loadMessageSchemas();
+    loadResetControls();
+    loadLatencyProfiles();
+    loadSerialParameters();
+    initMetricsExporter();
+    initDeviceHandover();
 }
 
 SerialPortGateway::~SerialPortGateway()
 {
+    // Consumers should be gone by now; One which is still registered doesn't hold the stop up
+    if ( getEventBusInstance() != nullptr )
+    {
+        getEventBusInstance()->close();
+    }
+
     stop();
+    deleteAllSerialDevices( true ); // Devices added without starting the gateway
+
+    // Also the threads which were still running at the stop timeout; Meanwhile no message reaches a callback anymore
+    discardingInbound = true;
+    threads.join();
+    deleteMessageWorkerPoolInstance();
+    getCallbackDispatcherInstance()->stop();
+    deleteSendWorkerPoolInstance(); // After the callbacks, since they may still send a message
+    threads.join(); // A write error deletes its device, which runs the deleted callback
+
+    deleteDeviceHandoverInstance(); // Waits for a handover which just completed
+    deleteMetricsExporterInstance();
+    deleteSerialTransportFactoryInstance();
+    deleteDeviceIdentityCacheInstance();
+    deleteProbeSchedulerInstance();
+    deleteEventBusInstance();
+    deleteOutboundBufferInstance();
+    deleteCallbackDispatcherInstance();
+    deleteTracerInstance();
     deleteLoggerInstance();
     deleteConfigInstance();
 }
@@ -107,6 +170,41 @@ bool SerialPortGateway::isLoggingActive()
     return this->loggingActive;
 }
 
+void SerialPortGateway::setAsyncLoggingActive( bool asyncLoggingActive )
+{
+    this->asyncLoggingActive = asyncLoggingActive;
+}
+
+bool SerialPortGateway::isAsyncLoggingActive()
+{
+    return this->asyncLoggingActive;
+}
+
+void SerialPortGateway::setAsyncLoggingCapacity( unsigned int asyncLoggingCapacity )
+{
+    if ( asyncLoggingCapacity == 0 )
+    {
+        throw Exception( "Capacity of the async logger must be > 0." );
+    }
+
+    this->asyncLoggingCapacity = asyncLoggingCapacity;
+}
+
+unsigned int SerialPortGateway::getAsyncLoggingCapacity()
+{
+    return this->asyncLoggingCapacity;
+}
+
+void SerialPortGateway::setLogLevel( LogLevel logLevel )
+{
+    this->logLevel = logLevel;
+}
+
+LogLevel SerialPortGateway::getLogLevel()
+{
+    return this->logLevel;
+}
+
 void SerialPortGateway::setScanInterval( unsigned int scanInterval )
 {
     this->scanInterval = scanInterval;
@@ -187,754 +285,3378 @@ std::string SerialPortGateway::getMessageTypeForIds()
     return this->messageTypeForIds;
 }
 
-void SerialPortGateway::setConfigInstance( Config * configInstance )
+void SerialPortGateway::setMessageSchemaFile( std::string messageSchemaFile )
 {
-    if ( configInstance == nullptr )
+    this->messageSchemaFile = messageSchemaFile;
+}
+
+std::string SerialPortGateway::getMessageSchemaFile()
+{
+    return this->messageSchemaFile;
+}
+
+void SerialPortGateway::setSchemaFieldDelimiter( std::string schemaFieldDelimiter )
+{
+    if ( schemaFieldDelimiter.empty() )
     {
-        throw Exception( "Config instance must not be null." );
+        throw Exception( "Schema field delimiter must not be empty." );
     }
 
-    this->configInstance = configInstance;
+    this->schemaFieldDelimiter = schemaFieldDelimiter;
 }
 
-Config * SerialPortGateway::getConfigInstance()
+std::string SerialPortGateway::getSchemaFieldDelimiter()
 {
-    return this->configInstance;
+    return this->schemaFieldDelimiter;
 }
 
-void SerialPortGateway::initConfig()
+void SerialPortGateway::setMetricsUnixSocket( std::string metricsUnixSocket )
 {
-    Config * config = new Config( getConfigFile() );
-    setConfigInstance( config );
-
-    bool loggingActive = config->getBool( "LOGGING_ACTIVE" );
-    unsigned int scanInterval = config->getUnsignedInteger( "SCAN_INTERVAL" );
-    unsigned int waitBeforeCommunication = config->getUnsignedInteger( "WAIT_BEFORE_COMMUNICATION" );
-    unsigned int baudRate = config->getUnsignedInteger( "BAUD_RATE" );
-    std::string messageDelimiter = config->getString( "MESSAGE_DELIMITER" );
-    std::string commandToGetDeviceId = config->getString( "COMMAND_GETID" );
-    std::string messageTypeForIds = config->getString( "MESSAGE_TYPE_ID" );
-
-    setLoggingActive( loggingActive );
-    setScanInterval( scanInterval );
-    setWaitBeforeCommunication( waitBeforeCommunication );
-    setBaudRate( baudRate );
-    setMessageDelimiter( messageDelimiter );
-    setCommandToGetDeviceId( commandToGetDeviceId );
-    setMessageTypeForIds( messageTypeForIds );
+    this->metricsUnixSocket = metricsUnixSocket;
 }
 
-void SerialPortGateway::deleteConfigInstance()
+std::string SerialPortGateway::getMetricsUnixSocket()
 {
-    delete getConfigInstance();
+    return this->metricsUnixSocket;
 }
 
-void SerialPortGateway::setLoggerInstance( Logger * loggerInstance )
+void SerialPortGateway::setMetricsPort( unsigned int metricsPort )
 {
-    if ( loggerInstance == nullptr )
+    if ( metricsPort > 65535 )
     {
-        throw Exception( "Logger instance must not be null." );
+        throw Exception( "Metrics port must be <= 65535." );
     }
 
-    this->loggerInstance = loggerInstance;
+    this->metricsPort = metricsPort;
 }
 
-Logger * SerialPortGateway::getLoggerInstance()
+unsigned int SerialPortGateway::getMetricsPort()
 {
-    return this->loggerInstance;
+    return this->metricsPort;
 }
 
-void SerialPortGateway::initLogger()
+void SerialPortGateway::setTracingActive( bool tracingActive )
 {
-    Logger * logger = new Logger( "SerialPortGateway", getLogPath(), true, isLoggingActive(), true );
-    logger->writeInfo( "Logger initialized." );
-
-    setLoggerInstance( logger );
+    this->tracingActive = tracingActive;
 }
 
-void SerialPortGateway::deleteLoggerInstance()
+bool SerialPortGateway::isTracingActive()
 {
-    delete getLoggerInstance();
+    return this->tracingActive;
 }
 
-void SerialPortGateway::loadHardwareWhitelist()
+void SerialPortGateway::setTracingBufferSize( unsigned int tracingBufferSize )
 {
-    std::string fileName = getHardwareWhitelistFile();
-
-    if ( fileName.empty() )
-    {
-        throw Exception( "Path to Hardware-ID Whitelist must not be empty." );
-    }
-
-    std::ifstream fileStream( fileName, std::ifstream::out | std::ifstream::app );
-
-    if ( !fileStream.is_open() )
+    if ( tracingBufferSize == 0 )
     {
-        throw Exception( "Couldn't open Hardware-ID Whitelist. (Path: \"" + fileName + "\")" );
+        throw Exception( "Tracing buffer size must be > 0." );
     }
 
-    std::string line;
+    this->tracingBufferSize = tracingBufferSize;
+}
 
-    while ( std::getline( fileStream, line ) )
-    {
-        getHardwareWhitelist()->insert( line );
+unsigned int SerialPortGateway::getTracingBufferSize()
+{
+    return this->tracingBufferSize;
+}
 
-        getLoggerInstance()->writeInfo( std::string( "Whitelisted Hardware-ID: \"" + line + "\"." ) );
-    }
+void SerialPortGateway::setCallbackBudget( unsigned int callbackBudget )
+{
+    this->callbackBudget = callbackBudget;
+}
 
-    fileStream.close();
+unsigned int SerialPortGateway::getCallbackBudget()
+{
+    return this->callbackBudget;
+}
 
-    if ( isHardwareWhitelistEmpty() )
+void SerialPortGateway::setCallbackSlowStreak( unsigned int callbackSlowStreak )
+{
+    if ( callbackSlowStreak == 0 )
     {
-        getLoggerInstance()->writeInfo( "Hardware Whitelist is empty, which means that not whitelist-checks will be performed." );
+        throw Exception( "Callback slow streak must be > 0." );
     }
+
+    this->callbackSlowStreak = callbackSlowStreak;
 }
 
-SerialPortGateway::StringSet * SerialPortGateway::getHardwareWhitelist()
+unsigned int SerialPortGateway::getCallbackSlowStreak()
 {
-    return &hardwareWhitelist;
+    return this->callbackSlowStreak;
 }
 
-bool SerialPortGateway::isHardwareWhitelistEmpty()
+void SerialPortGateway::setIsolatedLaneThreads( unsigned int isolatedLaneThreads )
 {
-    return getHardwareWhitelist()->empty();
+    if ( isolatedLaneThreads == 0 )
+    {
+        throw Exception( "Number of isolated lane threads must be > 0." );
+    }
+
+    this->isolatedLaneThreads = isolatedLaneThreads;
 }
 
-bool SerialPortGateway::hasHardwareWhitelistEntry( std::string hardwareId )
+unsigned int SerialPortGateway::getIsolatedLaneThreads()
 {
-    StringSet * hardwareWhitelist = getHardwareWhitelist();
+    return this->isolatedLaneThreads;
+}
 
-    if ( hardwareWhitelist->find( hardwareId ) != hardwareWhitelist->end() )
+void SerialPortGateway::setMessageThreads( unsigned int messageThreads )
+{
+    if ( messageThreads == 0 )
     {
-        return true;
+        throw Exception( "Number of message threads must be > 0." );
     }
 
-    return false;
+    this->messageThreads = messageThreads;
 }
 
-std::string SerialPortGateway::getHardwareId( std::string serialPort )
+unsigned int SerialPortGateway::getMessageThreads()
 {
-    // The sysfs information returns a string which contains the hardwareId
-    // Inside this string, the hardwareId is formatted as followed (if it exists): "[...] VID:PID=<4 character long VID>:<4 character long PID> [...]"
-    // Examples: "[...] USB VID:PID=1a86:7523 " or "[...] USB VID:PID=2341:0042 SNR=85438333935351F01180 [...]"
-    // -> We only need the characters after the key ("VID:PID="), until the next blank space (" ")
-
-    std::string hardwareId;
+    return this->messageThreads;
+}
 
-    // VERY VERY VEEEEERY ugly workaround for getting the hardwareId, until we have another RELIABLE solution for this (e.g. a new, better [proably self-written] serial library)
-    // Unfortunately the serial libraries' "get_sysfs_info" function wasn't exposed, with which we could've done this directly. Without this ugly loop-workaround..
-    for ( serial::PortInfo const & serialPortInfo : serial::list_ports() )
+void SerialPortGateway::setSendThreads( unsigned int sendThreads )
+{
+    if ( sendThreads == 0 )
     {
-        if ( serialPortInfo.port == serialPort )
-        {
-            hardwareId = serialPortInfo.hardware_id;
-
-            break;
-        }
+        throw Exception( "Number of send threads must be > 0." );
     }
 
-    std::string key = "VID:PID=";
-    std::size_t keyPosition = hardwareId.find( key );
-    std::size_t valuePosition = keyPosition + key.length();
-    std::size_t hardwareIdLength = hardwareId.find_first_of( " ", valuePosition ) - valuePosition;
+    this->sendThreads = sendThreads;
+}
 
-    if ( keyPosition != std::string::npos && hardwareIdLength != std::string::npos )
-    {
-        hardwareId = hardwareId.substr( valuePosition, hardwareIdLength );
+unsigned int SerialPortGateway::getSendThreads()
+{
+    return this->sendThreads;
+}
 
-        return hardwareId;
-    }
-    else
-    {
-        return "";
-    }
+void SerialPortGateway::setInboundQueueCapacity( unsigned int inboundQueueCapacity )
+{
+    this->inboundQueueCapacity = inboundQueueCapacity;
 }
 
-void SerialPortGateway::loadSerialPortBlacklist()
+unsigned int SerialPortGateway::getInboundQueueCapacity()
 {
-    std::string fileName = getSerialPortBlacklistFile();
+    return this->inboundQueueCapacity;
+}
 
-    if ( fileName.empty() )
-    {
-        getLoggerInstance()->writeInfo( "No Serial Port Blacklist given. (No ports will be ignored while scanning.)" );
+void SerialPortGateway::setInboundOverflowPolicy( OverflowPolicy inboundOverflowPolicy )
+{
+    this->inboundOverflowPolicy = inboundOverflowPolicy;
+}
 
-        return;
-    }
+OverflowPolicy SerialPortGateway::getInboundOverflowPolicy()
+{
+    return this->inboundOverflowPolicy;
+}
 
-    std::ifstream fileStream( fileName, std::ifstream::out | std::ifstream::app );
+void SerialPortGateway::setOutboundBufferCapacity( unsigned int outboundBufferCapacity )
+{
+    this->outboundBufferCapacity = outboundBufferCapacity;
+}
 
-    if ( !fileStream.is_open() )
+unsigned int SerialPortGateway::getOutboundBufferCapacity()
+{
+    return this->outboundBufferCapacity;
+}
+
+void SerialPortGateway::setOutboundBufferBytes( unsigned int outboundBufferBytes )
+{
+    if ( outboundBufferBytes == 0 )
     {
-        throw Exception( "Couldn't open Serial Port Blacklist. (Path: \"" + fileName + "\")" );
+        throw Exception( "Outbound buffer bytes must be > 0." );
     }
 
-    std::string line;
-
-    while ( std::getline( fileStream, line ) )
-    {
-        getSerialPortBlacklist()->insert( line );
+    this->outboundBufferBytes = outboundBufferBytes;
+}
 
-        getLoggerInstance()->writeInfo( std::string( "Blacklisted Serial Port: \"" + line + "\"" ) );
-    }
+unsigned int SerialPortGateway::getOutboundBufferBytes()
+{
+    return this->outboundBufferBytes;
+}
 
-    fileStream.close();
+void SerialPortGateway::setOutboundBufferTtl( unsigned int outboundBufferTtl )
+{
+    this->outboundBufferTtl = outboundBufferTtl;
 }
 
-SerialPortGateway::StringSet * SerialPortGateway::getSerialPortBlacklist()
+unsigned int SerialPortGateway::getOutboundBufferTtl()
 {
-    return &serialPortBlacklist;
+    return this->outboundBufferTtl;
 }
 
-bool SerialPortGateway::isSerialPortBlacklistEmpty()
+void SerialPortGateway::setIdentityCacheFile( std::string identityCacheFile )
 {
-    return getSerialPortBlacklist()->empty();
+    this->identityCacheFile = identityCacheFile;
 }
 
-bool SerialPortGateway::hasSerialPortBlacklistEntry( std::string serialPort )
+std::string SerialPortGateway::getIdentityCacheFile()
 {
-    StringSet * serialPortBlacklist = getSerialPortBlacklist();
+    return this->identityCacheFile;
+}
 
-    if ( serialPortBlacklist->find( serialPort ) != serialPortBlacklist->end() )
+void SerialPortGateway::setIdentityVerifyTimeout( unsigned int identityVerifyTimeout )
+{
+    if ( identityVerifyTimeout == 0 )
     {
-        return true;
+        throw Exception( "Identity verify timeout must be > 0." );
     }
 
-    return false;
+    this->identityVerifyTimeout = identityVerifyTimeout;
 }
 
-SerialPortGateway::SerialDeviceMap * SerialPortGateway::getSerialDevices()
+unsigned int SerialPortGateway::getIdentityVerifyTimeout()
 {
-    return &serialDevices;
+    return this->identityVerifyTimeout;
 }
 
-SerialPortGateway::AtomicBoolPairMap * SerialPortGateway::getReadLoopStates()
+void SerialPortGateway::setAdaptiveHandshakeActive( bool adaptiveHandshakeActive )
 {
-    return &readLoopStates;
+    this->adaptiveHandshakeActive = adaptiveHandshakeActive;
 }
 
-bool SerialPortGateway::addSerialDevice( std::string serialPort, bool suppressLogs )
+bool SerialPortGateway::isAdaptiveHandshakeActive()
 {
-    if ( !std::ifstream( serialPort ) )
-    {
-        getLoggerInstance()->writeWarn( std::string( "Couldn't add serial device on port \"" + serialPort + "\", because it doesn't exist or can not be accessed." ) );
-
-        return false;
-    }
+    return this->adaptiveHandshakeActive;
+}
 
-    if ( SerialDevicePointer tempSerialDevice = getSerialDeviceByPort( serialPort ) )
+void SerialPortGateway::setHandshakeRetryInterval( unsigned int handshakeRetryInterval )
+{
+    if ( handshakeRetryInterval == 0 )
     {
-        if ( !suppressLogs )
-        {
-            getLoggerInstance()->writeWarn( std::string( "Couldn't add serial device on port \"" + serialPort + "\", because it has already been registered with ID \"" + tempSerialDevice->getId() + "\"." ) );
-        }
-
-        return false;
+        throw Exception( "Handshake retry interval must be > 0." );
     }
 
-    if ( hasSerialPortBlacklistEntry( serialPort ) )
-    {
-        if ( !suppressLogs )
-        {
-            getLoggerInstance()->writeWarn( std::string( "Didn't add serial device on port \"" + serialPort + "\", because the port is blacklisted." ) );
-        }
+    this->handshakeRetryInterval = handshakeRetryInterval;
+}
 
-        return false;
-    }
+unsigned int SerialPortGateway::getHandshakeRetryInterval()
+{
+    return this->handshakeRetryInterval;
+}
 
-    if ( !isHardwareWhitelistEmpty() )
+void SerialPortGateway::setHandshakeDeadline( unsigned int handshakeDeadline )
+{
+    if ( handshakeDeadline == 0 )
     {
-        std::string hardwareId = getHardwareId( serialPort );
+        throw Exception( "Handshake deadline must be > 0." );
+    }
 
-        if ( hardwareId.empty() )
-        {
-            if ( !suppressLogs )
-            {
-                getLoggerInstance()->writeWarn( std::string( "Couldn't add device on port \"" + serialPort + "\", because the Hardware ID could not be retrieved." ) );
-            }
+    this->handshakeDeadline = handshakeDeadline;
+}
 
-            return false;
-        }
+unsigned int SerialPortGateway::getHandshakeDeadline()
+{
+    return this->handshakeDeadline;
+}
 
-        if ( !hasHardwareWhitelistEntry( hardwareId ) )
-        {
-            if ( !suppressLogs )
-            {
-                getLoggerInstance()->writeWarn( std::string( "Didn't add device on port \"" + serialPort + "\", because Hardware ID \"" + hardwareId + "\" is not whitelisted." ) );
-            }
+void SerialPortGateway::setResetControlFile( std::string resetControlFile )
+{
+    this->resetControlFile = resetControlFile;
+}
 
-            return false;
-        }
+std::string SerialPortGateway::getResetControlFile()
+{
+    return this->resetControlFile;
+}
 
-    }
+void SerialPortGateway::setProbeBackoff( unsigned int probeBackoff )
+{
+    this->probeBackoff = probeBackoff;
+}
 
-    SerialDevicePointer serialDevice = std::make_shared<SerialDevice>( serialPort, getBaudRate(), serial::Timeout::simpleTimeout( 250 ) );
+unsigned int SerialPortGateway::getProbeBackoff()
+{
+    return this->probeBackoff;
+}
 
-    if ( !initSerialDevice( serialDevice ) )
-    {
-        return false;
-    }
+void SerialPortGateway::setProbeBackoffMax( unsigned int probeBackoffMax )
+{
+    this->probeBackoffMax = probeBackoffMax;
+}
 
-    std::string deviceId = serialDevice->getId();
-    SerialDeviceMap * serialDevices = getSerialDevices();
-    SerialDeviceMap::iterator it = serialDevices->find( deviceId );
+unsigned int SerialPortGateway::getProbeBackoffMax()
+{
+    return this->probeBackoffMax;
+}
+
+void SerialPortGateway::setProbeQuarantineAfter( unsigned int probeQuarantineAfter )
+{
+    this->probeQuarantineAfter = probeQuarantineAfter;
+}
+
+unsigned int SerialPortGateway::getProbeQuarantineAfter()
+{
+    return this->probeQuarantineAfter;
+}
+
+void SerialPortGateway::setDefaultLatencyProfile( LatencyProfile defaultLatencyProfile )
+{
+    if ( defaultLatencyProfile.readTimeout == 0 )
+    {
+        throw Exception( "Read timeout must be > 0." );
+    }
+
+    this->defaultLatencyProfile = defaultLatencyProfile;
+}
+
+LatencyProfile SerialPortGateway::getDefaultLatencyProfile()
+{
+    return this->defaultLatencyProfile;
+}
+
+void SerialPortGateway::setLatencyProfileFile( std::string latencyProfileFile )
+{
+    this->latencyProfileFile = latencyProfileFile;
+}
+
+std::string SerialPortGateway::getLatencyProfileFile()
+{
+    return this->latencyProfileFile;
+}
+
+void SerialPortGateway::setSerialParametersFile( std::string serialParametersFile )
+{
+    this->serialParametersFile = serialParametersFile;
+}
+
+std::string SerialPortGateway::getSerialParametersFile()
+{
+    return this->serialParametersFile;
+}
+
+void SerialPortGateway::setBaudEscalationCommand( std::string baudEscalationCommand )
+{
+    this->baudEscalationCommand = baudEscalationCommand;
+}
+
+std::string SerialPortGateway::getBaudEscalationCommand()
+{
+    return this->baudEscalationCommand;
+}
+
+void SerialPortGateway::setBaudEscalationRate( unsigned int baudEscalationRate )
+{
+    this->baudEscalationRate = baudEscalationRate;
+}
+
+unsigned int SerialPortGateway::getBaudEscalationRate()
+{
+    return this->baudEscalationRate;
+}
+
+void SerialPortGateway::setFlowControl( serial::flowcontrol_t flowControl )
+{
+    this->flowControl = flowControl;
+}
+
+serial::flowcontrol_t SerialPortGateway::getFlowControl()
+{
+    return this->flowControl;
+}
+
+void SerialPortGateway::setLineErrorInterval( unsigned int lineErrorInterval )
+{
+    this->lineErrorInterval = lineErrorInterval;
+}
+
+unsigned int SerialPortGateway::getLineErrorInterval()
+{
+    return this->lineErrorInterval;
+}
+
+void SerialPortGateway::setHandoverSocket( std::string handoverSocket )
+{
+    this->handoverSocket = handoverSocket;
+}
+
+std::string SerialPortGateway::getHandoverSocket()
+{
+    return this->handoverSocket;
+}
+
+void SerialPortGateway::setStopTimeout( unsigned int stopTimeout )
+{
+    this->stopTimeout = stopTimeout;
+}
+
+unsigned int SerialPortGateway::getStopTimeout()
+{
+    return this->stopTimeout;
+}
+
+void SerialPortGateway::setEventBusCapacity( unsigned int eventBusCapacity )
+{
+    this->eventBusCapacity = eventBusCapacity;
+}
+
+unsigned int SerialPortGateway::getEventBusCapacity()
+{
+    return this->eventBusCapacity;
+}
+
+void SerialPortGateway::setConfigInstance( Config * configInstance )
+{
+    if ( configInstance == nullptr )
+    {
+        throw Exception( "Config instance must not be null." );
+    }
+
+    this->configInstance = configInstance;
+}
+
+Config * SerialPortGateway::getConfigInstance()
+{
+    return this->configInstance;
+}
+
+void SerialPortGateway::initConfig()
+{
+    Config * config = new Config( getConfigFile() );
+    setConfigInstance( config );
+
+    bool loggingActive = config->getBool( "LOGGING_ACTIVE" );
+    unsigned int scanInterval = config->getUnsignedInteger( "SCAN_INTERVAL" );
+    unsigned int waitBeforeCommunication = config->getUnsignedInteger( "WAIT_BEFORE_COMMUNICATION" );
+    unsigned int baudRate = config->getUnsignedInteger( "BAUD_RATE" );
+    std::string messageDelimiter = config->getString( "MESSAGE_DELIMITER" );
+    std::string commandToGetDeviceId = config->getString( "COMMAND_GETID" );
+    std::string messageTypeForIds = config->getString( "MESSAGE_TYPE_ID" );
+    std::string messageSchemaFile = getOptionalConfigString( "MESSAGE_SCHEMA_FILE", "" );
+    std::string schemaFieldDelimiter = getOptionalConfigString( "SCHEMA_FIELD_DELIMITER", "," );
+    bool asyncLoggingActive = getOptionalConfigBool( "LOGGING_ASYNC", false );
+    unsigned int asyncLoggingCapacity = getOptionalConfigUnsignedInteger( "LOGGING_ASYNC_CAPACITY", 8192 );
+    std::string logLevel = getOptionalConfigString( "LOG_LEVEL", "INFO" );
+    std::string metricsUnixSocket = getOptionalConfigString( "METRICS_UNIX_SOCKET", "" );
+    unsigned int metricsPort = getOptionalConfigUnsignedInteger( "METRICS_PORT", 0 );
+    bool tracingActive = getOptionalConfigBool( "TRACING_ACTIVE", false );
+    unsigned int tracingBufferSize = getOptionalConfigUnsignedInteger( "TRACING_BUFFER_SIZE", StageTracer::DEFAULT_RING_CAPACITY );
+    unsigned int callbackBudget = getOptionalConfigUnsignedInteger( "CALLBACK_BUDGET", 0 );
+    unsigned int callbackSlowStreak = getOptionalConfigUnsignedInteger( "CALLBACK_SLOW_STREAK", 3 );
+    unsigned int isolatedLaneThreads = getOptionalConfigUnsignedInteger( "ISOLATED_LANE_THREADS", 2 );
+    unsigned int messageThreads = getOptionalConfigUnsignedInteger( "MESSAGE_THREADS", 4 );
+    unsigned int sendThreads = getOptionalConfigUnsignedInteger( "SEND_THREADS", 4 );
+    unsigned int inboundQueueCapacity = getOptionalConfigUnsignedInteger( "INBOUND_QUEUE_CAPACITY", 0 );
+    std::string inboundOverflowPolicy = getOptionalConfigString( "INBOUND_OVERFLOW_POLICY", "block" );
+    unsigned int outboundBufferCapacity = getOptionalConfigUnsignedInteger( "OUTBOUND_BUFFER_CAPACITY", 0 );
+    unsigned int outboundBufferBytes = getOptionalConfigUnsignedInteger( "OUTBOUND_BUFFER_BYTES", 4096 );
+    unsigned int outboundBufferTtl = getOptionalConfigUnsignedInteger( "OUTBOUND_BUFFER_TTL", 30000 );
+    std::string identityCacheFile = getOptionalConfigString( "IDENTITY_CACHE_FILE", "" );
+    unsigned int identityVerifyTimeout = getOptionalConfigUnsignedInteger( "IDENTITY_VERIFY_TIMEOUT", 2000 );
+    bool adaptiveHandshakeActive = getOptionalConfigBool( "ADAPTIVE_HANDSHAKE", false );
+    unsigned int handshakeRetryInterval = getOptionalConfigUnsignedInteger( "HANDSHAKE_RETRY_INTERVAL", 50 );
+    unsigned int handshakeDeadline = getOptionalConfigUnsignedInteger( "HANDSHAKE_DEADLINE", 5000 );
+    std::string resetControlFile = getOptionalConfigString( "RESET_CONTROL_FILE", "" );
+    unsigned int probeBackoff = getOptionalConfigUnsignedInteger( "PROBE_BACKOFF", 0 );
+    unsigned int probeBackoffMax = getOptionalConfigUnsignedInteger( "PROBE_BACKOFF_MAX", 300000 );
+    unsigned int probeQuarantineAfter = getOptionalConfigUnsignedInteger( "PROBE_QUARANTINE_AFTER", 5 );
+    unsigned int readTimeout = getOptionalConfigUnsignedInteger( "READ_TIMEOUT", 250 );
+    std::string latencyProfile = getOptionalConfigString( "LATENCY_PROFILE", "default" );
+    std::string latencyProfileFile = getOptionalConfigString( "LATENCY_PROFILE_FILE", "" );
+    std::string serialParametersFile = getOptionalConfigString( "SERIAL_PARAMETERS_FILE", "" );
+    std::string baudEscalationCommand = getOptionalConfigString( "BAUD_ESCALATION_COMMAND", "" );
+    unsigned int baudEscalationRate = getOptionalConfigUnsignedInteger( "BAUD_ESCALATION_RATE", 0 );
+    std::string flowControl = getOptionalConfigString( "FLOW_CONTROL", "none" );
+    unsigned int lineErrorInterval = getOptionalConfigUnsignedInteger( "LINE_ERROR_INTERVAL", 1000 );
+    std::string handoverSocket = getOptionalConfigString( "HANDOVER_SOCKET", "" );
+    unsigned int stopTimeout = getOptionalConfigUnsignedInteger( "STOP_TIMEOUT", 5000 );
+    unsigned int eventBusCapacity = getOptionalConfigUnsignedInteger( "EVENT_BUS_CAPACITY", 0 );
+
+    setLoggingActive( loggingActive );
+    setScanInterval( scanInterval );
+    setWaitBeforeCommunication( waitBeforeCommunication );
+    setBaudRate( baudRate );
+    setMessageDelimiter( messageDelimiter );
+    setCommandToGetDeviceId( commandToGetDeviceId );
+    setMessageTypeForIds( messageTypeForIds );
+    setMessageSchemaFile( messageSchemaFile );
+    setSchemaFieldDelimiter( schemaFieldDelimiter );
+    setAsyncLoggingActive( asyncLoggingActive );
+    setAsyncLoggingCapacity( asyncLoggingCapacity );
+    setMetricsUnixSocket( metricsUnixSocket );
+    setMetricsPort( metricsPort );
+    setTracingActive( tracingActive );
+    setTracingBufferSize( tracingBufferSize );
+    setCallbackBudget( callbackBudget );
+    setCallbackSlowStreak( callbackSlowStreak );
+    setIsolatedLaneThreads( isolatedLaneThreads );
+    setMessageThreads( messageThreads );
+    setSendThreads( sendThreads );
+    setInboundQueueCapacity( inboundQueueCapacity );
+    setOutboundBufferCapacity( outboundBufferCapacity );
+    setOutboundBufferBytes( outboundBufferBytes );
+    setOutboundBufferTtl( outboundBufferTtl );
+    setIdentityCacheFile( identityCacheFile );
+    setIdentityVerifyTimeout( identityVerifyTimeout );
+    setAdaptiveHandshakeActive( adaptiveHandshakeActive );
+    setHandshakeRetryInterval( handshakeRetryInterval );
+    setHandshakeDeadline( handshakeDeadline );
+    setResetControlFile( resetControlFile );
+    setProbeBackoff( probeBackoff );
+    setProbeBackoffMax( probeBackoffMax );
+    setProbeQuarantineAfter( probeQuarantineAfter );
+    setLatencyProfileFile( latencyProfileFile );
+    setSerialParametersFile( serialParametersFile );
+    setBaudEscalationCommand( baudEscalationCommand );
+    setBaudEscalationRate( baudEscalationRate );
+    setLineErrorInterval( lineErrorInterval );
+    setHandoverSocket( handoverSocket );
+    setStopTimeout( stopTimeout );
+    setEventBusCapacity( eventBusCapacity );
+
+    LatencyProfile baseLatencyProfile;
+    baseLatencyProfile.readTimeout = readTimeout;
+
+    try
+    {
+        setLogLevel( StructuredLogger::parseLevel( logLevel ) );
+        setInboundOverflowPolicy( InboundQueue::parseOverflowPolicy( inboundOverflowPolicy ) );
+        setDefaultLatencyProfile( LatencyProfile::parse( latencyProfile, baseLatencyProfile ) );
+        setFlowControl( SerialParameters::parseFlowControl( flowControl ) );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        throw Exception( std::string( e.what() ) );
+    }
+}
+
+std::string SerialPortGateway::getOptionalConfigString( std::string key, std::string defaultValue )
+{
+    try
+    {
+        return getConfigInstance()->getString( key );
+    }
+    catch ( ConfigKeyNotFoundException & e )
+    {
+        return defaultValue;
+    }
+}
+
+unsigned int SerialPortGateway::getOptionalConfigUnsignedInteger( std::string key, unsigned int defaultValue )
+{
+    try
+    {
+        return getConfigInstance()->getUnsignedInteger( key );
+    }
+    catch ( ConfigKeyNotFoundException & e )
+    {
+        return defaultValue;
+    }
+}
+
+bool SerialPortGateway::getOptionalConfigBool( std::string key, bool defaultValue )
+{
+    try
+    {
+        return getConfigInstance()->getBool( key );
+    }
+    catch ( ConfigKeyNotFoundException & e )
+    {
+        return defaultValue;
+    }
+}
+
+void SerialPortGateway::deleteConfigInstance()
+{
+    delete getConfigInstance();
+}
+
+void SerialPortGateway::setLoggerInstance( Logger * loggerInstance )
+{
+    if ( loggerInstance == nullptr )
+    {
+        throw Exception( "Logger instance must not be null." );
+    }
+
+    this->loggerInstance = loggerInstance;
+}
+
+Logger * SerialPortGateway::getLoggerInstance()
+{
+    return this->loggerInstance;
+}
+
+void SerialPortGateway::initLogger()
+{
+    Logger * logger = new Logger( "SerialPortGateway", getLogPath(), true, isLoggingActive(), true );
+    logger->writeInfo( "Logger initialized." );
+
+    setLoggerInstance( logger );
+
+    if ( isAsyncLoggingActive() )
+    {
+        AsyncLogger * asyncLogger = new AsyncLogger( "SerialPortGateway", getLogPath(), true, isLoggingActive(), getAsyncLoggingCapacity() );
+        asyncLogger->start();
+
+        setAsyncLoggerInstance( asyncLogger );
+
+        logger->writeInfo( "Async logging active; Gateway logs are written in batches by a background thread." );
+    }
+
+    setStructuredLoggerInstance( new StructuredLogger( logger, getAsyncLoggerInstance(), getLogLevel() ) );
+}
+
+void SerialPortGateway::deleteLoggerInstance()
+{
+    delete getStructuredLoggerInstance();
+    delete getAsyncLoggerInstance(); // Stops the async logger, which flushes all pending records
+    delete getLoggerInstance();
+}
+
+void SerialPortGateway::setAsyncLoggerInstance( AsyncLogger * asyncLoggerInstance )
+{
+    this->asyncLoggerInstance = asyncLoggerInstance;
+}
+
+AsyncLogger * SerialPortGateway::getAsyncLoggerInstance()
+{
+    return this->asyncLoggerInstance;
+}
+
+void SerialPortGateway::setStructuredLoggerInstance( StructuredLogger * structuredLoggerInstance )
+{
+    if ( structuredLoggerInstance == nullptr )
+    {
+        throw Exception( "Structured logger instance must not be null." );
+    }
+
+    this->structuredLoggerInstance = structuredLoggerInstance;
+}
+
+StructuredLogger * SerialPortGateway::getStructuredLoggerInstance()
+{
+    return this->structuredLoggerInstance;
+}
+
+unsigned long long SerialPortGateway::getDroppedLogCount()
+{
+    if ( AsyncLogger * asyncLogger = getAsyncLoggerInstance() )
+    {
+        return asyncLogger->getDroppedCount();
+    }
+
+    return 0;
+}
+
+void SerialPortGateway::initMetricsExporter()
+{
+    if ( getMetricsUnixSocket().empty() && getMetricsPort() == 0 )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "No metrics socket or port given. (Metrics are not exported.)" );
+
+        return;
+    }
+
+    setPrometheusExporterInstance( new PrometheusExporter( std::bind( &SerialPortGateway::getMetricsSnapshot, this ), getMetricsUnixSocket(), getMetricsPort() ) );
+}
+
+void SerialPortGateway::deleteMetricsExporterInstance()
+{
+    delete getPrometheusExporterInstance(); // Stops the exporter
+    setPrometheusExporterInstance( nullptr );
+}
+
+void SerialPortGateway::setPrometheusExporterInstance( PrometheusExporter * prometheusExporterInstance )
+{
+    this->prometheusExporterInstance = prometheusExporterInstance;
+}
+
+PrometheusExporter * SerialPortGateway::getPrometheusExporterInstance()
+{
+    return this->prometheusExporterInstance;
+}
+
+void SerialPortGateway::initDeviceHandover()
+{
+    if ( getHandoverSocket().empty() )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "No handover socket given. (Devices are not handed over.)" );
+
+        return;
+    }
+
+    setDeviceHandoverInstance( new DeviceHandover( getHandoverSocket(), std::bind( &SerialPortGateway::provideHandoverDevices, this, std::placeholders::_1 ), std::bind( &SerialPortGateway::completeHandover, this, std::placeholders::_1, std::placeholders::_2 ) ) );
+}
+
+void SerialPortGateway::deleteDeviceHandoverInstance()
+{
+    delete getDeviceHandoverInstance(); // Stops serving handovers
+    setDeviceHandoverInstance( nullptr );
+}
+
+void SerialPortGateway::setDeviceHandoverInstance( DeviceHandover * deviceHandoverInstance )
+{
+    this->deviceHandoverInstance = deviceHandoverInstance;
+}
+
+DeviceHandover * SerialPortGateway::getDeviceHandoverInstance()
+{
+    return this->deviceHandoverInstance;
+}
+
+void SerialPortGateway::initTracer()
+{
+    setStageTracerInstance( new StageTracer( isTracingActive(), getTracingBufferSize() ) );
+
+    if ( isTracingActive() )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Stage tracing active", logField( "bufferSize", getTracingBufferSize() ) );
+    }
+}
+
+void SerialPortGateway::deleteTracerInstance()
+{
+    delete getStageTracerInstance();
+}
+
+void SerialPortGateway::setStageTracerInstance( StageTracer * stageTracerInstance )
+{
+    if ( stageTracerInstance == nullptr )
+    {
+        throw Exception( "Stage tracer instance must not be null." );
+    }
+
+    this->stageTracerInstance = stageTracerInstance;
+}
+
+StageTracer * SerialPortGateway::getStageTracerInstance()
+{
+    return this->stageTracerInstance;
+}
+
+void SerialPortGateway::initEventBus()
+{
+    if ( getEventBusCapacity() == 0 )
+    {
+        return;
+    }
+
+    setEventBusInstance( new EventBus( getEventBusCapacity() ) );
+
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Event bus active", logField( "capacity", getEventBusInstance()->getCapacity() ) );
+}
+
+void SerialPortGateway::deleteEventBusInstance()
+{
+    delete getEventBusInstance();
+    setEventBusInstance( nullptr );
+}
+
+void SerialPortGateway::setEventBusInstance( EventBus * eventBusInstance )
+{
+    this->eventBusInstance = eventBusInstance;
+}
+
+EventBus * SerialPortGateway::getEventBusInstance()
+{
+    return this->eventBusInstance;
+}
+
+void SerialPortGateway::initSerialTransportFactory()
+{
+    setSerialTransportFactoryInstance( new SerialLibraryTransportFactory() );
+}
+
+void SerialPortGateway::deleteSerialTransportFactoryInstance()
+{
+    delete getSerialTransportFactoryInstance();
+}
+
+void SerialPortGateway::setSerialTransportFactoryInstance( SerialTransportFactory * serialTransportFactoryInstance )
+{
+    if ( serialTransportFactoryInstance == nullptr )
+    {
+        throw Exception( "Serial transport factory instance must not be null." );
+    }
+
+    this->serialTransportFactoryInstance = serialTransportFactoryInstance;
+}
+
+SerialTransportFactory * SerialPortGateway::getSerialTransportFactoryInstance()
+{
+    return this->serialTransportFactoryInstance;
+}
+
+void SerialPortGateway::useSerialTransportFactory( SerialTransportFactory * serialTransportFactory )
+{
+    bool serialDevicesEmpty;
+
+    {
+        std::lock_guard<std::mutex> lock( serialDevicesMutex );
+        serialDevicesEmpty = getSerialDevices()->empty();
+    }
+
+    if ( isStarted() || !serialDevicesEmpty )
+    {
+        throw Exception( "The serial transport factory can only be replaced while the gateway is stopped and no devices are added." );
+    }
+
+    SerialTransportFactory * previous = getSerialTransportFactoryInstance();
+    setSerialTransportFactoryInstance( serialTransportFactory );
+
+    delete previous;
+}
+
+void SerialPortGateway::initCallbackDispatcher()
+{
+    setCallbackDispatcherInstance( new CallbackDispatcher( getCallbackBudget(), getCallbackSlowStreak(), getIsolatedLaneThreads(), getStructuredLoggerInstance() ) );
+
+    if ( getCallbackBudget() > 0 )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Slow callback detection active", logField( "budgetMs", getCallbackBudget() ), logField( "slowStreak", getCallbackSlowStreak() ), logField( "isolatedLaneThreads", getIsolatedLaneThreads() ) );
+    }
+}
+
+void SerialPortGateway::deleteCallbackDispatcherInstance()
+{
+    delete getCallbackDispatcherInstance(); // Stops the isolated lane
+}
+
+void SerialPortGateway::setCallbackDispatcherInstance( CallbackDispatcher * callbackDispatcherInstance )
+{
+    if ( callbackDispatcherInstance == nullptr )
+    {
+        throw Exception( "Callback dispatcher instance must not be null." );
+    }
+
+    this->callbackDispatcherInstance = callbackDispatcherInstance;
+}
+
+CallbackDispatcher * SerialPortGateway::getCallbackDispatcherInstance()
+{
+    return this->callbackDispatcherInstance;
+}
+
+void SerialPortGateway::initWorkerPools()
+{
+    // The jobs are reused, so their metrics get released once they're done; An unregistered device's metrics aren't held by a job which ran long ago
+    setMessageWorkerPoolInstance( new MessageWorkerPool( getMessageThreads(), WORKER_QUEUE_CAPACITY, [this]( LineJob & job )
+    {
+        processMessage( job.deviceId, job.line, job.readTime, job.deviceMetrics, job.traceContext );
+        job.deviceMetrics = nullptr;
+    } ) );
+
+    setSendWorkerPoolInstance( new SendWorkerPool( getSendThreads(), WORKER_QUEUE_CAPACITY, [this]( SendJob & job )
+    {
+        sendMessageToSerialDeviceBlocking( job.deviceId, job.message, job.requestTime, job.deviceMetrics );
+        job.deviceMetrics = nullptr;
+    } ) );
+}
+
+void SerialPortGateway::deleteMessageWorkerPoolInstance()
+{
+    delete getMessageWorkerPoolInstance(); // Processes the queued messages first
+    this->messageWorkerPoolInstance = nullptr;
+}
+
+void SerialPortGateway::deleteSendWorkerPoolInstance()
+{
+    delete getSendWorkerPoolInstance(); // Sends the queued messages first
+    this->sendWorkerPoolInstance = nullptr;
+}
+
+void SerialPortGateway::setMessageWorkerPoolInstance( MessageWorkerPool * messageWorkerPoolInstance )
+{
+    if ( messageWorkerPoolInstance == nullptr )
+    {
+        throw Exception( "Message worker pool instance must not be null." );
+    }
+
+    this->messageWorkerPoolInstance = messageWorkerPoolInstance;
+}
+
+SerialPortGateway::MessageWorkerPool * SerialPortGateway::getMessageWorkerPoolInstance()
+{
+    return this->messageWorkerPoolInstance;
+}
+
+void SerialPortGateway::setSendWorkerPoolInstance( SendWorkerPool * sendWorkerPoolInstance )
+{
+    if ( sendWorkerPoolInstance == nullptr )
+    {
+        throw Exception( "Send worker pool instance must not be null." );
+    }
+
+    this->sendWorkerPoolInstance = sendWorkerPoolInstance;
+}
+
+SerialPortGateway::SendWorkerPool * SerialPortGateway::getSendWorkerPoolInstance()
+{
+    return this->sendWorkerPoolInstance;
+}
+
+void SerialPortGateway::initOutboundBuffer()
+{
+    setOutboundBufferInstance( new OutboundBuffer( getOutboundBufferCapacity(), getOutboundBufferBytes(), getOutboundBufferTtl() ) );
+
+    if ( getOutboundBufferCapacity() > 0 )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Store and forward active", logField( "capacity", getOutboundBufferCapacity() ), logField( "bytes", getOutboundBufferBytes() ), logField( "ttlMs", getOutboundBufferTtl() ) );
+    }
+}
+
+void SerialPortGateway::deleteOutboundBufferInstance()
+{
+    delete getOutboundBufferInstance();
+}
+
+void SerialPortGateway::setOutboundBufferInstance( OutboundBuffer * outboundBufferInstance )
+{
+    if ( outboundBufferInstance == nullptr )
+    {
+        throw Exception( "Outbound buffer instance must not be null." );
+    }
+
+    this->outboundBufferInstance = outboundBufferInstance;
+}
+
+OutboundBuffer * SerialPortGateway::getOutboundBufferInstance()
+{
+    return this->outboundBufferInstance;
+}
+
+void SerialPortGateway::initProbeScheduler()
+{
+    setProbeSchedulerInstance( new ProbeScheduler( getProbeBackoff(), getProbeBackoffMax(), getProbeQuarantineAfter() ) );
+
+    if ( getProbeBackoff() > 0 )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Probe backoff active", logField( "backoffMs", getProbeBackoff() ), logField( "maxBackoffMs", getProbeBackoffMax() ), logField( "quarantineAfter", getProbeQuarantineAfter() ) );
+    }
+}
+
+void SerialPortGateway::deleteProbeSchedulerInstance()
+{
+    delete getProbeSchedulerInstance();
+}
+
+void SerialPortGateway::setProbeSchedulerInstance( ProbeScheduler * probeSchedulerInstance )
+{
+    if ( probeSchedulerInstance == nullptr )
+    {
+        throw Exception( "Probe scheduler instance must not be null." );
+    }
+
+    this->probeSchedulerInstance = probeSchedulerInstance;
+}
+
+ProbeScheduler * SerialPortGateway::getProbeSchedulerInstance()
+{
+    return this->probeSchedulerInstance;
+}
+
+std::string SerialPortGateway::getPortIdentity( const serial::PortInfo & serialPortInfo )
+{
+    return serialPortInfo.description + CHAR_SPACE + serialPortInfo.hardware_id;
+}
+
+void SerialPortGateway::recordFailedProbe( std::string serialPort )
+{
+    ProbeScheduler * probeScheduler = getProbeSchedulerInstance();
+
+    if ( !probeScheduler->isActive() )
+    {
+        return;
+    }
+
+    for ( serial::PortInfo const & serialPortInfo : getSerialTransportFactoryInstance()->listPorts() )
+    {
+        if ( serialPortInfo.port == serialPort )
+        {
+            ProbeRecord probeRecord = probeScheduler->recordFailure( serialPort, getPortIdentity( serialPortInfo ), std::chrono::steady_clock::now() );
+
+            if ( probeRecord.quarantined && probeRecord.failures == getProbeQuarantineAfter() )
+            {
+                SPG_LOG_WARN( getStructuredLoggerInstance(), "Quarantined serial port, because probing it failed repeatedly", logField( "port", serialPort ), logField( "failures", probeRecord.failures ), logField( "identity", probeRecord.identity ) );
+            }
+
+            return;
+        }
+    }
+}
+
+void SerialPortGateway::initDeviceIdentityCache()
+{
+    if ( getIdentityCacheFile().empty() )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "No identity cache file given. (Every device gets asked for its ID before it gets added.)" );
+
+        return;
+    }
+
+    DeviceIdentityCache * deviceIdentityCache = new DeviceIdentityCache( getIdentityCacheFile() );
+    setDeviceIdentityCacheInstance( deviceIdentityCache );
+
+    // A broken cache only costs the fast path, so it's no reason to not start
+    if ( deviceIdentityCache->load() )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Loaded identity cache", logField( "file", getIdentityCacheFile() ), logField( "entries", deviceIdentityCache->getSize() ) );
+    }
+    else
+    {
+        SPG_LOG_WARN( getStructuredLoggerInstance(), "Identity cache is unreadable or corrupt, starting with an empty one", logField( "file", getIdentityCacheFile() ) );
+    }
+}
+
+void SerialPortGateway::deleteDeviceIdentityCacheInstance()
+{
+    delete getDeviceIdentityCacheInstance();
+    setDeviceIdentityCacheInstance( nullptr );
+}
+
+void SerialPortGateway::setDeviceIdentityCacheInstance( DeviceIdentityCache * deviceIdentityCacheInstance )
+{
+    this->deviceIdentityCacheInstance = deviceIdentityCacheInstance;
+}
+
+DeviceIdentityCache * SerialPortGateway::getDeviceIdentityCacheInstance()
+{
+    return this->deviceIdentityCacheInstance;
+}
+
+std::string SerialPortGateway::getIdentityKey( std::string serialPort )
+{
+    for ( serial::PortInfo const & serialPortInfo : getSerialTransportFactoryInstance()->listPorts() )
+    {
+        if ( serialPortInfo.port == serialPort )
+        {
+            // E.g. "USB VID:PID=2341:0042 SNR=85438333935351F01180"; Without a serial number, identical devices can't be told apart
+            if ( serialPortInfo.hardware_id.find( "SNR=" ) == std::string::npos )
+            {
+                return "";
+            }
+
+            // Serial numbers aren't always unique (e.g. cloned FTDI chips); The device path tells apart where the device is plugged in
+            std::string sysfsDevicePath = getSysfsDevicePath( serialPort );
+
+            if ( sysfsDevicePath.empty() )
+            {
+                return "";
+            }
+
+            return serialPort + CHAR_SPACE + sysfsDevicePath + CHAR_SPACE + serialPortInfo.hardware_id;
+        }
+    }
+
+    return "";
+}
+
+std::string SerialPortGateway::getSysfsDevicePath( std::string serialPort )
+{
+    char path[PATH_MAX];
+
+    // The port may be a link, e.g. /dev/serial/by-id/...; sysfs knows the tty by its name
+    if ( realpath( serialPort.c_str(), path ) == nullptr )
+    {
+        return "";
+    }
+
+    std::string deviceName = path;
+    deviceName = deviceName.substr( deviceName.find_last_of( '/' ) + 1 );
+
+    if ( realpath( ( "/sys/class/tty/" + deviceName + "/device" ).c_str(), path ) == nullptr )
+    {
+        return "";
+    }
+
+    return path;
+}
+
+void SerialPortGateway::loadHardwareWhitelist()
+{
+    std::string fileName = getHardwareWhitelistFile();
+
+    if ( fileName.empty() )
+    {
+        throw Exception( "Path to Hardware-ID Whitelist must not be empty." );
+    }
+
+    std::ifstream fileStream( fileName, std::ifstream::out | std::ifstream::app );
+
+    if ( !fileStream.is_open() )
+    {
+        throw Exception( "Couldn't open Hardware-ID Whitelist. (Path: \"" + fileName + "\")" );
+    }
+
+    std::string line;
+
+    while ( std::getline( fileStream, line ) )
+    {
+        getHardwareWhitelist()->insert( line );
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Whitelisted Hardware-ID", logField( "hardwareId", line ) );
+    }
+
+    fileStream.close();
+
+    if ( isHardwareWhitelistEmpty() )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Hardware Whitelist is empty, which means that no whitelist-checks will be performed." );
+    }
+}
+
+SerialPortGateway::StringSet * SerialPortGateway::getHardwareWhitelist()
+{
+    return &hardwareWhitelist;
+}
+
+bool SerialPortGateway::isHardwareWhitelistEmpty()
+{
+    return getHardwareWhitelist()->empty();
+}
+
+bool SerialPortGateway::hasHardwareWhitelistEntry( std::string hardwareId )
+{
+    StringSet * hardwareWhitelist = getHardwareWhitelist();
+
+    if ( hardwareWhitelist->find( hardwareId ) != hardwareWhitelist->end() )
+    {
+        return true;
+    }
+
+    return false;
+}
+
+std::string SerialPortGateway::getHardwareId( std::string serialPort )
+{
+    // The sysfs information returns a string which contains the hardwareId
+    // Inside this string, the hardwareId is formatted as followed (if it exists): "[...] VID:PID=<4 character long VID>:<4 character long PID> [...]"
+    // Examples: "[...] USB VID:PID=1a86:7523 " or "[...] USB VID:PID=2341:0042 SNR=85438333935351F01180 [...]"
+    // -> We only need the characters after the key ("VID:PID="), until the next blank space (" ")
+
+    std::string hardwareId;
+
+    // VERY VERY VEEEEERY ugly workaround for getting the hardwareId, until we have another RELIABLE solution for this (e.g. a new, better [proably self-written] serial library)
+    // Unfortunately the serial libraries' "get_sysfs_info" function wasn't exposed, with which we could've done this directly. Without this ugly loop-workaround..
+    // (The ports get listed by the transport factory, so other transports can report hardware IDs as well.)
+    for ( serial::PortInfo const & serialPortInfo : getSerialTransportFactoryInstance()->listPorts() )
+    {
+        if ( serialPortInfo.port == serialPort )
+        {
+            hardwareId = serialPortInfo.hardware_id;
+
+            break;
+        }
+    }
+
+    std::string key = "VID:PID=";
+    std::size_t keyPosition = hardwareId.find( key );
+    std::size_t valuePosition = keyPosition + key.length();
+    std::size_t hardwareIdLength = hardwareId.find_first_of( " ", valuePosition ) - valuePosition;
+
+    if ( keyPosition != std::string::npos && hardwareIdLength != std::string::npos )
+    {
+        hardwareId = hardwareId.substr( valuePosition, hardwareIdLength );
+
+        return hardwareId;
+    }
+    else
+    {
+        return "";
+    }
+}
+
+void SerialPortGateway::loadSerialPortBlacklist()
+{
+    std::string fileName = getSerialPortBlacklistFile();
+
+    if ( fileName.empty() )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "No Serial Port Blacklist given. (No ports will be ignored while scanning.)" );
+
+        return;
+    }
+
+    std::ifstream fileStream( fileName, std::ifstream::out | std::ifstream::app );
+
+    if ( !fileStream.is_open() )
+    {
+        throw Exception( "Couldn't open Serial Port Blacklist. (Path: \"" + fileName + "\")" );
+    }
+
+    std::string line;
+
+    while ( std::getline( fileStream, line ) )
+    {
+        getSerialPortBlacklist()->insert( line );
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Blacklisted Serial Port", logField( "port", line ) );
+    }
+
+    fileStream.close();
+}
+
+SerialPortGateway::StringSet * SerialPortGateway::getSerialPortBlacklist()
+{
+    return &serialPortBlacklist;
+}
+
+bool SerialPortGateway::isSerialPortBlacklistEmpty()
+{
+    return getSerialPortBlacklist()->empty();
+}
+
+bool SerialPortGateway::hasSerialPortBlacklistEntry( std::string serialPort )
+{
+    StringSet * serialPortBlacklist = getSerialPortBlacklist();
+
+    if ( serialPortBlacklist->find( serialPort ) != serialPortBlacklist->end() )
+    {
+        return true;
+    }
+
+    return false;
+}
+
+void SerialPortGateway::parseConfigFile( std::string fileName, std::string fileDescription, std::string format, ConfigLineHandler lineHandler )
+{
+    std::ifstream fileStream( fileName );
+
+    if ( !fileStream.is_open() )
+    {
+        throw Exception( "Couldn't open " + fileDescription + ". (Path: \"" + fileName + "\")" );
+    }
+
+    std::string line;
+
+    while ( std::getline( fileStream, line ) )
+    {
+        if ( line.empty() || line.compare( 0, CHAR_COMMENT.length(), CHAR_COMMENT ) == 0 )
+        {
+            continue;
+        }
+
+        std::size_t separatorPosition = line.find( SCHEMA_TYPE_SEPARATOR );
+
+        if ( separatorPosition == std::string::npos )
+        {
+            throw Exception( "Malformed line in " + fileDescription + ": \"" + line + "\". (Format: \"" + format + "\")" );
+        }
+
+        try
+        {
+            lineHandler( line.substr( 0, separatorPosition ), line.substr( separatorPosition + SCHEMA_TYPE_SEPARATOR.length() ) );
+        }
+        catch ( const std::invalid_argument & e )
+        {
+            throw Exception( "Malformed line in " + fileDescription + ": " + std::string( e.what() ) );
+        }
+    }
+
+    fileStream.close();
+}
+
+void SerialPortGateway::loadMessageSchemas()
+{
+    std::string fileName = getMessageSchemaFile();
+
+    if ( fileName.empty() )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "No Message Schema File given. (Messages will not be extracted into fields.)" );
+
+        return;
+    }
+
+    parseConfigFile( fileName, "Message Schema File", "<type>=<name>:<fieldType>,...", [this]( std::string type, std::string declaration )
+    {
+        ( * getMessageSchemas() )[type] = std::make_shared<MessageSchema>( type, declaration );
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Loaded message schema", logField( "type", type ), logField( "schema", declaration ) );
+    } );
+}
+
+SerialPortGateway::MessageSchemaMap * SerialPortGateway::getMessageSchemas()
+{
+    return &messageSchemas;
+}
+
+const MessageSchema * SerialPortGateway::getMessageSchema( std::string type )
+{
+    MessageSchemaMap * messageSchemas = getMessageSchemas();
+    MessageSchemaMap::iterator it = messageSchemas->find( type );
+
+    if ( it != messageSchemas->end() )
+    {
+        return it->second.get();
+    }
+
+    return nullptr;
+}
+
+void SerialPortGateway::loadResetControls()
+{
+    std::string fileName = getResetControlFile();
+
+    if ( fileName.empty() )
+    {
+        return;
+    }
+
+    parseConfigFile( fileName, "Reset Control File", "<port or VID:PID>=<reset|hold|release>", [this]( std::string target, std::string name )
+    {
+        ( * getResetControls() )[target] = SerialDevice::parseResetControl( name );
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Loaded reset control", logField( "target", target ), logField( "resetControl", name ) );
+    } );
+}
+
+SerialPortGateway::ResetControlMap * SerialPortGateway::getResetControls()
+{
+    return &resetControls;
+}
+
+ResetControl SerialPortGateway::getResetControl( std::string serialPort )
+{
+    ResetControlMap * resetControls = getResetControls();
+
+    if ( resetControls->empty() )
+    {
+        return ResetControl::RESET_ON_OPEN;
+    }
+
+    ResetControlMap::iterator it = resetControls->find( serialPort );
+
+    if ( it == resetControls->end() )
+    {
+        it = resetControls->find( getHardwareId( serialPort ) );
+    }
+
+    if ( it != resetControls->end() )
+    {
+        return it->second;
+    }
+
+    return ResetControl::RESET_ON_OPEN;
+}
+
+void SerialPortGateway::loadLatencyProfiles()
+{
+    std::string fileName = getLatencyProfileFile();
+
+    if ( fileName.empty() )
+    {
+        return;
+    }
+
+    parseConfigFile( fileName, "Latency Profile File", "<port or VID:PID>=<settings>", [this]( std::string target, std::string settings )
+    {
+        LatencyProfile latencyProfile = LatencyProfile::parse( settings, getDefaultLatencyProfile() );
+        ( * getLatencyProfiles() )[target] = latencyProfile;
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Loaded latency profile", logField( "target", target ), logField( "latencyProfile", latencyProfile.toString() ) );
+    } );
+}
+
+SerialPortGateway::LatencyProfileMap * SerialPortGateway::getLatencyProfiles()
+{
+    return &latencyProfiles;
+}
+
+LatencyProfile SerialPortGateway::getLatencyProfile( std::string serialPort )
+{
+    LatencyProfileMap * latencyProfiles = getLatencyProfiles();
+
+    if ( latencyProfiles->empty() )
+    {
+        return getDefaultLatencyProfile();
+    }
+
+    LatencyProfileMap::iterator it = latencyProfiles->find( serialPort );
+
+    if ( it == latencyProfiles->end() )
+    {
+        it = latencyProfiles->find( getHardwareId( serialPort ) );
+    }
+
+    if ( it != latencyProfiles->end() )
+    {
+        return it->second;
+    }
+
+    return getDefaultLatencyProfile();
+}
+
+void SerialPortGateway::loadSerialParameters()
+{
+    std::string fileName = getSerialParametersFile();
+
+    if ( fileName.empty() )
+    {
+        return;
+    }
+
+    parseConfigFile( fileName, "Serial Parameters File", "<port, VID:PID or device ID>=<settings>", [this]( std::string target, std::string settings )
+    {
+        SerialParameters serialParameters = SerialParameters::parse( settings, getDefaultSerialParameters() );
+        ( * getDeclaredSerialParameters() )[target] = serialParameters;
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Loaded serial parameters", logField( "target", target ), logField( "serialParameters", serialParameters.toString() ) );
+    } );
+}
+
+SerialPortGateway::SerialParametersMap * SerialPortGateway::getDeclaredSerialParameters()
+{
+    return &declaredSerialParameters;
+}
+
+SerialParameters SerialPortGateway::getDefaultSerialParameters()
+{
+    SerialParameters serialParameters;
+    serialParameters.baudRate = getBaudRate();
+    serialParameters.flowControl = getFlowControl();
+    serialParameters.escalationBaudRate = getBaudEscalationRate();
+
+    return serialParameters;
+}
+
+SerialParameters SerialPortGateway::getSerialParameters( std::string serialPort )
+{
+    SerialParametersMap * declaredSerialParameters = getDeclaredSerialParameters();
+
+    if ( declaredSerialParameters->empty() )
+    {
+        return getDefaultSerialParameters();
+    }
+
+    SerialParametersMap::iterator it = declaredSerialParameters->find( serialPort );
+
+    if ( it == declaredSerialParameters->end() )
+    {
+        it = declaredSerialParameters->find( getHardwareId( serialPort ) );
+    }
+
+    if ( it != declaredSerialParameters->end() )
+    {
+        return it->second;
+    }
+
+    return getDefaultSerialParameters();
+}
+
+BootDelayTracker * SerialPortGateway::getBootDelayTracker()
+{
+    return &bootDelays;
+}
+
+GatewayMetrics * SerialPortGateway::getMetrics()
+{
+    return &metrics;
+}
+
+unsigned long long SerialPortGateway::getMicrosecondsSince( SteadyTimePoint timePoint )
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - timePoint ).count();
+}
+
+SerialPortGateway::SerialDeviceMap * SerialPortGateway::getSerialDevices()
+{
+    return &serialDevices;
+}
+
+SerialPortGateway::AtomicBoolPairMap * SerialPortGateway::getReadLoopStates()
+{
+    return &readLoopStates;
+}
+
+bool SerialPortGateway::addSerialDevice( std::string serialPort, bool suppressLogs )
+{
+    // The devices are being handed over; Whatever isn't part of it gets found by the successor's scan
+    if ( handoverActive || stopping )
+    {
+        return false;
+    }
+
+    if ( !getSerialTransportFactoryInstance()->hasPort( serialPort ) )
+    {
+        SPG_LOG_WARN( getStructuredLoggerInstance(), "Couldn't add serial device, because the port doesn't exist or can not be accessed", logField( "port", serialPort ) );
+
+        return false;
+    }
+
+    if ( SerialDevicePointer tempSerialDevice = getSerialDeviceByPort( serialPort ) )
+    {
+        if ( !suppressLogs )
+        {
+            SPG_LOG_WARN( getStructuredLoggerInstance(), "Couldn't add serial device, because the port has already been registered", logField( "port", serialPort ), logField( "deviceId", tempSerialDevice->getId() ) );
+        }
+
+        return false;
+    }
+
+    if ( hasSerialPortBlacklistEntry( serialPort ) )
+    {
+        if ( !suppressLogs )
+        {
+            SPG_LOG_WARN( getStructuredLoggerInstance(), "Didn't add serial device, because the port is blacklisted", logField( "port", serialPort ) );
+        }
+
+        return false;
+    }
+
+    if ( !isHardwareWhitelistEmpty() )
+    {
+        std::string hardwareId = getHardwareId( serialPort );
+
+        if ( hardwareId.empty() )
+        {
+            if ( !suppressLogs )
+            {
+                SPG_LOG_WARN( getStructuredLoggerInstance(), "Couldn't add serial device, because the Hardware ID could not be retrieved", logField( "port", serialPort ) );
+            }
+
+            return false;
+        }
+
+        if ( !hasHardwareWhitelistEntry( hardwareId ) )
+        {
+            if ( !suppressLogs )
+            {
+                SPG_LOG_WARN( getStructuredLoggerInstance(), "Didn't add serial device, because the Hardware ID is not whitelisted", logField( "port", serialPort ), logField( "hardwareId", hardwareId ) );
+            }
+
+            return false;
+        }
+
+    }
+
+    std::string identityKey;
+    std::string cachedDeviceId;
+
+    if ( DeviceIdentityCache * deviceIdentityCache = getDeviceIdentityCacheInstance() )
+    {
+        identityKey = getIdentityKey( serialPort );
+        cachedDeviceId = identityKey.empty() ? "" : deviceIdentityCache->lookup( identityKey );
+    }
+
+    LatencyProfile latencyProfile = getLatencyProfile( serialPort );
+    SerialDevicePointer serialDevice = std::make_shared<SerialDevice>( serialPort, getBaudRate(), serial::Timeout::simpleTimeout( latencyProfile.readTimeout ) );
+    serialDevice->setSerialParameters( getSerialParameters( serialPort ) );
+    serialDevice->setResetControl( getResetControl( serialPort ) );
+    serialDevice->setLatencyProfile( latencyProfile );
+
+    if ( !initSerialDevice( serialDevice, cachedDeviceId ) )
+    {
+        recordFailedProbe( serialPort );
+
+        return false;
+    }
+
+    getProbeSchedulerInstance()->recordSuccess( serialPort );
+
+    std::string deviceId = serialDevice->getId();
+    SerialDeviceMap * serialDevices = getSerialDevices();
+    std::unique_lock<std::mutex> lock( serialDevicesMutex );
+
+    // Checked again, since identifying the device may have taken seconds; A handover must neither miss the device, nor share it with the successor
+    if ( handoverActive || stopping )
+    {
+        lock.unlock();
+        serialDevice->getInstance()->close();
+
+        return false;
+    }
+
+    SerialDeviceMap::iterator it = serialDevices->find( deviceId );
 
     if ( it == serialDevices->end() )
     {
-        ( * serialDevices )[deviceId] = serialDevice;
+        // From the moment the device can be found, sends get buffered behind the ones to be forwarded; With a cached ID, until it's verified
+        bool forwarding = cachedDeviceId.empty() && getOutboundBufferInstance()->startForwarding( deviceId );
+
+        if ( !cachedDeviceId.empty() )
+        {
+            std::lock_guard<std::mutex> identityLock( identityVerificationsMutex );
+            identityVerifications[deviceId] = IdentityVerification::PENDING;
+            identityVerificationCount = identityVerifications.size();
+        }
+
+        ( * serialDevices )[deviceId] = serialDevice;
+        getMetrics()->registerDevice( deviceId, serialPort );
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Added Serial Device", logField( "deviceId", deviceId ), logField( "port", serialPort ) );
+
+        if ( EventBus * eventBus = getEventBusInstance() )
+        {
+            eventBus->publishDeviceAdded( deviceId, serialPort ); // Before the read loop starts, so it precedes the device's messages
+        }
+
+        threads.spawn( std::bind( &SerialPortGateway::serialDeviceAddedCallback, this, deviceId, serialPort ) );
+        startReadLoop( deviceId );
+        lock.unlock(); // Forwarding and the verification may delete the device again
+
+        if ( !cachedDeviceId.empty() )
+        {
+            // Buffered and held messages get forwarded once the ID is confirmed, so they can't reach the wrong device
+            threads.spawn( std::bind( &SerialPortGateway::verifyDeviceIdentity, this, deviceId, serialPort, identityKey ) );
+        }
+        else
+        {
+            if ( !identityKey.empty() && !getDeviceIdentityCacheInstance()->store( identityKey, deviceId ) )
+            {
+                SPG_LOG_WARN( getStructuredLoggerInstance(), "Couldn't write identity cache", logField( "file", getIdentityCacheFile() ) );
+            }
+
+            if ( forwarding )
+            {
+                forwardOutboundMessages( deviceId );
+            }
+        }
+
+        return true;
+    }
+    else
+    {
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Can't add serial device, because a device with the same ID already exists", logField( "deviceId", deviceId ), logField( "port", serialPort ), logField( "existingPort", it->second->getPort() ) );
+
+        if ( !cachedDeviceId.empty() )
+        {
+            getDeviceIdentityCacheInstance()->evict( identityKey ); // The next attempt asks the device itself
+        }
+
+        return false;
+    }
+}
+
+unsigned int SerialPortGateway::addNewSerialPorts( bool suppressLogs )
+{
+    if ( !suppressLogs )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Searching for new serial ports..." );
+    }
+
+    unsigned int numDevicesAdded = 0;
+    std::vector<serial::PortInfo> serialPorts = getSerialTransportFactoryInstance()->listPorts();
+    std::vector<std::string> presentPorts;
+    ProbeScheduler * probeScheduler = getProbeSchedulerInstance();
+    SteadyTimePoint now = std::chrono::steady_clock::now();
+
+    for ( serial::PortInfo const & serialPortInfo : serialPorts )
+    {
+        presentPorts.push_back( serialPortInfo.port );
+
+        // Ports which failed recently (or too often) get skipped, so the scan doesn't wait for them every time
+        if ( probeScheduler->isActive() && !probeScheduler->isDue( serialPortInfo.port, getPortIdentity( serialPortInfo ), now ) )
+        {
+            continue;
+        }
+
+        // Set suppressLogs to true, so our logs don't get spammed with obvious "Errors" while using addNewSerialPorts repeatedly.
+        // (This is to surpress messages about the currently iterated serialPort being blacklisted, and the current port already being added/registered.)
+        if ( addSerialDevice( serialPortInfo.port, true ) )
+        {
+            numDevicesAdded++;
+        }
+    }
+
+    probeScheduler->retain( presentPorts );
+
+    if ( !suppressLogs )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Finished searching for new serial ports", logField( "devicesAdded", numDevicesAdded ) );
+    }
+
+    return numDevicesAdded;
+}
+
+void SerialPortGateway::addNewSerialPortsLoop()
+{
+    unsigned int scanInterval = getScanInterval();
+
+    while ( isStarted() )
+    {
+        if ( scanInterval > 0 )
+        {
+            addNewSerialPorts( true );
+
+            std::unique_lock<std::mutex> lock( scanMutex );
+            scanCondition.wait_for( lock, std::chrono::milliseconds( scanInterval ), [this]() { return !isStarted(); } );
+        }
+        else // If scanInterval is 0, don't add new serial ports automatically and quit the loop immediately
+        {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( scanMutex );
+        scanLoopRunning = false;
+    }
+
+    scanCondition.notify_all();
+}
+
+SerialPortGateway::SerialDevicePointer SerialPortGateway::getSerialDeviceById( const std::string & deviceId )
+{
+    std::lock_guard<std::mutex> lock( serialDevicesMutex );
+    SerialDeviceMap * serialDevices = getSerialDevices();
+    SerialDeviceMap::iterator it = serialDevices->find( deviceId );
+    SerialDevicePointer serialDevice = nullptr;
+
+    if ( it != serialDevices->end() )
+    {
+        serialDevice = it->second;
+    }
+
+    return serialDevice;
+}
+
+SerialPortGateway::SerialDevicePointer SerialPortGateway::getSerialDeviceByPort( std::string serialPort )
+{
+    SerialDevicePointer serialDevice = nullptr;
+    std::lock_guard<std::mutex> lock( serialDevicesMutex );
+
+    for ( std::pair<const std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
+    {
+        if ( entry.second->getPort() == serialPort )
+        {
+            serialDevice = entry.second;
+        }
+    }
+
+    return serialDevice;
+}
+
+bool SerialPortGateway::initSerialDevice( SerialDevicePointer serialDevice, std::string cachedDeviceId )
+{
+    std::string serialPort = serialDevice->getPort();
+    bool idRetrieved = false;
+
+    try
+    {
+        SteadyTimePoint openTime = std::chrono::steady_clock::now();
+        serialDevice->init( getSerialTransportFactoryInstance() );
+
+        std::string requestedLatencyProfile = serialDevice->getLatencyProfile().toString();
+        std::string effectiveLatencyProfile = serialDevice->getInstance()->getLatencyProfile().toString();
+
+        if ( effectiveLatencyProfile != requestedLatencyProfile )
+        {
+            SPG_LOG_INFO( getStructuredLoggerInstance(), "Port doesn't support every latency setting", logField( "port", serialPort ), logField( "requested", requestedLatencyProfile ), logField( "effective", effectiveLatencyProfile ) );
+        }
+
+        if ( !cachedDeviceId.empty() )
+        {
+            serialDevice->setId( cachedDeviceId ); // Gets verified after the device has been added (See "verifyDeviceIdentity")
+            idRetrieved = true;
+        }
+        else if ( serialDevice->getResetControl() != ResetControl::RESET_ON_OPEN && !serialDevice->getInstance()->hasResetDevice() )
+        {
+            // The modem lines were held since the port got closed the last time, so the device kept running and can answer right away
+            SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Device didn't reset on open, skipping the boot wait", logField( "port", serialPort ) );
+            idRetrieved = retrieveDeviceId( serialDevice );
+            serialDevice->getInstance()->flush();
+        }
+        else if ( isAdaptiveHandshakeActive() )
+        {
+            idRetrieved = retrieveDeviceIdAdaptively( serialDevice, openTime );
+        }
+        else
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( getWaitBeforeCommunication() ) );
+            idRetrieved = retrieveDeviceId( serialDevice );
+            serialDevice->getInstance()->flush();
+        }
+
+        if ( idRetrieved )
+        {
+            applyDeviceSerialParameters( serialDevice );
+
+            serial::flowcontrol_t requestedFlowControl = serialDevice->getFlowControl();
+            serial::flowcontrol_t effectiveFlowControl = serialDevice->getInstance()->getFlowControl();
+
+            // Without it, the device may send faster than the gateway reads; That's worth a warning, unlike a missing latency setting
+            if ( requestedFlowControl != serial::flowcontrol_none && effectiveFlowControl != requestedFlowControl )
+            {
+                SPG_LOG_WARN( getStructuredLoggerInstance(), "Port doesn't support the flow control", logField( "port", serialPort ), logField( "deviceId", serialDevice->getId() ), logField( "requested", SerialParameters::getFlowControlName( requestedFlowControl ) ), logField( "effective", SerialParameters::getFlowControlName( effectiveFlowControl ) ) );
+            }
+
+            // A cached ID hasn't been confirmed yet, so the device may not even be up
+            if ( cachedDeviceId.empty() )
+            {
+                escalateBaudRate( serialDevice );
+            }
+        }
+    }
+    catch ( const serial::IOException & e )
+    {
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Couldn't add serial device due to an IOException", logField( "port", serialPort ), logField( "error", e.what() ) );
+
+        return false;
+    }
+    catch ( const serial::SerialException & e )
+    {
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Couldn't add serial device due to a SerialException", logField( "port", serialPort ), logField( "error", e.what() ) );
+
+        return false;
+    }
+    catch ( const serial::PortNotOpenedException & e )
+    {
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Couldn't add serial device due to a PortNotOpenedException", logField( "port", serialPort ), logField( "error", e.what() ) );
+
+        return false;
+    }
+
+    if ( !idRetrieved )
+    {
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Couldn't add serial device, because the device didn't respond with a valid message containing the ID, or the ID was empty", logField( "port", serialPort ) );
+
+        return false;
+    }
+
+    return true;
+}
+
+bool SerialPortGateway::deleteSerialDevice( std::string deviceId )
+{
+    SerialDeviceMap * serialDevices = getSerialDevices();
+    SerialDevicePointer serialDevice = nullptr;
+    std::string serialPort;
+    bool properlyClosed;
+
+    {
+        std::lock_guard<std::mutex> lock( serialDevicesMutex );
+        SerialDeviceMap::iterator it = serialDevices->find( deviceId );
+
+        if ( it != serialDevices->end() )
+        {
+            serialDevice = it->second;
+        }
+    }
+
+    if ( serialDevice != nullptr )
+    {
+        stopReadLoop( deviceId );
+
+        serialPort = serialDevice->getPort();
+        SerialDevice::SerialInstance serialInstance = serialDevice->getInstance();
+
+        if ( serialInstance != nullptr )
+        {
+            try
+            {
+                serialInstance->flush();
+                serialInstance->close();
+
+                properlyClosed = true;
+            }
+            catch ( const serial::IOException & e )
+            {
+                SPG_LOG_ERROR( getStructuredLoggerInstance(), "Could not properly delete Serial Device due to an IOException", logField( "deviceId", deviceId ), logField( "port", serialPort ), logField( "error", e.what() ) );
+
+                properlyClosed = false;
+            }
+            catch ( const serial::PortNotOpenedException & e )
+            {
+                SPG_LOG_ERROR( getStructuredLoggerInstance(), "Could not properly delete Serial Device due to a PortNotOpenedException", logField( "deviceId", deviceId ), logField( "port", serialPort ), logField( "error", e.what() ) );
+
+                properlyClosed = false;
+            }
+        }
+    }
+    else
+    {
+        SPG_LOG_WARN( getStructuredLoggerInstance(), "Serial Device was not found and could therefore not be deleted", logField( "deviceId", deviceId ) );
+
+        return false;
+    }
+
+    SerialDeviceMap::size_type numDeleted = 0;
+
+    {
+        // Not locked while closing the port, which may take a while; Meanwhile, another thread may have deleted the device (and added it again)
+        std::lock_guard<std::mutex> lock( serialDevicesMutex );
+        SerialDeviceMap::iterator it = serialDevices->find( deviceId );
+
+        if ( it != serialDevices->end() && it->second == serialDevice )
+        {
+            serialDevices->erase( it );
+            numDeleted = 1;
+        }
+    }
+
+    getMetrics()->unregisterDevice( deviceId );
+    eraseReadLoopState( deviceId ); // If the read loop quitted already; Otherwise it erases the state itself
+
+    {
+        std::lock_guard<std::mutex> lock( partialLinesMutex );
+        partialLines.erase( deviceId );
+    }
+
+    if ( properlyClosed && numDeleted > 0 )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Deleted Serial Device", logField( "deviceId", deviceId ), logField( "port", serialPort ) );
+
+        if ( EventBus * eventBus = getEventBusInstance() )
+        {
+            eventBus->publishDeviceDeleted( deviceId, serialPort );
+        }
+
+        threads.spawn( std::bind( &SerialPortGateway::serialDeviceDeletedCallback, this, deviceId, serialPort ) );
+
+        return true;
+    }
+    else
+    {
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Could not properly delete Serial Device", logField( "deviceId", deviceId ), logField( "port", serialPort ) );
+
+        return false;
+    }
+}
+
+unsigned int SerialPortGateway::deleteAllSerialDevices( bool suppressLogs )
+{
+    if ( !suppressLogs )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Trying to delete all Serial Devices." );
+    }
+
+    unsigned int numDevicesDeleted = 0;
+    std::vector<std::string> deviceIds;
+
+    // deleteSerialDevice erases from the map, so the IDs get collected before
+    {
+        std::lock_guard<std::mutex> lock( serialDevicesMutex );
+
+        for ( std::pair<const std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
+        {
+            deviceIds.push_back( entry.first );
+        }
+    }
+
+    for ( std::string const & deviceId : deviceIds )
+    {
+        if ( deleteSerialDevice( deviceId ) )
+        {
+            numDevicesDeleted++;
+        }
+    }
+
+    if ( !suppressLogs )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Finished deleting serial devices", logField( "devicesDeleted", numDevicesDeleted ) );
+    }
+
+    return numDevicesDeleted;
+}
+
+void SerialPortGateway::readLoop( std::string deviceId )
+{
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Read loop started", logField( "deviceId", deviceId ) );
+
+    setReadLoopQuitted( deviceId, false );
+
+    // The device may have been deleted before this thread got to run (e.g. by a write error, or because its identity couldn't be verified)
+    SerialDevicePointer serialDevice = getSerialDeviceById( deviceId );
+    SerialDevice::SerialInstance serialInstance = serialDevice != nullptr ? serialDevice->getInstance() : nullptr;
+
+    if ( serialInstance == nullptr )
+    {
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Read loop stopped, because the device is gone", logField( "deviceId", deviceId ) );
+
+        setReadLoopQuitted( deviceId, true );
+        eraseReadLoopState( deviceId );
+
+        return;
+    }
+
+    DeviceMetricsPointer deviceMetrics = getMetrics()->getDeviceMetrics( deviceId );
+    StageTracer * stageTracer = getStageTracerInstance();
+    InboundQueuePointer inboundQueue = nullptr;
+
+    // The driver's counters only ever grow, so the first read is the baseline; Ports without any don't get asked again
+    std::chrono::milliseconds lineErrorInterval( getLineErrorInterval() );
+    LineErrorCounters lineErrors;
+    bool lineErrorsCounted = lineErrorInterval.count() > 0 && serialInstance->getLineErrorCounters( lineErrors );
+    SteadyTimePoint nextLineErrorCount = std::chrono::steady_clock::now() + lineErrorInterval;
+
+    // Reused for every line, so their buffers keep the capacity of the longest line so far; The inbound queue swaps them with its own
+    std::string line;
+    InboundMessage inboundMessage;
+    std::string content; // Parsed along with the type, which is all conflating needs
+
+    // Left unfinished by the previous read loop of the device, which may have been run by the process the device got taken over from
+    std::string partialLine;
+
+    {
+        std::lock_guard<std::mutex> lock( partialLinesMutex );
+        PartialLineMap::iterator it = partialLines.find( deviceId );
+
+        if ( it != partialLines.end() )
+        {
+            partialLine.swap( it->second );
+            partialLines.erase( it );
+        }
+    }
+
+    if ( getInboundQueueCapacity() > 0 )
+    {
+        inboundQueue = addInboundQueue( deviceId );
+        threads.spawn( std::bind( &SerialPortGateway::deliveryLoop, this, deviceId, inboundQueue, deviceMetrics ) );
+    }
+
+    while ( isReadLoopStarted( deviceId ) )
+    {
+        std::string readError;
+
+        try
+        {
+            SPG_ALLOCATION_STAGE( AllocationStage::READ );
+
+            TraceContext traceContext = { 0, 0 };
+            stageTracer->begin( traceContext );
+
+            if ( lineErrorsCounted && std::chrono::steady_clock::now() >= nextLineErrorCount )
+            {
+                countLineErrors( deviceId, serialInstance, lineErrors, deviceMetrics );
+                nextLineErrorCount = std::chrono::steady_clock::now() + lineErrorInterval;
+            }
+
+            serialInstance->readline( line );
+
+            // Deleted without waiting for this read loop, and added again (with a read loop of its own) before this one noticed
+            if ( line.empty() && getSerialDeviceById( deviceId ) != serialDevice )
+            {
+                break;
+            }
+
+            if ( !line.empty() && !partialLine.empty() )
+            {
+                line.insert( 0, partialLine );
+                partialLine.clear();
+            }
+
+            // The rest of the line is still to come; It gets completed by whoever reads the device next, instead of being processed cut off
+            if ( handoverActive && !isReadLoopStarted( deviceId ) && !line.empty() && line.compare( line.length() - 1, 1, CHAR_NEWLINE ) != 0 )
+            {
+                partialLine.swap( line );
+
+                break;
+            }
+
+            if ( !line.empty() )
+            {
+                SteadyTimePoint readTime = std::chrono::steady_clock::now();
+
+                stageTracer->mark( traceContext, TracePoint::BYTES_READ, deviceId );
+                deviceMetrics->addReceived( line.length() );
+
+                if ( inboundQueue == nullptr )
+                {
+                    deviceMetrics->changeInFlightCallbacks( 1 );
+
+                    getMessageWorkerPoolInstance()->submit( deviceId, [&]( LineJob & job )
+                    {
+                        job.deviceId = deviceId;
+                        job.line.swap( line );
+                        job.readTime = readTime;
+                        job.deviceMetrics = deviceMetrics;
+                        job.traceContext = traceContext;
+                    } );
+
+                    continue;
+                }
+
+                if ( getInboundOverflowPolicy() == OverflowPolicy::CONFLATE )
+                {
+                    parseMessage( line, getMessageDelimiter(), inboundMessage.type, content );
+                }
+
+                inboundMessage.message.swap( line );
+                inboundMessage.readTime = readTime;
+                inboundMessage.traceContext = traceContext;
+
+                // A dropped or conflated message gets replaced by the new one, so only a newly queued message changes the gauges
+                switch ( inboundQueue->push( inboundMessage ) )
+                {
+                    case PushResult::QUEUED:
+                        deviceMetrics->changeInFlightCallbacks( 1 );
+                        deviceMetrics->changeInboundQueued( 1 );
+                        break;
+                    case PushResult::DROPPED_OLDEST:
+                        deviceMetrics->addInboundDrop();
+                        break;
+                    case PushResult::CONFLATED:
+                        deviceMetrics->addInboundConflation();
+                        break;
+                    case PushResult::CLOSED:
+                        break;
+                }
+            }
+        }
+        catch ( const serial::IOException & e )
+        {
+            readError = e.what();
+        }
+        catch ( const serial::SerialException & e )
+        {
+            readError = e.what();
+        }
+        catch ( const serial::PortNotOpenedException & e )
+        {
+            readError = e.what();
+        }
+
+        if ( readError.empty() )
+        {
+            continue;
+        }
+
+        // The port got closed while the read loop was being stopped, or the device got deleted (and maybe added again) meanwhile
+        if ( !isReadLoopStarted( deviceId ) || getSerialDeviceById( deviceId ) != serialDevice )
+        {
+            break;
+        }
+
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Serial Port Error", logField( "deviceId", deviceId ), logField( "error", readError ) );
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Deleting Serial Device due to a read error", logField( "deviceId", deviceId ) );
+
+        deleteSerialDevice( deviceId );
+    }
+
+    if ( inboundQueue != nullptr )
+    {
+        inboundQueue->close(); // Lets the delivery loop finish the queued messages, and stop afterwards
+    }
+
+    if ( handoverActive && !partialLine.empty() )
+    {
+        std::lock_guard<std::mutex> lock( partialLinesMutex );
+        partialLines[deviceId] = partialLine;
+    }
+
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Read loop stopped", logField( "deviceId", deviceId ) );
+
+    SerialDevicePointer registeredDevice = getSerialDeviceById( deviceId );
+
+    // The state belongs to the read loop of the device which replaced this one
+    if ( registeredDevice != nullptr && registeredDevice != serialDevice )
+    {
+        return;
+    }
+
+    setReadLoopQuitted( deviceId, true );
+    eraseReadLoopState( deviceId ); // If the device got deleted meanwhile
+}
+
+void SerialPortGateway::startReadLoop( std::string deviceId )
+{
+    setReadLoopStarted( deviceId, true );
+    threads.spawn( std::bind( &SerialPortGateway::readLoop, this, deviceId ) );
+}
+
+void SerialPortGateway::stopReadLoop( std::string deviceId )
+{
+    setReadLoopStarted( deviceId, false );
+    closeInboundQueue( deviceId ); // Wakes up the read loop, in case it's blocked on a full queue
+
+    SerialDevicePointer serialDevice = getSerialDeviceById( deviceId );
+
+    // Wakes up the read loop, in case it's waiting for data; Otherwise it would only notice once the read timeout passed
+    if ( serialDevice != nullptr && serialDevice->getInstance() != nullptr )
+    {
+        serialDevice->getInstance()->interruptRead();
+    }
+}
+
+void SerialPortGateway::deliveryLoop( std::string deviceId, InboundQueuePointer inboundQueue, DeviceMetricsPointer deviceMetrics )
+{
+    SPG_ALLOCATION_STAGE( AllocationStage::DISPATCH );
+
+    InboundMessage inboundMessage;
+
+    while ( inboundQueue->pop( inboundMessage ) )
+    {
+        deviceMetrics->changeInboundQueued( -1 );
+
+        processMessage( deviceId, inboundMessage.message, inboundMessage.readTime, deviceMetrics, inboundMessage.traceContext );
+    }
+}
+
+SerialPortGateway::InboundQueuePointer SerialPortGateway::addInboundQueue( std::string deviceId )
+{
+    InboundQueuePointer inboundQueue = std::make_shared<InboundQueue>( getInboundQueueCapacity(), getInboundOverflowPolicy() );
+    std::lock_guard<std::mutex> lock( inboundQueuesMutex );
+
+    inboundQueues[deviceId] = inboundQueue;
+
+    return inboundQueue;
+}
+
+void SerialPortGateway::closeInboundQueue( std::string deviceId )
+{
+    std::lock_guard<std::mutex> lock( inboundQueuesMutex );
+    InboundQueueMap::iterator it = inboundQueues.find( deviceId );
+
+    if ( it != inboundQueues.end() )
+    {
+        it->second->close();
+        inboundQueues.erase( it );
+    }
+}
+
+void SerialPortGateway::stopAllReadLoops()
+{
+    std::vector<std::string> deviceIds;
+
+    // stopReadLoop looks the device up, so the IDs get collected before
+    {
+        std::lock_guard<std::mutex> lock( readLoopStatesMutex );
+
+        for ( std::pair<const std::string, AtomicBoolPair> const & entry : * getReadLoopStates() )
+        {
+            deviceIds.push_back( entry.first );
+        }
+    }
+
+    for ( std::string const & deviceId : deviceIds )
+    {
+        stopReadLoop( deviceId );
+    }
+}
+
+void SerialPortGateway::setReadLoopStarted( std::string deviceId, bool started )
+{
+    std::lock_guard<std::mutex> lock( readLoopStatesMutex );
+    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
+
+    if ( started )
+    {
+        AtomicBoolPair & readLoopState = ( * readLoopStates )[deviceId];
+        readLoopState.first = true;
+        readLoopState.second = false; // Not quitted before it ran, so nobody takes the read loop for gone meanwhile
+
+        return;
+    }
+
+    AtomicBoolPairMap::iterator it = readLoopStates->find( deviceId );
+
+    if ( it != readLoopStates->end() )
+    {
+        it->second.first = false;
+    }
+}
+
+bool SerialPortGateway::isReadLoopStarted( const std::string & deviceId )
+{
+    std::lock_guard<std::mutex> lock( readLoopStatesMutex );
+    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
+    AtomicBoolPairMap::iterator it = readLoopStates->find( deviceId );
+
+    if ( it != readLoopStates->end() )
+    {
+        return it->second.first;
+    }
+
+    return false;
+}
+
+void SerialPortGateway::setReadLoopQuitted( std::string deviceId, bool quitted )
+{
+    std::lock_guard<std::mutex> lock( readLoopStatesMutex );
+    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
+    AtomicBoolPairMap::iterator it = readLoopStates->find( deviceId );
+
+    if ( it != readLoopStates->end() )
+    {
+        it->second.second = quitted;
+    }
+}
+
+bool SerialPortGateway::isReadLoopQuitted( std::string deviceId )
+{
+    std::lock_guard<std::mutex> lock( readLoopStatesMutex );
+    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
+    AtomicBoolPairMap::iterator it = readLoopStates->find( deviceId );
+
+    if ( it != readLoopStates->end() )
+    {
+        return it->second.second;
+    }
+
+    return true;
+}
+
+void SerialPortGateway::eraseReadLoopState( std::string deviceId )
+{
+    std::lock_guard<std::mutex> serialDevicesLock( serialDevicesMutex );
+
+    if ( getSerialDevices()->find( deviceId ) != getSerialDevices()->end() )
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock( readLoopStatesMutex );
+    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
+    AtomicBoolPairMap::iterator it = readLoopStates->find( deviceId );
+
+    if ( it != readLoopStates->end() && it->second.second )
+    {
+        readLoopStates->erase( it );
+    }
+}
+
+bool SerialPortGateway::isEveryReadLoopQuitted()
+{
+    std::lock_guard<std::mutex> lock( readLoopStatesMutex );
+    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
+    AtomicBoolPairMap::iterator it;
+
+    for ( it = readLoopStates->begin(); it != readLoopStates->end(); it++ )
+    {
+        if ( it->second.second )
+        {
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SerialPortGateway::retrieveDeviceId( SerialDevicePointer serialDevice )
+{
+    std::string commandToGetDeviceId = getCommandToGetDeviceId() + CHAR_NEWLINE;
+
+    SerialDevice::SerialInstance serialInstance = serialDevice->getInstance();
+    serialInstance->flush();
+    serialInstance->write( commandToGetDeviceId );
+    //std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
+    std::string message = serialInstance->readline();
+
+    StringPair parsedMessage = parseMessage( message, getMessageDelimiter() );
+    std::string type = parsedMessage.first;
+    std::string deviceId = parsedMessage.second;
+
+    if ( type == getMessageTypeForIds() && !deviceId.empty() )
+    {
+        serialDevice->setId( deviceId );
+
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool SerialPortGateway::retrieveDeviceIdAdaptively( SerialDevicePointer serialDevice, SteadyTimePoint openTime )
+{
+    std::string commandToGetDeviceId = getCommandToGetDeviceId() + CHAR_NEWLINE;
+    std::string hardwareId = getHardwareId( serialDevice->getPort() );
+    unsigned int typicalDelay = getBootDelayTracker()->getTypicalDelay( hardwareId );
+    unsigned int retryInterval = getHandshakeRetryInterval();
+    unsigned int attempts = 0;
+
+    SteadyTimePoint deadline = openTime + std::chrono::milliseconds( getHandshakeDeadline() );
+    SteadyTimePoint nextAttempt = openTime;
+    SteadyTimePoint lastAttempt = openTime;
+    SteadyTimePoint previousAttempt = openTime;
+    SteadyTimePoint firstOutput = SteadyTimePoint::max();
+    SteadyTimePoint now = std::chrono::steady_clock::now();
+
+    SerialDevice::SerialInstance serialInstance = serialDevice->getInstance();
+    serialInstance->flush();
+
+    while ( now < deadline )
+    {
+        if ( now >= nextAttempt )
+        {
+            serialInstance->write( commandToGetDeviceId );
+            previousAttempt = lastAttempt;
+            lastAttempt = now;
+            attempts++;
+
+            if ( attempts == 1 && typicalDelay * 3 / 4 > retryInterval )
+            {
+                // Asking a little early lets the typical delay shrink again, once the devices got faster
+                nextAttempt = openTime + std::chrono::milliseconds( typicalDelay * 3 / 4 );
+            }
+            else
+            {
+                nextAttempt = now + std::chrono::milliseconds( retryInterval );
+
+                // Around the typical delay the device is most likely to get up, so the interval only grows beyond
+                if ( now - openTime >= std::chrono::milliseconds( typicalDelay * 2 ) )
+                {
+                    retryInterval = std::min( retryInterval * 2, MAX_HANDSHAKE_RETRY_INTERVAL );
+                }
+            }
+        }
+
+        // Waits for an answer only until the next attempt is due
+        SteadyTimePoint readUntil = std::min( nextAttempt, deadline );
+        serial::Timeout timeout = serial::Timeout::simpleTimeout( std::max<long long>( 1, std::chrono::duration_cast<std::chrono::milliseconds>( readUntil - now ).count() ) );
+        serialInstance->setTimeout( timeout );
+
+        std::string message = serialInstance->readline();
+        now = std::chrono::steady_clock::now();
+
+        if ( message.empty() )
+        {
+            continue;
+        }
+
+        StringPair parsedMessage = parseMessage( message, getMessageDelimiter() );
+
+        if ( parsedMessage.first == getMessageTypeForIds() && !parsedMessage.second.empty() )
+        {
+            // The device got up when it first sent anything, or else somewhere between the last unanswered attempt and the answered one
+            SteadyTimePoint readyTime = firstOutput != SteadyTimePoint::max() ? firstOutput : ( attempts == 1 ? openTime : previousAttempt + ( lastAttempt - previousAttempt ) / 2 );
+            unsigned int bootDelay = std::chrono::duration_cast<std::chrono::milliseconds>( std::min( readyTime, now ) - openTime ).count();
+            unsigned int handshakeTime = std::chrono::duration_cast<std::chrono::milliseconds>( now - openTime ).count();
+
+            serialInstance->setTimeout( serialDevice->getTimeout() );
+            serialDevice->setId( parsedMessage.second );
+            getBootDelayTracker()->record( hardwareId, bootDelay );
+
+            SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Handshake completed", logField( "port", serialDevice->getPort() ), logField( "deviceId", parsedMessage.second ), logField( "handshakeMs", handshakeTime ), logField( "bootDelayMs", bootDelay ), logField( "attempts", attempts ) );
+
+            return true;
+        }
+
+        // The device is up (boot message, telemetry, or an answer to a garbled command); Ask right away, but don't flood a chatty device afterwards
+        retryInterval = getHandshakeRetryInterval();
+        nextAttempt = firstOutput == SteadyTimePoint::max() ? now : std::min( nextAttempt, lastAttempt + std::chrono::milliseconds( retryInterval ) );
+        firstOutput = std::min( firstOutput, now );
+    }
+
+    serialInstance->setTimeout( serialDevice->getTimeout() );
+
+    return false;
+}
+
+void SerialPortGateway::applyDeviceSerialParameters( SerialDevicePointer serialDevice )
+{
+    SerialParametersMap * declaredSerialParameters = getDeclaredSerialParameters();
+    SerialParametersMap::iterator it = declaredSerialParameters->find( serialDevice->getId() );
+
+    if ( it == declaredSerialParameters->end() )
+    {
+        return;
+    }
+
+    if ( !it->second.hasSameLineSettings( serialDevice->getSerialParameters() ) )
+    {
+        serialDevice->getInstance()->setLineSettings( it->second );
+        SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Applied serial parameters of the device", logField( "port", serialDevice->getPort() ), logField( "deviceId", serialDevice->getId() ), logField( "serialParameters", it->second.toString() ) );
+    }
+
+    serialDevice->setSerialParameters( it->second );
+}
+
+void SerialPortGateway::countLineErrors( std::string deviceId, SerialDevice::SerialInstance serialInstance, LineErrorCounters & lineErrors, DeviceMetricsPointer deviceMetrics )
+{
+    LineErrorCounters current;
+
+    if ( !serialInstance->getLineErrorCounters( current ) )
+    {
+        return;
+    }
+
+    // Counters going back means the driver set the port up again; Then everything counted since is new
+    unsigned long long overruns = current.overruns >= lineErrors.overruns ? current.overruns - lineErrors.overruns : current.overruns;
+    unsigned long long bufferOverruns = current.bufferOverruns >= lineErrors.bufferOverruns ? current.bufferOverruns - lineErrors.bufferOverruns : current.bufferOverruns;
+    unsigned long long framingErrors = current.framingErrors >= lineErrors.framingErrors ? current.framingErrors - lineErrors.framingErrors : current.framingErrors;
+    unsigned long long parityErrors = current.parityErrors >= lineErrors.parityErrors ? current.parityErrors - lineErrors.parityErrors : current.parityErrors;
+
+    lineErrors = current;
+
+    if ( overruns + bufferOverruns + framingErrors + parityErrors == 0 )
+    {
+        return;
+    }
+
+    deviceMetrics->addLineErrors( overruns, bufferOverruns, framingErrors, parityErrors );
+
+    SPG_LOG_WARN( getStructuredLoggerInstance(), "Port reported line errors", logField( "deviceId", deviceId ), logField( "overruns", overruns ), logField( "bufferOverruns", bufferOverruns ), logField( "framingErrors", framingErrors ), logField( "parityErrors", parityErrors ) );
+}
+
+bool SerialPortGateway::awaitMessage( SerialDevice::SerialInstance serialInstance, std::string type, std::string content, unsigned int timeout )
+{
+    SteadyTimePoint deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeout );
+
+    do
+    {
+        StringPair parsedMessage = parseMessage( serialInstance->readline(), getMessageDelimiter() );
+
+        if ( parsedMessage.first == type && parsedMessage.second == content )
+        {
+            return true;
+        }
+    }
+    while ( std::chrono::steady_clock::now() < deadline );
+
+    return false;
+}
+
+bool SerialPortGateway::escalateBaudRate( SerialDevicePointer serialDevice )
+{
+    std::string baudEscalationCommand = getBaudEscalationCommand();
+    SerialParameters serialParameters = serialDevice->getSerialParameters();
+    unsigned int baseBaudRate = serialParameters.baudRate;
+
+    if ( baudEscalationCommand.empty() || serialParameters.escalationBaudRate <= baseBaudRate )
+    {
+        return false;
+    }
+
+    std::string deviceId = serialDevice->getId();
+    std::string escalationBaudRate = std::to_string( serialParameters.escalationBaudRate );
+    SerialDevice::SerialInstance serialInstance = serialDevice->getInstance();
+
+    unsigned int timeout = serialDevice->getTimeout().read_timeout_constant;
+
+    serialInstance->write( baudEscalationCommand + getMessageDelimiter() + escalationBaudRate + CHAR_NEWLINE );
+
+    if ( !awaitMessage( serialInstance, baudEscalationCommand, escalationBaudRate, timeout ) )
+    {
+        SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Device didn't confirm the baud escalation", logField( "port", serialDevice->getPort() ), logField( "deviceId", deviceId ) );
+        serialInstance->flush();
+
+        return false;
+    }
+
+    // The device switches right after its confirmation; Without closing the port, which would reset it
+    serialParameters.baudRate = serialParameters.escalationBaudRate;
+    serialInstance->setLineSettings( serialParameters );
+    serialInstance->write( getCommandToGetDeviceId() + CHAR_NEWLINE );
+
+    if ( awaitMessage( serialInstance, getMessageTypeForIds(), deviceId, timeout ) )
+    {
+        serialDevice->setSerialParameters( serialParameters );
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Escalated baud rate", logField( "port", serialDevice->getPort() ), logField( "deviceId", deviceId ), logField( "fromBaud", baseBaudRate ), logField( "toBaud", serialParameters.baudRate ) );
+
+        return true;
+    }
+
+    // The device falls back on its own, once nothing arrives at the new rate
+    serialInstance->setLineSettings( serialDevice->getSerialParameters() );
+    serialInstance->flush();
+    SPG_LOG_WARN( getStructuredLoggerInstance(), "Baud escalation failed, staying at the base rate", logField( "port", serialDevice->getPort() ), logField( "deviceId", deviceId ), logField( "baud", baseBaudRate ) );
+
+    return false;
+}
+
+void SerialPortGateway::verifyDeviceIdentity( std::string deviceId, std::string serialPort, std::string identityKey )
+{
+    // Same as before asking for the ID the regular way; The device may have been reset by opening the port
+    std::this_thread::sleep_for( std::chrono::milliseconds( getWaitBeforeCommunication() ) );
+
+    // Written directly, since the sends to the device are held until it's verified (See "holdUntilIdentityVerified")
+    if ( SerialDevicePointer serialDevice = getSerialDeviceById( deviceId ) )
+    {
+        try
+        {
+            serialDevice->getInstance()->write( getCommandToGetDeviceId() + CHAR_NEWLINE );
+        }
+        catch ( const serial::SerialException & e )
+        {
+            SPG_LOG_ERROR( getStructuredLoggerInstance(), "Serial Port Error", logField( "deviceId", deviceId ), logField( "error", e.what() ) );
+        }
+    }
+
+    IdentityVerification identityVerification;
+
+    {
+        std::unique_lock<std::mutex> lock( identityVerificationsMutex );
+        identityVerificationsCondition.wait_for( lock, std::chrono::milliseconds( getIdentityVerifyTimeout() ), [this, &deviceId]
+        {
+            return identityVerifications[deviceId] != IdentityVerification::PENDING;
+        } );
+
+        identityVerification = identityVerifications[deviceId];
+        identityVerifications.erase( deviceId );
+        identityVerificationCount = identityVerifications.size();
+    }
+
+    identityVerificationsCondition.notify_all(); // Wakes up the sends waiting for the verification
+
+    if ( identityVerification == IdentityVerification::CONFIRMED )
+    {
+        SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Verified cached device identity", logField( "deviceId", deviceId ), logField( "port", serialPort ) );
+
+        if ( getOutboundBufferInstance()->startForwarding( deviceId ) )
+        {
+            forwardOutboundMessages( deviceId );
+        }
+
+        return;
+    }
+
+    SerialDevicePointer serialDevice = getSerialDeviceById( deviceId );
+
+    if ( serialDevice == nullptr || serialDevice->getPort() != serialPort )
+    {
+        return; // Unplugged meanwhile; Says nothing about the cache entry
+    }
+
+    SPG_LOG_WARN( getStructuredLoggerInstance(), "Cached device identity could not be verified, deleting Serial Device", logField( "deviceId", deviceId ), logField( "port", serialPort ), logField( "reason", identityVerification == IdentityVerification::MISMATCHED ? "mismatch" : "timeout" ) );
+
+    getDeviceIdentityCacheInstance()->evict( identityKey );
+    deleteSerialDevice( deviceId ); // The next scan adds it again, and asks for its ID
+}
+
+bool SerialPortGateway::answerIdentityVerification( std::string deviceId, std::string content )
+{
+    std::lock_guard<std::mutex> lock( identityVerificationsMutex );
+    IdentityVerificationMap::iterator it = identityVerifications.find( deviceId );
+
+    if ( it == identityVerifications.end() || it->second != IdentityVerification::PENDING )
+    {
+        return false;
+    }
+
+    it->second = content == deviceId ? IdentityVerification::CONFIRMED : IdentityVerification::MISMATCHED;
+    identityVerificationsCondition.notify_all();
+
+    return true;
+}
+
+bool SerialPortGateway::isIdentityBeingVerified( const std::string & deviceId )
+{
+    if ( identityVerificationCount == 0 )
+    {
+        return false;
+    }
 
-        getLoggerInstance()->writeInfo( std::string( "Added Serial Device with ID \"" + deviceId + "\" on port \"" + serialPort + "\"." ) );
+    std::lock_guard<std::mutex> lock( identityVerificationsMutex );
 
-        std::thread( &SerialPortGateway::serialDeviceAddedCallback, this, deviceId, serialPort ).detach();
-        startReadLoop( deviceId );
+    return identityVerifications.find( deviceId ) != identityVerifications.end();
+}
+
+bool SerialPortGateway::holdUntilIdentityVerified( const std::string & deviceId, const std::string & message, SerialDevicePointer & device )
+{
+    // Devices get registered only after their verification is pending, so a device which has been found can't miss it
+    if ( identityVerificationCount == 0 )
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock( identityVerificationsMutex );
+
+    if ( identityVerifications.find( deviceId ) == identityVerifications.end() )
+    {
+        return false;
+    }
 
+    // Buffered under the lock, so it's there once the verification ends and starts forwarding
+    if ( getOutboundBufferInstance()->store( deviceId, message ) )
+    {
         return true;
     }
-    else
+
+    // Ends within the verify timeout
+    identityVerificationsCondition.wait( lock, [this, &deviceId]
     {
-        getLoggerInstance()->writeError( std::string( "Serial Device with ID \"" + deviceId + "\" already exists on port \"" + it->second->getPort() + "\". Can't add device with the same ID on port \"" + serialPort + "\"." ) );
+        return identityVerifications.find( deviceId ) == identityVerifications.end();
+    } );
 
-        return false;
+    lock.unlock();
+    device = getSerialDeviceById( deviceId );
+
+    return false;
+}
+
+SerialPortGateway::StringPair SerialPortGateway::parseMessage( std::string message, std::string delimiter )
+{
+    StringPair parsedMessage;
+    parseMessage( message, delimiter, parsedMessage.first, parsedMessage.second );
+
+    return parsedMessage;
+}
+
+void SerialPortGateway::parseMessage( const std::string & message, const std::string & delimiter, std::string & type, std::string & content )
+{
+    std::size_t delimiterPos = message.find_first_of( delimiter );
+    std::size_t messageEnd = message.find_first_of( CHAR_NEWLINE + CHAR_CARRIAGE_RETURN );
+
+    type.clear();
+    content.clear();
+
+    // Parses the message only when there is a correct ending and a delimiter.
+    // Allows to send messages with empty types, as long as there's a delimiter AND content after that
+    if ( messageEnd != std::string::npos && delimiterPos != std::string::npos )
+    {
+        type.assign( message, 0, delimiterPos );
+
+        if (  delimiterPos < messageEnd )
+        {
+            messageEnd--; // Exclude the newline character
+            content.assign( message, delimiterPos + 1, messageEnd - delimiterPos );
+        }
     }
 }
 
-unsigned int SerialPortGateway::addNewSerialPorts( bool suppressLogs )
+void SerialPortGateway::processMessage( const std::string & deviceId, const std::string & message, SteadyTimePoint readTime, const DeviceMetricsPointer & deviceMetrics, TraceContext traceContext )
 {
-    if ( !suppressLogs )
+    SPG_ALLOCATION_STAGE( AllocationStage::PROCESS );
+
+    // Reused for every message processed by this thread, so their buffers keep the capacity of the longest message so far
+    static thread_local std::string type;
+    static thread_local std::string content;
+    static thread_local SerialMessage serialMessage;
+
+    // The stop timeout passed; What's left gets dropped, so the remaining threads finish quickly
+    if ( discardingInbound )
     {
-        getLoggerInstance()->writeInfo( "Searching for new serial ports..." );
+        deviceMetrics->changeInFlightCallbacks( -1 );
+        inboundDropped++;
+
+        return;
     }
 
-    unsigned int numDevicesAdded = 0;
-    std::vector<serial::PortInfo> serialPorts = serial::list_ports();
+    StageTracer * stageTracer = getStageTracerInstance();
+    stageTracer->mark( traceContext, TracePoint::PROCESS_BEGIN, deviceId );
 
-    for ( serial::PortInfo const & serialPortInfo : serialPorts )
+    parseMessage( message, getMessageDelimiter(), type, content );
+
+    if ( type == getMessageTypeForIds() && answerIdentityVerification( deviceId, content ) )
     {
-        // Set suppressLogs to true, so our logs don't get spammed with obvious "Errors" while using addNewSerialPorts repeatedly.
-        // (This is to surpress messages about the currently iterated serialPort being blacklisted, and the current port already being added/registered.)
-        if ( addSerialDevice( serialPortInfo.port, true ) )
+        deviceMetrics->changeInFlightCallbacks( -1 ); // Answers the verification of a cached identity; Doesn't reach a callback
+
+        return;
+    }
+
+    serialMessage.assign( deviceId, type, content );
+    MessageSchemaMap * messageSchemas = getMessageSchemas();
+    MessageSchemaMap::iterator it = messageSchemas->find( type );
+    SchemaRecord schemaRecord;
+    CallbackType callbackType = CallbackType::MESSAGE;
+
+    stageTracer->mark( traceContext, TracePoint::FRAMED, deviceId );
+
+    if ( type.empty() && content.empty() ) // No delimiter or no line ending; Still handed over to the callback, as before
+    {
+        deviceMetrics->addParseFailure();
+    }
+
+    if ( it != messageSchemas->end() )
+    {
+        if ( it->second->extract( content, getSchemaFieldDelimiter(), schemaRecord ) )
         {
-            numDevicesAdded++;
+            callbackType = CallbackType::SCHEMA_MESSAGE;
+        }
+        else
+        {
+            callbackType = CallbackType::SCHEMA_MISMATCH;
+            deviceMetrics->addParseFailure();
         }
     }
 
-    if ( !suppressLogs )
+    stageTracer->mark( traceContext, TracePoint::DISPATCHED, deviceId );
+
     {
-        getLoggerInstance()->writeInfo( "Finished searching for new serial ports. Added " + std::to_string( numDevicesAdded ) + " devices." );
+        SPG_ALLOCATION_STAGE( AllocationStage::DISPATCH );
+
+        if ( EventBus * eventBus = getEventBusInstance() )
+        {
+            eventBus->publishMessage( deviceId, serialMessage.getTimestamp(), type, content ); // Copied once onto the ring, however many consumers read it
+        }
+
+        // Refers to the message, so handing it over doesn't allocate (a reference fits into the callback itself); Unless the callback gets queued
+        // on the isolated lane, it has returned before the message gets reused. Only this thread moves the device onto the isolated lane,
+        // since every message of the device is processed by the same thread (its delivery loop or message worker), so the check holds.
+        auto callback = [&]() { runMessageCallback( callbackType, deviceId, serialMessage, schemaRecord, readTime, deviceMetrics, traceContext ); };
+
+        if ( getInboundQueueCapacity() > 0 )
+        {
+            getCallbackDispatcherInstance()->run( deviceMetrics, std::ref( callback ) ); // Already on the device's own delivery thread; Keeps the messages in order
+        }
+        else if ( deviceMetrics->isIsolated() )
+        {
+            getCallbackDispatcherInstance()->dispatch( deviceMetrics, std::bind( &SerialPortGateway::runMessageCallback, this, callbackType, deviceId, serialMessage, schemaRecord, readTime, deviceMetrics, traceContext ) );
+        }
+        else
+        {
+            getCallbackDispatcherInstance()->dispatch( deviceMetrics, std::ref( callback ) );
+        }
     }
+}
 
-    return numDevicesAdded;
+void SerialPortGateway::runMessageCallback( CallbackType callbackType, const std::string & deviceId, const SerialMessage & serialMessage, const SchemaRecord & schemaRecord, SteadyTimePoint readTime, const DeviceMetricsPointer & deviceMetrics, TraceContext traceContext )
+{
+    StageTracer * stageTracer = getStageTracerInstance();
+
+    deviceMetrics->recordReadToCallbackLatency( getMicrosecondsSince( readTime ) );
+    stageTracer->mark( traceContext, TracePoint::CALLBACK_BEGIN, deviceId );
+
+    {
+        SPG_ALLOCATION_STAGE( AllocationStage::CALLBACK );
+
+        switch ( callbackType )
+        {
+            case CallbackType::MESSAGE:
+                messageCallback( serialMessage );
+                break;
+            case CallbackType::SCHEMA_MESSAGE:
+                schemaMessageCallback( serialMessage, schemaRecord );
+                break;
+            case CallbackType::SCHEMA_MISMATCH:
+                schemaMismatchCallback( serialMessage );
+                break;
+        }
+    }
+
+    stageTracer->mark( traceContext, TracePoint::CALLBACK_END, deviceId );
+    deviceMetrics->changeInFlightCallbacks( -1 );
 }
 
-void SerialPortGateway::addNewSerialPortsLoop()
+void SerialPortGateway::sendMessageToSerialDeviceBlocking( const std::string & deviceId, const std::string & message, SteadyTimePoint requestTime, const DeviceMetricsPointer & deviceMetrics )
 {
-    unsigned int scanInterval = getScanInterval();
+    SPG_ALLOCATION_STAGE( AllocationStage::SEND );
 
-    while ( isStarted() )
+    static thread_local std::string line; // Reused for every message written by this thread, so its buffer keeps the capacity of the longest message so far
+
+    try
     {
-        if ( scanInterval > 0 )
+        SerialDevicePointer device = getSerialDeviceById( deviceId );
+
+        if ( device != nullptr && holdUntilIdentityVerified( deviceId, message, device ) )
         {
-            addNewSerialPorts( true );
-            std::this_thread::sleep_for( std::chrono::milliseconds( scanInterval ) );
+            SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Buffered message until the device's ID is verified", logField( "deviceId", deviceId ), logField( "message", message ) );
         }
-        else // If scanInterval is 0, don't add new serial ports automatically and quit the loop immediately
+        else if ( device != nullptr && getOutboundBufferInstance()->storeWhileForwarding( deviceId, message ) )
         {
-            break;
+            SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Buffered message behind the ones being forwarded", logField( "deviceId", deviceId ), logField( "message", message ) );
+        }
+        else if ( device != nullptr )
+        {
+            SerialDevice::SerialInstance serialInstance = device->getInstance();
+            line.assign( message );
+            line += CHAR_NEWLINE; // Append a newline character to mark the end of the message
+
+            std::size_t bytesWritten = serialInstance->write( line );
+
+            if ( deviceMetrics != nullptr )
+            {
+                deviceMetrics->recordSendLatency( getMicrosecondsSince( requestTime ) );
+            }
+
+            if ( bytesWritten == message.length() + 1 ) // + 1 for the appended newline character
+            {
+                if ( deviceMetrics != nullptr )
+                {
+                    deviceMetrics->addSent( bytesWritten );
+                }
+
+                SPG_LOG_INFO( getStructuredLoggerInstance(), "Delivered message", logField( "message", message ), logField( "deviceId", deviceId ), logField( "bytesWritten", bytesWritten ), logField( "bytesExpected", message.length() + 1 ) );
+            }
+            else
+            {
+                if ( deviceMetrics != nullptr )
+                {
+                    deviceMetrics->addShortWrite();
+                }
+
+                SPG_LOG_ERROR( getStructuredLoggerInstance(), "Could not deliver message properly", logField( "message", message ), logField( "deviceId", deviceId ), logField( "bytesWritten", bytesWritten ), logField( "bytesExpected", message.length() + 1 ) );
+            }
+        }
+        else if ( deviceMetrics != nullptr && getOutboundBufferInstance()->store( deviceId, message ) ) // Only known devices get a buffer, so typos can't grow it
+        {
+            SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Device absent, buffered message", logField( "deviceId", deviceId ), logField( "message", message ) );
+
+            // The device may have come back between the lookup and the buffering, after its buffer got forwarded already; With a cached ID, its verification forwards it
+            if ( getSerialDeviceById( deviceId ) != nullptr && !isIdentityBeingVerified( deviceId ) && getOutboundBufferInstance()->startForwarding( deviceId ) )
+            {
+                forwardOutboundMessages( deviceId );
+            }
+        }
+        else
+        {
+            SPG_LOG_INFO( getStructuredLoggerInstance(), "Device not found, message can not be delivered", logField( "deviceId", deviceId ), logField( "message", message ) );
+        }
+    }
+    catch ( const serial::SerialException & e )
+    {
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Serial Port Error", logField( "deviceId", deviceId ), logField( "error", e.what() ) );
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Deleting Serial Device due to a write error", logField( "deviceId", deviceId ) );
+
+        deleteSerialDevice( deviceId );
+
+        // The message may have been written partially; Sending it again once the device is back is preferred over losing it
+        if ( deviceMetrics != nullptr && getOutboundBufferInstance()->store( deviceId, message ) )
+        {
+            SPG_LOG_DEBUG( getStructuredLoggerInstance(), "Buffered message after the write error", logField( "deviceId", deviceId ), logField( "message", message ) );
         }
     }
+
+    if ( deviceMetrics != nullptr )
+    {
+        deviceMetrics->changePendingSends( -1 );
+    }
 }
 
-SerialPortGateway::SerialDevicePointer SerialPortGateway::getSerialDeviceById( std::string deviceId )
+void SerialPortGateway::forwardOutboundMessages( std::string deviceId )
 {
-    SerialDeviceMap * serialDevices = getSerialDevices();
-    SerialDeviceMap::iterator it = serialDevices->find( deviceId );
-    SerialDevicePointer serialDevice = nullptr;
+    OutboundBuffer * outboundBuffer = getOutboundBufferInstance();
+    std::vector<OutboundMessage> messages;
 
-    if ( it != serialDevices->end() )
+    // Sends which come in meanwhile get buffered behind these, so they're taken in the next round; Forwarding ends once there are none left
+    while ( !( messages = outboundBuffer->take( deviceId ) ).empty() )
     {
-        serialDevice = it->second;
-    }
+        SerialDevicePointer device = getSerialDeviceById( deviceId );
 
-    return serialDevice;
+        if ( device == nullptr )
+        {
+            outboundBuffer->restore( deviceId, messages );
+
+            return;
+        }
+
+        // One write for all buffered messages, with the same newline "sendMessageToSerialDeviceBlocking" appends to every message
+        std::string burst;
+
+        for ( OutboundMessage const & outboundMessage : messages )
+        {
+            burst += outboundMessage.message;
+            burst += CHAR_NEWLINE;
+        }
+
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Forwarding buffered messages", logField( "deviceId", deviceId ), logField( "messages", messages.size() ), logField( "bytes", burst.length() ) );
+
+        DeviceMetricsPointer deviceMetrics = getMetrics()->getDeviceMetrics( deviceId );
+        std::size_t bytesWritten;
+
+        try
+        {
+            bytesWritten = device->getInstance()->write( burst );
+        }
+        catch ( const serial::SerialException & e )
+        {
+            SPG_LOG_ERROR( getStructuredLoggerInstance(), "Serial Port Error", logField( "deviceId", deviceId ), logField( "error", e.what() ) );
+            SPG_LOG_INFO( getStructuredLoggerInstance(), "Deleting Serial Device due to a write error", logField( "deviceId", deviceId ) );
+
+            // Deleted first, so sends coming in meanwhile get buffered behind the restored messages, instead of being written
+            deleteSerialDevice( deviceId );
+            outboundBuffer->restore( deviceId, messages );
+
+            return;
+        }
+
+        // Only messages which have been written completely count as forwarded
+        std::size_t messagesWritten = 0;
+        std::size_t bytesCounted = 0;
+
+        for ( OutboundMessage const & outboundMessage : messages )
+        {
+            bytesCounted += outboundMessage.message.length() + 1;
+
+            if ( bytesCounted > bytesWritten )
+            {
+                break;
+            }
+
+            messagesWritten++;
+        }
+
+        outboundBuffer->addForwarded( deviceId, messagesWritten );
+
+        if ( deviceMetrics != nullptr )
+        {
+            deviceMetrics->addSent( bytesWritten );
+        }
+
+        if ( bytesWritten != burst.length() )
+        {
+            if ( deviceMetrics != nullptr )
+            {
+                deviceMetrics->addShortWrite();
+            }
+
+            SPG_LOG_ERROR( getStructuredLoggerInstance(), "Could not forward buffered messages properly", logField( "deviceId", deviceId ), logField( "messagesWritten", messagesWritten ), logField( "messages", messages.size() ), logField( "bytesWritten", bytesWritten ), logField( "bytesExpected", burst.length() ) );
+        }
+    }
 }
 
-SerialPortGateway::SerialDevicePointer SerialPortGateway::getSerialDeviceByPort( std::string serialPort )
+unsigned int SerialPortGateway::takeOverSerialDevices()
 {
-    SerialDevicePointer serialDevice = nullptr;
+    std::vector<HandoverDevice> handoverDevices;
 
-    for ( std::pair<std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
+    if ( !DeviceHandover::takeOver( getHandoverSocket(), handoverDevices, DeviceHandover::RECORD_TIMEOUT ) )
     {
-        if ( entry.second->getPort() == serialPort )
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "No serial devices taken over", logField( "socket", getHandoverSocket() ) );
+
+        return 0;
+    }
+
+    unsigned int numDevicesAdded = 0;
+
+    for ( HandoverDevice const & handoverDevice : handoverDevices )
+    {
+        if ( adoptSerialDevice( handoverDevice ) )
         {
-            serialDevice = entry.second;
+            numDevicesAdded++;
         }
     }
 
-    return serialDevice;
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Took serial devices over", logField( "socket", getHandoverSocket() ), logField( "devicesHandedOver", handoverDevices.size() ), logField( "devicesAdded", numDevicesAdded ) );
+
+    return numDevicesAdded;
 }
 
-bool SerialPortGateway::initSerialDevice( SerialDevicePointer serialDevice )
+bool SerialPortGateway::adoptSerialDevice( const HandoverDevice & handoverDevice )
 {
-    std::string serialPort = serialDevice->getPort();
-    bool idRetrieved = false;
+    std::string deviceId = handoverDevice.deviceId;
+    std::string serialPort = handoverDevice.port;
+    LatencyProfile latencyProfile = getLatencyProfile( serialPort );
+    SerialDevicePointer serialDevice = std::make_shared<SerialDevice>( serialPort, getBaudRate(), serial::Timeout::simpleTimeout( latencyProfile.readTimeout ) );
+    std::string error;
 
     try
     {
-        serialDevice->init();
-        std::this_thread::sleep_for( std::chrono::milliseconds( getWaitBeforeCommunication() ) );
-        idRetrieved = retrieveDeviceId( serialDevice );
-        serialDevice->getInstance()->flush();
+        // The predecessor's parameters, since the device may run at its escalation baud rate by now
+        serialDevice->setSerialParameters( SerialParameters::parse( handoverDevice.serialParameters, getSerialParameters( serialPort ) ) );
+        serialDevice->setResetControl( getResetControl( serialPort ) );
+        serialDevice->setLatencyProfile( latencyProfile );
+        serialDevice->setId( deviceId );
+
+        // Opened by its path, since the serial Library can't take the handed over descriptor over; That one keeps the tty open meanwhile though,
+        // so the modem lines don't drop (a tty only hangs up on its last close), and the driver keeps the input it buffered
+        serialDevice->init( getSerialTransportFactoryInstance() );
+    }
+    catch ( const std::invalid_argument & e )
+    {
+        error = e.what();
     }
     catch ( const serial::IOException & e )
     {
-        getLoggerInstance()->writeError( std::string( "Couldn't add serial device on port \"" + serialPort + "\" due to an IOException: " + std::string( e.what() ) ) );
-
-        return false;
+        error = e.what();
     }
     catch ( const serial::SerialException & e )
     {
-        getLoggerInstance()->writeError( std::string( "Couldn't add serial device on port \"" + serialPort + "\" due to an SerialException: " + std::string( e.what() ) ) );
-
-        return false;
+        error = e.what();
     }
     catch ( const serial::PortNotOpenedException & e )
     {
-        getLoggerInstance()->writeError( std::string( "Couldn't add serial device on port \"" + serialPort + "\" due to an PortNotOpenedException: " + std::string( e.what() ) ) );
+        error = e.what();
+    }
 
-        return false;
+    if ( handoverDevice.fd >= 0 )
+    {
+        ::close( handoverDevice.fd );
     }
 
-    if ( !idRetrieved )
+    if ( !error.empty() )
     {
-        getLoggerInstance()->writeError( std::string( "Couldn't add serial device on port \"" + serialPort + "\", because the device didn't respond with a valid message containing the ID, or the ID was empty." ) );
+        // The scan probes the port instead
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Couldn't take serial device over", logField( "deviceId", deviceId ), logField( "port", serialPort ), logField( "error", error ) );
 
         return false;
     }
 
-    return true;
-}
-
-bool SerialPortGateway::deleteSerialDevice( std::string deviceId )
-{
     SerialDeviceMap * serialDevices = getSerialDevices();
+    std::unique_lock<std::mutex> lock( serialDevicesMutex );
     SerialDeviceMap::iterator it = serialDevices->find( deviceId );
-    std::string serialPort;
-    bool properlyClosed;
 
     if ( it != serialDevices->end() )
     {
-        stopReadLoop( deviceId );
-
-        serialPort = it->second->getPort();
-        SerialDevice::SerialInstance serialInstance = it->second->getInstance();
-
-        if ( serialInstance != nullptr )
-        {
-            try
-            {
-                serialInstance->flush();
-                serialInstance->close();
-
-                properlyClosed = true;
-            }
-            catch ( const serial::IOException & e )
-            {
-                getLoggerInstance()->writeError( std::string( "Could not properly delete Serial Device with ID \"" + deviceId + "\" on port \"" + serialPort + "\" due to an IOException: " + std::string( e.what() ) ) );
+        SPG_LOG_ERROR( getStructuredLoggerInstance(), "Can't take serial device over, because a device with the same ID already exists", logField( "deviceId", deviceId ), logField( "port", serialPort ), logField( "existingPort", it->second->getPort() ) );
 
-                properlyClosed = false;
-            }
-            catch ( const serial::PortNotOpenedException & e )
-            {
-                getLoggerInstance()->writeError( std::string( "Could not properly delete Serial Device with ID \"" + deviceId + "\" on port \"" + serialPort + "\" due to an PortNotOpenedException: " + std::string( e.what() ) ) );
+        lock.unlock();
+        serialDevice->getInstance()->close();
 
-                properlyClosed = false;
-            }
-        }
+        return false;
     }
-    else
-    {
-        getLoggerInstance()->writeWarn( std::string( "Serial Device with ID \"" + deviceId + "\" was not found and could therefore not be deleted." ) );
 
-        return false;
+    if ( !handoverDevice.partialLine.empty() )
+    {
+        std::lock_guard<std::mutex> lock( partialLinesMutex );
+        partialLines[deviceId] = handoverDevice.partialLine;
     }
 
-    SerialDeviceMap::size_type numDeleted = serialDevices->erase( deviceId );
+    bool forwarding = getOutboundBufferInstance()->startForwarding( deviceId ); // Before the device can be found, so no send overtakes the buffered messages
 
-    if ( properlyClosed && numDeleted > 0 )
+    ( * serialDevices )[deviceId] = serialDevice;
+    getMetrics()->registerDevice( deviceId, serialPort );
+    getProbeSchedulerInstance()->recordSuccess( serialPort );
+
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Took Serial Device over", logField( "deviceId", deviceId ), logField( "port", serialPort ), logField( "serialParameters", handoverDevice.serialParameters ) );
+
+    if ( EventBus * eventBus = getEventBusInstance() )
     {
-        getLoggerInstance()->writeInfo( std::string( "Deleted Serial Device with ID \"" + deviceId + "\" on port \"" + serialPort + "\"." ) );
+        eventBus->publishDeviceAdded( deviceId, serialPort );
+    }
 
-        std::thread( &SerialPortGateway::serialDeviceDeletedCallback, this, deviceId, serialPort ).detach();
+    threads.spawn( std::bind( &SerialPortGateway::serialDeviceAddedCallback, this, deviceId, serialPort ) );
+    startReadLoop( deviceId );
+    lock.unlock(); // Forwarding may delete the device again
 
-        return true;
-    }
-    else
+    if ( forwarding )
     {
-        getLoggerInstance()->writeError( std::string( "Could not properly delete Serial Device with ID \"" + deviceId + "\" on port \"" + serialPort + "\"." ) );
-
-        return false;
+        forwardOutboundMessages( deviceId );
     }
+
+    return true;
 }
 
-unsigned int SerialPortGateway::deleteAllSerialDevices( bool suppressLogs )
+bool SerialPortGateway::provideHandoverDevices( std::vector<HandoverDevice> & handoverDevices )
 {
-    if ( !suppressLogs )
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Handing serial devices over" );
+
     {
-        getLoggerInstance()->writeInfo( std::string( "Trying to delete all Serial Devices." ) );
+        // From here on, no device gets added and no read loop started (See "addSerialDevice")
+        std::lock_guard<std::mutex> lock( serialDevicesMutex );
+        handoverActive = true;
     }
 
-    unsigned int numDevicesDeleted = 0;
+    stopAllReadLoops(); // Not locked, since stopping a read loop looks its device up
 
-    for ( std::pair<std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
+    // Every read loop finishes its current read, so no line gets read twice, or by nobody; The successor doesn't wait any longer for the devices
+    SteadyTimePoint deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( DeviceHandover::RECORD_TIMEOUT );
+
+    while ( !isEveryReadLoopQuitted() )
     {
-        if ( deleteSerialDevice( entry.first ) )
+        if ( std::chrono::steady_clock::now() >= deadline )
         {
-            numDevicesDeleted++;
+            SPG_LOG_WARN( getStructuredLoggerInstance(), "Read loops didn't stop in time, aborting the handover", logField( "timeoutMs", DeviceHandover::RECORD_TIMEOUT ) );
+
+            return false;
         }
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
     }
 
-    if ( !suppressLogs )
+    std::lock_guard<std::mutex> lock( serialDevicesMutex );
+
+    for ( std::pair<const std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
     {
-        getLoggerInstance()->writeInfo( "Finished deleting serial devices. Deleted " + std::to_string( numDevicesDeleted ) + " devices." );
+        HandoverDevice handoverDevice;
+        handoverDevice.deviceId = entry.first;
+        handoverDevice.port = entry.second->getPort();
+        handoverDevice.serialParameters = entry.second->getSerialParameters().toString();
+        handoverDevice.fd = ::open( handoverDevice.port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC );
+
+        // The successor can still open the port itself; The device may reset then, though
+        if ( handoverDevice.fd < 0 )
+        {
+            SPG_LOG_WARN( getStructuredLoggerInstance(), "Couldn't keep the port open for the handover", logField( "deviceId", entry.first ), logField( "port", handoverDevice.port ), logField( "error", std::strerror( errno ) ) );
+        }
+
+        {
+            std::lock_guard<std::mutex> lock( partialLinesMutex );
+            PartialLineMap::iterator it = partialLines.find( entry.first );
+
+            if ( it != partialLines.end() )
+            {
+                handoverDevice.partialLine = it->second;
+            }
+        }
+
+        handoverDevices.push_back( handoverDevice );
     }
 
-    return numDevicesDeleted;
+    return true;
 }
 
-void SerialPortGateway::readLoop( std::string deviceId )
+void SerialPortGateway::completeHandover( const std::vector<HandoverDevice> & devices, bool confirmed )
 {
-    getLoggerInstance()->writeInfo( std::string( "Read loop started for Serial Device with ID \"" + deviceId + "\"." ) );
+    if ( !confirmed )
+    {
+        SPG_LOG_WARN( getStructuredLoggerInstance(), "Handover wasn't confirmed, serving the serial devices again", logField( "devices", devices.size() ) );
 
-    setReadLoopQuitted( deviceId, false );
+        std::vector<std::string> stuckDeviceIds;
 
-    while ( isReadLoopStarted( deviceId ) )
-    {
-        try
         {
-            std::string line = getSerialDeviceById( deviceId )->getInstance()->readline();
+            std::lock_guard<std::mutex> lock( serialDevicesMutex );
+            handoverActive = false;
 
-            if ( !line.empty() )
+            // The partial lines are still there for the new read loops
+            for ( std::pair<const std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
             {
-                std::thread( &SerialPortGateway::processMessage, this, deviceId, line ).detach();
+                if ( isReadLoopQuitted( entry.first ) )
+                {
+                    startReadLoop( entry.first );
+                }
+                else
+                {
+                    stuckDeviceIds.push_back( entry.first ); // Starting another read loop would leave the device with two, once the stuck one returns
+                }
             }
         }
-        catch ( const serial::SerialException & e )
+
+        for ( std::string const & deviceId : stuckDeviceIds )
         {
-            getLoggerInstance()->writeError( std::string( "Serial Port Error: " + std::string( e.what() ) ) );
-            getLoggerInstance()->writeInfo( std::string( "Deleting Serial Device with ID \"" + deviceId + "\" due to an read error." ) );
+            SPG_LOG_WARN( getStructuredLoggerInstance(), "Read loop didn't stop for the handover, deleting Serial Device", logField( "deviceId", deviceId ) );
 
-            deleteSerialDevice( deviceId );
+            deleteSerialDevice( deviceId ); // The next scan adds it again
         }
+
+        return;
     }
 
-    getLoggerInstance()->writeInfo( std::string( "Read loop stopped for Serial Device with ID \"" + deviceId + "\"." ) );
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Handed serial devices over", logField( "devices", devices.size() ) );
 
-    setReadLoopQuitted( deviceId, true );
+    // Closes our descriptors of the ports; The successor holds its own, so the ttys stay open
+    stop();
+    handedOver = true;
 }
 
-void SerialPortGateway::startReadLoop( std::string deviceId )
+void SerialPortGateway::start()
 {
-    setReadLoopStarted( deviceId, true );
-    std::thread( &SerialPortGateway::readLoop, this, deviceId ).detach();
-}
+    if ( isStarted() )
+    {
+        SPG_LOG_WARN( getStructuredLoggerInstance(), "SerialPortGateway already started, not starting again." );
 
-void SerialPortGateway::stopReadLoop( std::string deviceId )
-{
-    setReadLoopStarted( deviceId, false );
-}
+        return;
+    }
 
-void SerialPortGateway::stopAllReadLoops()
-{
-    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
-    AtomicBoolPairMap::iterator it;
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Starting SerialPortGateway." );
 
-    for ( it = readLoopStates->begin(); it != readLoopStates->end(); it++ )
+    setStarted( true );
+    discardingInbound = false;
+    getCallbackDispatcherInstance()->start();
+
+    if ( PrometheusExporter * prometheusExporter = getPrometheusExporterInstance() )
     {
-        stopReadLoop( it->first );
+        // A metrics exporter which can't listen is no reason to not serve the devices
+        try
+        {
+            prometheusExporter->start();
+
+            SPG_LOG_INFO( getStructuredLoggerInstance(), "Serving Prometheus metrics", logField( "unixSocket", getMetricsUnixSocket() ), logField( "port", getMetricsPort() ) );
+        }
+        catch ( const Exception & e )
+        {
+            SPG_LOG_ERROR( getStructuredLoggerInstance(), "Couldn't start the Prometheus exporter", logField( "error", e.what() ) );
+        }
     }
-}
 
-void SerialPortGateway::setReadLoopStarted( std::string deviceId, bool started )
-{
-    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
+    if ( DeviceHandover * deviceHandover = getDeviceHandoverInstance() )
+    {
+        // Before the first scan, so it doesn't probe the ports which are being taken over
+        takeOverSerialDevices();
 
-    ( * readLoopStates )[deviceId].first = started;
-}
+        try
+        {
+            deviceHandover->start();
 
-bool SerialPortGateway::isReadLoopStarted( std::string deviceId )
-{
-    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
-    AtomicBoolPairMap::iterator it = readLoopStates->find( deviceId );
+            SPG_LOG_INFO( getStructuredLoggerInstance(), "Serving device handovers", logField( "socket", getHandoverSocket() ) );
+        }
+        catch ( const Exception & e )
+        {
+            SPG_LOG_ERROR( getStructuredLoggerInstance(), "Couldn't start the device handover", logField( "error", e.what() ) );
+        }
+    }
 
-    if ( it != readLoopStates->end() )
     {
-        return it->second.first;
+        std::lock_guard<std::mutex> lock( scanMutex );
+        scanLoopRunning = true;
     }
 
-    return false;
+    threads.spawn( std::bind( &SerialPortGateway::addNewSerialPortsLoop, this ) );
 }
 
-void SerialPortGateway::setReadLoopQuitted( std::string deviceId, bool quitted )
+StopReport SerialPortGateway::stop()
 {
-    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
-
-    ( * readLoopStates )[deviceId].second = quitted;
+    return stop( std::chrono::milliseconds( getStopTimeout() ) );
 }
 
-bool SerialPortGateway::isReadLoopQuitted( std::string deviceId )
+StopReport SerialPortGateway::stop( std::chrono::milliseconds timeout )
 {
-    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
-    AtomicBoolPairMap::iterator it = readLoopStates->find( deviceId );
+    StopReport stopReport = { true, 0, 0, 0, 0 };
 
-    if ( it != readLoopStates->end() )
+    if ( !isStarted() )
     {
-        return it->second.second;
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "SerialPortGateway not started. Nothing to be stopped." );
+
+        return stopReport;
     }
 
-    return true;
-}
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Stopping SerialPortGateway.", logField( "timeoutMs", timeout.count() ) );
 
-bool SerialPortGateway::isEveryReadLoopQuitted()
-{
-    AtomicBoolPairMap * readLoopStates = getReadLoopStates();
-    AtomicBoolPairMap::iterator it;
+    SteadyTimePoint begin = std::chrono::steady_clock::now();
+    SteadyTimePoint deadline = begin + timeout;
+    stopping = true;
+    inboundDropped = 0;
 
-    for ( it = readLoopStates->begin(); it != readLoopStates->end(); it++ )
     {
-        if ( isReadLoopQuitted( it->first ) )
-        {
-            continue;
-        }
-        else
-        {
-            return false;
-        }
+        std::lock_guard<std::mutex> lock( scanMutex );
+        setStarted( false );
     }
 
-    return true;
-}
-
-bool SerialPortGateway::retrieveDeviceId( SerialDevicePointer serialDevice )
-{
-    std::string commandToGetDeviceId = getCommandToGetDeviceId() + CHAR_NEWLINE;
-
-    SerialDevice::SerialInstance serialInstance = serialDevice->getInstance();
-    serialInstance->flush();
-    serialInstance->write( commandToGetDeviceId );
-    //std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
-    std::string message = serialInstance->readline();
-
-    StringPair parsedMessage = parseMessage( message, getMessageDelimiter() );
-    std::string type = parsedMessage.first;
-    std::string deviceId = parsedMessage.second;
+    scanCondition.notify_all();
 
-    if ( type == getMessageTypeForIds() && !deviceId.empty() )
+    // First, so no successor takes the devices over while they get deleted
+    if ( DeviceHandover * deviceHandover = getDeviceHandoverInstance() )
     {
-        serialDevice->setId( deviceId );
-
-        return true;
+        deviceHandover->stop();
     }
-    else
+
+    // A scan which is still running could add devices after they got deleted; No new ports get probed, so it only finishes the current one
     {
-        return false;
+        std::unique_lock<std::mutex> lock( scanMutex );
+        scanCondition.wait_until( lock, deadline, [this]() { return !scanLoopRunning; } );
     }
-}
 
-SerialPortGateway::StringPair SerialPortGateway::parseMessage( std::string message, std::string delimiter )
-{
-    std::size_t delimiterPos = message.find_first_of( delimiter );
-    std::size_t messageEnd = message.find_first_of( CHAR_NEWLINE + CHAR_CARRIAGE_RETURN );
-    std::string type = "";
-    std::string content = "";
+    InboundQueueMap stoppedInboundQueues;
 
-    // Parses the message only when there is a correct ending and a delimiter.
-    // Allows to send messages with empty types, as long as there's a delimiter AND content after that
-    if ( messageEnd != std::string::npos && delimiterPos != std::string::npos )
     {
-        type = message.substr( 0, delimiterPos );
-
-        if (  delimiterPos < messageEnd )
-        {
-            messageEnd--; // Exclude the newline character
-            content = message.substr( delimiterPos + 1, messageEnd - delimiterPos );
-        }
+        std::lock_guard<std::mutex> lock( inboundQueuesMutex );
+        stoppedInboundQueues = inboundQueues; // Closing a queue unregisters it
     }
 
-    return std::make_pair( type, content );
-}
+    // The read loops get interrupted, and finish their current line; Closing the ports underneath them would cut it off
+    stopAllReadLoops();
 
-void SerialPortGateway::processMessage( std::string deviceId, std::string message )
-{
-    StringPair parsedMessage = parseMessage( message, getMessageDelimiter() );
-    std::string type = parsedMessage.first;
-    std::string content = parsedMessage.second;
-    SerialMessage serialMessage = SerialMessage( deviceId, type, content );
+    while ( !isEveryReadLoopQuitted() && std::chrono::steady_clock::now() < deadline )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
 
-    std::thread( &SerialPortGateway::messageCallback, this, serialMessage ).detach();
-}
+    deleteAllSerialDevices();
 
-void SerialPortGateway::sendMessageToSerialDeviceBlocking( std::string deviceId, std::string message )
-{
-    try
+    // Meanwhile the delivery loops and the message workers process the messages which are still queued
+    if ( threads.join( deadline ) > 0 || !getMessageWorkerPoolInstance()->waitIdle( deadline ) )
     {
-        SerialDevicePointer device = getSerialDeviceById( deviceId );
+        discardingInbound = true;
 
-        if ( device != nullptr )
+        for ( std::pair<const std::string, InboundQueuePointer> const & entry : stoppedInboundQueues )
         {
-            SerialDevice::SerialInstance serialInstance = device->getInstance();
-            std::size_t bytesWritten = serialInstance->write( message + CHAR_NEWLINE ); // Append a newline character to mark the end of the message
+            long long discarded = static_cast<long long>( entry.second->discard() );
+            DeviceMetricsPointer deviceMetrics = getMetrics()->getDeviceMetrics( entry.first );
 
-            if ( bytesWritten == message.length() + 1 ) // + 1 for the appended newline character
-            {
-                getLoggerInstance()->writeInfo( std::string( "Delivered message \"" + message + "\" to device with ID \"" + deviceId + "\" (Bytes written: " + std::to_string( bytesWritten ) + "/" + std::to_string( message.length() + 1 ) + ")." ) );
-            }
-            else
+            if ( discarded > 0 && deviceMetrics != nullptr )
             {
-                getLoggerInstance()->writeError( std::string( "Could not deliver message \"" + message + "\" properly to device with ID \"" + deviceId + "\" (Bytes written: " + std::to_string( bytesWritten ) + "/" + std::to_string( message.length() + 1 ) + ")." ) );
+                deviceMetrics->changeInboundQueued( -discarded );
+                deviceMetrics->changeInFlightCallbacks( -discarded );
             }
-        }
-        else
-        {
-            getLoggerInstance()->writeInfo( std::string( "Device with ID \"" + deviceId + "\" not found. Message \"" + message + "\" can not be delivered." ) );
+
+            inboundDropped += discarded;
         }
     }
-    catch ( const serial::SerialException & e )
-    {
-        getLoggerInstance()->writeError( std::string( "Serial Port Error: " + std::string( e.what() ) ) );
-        getLoggerInstance()->writeInfo( std::string( "Deleting Serial Device with ID \"" + deviceId + "\" due to an write error." ) );
 
-        deleteSerialDevice( deviceId );
-    }
-}
+    stopReport.callbacksDropped = getCallbackDispatcherInstance()->stop( deadline ); // Runs the callbacks still queued on the isolated lane, until the deadline
+    getSendWorkerPoolInstance()->waitIdle( deadline ); // Including the messages the callbacks sent
 
-void SerialPortGateway::start()
-{
-    if ( isStarted() )
+    if ( PrometheusExporter * prometheusExporter = getPrometheusExporterInstance() )
     {
-        getLoggerInstance()->writeWarn( "SerialPortGateway already started, not starting again." );
-
-        return;
+        prometheusExporter->stop();
     }
 
-    getLoggerInstance()->writeInfo( "Starting SerialPortGateway." );
-
-    setStarted( true );
-
-    std::thread( &SerialPortGateway::addNewSerialPortsLoop, this ).detach();
-}
+    stopReport.threadsRunning = static_cast<unsigned int>( threads.getSize() + getCallbackDispatcherInstance()->getRunningThreads() + getMessageWorkerPoolInstance()->getBusyWorkers() + getSendWorkerPoolInstance()->getBusyWorkers() );
+    stopReport.inboundDropped = inboundDropped;
+    stopReport.complete = stopReport.threadsRunning == 0 && stopReport.inboundDropped == 0 && stopReport.callbacksDropped == 0;
+    stopReport.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - begin ).count();
+    stopping = false;
 
-void SerialPortGateway::stop()
-{
-    if ( !isStarted() )
+    if ( stopReport.complete )
     {
-        getLoggerInstance()->writeInfo( "SerialPortGateway not started. Nothing to be stopped." );
-
-        return;
+        SPG_LOG_INFO( getStructuredLoggerInstance(), "Stopped SerialPortGateway.", logField( "elapsedMs", stopReport.elapsed ) );
+    }
+    else
+    {
+        SPG_LOG_WARN( getStructuredLoggerInstance(), "SerialPortGateway didn't stop completely within the timeout", logField( "elapsedMs", stopReport.elapsed ), logField( "inboundDropped", stopReport.inboundDropped ), logField( "callbacksDropped", stopReport.callbacksDropped ), logField( "threadsRunning", stopReport.threadsRunning ) );
     }
 
-    getLoggerInstance()->writeInfo( "Stopping SerialPortGateway." );
+    if ( AsyncLogger * asyncLogger = getAsyncLoggerInstance() )
+    {
+        asyncLogger->flush();
+    }
 
-    setStarted( false );
-    deleteAllSerialDevices();
+    return stopReport;
 }
 
 void SerialPortGateway::setStarted( bool started )
@@ -947,11 +3669,17 @@ bool SerialPortGateway::isStarted()
     return this->started;
 }
 
+bool SerialPortGateway::isHandedOver()
+{
+    return this->handedOver;
+}
+
 std::vector<std::string> SerialPortGateway::getDeviceIds()
 {
     std::vector<std::string> deviceIds;
+    std::lock_guard<std::mutex> lock( serialDevicesMutex );
 
-    for ( std::pair<std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
+    for ( std::pair<const std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
     {
         deviceIds.insert( deviceIds.begin(), entry.first );
     }
@@ -983,7 +3711,7 @@ std::vector<std::string> SerialPortGateway::getSerialPorts()
 {
     std::vector<std::string> serialPorts;
 
-    for ( serial::PortInfo const & serialPortInfo : serial::list_ports() )
+    for ( serial::PortInfo const & serialPortInfo : getSerialTransportFactoryInstance()->listPorts() )
     {
         serialPorts.insert( serialPorts.begin(), serialPortInfo.port );
     }
@@ -1014,8 +3742,9 @@ std::string SerialPortGateway::getSerialPortList()
 std::map<std::string, std::string> SerialPortGateway::getDeviceIdToSerialPortMappings()
 {
     std::map<std::string, std::string> deviceIdToSerialPortMappings;
+    std::lock_guard<std::mutex> lock( serialDevicesMutex );
 
-    for ( std::pair<std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
+    for ( std::pair<const std::string, SerialDevicePointer> const & entry : * getSerialDevices() )
     {
         deviceIdToSerialPortMappings[entry.first] = entry.second->getPort();
     }
@@ -1043,17 +3772,115 @@ std::string SerialPortGateway::getDeviceIdToSerialPortMappingList()
     return result;
 }
 
-void SerialPortGateway::sendMessageToSerialDevice( std::string deviceId, std::string message )
+std::vector<ProbeRecord> SerialPortGateway::getQuarantinedSerialPorts()
+{
+    return getProbeSchedulerInstance()->getQuarantined();
+}
+
+std::string SerialPortGateway::getQuarantinedSerialPortList()
+{
+    std::stringstream quarantinedSerialPortList;
+
+    for ( ProbeRecord const & probeRecord : getQuarantinedSerialPorts() )
+    {
+        quarantinedSerialPortList << probeRecord.port << " (" << probeRecord.failures << " failed probes: " << probeRecord.identity << ")" << LIST_SEPARATOR;
+    }
+
+    std::string result = quarantinedSerialPortList.str();
+
+    if ( !result.empty() )
+    {
+        std::size_t separatorLength = LIST_SEPARATOR.length();
+        result.erase( result.length() - separatorLength, separatorLength ); // Remove the last separator
+    }
+
+    return result;
+}
+
+bool SerialPortGateway::releaseQuarantinedSerialPort( std::string serialPort )
+{
+    if ( !getProbeSchedulerInstance()->release( serialPort ) )
+    {
+        SPG_LOG_WARN( getStructuredLoggerInstance(), "Serial port is not quarantined and could therefore not be released", logField( "port", serialPort ) );
+
+        return false;
+    }
+
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "Released serial port from quarantine", logField( "port", serialPort ) );
+
+    return true;
+}
+
+void SerialPortGateway::sendMessageToSerialDevice( const std::string & deviceId, const std::string & message )
 {
-    std::thread( &SerialPortGateway::sendMessageToSerialDeviceBlocking, this, deviceId, message ).detach();
+    SPG_ALLOCATION_STAGE( AllocationStage::SEND );
+
+    SteadyTimePoint requestTime = std::chrono::steady_clock::now();
+    DeviceMetricsPointer deviceMetrics = getMetrics()->getDeviceMetrics( deviceId );
+
+    if ( deviceMetrics != nullptr )
+    {
+        deviceMetrics->changePendingSends( 1 );
+    }
+
+    bool queued = getSendWorkerPoolInstance()->submit( deviceId, [&]( SendJob & job )
+    {
+        job.deviceId = deviceId;
+        job.message = message;
+        job.requestTime = requestTime;
+        job.deviceMetrics = deviceMetrics;
+    } );
+
+    if ( !queued && deviceMetrics != nullptr ) // The gateway is being destroyed
+    {
+        deviceMetrics->changePendingSends( -1 );
+    }
 }
 
 void SerialPortGateway::broadcastMessageToSerialDevices( std::string message )
 {
     for ( std::string deviceId : getDeviceIds() )
     {
-        std::thread( &SerialPortGateway::sendMessageToSerialDeviceBlocking, this, deviceId, message ).detach();
+        sendMessageToSerialDevice( deviceId, message );
+    }
+}
+
+unsigned long long SerialPortGateway::getSchemaMismatchCount()
+{
+    unsigned long long mismatchCount = 0;
+
+    for ( std::pair<const std::string, MessageSchemaPointer> const & entry : * getMessageSchemas() )
+    {
+        mismatchCount += entry.second->getMismatchCount();
+    }
+
+    return mismatchCount;
+}
+
+GatewayMetricsSnapshot SerialPortGateway::getMetricsSnapshot()
+{
+    GatewayMetricsSnapshot snapshot = getMetrics()->getSnapshot();
+    snapshot.schemaMismatchCount = getSchemaMismatchCount();
+    snapshot.droppedLogCount = getDroppedLogCount();
+    snapshot.isolatedQueueDepth = getCallbackDispatcherInstance()->getIsolatedQueueDepth();
+
+    for ( std::pair<const std::string, DeviceMetricsSnapshot> & entry : snapshot.devices )
+    {
+        OutboundBufferStatistics statistics = getOutboundBufferInstance()->getStatistics( entry.first );
+        entry.second.outboundBuffered = statistics.buffered;
+        entry.second.outboundDropped = statistics.dropped;
+        entry.second.outboundExpired = statistics.expired;
+        entry.second.outboundForwarded = statistics.forwarded;
     }
+
+    snapshot.stageLatencies = getStageTracerInstance()->getStageLatencies();
+
+    return snapshot;
+}
+
+std::string SerialPortGateway::getTraceJson()
+{
+    return getStageTracerInstance()->exportChromeTrace();
 }
 
 void SerialPortGateway::serialDeviceAddedCallback( std::string deviceId, std::string serialPort )
@@ -1068,13 +3895,15 @@ void SerialPortGateway::serialDeviceDeletedCallback( std::string deviceId, std::
 
 void SerialPortGateway::messageCallback( SerialMessage serialMessage )
 {
-    std::stringstream message;
-    message
-        << "New message from \"" << serialMessage.getDeviceId()
-        << "\": timestamp=\"" << serialMessage.getTimestamp()
-        << "\", type=\"" << serialMessage.getType()
-        << "\", content=\"" << serialMessage.getContent()
-        << "\".";
+    SPG_LOG_INFO( getStructuredLoggerInstance(), "New message", logField( "deviceId", serialMessage.getDeviceId() ), logField( "timestamp", serialMessage.getTimestamp() ), logField( "type", serialMessage.getType() ), logField( "content", serialMessage.getContent() ) );
+}
+
+void SerialPortGateway::schemaMessageCallback( SerialMessage serialMessage, SchemaRecord schemaRecord )
+{
+    messageCallback( serialMessage );
+}
 
-    getLoggerInstance()->writeInfo( message.str() );
+void SerialPortGateway::schemaMismatchCallback( SerialMessage serialMessage )
+{
+    SPG_LOG_WARN( getStructuredLoggerInstance(), "Message doesn't match the schema of its type", logField( "deviceId", serialMessage.getDeviceId() ), logField( "type", serialMessage.getType() ), logField( "content", serialMessage.getContent() ) );
 }
@@ -26,16 +26,54 @@
 #include <sstream> // std::stringstream
 #include <fstream>  // std::ifstream
 #include <thread> // std::thread, std::this_thread::sleep_for
+#include <chrono> // std::chrono::steady_clock
+#include <functional> // std::bind
+#include <mutex> // std::mutex, std::lock_guard
+#include <vector> // std::vector
+#include <algorithm> // std::min, std::max
+#include <condition_variable> // std::condition_variable
 
 // wjwwood's serial Library (https://github.com/wjwwood/serial)
 #include "serial/serial.h"
 
 #include "SerialDevice.hpp"
 #include "SerialMessage.hpp"
+#include "MessageSchema.hpp"
+#include "AsyncLogger.hpp"
+#include "StructuredLogger.hpp"
+#include "GatewayMetrics.hpp"
+#include "PrometheusExporter.hpp"
+#include "DeviceHandover.hpp"
+#include "StageTracer.hpp"
+#include "AllocationTracker.hpp"
+#include "CallbackDispatcher.hpp"
+#include "ThreadGroup.hpp"
+#include "InboundQueue.hpp"
+#include "WorkerPool.hpp"
+#include "OutboundBuffer.hpp"
+#include "EventBus.hpp"
+#include "DeviceIdentityCache.hpp"
+#include "BootDelayTracker.hpp"
+#include "ProbeScheduler.hpp"
+#include "SerialTransport.hpp"
+#include "SerialLibraryTransport.hpp"
 #include "../dependencies/Exception/src/Exception.hpp"
 #include "../dependencies/Config/src/Config.hpp"
 #include "../dependencies/Logger/src/Logger.hpp"
 
+/**
+ * StopReport struct
+ * Purpose: Holds how stopping the gateway went; Whatever couldn't be finished until the stop timeout got dropped.
+*/
+struct StopReport
+{
+    bool complete; // Every thread of the gateway finished, and nothing got dropped
+    unsigned long long elapsed; // ms
+    unsigned long long inboundDropped; // Messages read from the devices, which didn't get processed
+    unsigned long long callbacksDropped; // Callbacks queued on the isolated lane, which didn't get run
+    unsigned int threadsRunning; // Threads still running at the deadline (e.g. a callback which doesn't return); The destructor waits for them
+};
+
 /**
  * SerialPortGateway class
  * File: SerialPortGateway.hpp
@@ -47,22 +85,77 @@
  * @author Jan-Eric Schober
  * @version 1.0, 20.01.2019
 */
+class SerialPortGatewayProbe; // Defined by the microbenchmarks (See bench/gateway-microbench.cpp)
+
 class SerialPortGateway
 {
+    friend class SerialPortGatewayProbe; // Test-friend hook, which gives the microbenchmarks access to the private helpers
+
 private:
     // Types
-    typedef std::shared_ptr<SerialDevice> SerialDevicePointer; // Shared Pointers are used, so a detached thread can finish it's operation even when the SerialDevice has been deleted from our SerialDevice list.
+    typedef std::shared_ptr<SerialDevice> SerialDevicePointer; // Shared Pointers are used, so a thread can finish it's operation even when the SerialDevice has been deleted from our SerialDevice list.
     typedef std::map<std::string, SerialDevicePointer> SerialDeviceMap; // first value: deviceId, second value: SerialDevicePointer
     typedef std::set<std::string> StringSet;
     typedef std::pair<std::string, std::string> StringPair;
     typedef std::pair<std::atomic<bool>, std::atomic<bool>> AtomicBoolPair;
     typedef std::map<std::string, AtomicBoolPair> AtomicBoolPairMap;
+    typedef std::shared_ptr<MessageSchema> MessageSchemaPointer;
+    typedef std::map<std::string, MessageSchemaPointer> MessageSchemaMap; // first value: message type, second value: MessageSchemaPointer
+    typedef GatewayMetrics::DeviceMetricsPointer DeviceMetricsPointer;
+    typedef std::chrono::steady_clock::time_point SteadyTimePoint;
+    typedef std::shared_ptr<InboundQueue> InboundQueuePointer;
+    typedef std::map<std::string, InboundQueuePointer> InboundQueueMap; // first value: deviceId, second value: InboundQueuePointer
+    typedef std::map<std::string, ResetControl> ResetControlMap; // first value: port or hardwareId, second value: ResetControl
+    typedef std::map<std::string, LatencyProfile> LatencyProfileMap; // first value: port or hardwareId, second value: LatencyProfile
+    typedef std::map<std::string, SerialParameters> SerialParametersMap; // first value: port, hardwareId or deviceId, second value: SerialParameters
+    typedef std::map<std::string, std::string> PartialLineMap; // first value: deviceId, second value: partial line
+    typedef std::function<void( std::string key, std::string value )> ConfigLineHandler; // Throws std::invalid_argument if the value is malformed
+
+    enum class CallbackType
+    {
+        MESSAGE,
+        SCHEMA_MESSAGE,
+        SCHEMA_MISMATCH
+    };
+
+    enum class IdentityVerification
+    {
+        PENDING,
+        CONFIRMED,
+        MISMATCHED
+    };
+
+    typedef std::map<std::string, IdentityVerification> IdentityVerificationMap; // first value: deviceId, second value: state of the verification
+
+    struct LineJob // A line read from a device without an inbound queue, waiting for a message worker to process it
+    {
+        std::string deviceId;
+        std::string line;
+        SteadyTimePoint readTime;
+        DeviceMetricsPointer deviceMetrics;
+        TraceContext traceContext;
+    };
+
+    struct SendJob // A message waiting for a send worker to write it to a device
+    {
+        std::string deviceId;
+        std::string message;
+        SteadyTimePoint requestTime;
+        DeviceMetricsPointer deviceMetrics; // nullptr if the device has never been seen
+    };
+
+    typedef WorkerPool<LineJob> MessageWorkerPool;
+    typedef WorkerPool<SendJob> SendWorkerPool;
 
     // Constants
     static const std::string CHAR_SPACE;
     static const std::string CHAR_NEWLINE;
     static const std::string CHAR_CARRIAGE_RETURN;
     static const std::string LIST_SEPARATOR;
+    static const std::string SCHEMA_TYPE_SEPARATOR;
+    static const std::string CHAR_COMMENT;
+    static const unsigned int MAX_HANDSHAKE_RETRY_INTERVAL; // ms; The retry interval of the adaptive handshake doesn't grow beyond
+    static const std::size_t WORKER_QUEUE_CAPACITY; // Jobs queued per message or send worker; Submitting more blocks until the worker caught up
 
     // Variables
     std::string configFile;
@@ -70,19 +163,95 @@ private:
     std::string serialPortBlacklistFile;
     std::string logPath;
     bool loggingActive;
+    bool asyncLoggingActive;
+    unsigned int asyncLoggingCapacity;
+    LogLevel logLevel;
     unsigned int scanInterval;
     unsigned int waitBeforeCommunication;
     unsigned int baudRate;
     std::string messageDelimiter;
     std::string commandToGetDeviceId;
     std::string messageTypeForIds;
+    std::string messageSchemaFile;
+    std::string schemaFieldDelimiter;
+    std::string metricsUnixSocket;
+    unsigned int metricsPort;
+    bool tracingActive;
+    unsigned int tracingBufferSize;
+    unsigned int callbackBudget;
+    unsigned int callbackSlowStreak;
+    unsigned int isolatedLaneThreads;
+    unsigned int messageThreads;
+    unsigned int sendThreads;
+    unsigned int inboundQueueCapacity;
+    OverflowPolicy inboundOverflowPolicy;
+    unsigned int outboundBufferCapacity;
+    unsigned int outboundBufferBytes;
+    unsigned int outboundBufferTtl;
+    std::string identityCacheFile;
+    unsigned int identityVerifyTimeout;
+    bool adaptiveHandshakeActive;
+    unsigned int handshakeRetryInterval;
+    unsigned int handshakeDeadline;
+    std::string resetControlFile;
+    unsigned int probeBackoff;
+    unsigned int probeBackoffMax;
+    unsigned int probeQuarantineAfter;
+    LatencyProfile defaultLatencyProfile;
+    std::string latencyProfileFile;
+    std::string serialParametersFile;
+    std::string baudEscalationCommand;
+    unsigned int baudEscalationRate;
+    serial::flowcontrol_t flowControl;
+    unsigned int lineErrorInterval;
+    std::string handoverSocket;
+    unsigned int stopTimeout;
+    unsigned int eventBusCapacity;
     Config * configInstance;
     Logger * loggerInstance;
+    AsyncLogger * asyncLoggerInstance; // nullptr if async logging is not active
+    StructuredLogger * structuredLoggerInstance;
+    PrometheusExporter * prometheusExporterInstance; // nullptr if the metrics exporter is not active
+    DeviceHandover * deviceHandoverInstance; // nullptr if the device handover is not active
+    StageTracer * stageTracerInstance; // Always set; Records nothing if tracing is not active
+    CallbackDispatcher * callbackDispatcherInstance;
+    MessageWorkerPool * messageWorkerPoolInstance; // Processes the lines of the devices without an inbound queue
+    SendWorkerPool * sendWorkerPoolInstance;
+    OutboundBuffer * outboundBufferInstance;
+    EventBus * eventBusInstance; // nullptr if the event bus is not active
+    DeviceIdentityCache * deviceIdentityCacheInstance; // nullptr if the identity cache is not active
+    ProbeScheduler * probeSchedulerInstance; // Always set; Every port gets probed by every scan if the probe backoff is not active
+    SerialTransportFactory * serialTransportFactoryInstance;
     std::atomic_bool started;
+    std::atomic_bool handoverActive; // The read loops got stopped to hand the devices over; No devices get added meanwhile
+    std::atomic_bool handedOver;
+    std::atomic_bool stopping; // The gateway is being stopped; No devices get added meanwhile
+    std::atomic_bool discardingInbound; // The stop timeout passed; Messages which haven't been processed yet get dropped
+    std::atomic<unsigned long long> inboundDropped; // Messages dropped by the last stop
+    bool scanLoopRunning; // Guarded by scanMutex
+    std::mutex scanMutex;
+    std::condition_variable scanCondition; // Wakes up the scan loop once the gateway gets stopped, and the stop once the scan loop quitted
     StringSet hardwareWhitelist; // Contains all whitelisted hardwareIds
     StringSet serialPortBlacklist; // Contains all blacklisted serialPorts
     SerialDeviceMap serialDevices; // Contains a mapping between all registered deviceIds and SerialDevicePointers. ( deviceId -> SerialDevicePointer )
+    std::mutex serialDevicesMutex; // Guards serialDevices; Serializes adding and deleting devices (and starting their read loops) with the handover
     AtomicBoolPairMap readLoopStates; // Contains a mapping between all registered deviceIds, and whether the loop is started, respectively quitted. ( deviceId -> <started, quitted> )
+    std::mutex readLoopStatesMutex; // Guards readLoopStates (not the states themselves, they're atomic); Only ever taken after serialDevicesMutex, never before
+    MessageSchemaMap messageSchemas; // Contains a mapping between message types and their compiled schemas. ( type -> MessageSchemaPointer )
+    ResetControlMap resetControls; // Contains the ports and hardwareIds whose modem lines don't get treated the default way. ( port/hardwareId -> ResetControl )
+    LatencyProfileMap latencyProfiles; // Contains the ports and hardwareIds which don't get the default latency profile. ( port/hardwareId -> LatencyProfile )
+    SerialParametersMap declaredSerialParameters; // Contains the ports, hardwareIds and deviceIds which don't get the default serial parameters. ( port/hardwareId/deviceId -> SerialParameters )
+    GatewayMetrics metrics; // Contains the metrics of all devices seen so far
+    BootDelayTracker bootDelays; // Contains the typical boot delays, learned by the adaptive handshake
+    InboundQueueMap inboundQueues; // Contains a mapping between deviceIds and the inbound queues of their running read loops. ( deviceId -> InboundQueuePointer )
+    std::mutex inboundQueuesMutex;
+    IdentityVerificationMap identityVerifications; // Contains the devices which got registered from the identity cache, and haven't confirmed their ID yet. ( deviceId -> IdentityVerification )
+    std::atomic<std::size_t> identityVerificationCount; // Size of identityVerifications; Spares the sends the lock while no device is being verified
+    std::mutex identityVerificationsMutex;
+    std::condition_variable identityVerificationsCondition;
+    PartialLineMap partialLines; // Contains the lines which stopped read loops left unfinished, for the next read loop of the device (which may be run by another process). ( deviceId -> partial line )
+    std::mutex partialLinesMutex;
+    ThreadGroup threads; // Contains the threads the gateway starts itself; The read loops, delivery loops, scan loop, and device callbacks (The workers belong to their pools)
 
     // Methods
     /**
@@ -155,137 +324,1072 @@ private:
     */
     bool isLoggingActive();
 
+    /**
+     * Sets whether the gateway's logs are written asynchronously (in batches by a background thread) or not.
+     *
+     * @param asyncLoggingActive Async logging true/false.
+    */
+    void setAsyncLoggingActive( bool asyncLoggingActive );
+
+    /**
+     * Gets whether async logging is active or not.
+     *
+     * @return Async logging active?
+    */
+    bool isAsyncLoggingActive();
+
+    /**
+     * Sets how many log records the async logger can buffer, before messages get dropped.
+     *
+     * @param asyncLoggingCapacity Capacity in records.
+    */
+    void setAsyncLoggingCapacity( unsigned int asyncLoggingCapacity );
+
+    /**
+     * Gets the currently set capacity of the async logger.
+     *
+     * @return Capacity in records.
+    */
+    unsigned int getAsyncLoggingCapacity();
+
+    /**
+     * Sets the minimum level of log events to be emitted by the gateway.
+     *
+     * @param logLevel Minimum log level.
+    */
+    void setLogLevel( LogLevel logLevel );
+
+    /**
+     * Gets the minimum level of log events to be emitted by the gateway.
+     *
+     * @return Minimum log level.
+    */
+    LogLevel getLogLevel();
+
     /**
      * Sets the interval (in ms) in which should be searched for new serial devices.
      * Zero (0) means that there will only be one initial scan, but no further automatic, periodical scans.
      *
      * @param scanInterval Scan interval in ms.
     */
-    void setScanInterval( unsigned int scanInterval );
+    void setScanInterval( unsigned int scanInterval );
+
+    /**
+     * Gets the currently set scan interval.
+     *
+     * @return Scan interval in ms.
+    */
+    unsigned int getScanInterval();
+
+    /**
+     * Sets a waiting time before an inital communication attempt to a device.
+     *
+     * @param waitBeforeCommunication Waiting time in ms.
+    */
+    void setWaitBeforeCommunication( unsigned int waitBeforeCommunication );
+
+    /**
+     * Gets the currently set waiting time before a first communicaiton attempt to a device.
+     *
+     * @return Waiting time in ms.
+    */
+    unsigned int getWaitBeforeCommunication();
+
+    /**
+     * Sets the baud rate to be used for communication from and to the serial device.
+     *
+     * @param baudRate Current baud rate.
+    */
+    void setBaudRate( unsigned int baudRate );
+
+    /**
+     * Gets the currently set baud rate.
+     *
+     * @return Current baud rate.
+    */
+    unsigned int getBaudRate();
+
+    /**
+     * Sets the message delimiter to be used for interpreting messages from serial devices.
+     * The message delimiter separates the message type from the message content.
+     *
+     * @param messageDelimiter The message delimiter to be used. Can be a single or multiple characters.
+    */
+    void setMessageDelimiter( std::string messageDelimiter );
+
+    /**
+     * Gets the currently set message delimiter.
+     *
+     * @return Current message delimiter.
+    */
+    std::string getMessageDelimiter();
+
+    /**
+     * Sets the command which is used to request/retrieve the device ID for each of the connected devices.
+     * This command needs to be understood by every device connected and result in a validly formatted message (see ReadMe) directly after,
+     * which corresponds to the message type declared with the "setMessageTypeForIds" function and contains the device's ID.
+     *
+     * @param commandToGetDeviceId Command which gets send to each device to request/retrieve the device ID.
+    */
+    void setCommandToGetDeviceId( std::string commandToGetDeviceId );
+
+    /**
+     * Gets the currently set command to request/retrieve the device ID from devices.
+     *
+     * @return Currently set command to get device ID.
+    */
+    std::string getCommandToGetDeviceId();
+
+    /**
+     * Sets the message type for messages which are intended to contain a device ID.
+     * This message type needs to be used whenever a device is answereing the command set via "setCommandToGetDeviceId" with a
+     * validly formatted message (see ReadMe), in order to allow the gateway to identify the correct response and extract the contained device ID.
+     *
+     * @param messageTypeForIds Message type of a message containing the device ID.
+     * @return
+    */
+    void setMessageTypeForIds( std::string messageTypeForIds );
+
+    /**
+     * Gets the currently set message type for messages containing the device ID.
+     *
+     * @return Currently set message type for device IDs.
+    */
+    std::string getMessageTypeForIds();
+
+    /**
+     * Sets the path to the message schema file which shall be loaded.
+     * An empty path means that no schemas are used.
+     *
+     * @param messageSchemaFile Path to the message schema file to be used.
+    */
+    void setMessageSchemaFile( std::string messageSchemaFile );
+
+    /**
+     * Gets the currently set path to the message schema file.
+     *
+     * @return Current path to the message schema file.
+    */
+    std::string getMessageSchemaFile();
+
+    /**
+     * Sets the delimiter which separates the field values inside the content of messages with a schema.
+     *
+     * @param schemaFieldDelimiter The field delimiter to be used. Can be a single or multiple characters.
+    */
+    void setSchemaFieldDelimiter( std::string schemaFieldDelimiter );
+
+    /**
+     * Gets the currently set field delimiter for messages with a schema.
+     *
+     * @return Current field delimiter.
+    */
+    std::string getSchemaFieldDelimiter();
+
+    /**
+     * Sets the path of the Unix domain socket the Prometheus exporter listens on.
+     * An empty path means that the exporter doesn't listen on a Unix domain socket.
+     *
+     * @param metricsUnixSocket Path of the Unix domain socket.
+    */
+    void setMetricsUnixSocket( std::string metricsUnixSocket );
+
+    /**
+     * Gets the currently set path of the Unix domain socket for the Prometheus exporter.
+     *
+     * @return Current path of the Unix domain socket.
+    */
+    std::string getMetricsUnixSocket();
+
+    /**
+     * Sets the port the Prometheus exporter listens on (on 127.0.0.1 only).
+     * Zero (0) means that the exporter doesn't listen on a TCP port.
+     *
+     * @param metricsPort TCP port.
+    */
+    void setMetricsPort( unsigned int metricsPort );
+
+    /**
+     * Gets the currently set port of the Prometheus exporter.
+     *
+     * @return Current TCP port.
+    */
+    unsigned int getMetricsPort();
+
+    /**
+     * Sets whether the latency of every message gets attributed to the stages of the pipeline.
+     *
+     * @param tracingActive Tracing active true/false.
+    */
+    void setTracingActive( bool tracingActive );
+
+    /**
+     * Gets whether the latency of every message gets attributed to the stages of the pipeline.
+     *
+     * @return Tracing active?
+    */
+    bool isTracingActive();
+
+    /**
+     * Sets how many trace events each of the tracer's ring buffers keeps.
+     *
+     * @param tracingBufferSize Number of events per ring buffer.
+    */
+    void setTracingBufferSize( unsigned int tracingBufferSize );
+
+    /**
+     * Gets how many trace events each of the tracer's ring buffers keeps.
+     *
+     * @return Number of events per ring buffer.
+    */
+    unsigned int getTracingBufferSize();
+
+    /**
+     * Sets how long a message callback may take before it counts as slow.
+     * Zero (0) means that slow callbacks aren't detected, and no device gets isolated.
+     *
+     * @param callbackBudget Time in ms.
+    */
+    void setCallbackBudget( unsigned int callbackBudget );
+
+    /**
+     * Gets how long a message callback may take before it counts as slow.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getCallbackBudget();
+
+    /**
+     * Sets after how many consecutive slow callbacks a device gets isolated (and after how many consecutive callbacks within budget it gets released again).
+     *
+     * @param callbackSlowStreak Number of consecutive callbacks.
+    */
+    void setCallbackSlowStreak( unsigned int callbackSlowStreak );
+
+    /**
+     * Gets after how many consecutive slow callbacks a device gets isolated.
+     *
+     * @return Number of consecutive callbacks.
+    */
+    unsigned int getCallbackSlowStreak();
+
+    /**
+     * Sets the number of worker threads which run the callbacks of isolated devices.
+     *
+     * @param isolatedLaneThreads Number of threads.
+    */
+    void setIsolatedLaneThreads( unsigned int isolatedLaneThreads );
+
+    /**
+     * Gets the number of worker threads which run the callbacks of isolated devices.
+     *
+     * @return Number of threads.
+    */
+    unsigned int getIsolatedLaneThreads();
+
+    /**
+     * Sets the number of worker threads which process the messages of the devices without an inbound queue.
+     *
+     * @param messageThreads Number of threads.
+    */
+    void setMessageThreads( unsigned int messageThreads );
+
+    /**
+     * Gets the number of worker threads which process the messages of the devices without an inbound queue.
+     *
+     * @return Number of threads.
+    */
+    unsigned int getMessageThreads();
+
+    /**
+     * Sets the number of worker threads which send the messages to the devices.
+     *
+     * @param sendThreads Number of threads.
+    */
+    void setSendThreads( unsigned int sendThreads );
+
+    /**
+     * Gets the number of worker threads which send the messages to the devices.
+     *
+     * @return Number of threads.
+    */
+    unsigned int getSendThreads();
+
+    /**
+     * Sets the capacity of every device's inbound queue.
+     * Zero (0) means that there are no inbound queues; The messages get processed by the message workers then.
+     *
+     * @param inboundQueueCapacity Maximum number of queued messages per device.
+    */
+    void setInboundQueueCapacity( unsigned int inboundQueueCapacity );
+
+    /**
+     * Gets the capacity of every device's inbound queue.
+     *
+     * @return Maximum number of queued messages per device.
+    */
+    unsigned int getInboundQueueCapacity();
+
+    /**
+     * Sets what an inbound queue does with a new message while it's full.
+     *
+     * @param inboundOverflowPolicy Overflow policy.
+    */
+    void setInboundOverflowPolicy( OverflowPolicy inboundOverflowPolicy );
+
+    /**
+     * Gets what an inbound queue does with a new message while it's full.
+     *
+     * @return Overflow policy.
+    */
+    OverflowPolicy getInboundOverflowPolicy();
+
+    /**
+     * Sets how many messages get buffered per device while it's absent.
+     * Zero (0) means that nothing gets buffered; Messages to absent devices get dropped then.
+     *
+     * @param outboundBufferCapacity Maximum number of buffered messages per device.
+    */
+    void setOutboundBufferCapacity( unsigned int outboundBufferCapacity );
+
+    /**
+     * Gets how many messages get buffered per device while it's absent.
+     *
+     * @return Maximum number of buffered messages per device.
+    */
+    unsigned int getOutboundBufferCapacity();
+
+    /**
+     * Sets how many bytes get buffered per device while it's absent.
+     *
+     * @param outboundBufferBytes Maximum number of buffered bytes per device.
+    */
+    void setOutboundBufferBytes( unsigned int outboundBufferBytes );
+
+    /**
+     * Gets how many bytes get buffered per device while it's absent.
+     *
+     * @return Maximum number of buffered bytes per device.
+    */
+    unsigned int getOutboundBufferBytes();
+
+    /**
+     * Sets how long a message may be buffered for an absent device.
+     * Zero (0) means that buffered messages don't expire.
+     *
+     * @param outboundBufferTtl Time in ms.
+    */
+    void setOutboundBufferTtl( unsigned int outboundBufferTtl );
+
+    /**
+     * Gets how long a message may be buffered for an absent device.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getOutboundBufferTtl();
+
+    /**
+     * Sets the path to the file the device identity cache gets kept in.
+     * Empty means that there's no identity cache; Every device gets asked for its ID before it gets registered then.
+     *
+     * @param identityCacheFile Path to the identity cache file.
+    */
+    void setIdentityCacheFile( std::string identityCacheFile );
+
+    /**
+     * Gets the path to the file the device identity cache gets kept in.
+     *
+     * @return Path to the identity cache file.
+    */
+    std::string getIdentityCacheFile();
+
+    /**
+     * Sets how long a device registered from the identity cache may take to confirm its ID, before it gets deleted again.
+     *
+     * @param identityVerifyTimeout Time in ms.
+    */
+    void setIdentityVerifyTimeout( unsigned int identityVerifyTimeout );
+
+    /**
+     * Gets how long a device registered from the identity cache may take to confirm its ID.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getIdentityVerifyTimeout();
+
+    /**
+     * Sets whether devices get asked for their ID repeatedly right after opening the port, instead of once after "WAIT_BEFORE_COMMUNICATION".
+     *
+     * @param adaptiveHandshakeActive Adaptive handshake true/false.
+    */
+    void setAdaptiveHandshakeActive( bool adaptiveHandshakeActive );
+
+    /**
+     * Gets whether the adaptive handshake is active.
+     *
+     * @return Whether the adaptive handshake is active.
+    */
+    bool isAdaptiveHandshakeActive();
+
+    /**
+     * Sets the time between the first two unanswered attempts of the adaptive handshake; It doubles after every further unanswered attempt.
+     *
+     * @param handshakeRetryInterval Time in ms.
+    */
+    void setHandshakeRetryInterval( unsigned int handshakeRetryInterval );
+
+    /**
+     * Gets the time between the first two unanswered attempts of the adaptive handshake.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getHandshakeRetryInterval();
+
+    /**
+     * Sets how long the adaptive handshake may take, from opening the port until the device answered with its ID.
+     *
+     * @param handshakeDeadline Time in ms.
+    */
+    void setHandshakeDeadline( unsigned int handshakeDeadline );
+
+    /**
+     * Gets how long the adaptive handshake may take.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getHandshakeDeadline();
+
+    /**
+     * Sets the path to the file which declares how the modem lines of ports and hardware IDs get treated.
+     * Empty means that every port resets its device on open, like ttys do by default.
+     *
+     * @param resetControlFile Path to the reset control file.
+    */
+    void setResetControlFile( std::string resetControlFile );
+
+    /**
+     * Gets the path to the reset control file.
+     *
+     * @return Path to the reset control file.
+    */
+    std::string getResetControlFile();
+
+    /**
+     * Sets how long the scan skips a port after its first failed probe; It doubles after every further failed probe in a row.
+     * Zero (0) means that every scan probes every port which isn't registered.
+     *
+     * @param probeBackoff Time in ms.
+    */
+    void setProbeBackoff( unsigned int probeBackoff );
+
+    /**
+     * Gets how long the scan skips a port after its first failed probe.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getProbeBackoff();
+
+    /**
+     * Sets how long the scan skips a port at most.
+     *
+     * @param probeBackoffMax Time in ms.
+    */
+    void setProbeBackoffMax( unsigned int probeBackoffMax );
+
+    /**
+     * Gets how long the scan skips a port at most.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getProbeBackoffMax();
+
+    /**
+     * Sets after how many failed probes in a row a port gets quarantined; The scan skips it then, until its identity changes or it disappears.
+     * Zero (0) means that ports never get quarantined.
+     *
+     * @param probeQuarantineAfter Number of failed probes.
+    */
+    void setProbeQuarantineAfter( unsigned int probeQuarantineAfter );
+
+    /**
+     * Gets after how many failed probes in a row a port gets quarantined.
+     *
+     * @return Number of failed probes.
+    */
+    unsigned int getProbeQuarantineAfter();
+
+    /**
+     * Sets the latency profile of every port which hasn't got one declared in the latency profile file; Takes effect for devices added afterwards.
+     *
+     * @param defaultLatencyProfile Latency profile; Its read timeout must be > 0.
+    */
+    void setDefaultLatencyProfile( LatencyProfile defaultLatencyProfile );
+
+    /**
+     * Gets the latency profile of every port which hasn't got one declared.
+     *
+     * @return Default latency profile.
+    */
+    LatencyProfile getDefaultLatencyProfile();
+
+    /**
+     * Sets the path to the file which declares the latency profiles of ports and hardware IDs.
+     * Empty means that every port gets the default latency profile.
+     *
+     * @param latencyProfileFile Path to the latency profile file.
+    */
+    void setLatencyProfileFile( std::string latencyProfileFile );
+
+    /**
+     * Gets the path to the latency profile file.
+     *
+     * @return Path to the latency profile file.
+    */
+    std::string getLatencyProfileFile();
+
+    /**
+     * Sets the path to the file which declares the serial parameters (line settings and baud escalation) of ports, hardware IDs and device IDs.
+     * Empty means that every port uses "BAUD_RATE", 8N1 and no flow control.
+     *
+     * @param serialParametersFile Path to the serial parameters file.
+    */
+    void setSerialParametersFile( std::string serialParametersFile );
+
+    /**
+     * Gets the path to the serial parameters file.
+     *
+     * @return Path to the serial parameters file.
+    */
+    std::string getSerialParametersFile();
+
+    /**
+     * Sets the command which asks a device to switch to another baud rate; It gets sent as "<command><delimiter><baud rate>", and the device confirms with the same line before it switches.
+     * Empty means that devices never get asked.
+     *
+     * @param baudEscalationCommand Command to switch the baud rate.
+    */
+    void setBaudEscalationCommand( std::string baudEscalationCommand );
+
+    /**
+     * Gets the command which asks a device to switch to another baud rate.
+     *
+     * @return Command to switch the baud rate.
+    */
+    std::string getBaudEscalationCommand();
+
+    /**
+     * Sets the baud rate devices get asked to switch to after they answered with their ID, unless the serial parameters file declares another one.
+     * Zero (0) means that devices don't get asked by default.
+     *
+     * @param baudEscalationRate Baud rate to switch to.
+    */
+    void setBaudEscalationRate( unsigned int baudEscalationRate );
+
+    /**
+     * Gets the baud rate devices get asked to switch to by default.
+     *
+     * @return Baud rate to switch to.
+    */
+    unsigned int getBaudEscalationRate();
+
+    /**
+     * Sets the flow control every port uses, unless the serial parameters file declares another one.
+     *
+     * @param flowControl Flow control to be used.
+    */
+    void setFlowControl( serial::flowcontrol_t flowControl );
+
+    /**
+     * Gets the flow control every port uses by default.
+     *
+     * @return Flow control.
+    */
+    serial::flowcontrol_t getFlowControl();
+
+    /**
+     * Sets how often the read loops read the error counters of their port (overruns, framing and parity errors), and count their increase in the metrics.
+     * Zero (0) means that they don't get read.
+     *
+     * @param lineErrorInterval Interval in ms.
+    */
+    void setLineErrorInterval( unsigned int lineErrorInterval );
+
+    /**
+     * Gets how often the read loops read the error counters of their port.
+     *
+     * @return Interval in ms.
+    */
+    unsigned int getLineErrorInterval();
+
+    /**
+     * Sets the path of the Unix domain socket the devices get handed over on: On start, the devices get taken over from a process
+     * listening on it (if there is one), and afterwards, the gateway listens on it itself, to hand its devices over to its successor.
+     * An empty path means that devices don't get handed over.
+     *
+     * @param handoverSocket Path of the Unix domain socket.
+    */
+    void setHandoverSocket( std::string handoverSocket );
+
+    /**
+     * Gets the currently set path of the Unix domain socket the devices get handed over on.
+     *
+     * @return Path of the Unix domain socket, or an empty string if devices don't get handed over.
+    */
+    std::string getHandoverSocket();
+
+    /**
+     * Sets how long "stop" waits for the read loops, the queued messages and the callbacks to finish; Whatever is left afterwards gets dropped.
+     *
+     * @param stopTimeout Time in ms.
+    */
+    void setStopTimeout( unsigned int stopTimeout );
+
+    /**
+     * Gets how long "stop" waits for the read loops, the queued messages and the callbacks to finish.
+     *
+     * @return Time in ms.
+    */
+    unsigned int getStopTimeout();
+
+    /**
+     * Sets how many events the ring of the event bus holds.
+     * Zero (0) means that the event bus is not active.
+     *
+     * @param eventBusCapacity Number of events.
+    */
+    void setEventBusCapacity( unsigned int eventBusCapacity );
+
+    /**
+     * Gets how many events the ring of the event bus holds.
+     *
+     * @return Number of events; 0 if the event bus is not active.
+    */
+    unsigned int getEventBusCapacity();
+
+    /**
+     * Sets whether the gateway is started or not.
+     *
+     * @param started Started true/false.
+    */
+    void setStarted( bool started );
+
+    /**
+     * Sets the config instance to be used.
+     *
+     * @param configInstance Pointer to config instance.
+    */
+    void setConfigInstance( Config * configInstance );
+
+    /**
+     * Initializes the config instance, and loads the config file.
+    */
+    void initConfig();
+
+    /**
+     * Gets the value of an optional config key as string.
+     *
+     * @param key Config key to look up.
+     * @param defaultValue Value to be returned if the key is not defined.
+     * @return The config value, or the default value.
+    */
+    std::string getOptionalConfigString( std::string key, std::string defaultValue );
+
+    /**
+     * Gets the value of an optional config key as unsigned integer.
+     *
+     * @param key Config key to look up.
+     * @param defaultValue Value to be returned if the key is not defined.
+     * @return The config value, or the default value.
+    */
+    unsigned int getOptionalConfigUnsignedInteger( std::string key, unsigned int defaultValue );
+
+    /**
+     * Gets the value of an optional config key as bool.
+     *
+     * @param key Config key to look up.
+     * @param defaultValue Value to be returned if the key is not defined.
+     * @return The config value, or the default value.
+    */
+    bool getOptionalConfigBool( std::string key, bool defaultValue );
+
+    /**
+     * Deletes the config instance.
+    */
+    void deleteConfigInstance();
+
+    /**
+     * Sets the logger instance to be used.
+     *
+     * @param loggerInstance Pointer to logger instance.
+    */
+    void setLoggerInstance( Logger * loggerInstance );
+
+    /**
+     * Initializes the logger instance.
+    */
+    void initLogger();
+
+    /**
+     * Deletes the logger instance (and the async & structured logger instances).
+    */
+    void deleteLoggerInstance();
+
+    /**
+     * Sets the async logger instance to be used.
+     *
+     * @param asyncLoggerInstance Pointer to async logger instance, or nullptr if async logging is not active.
+    */
+    void setAsyncLoggerInstance( AsyncLogger * asyncLoggerInstance );
+
+    /**
+     * Sets the structured logger instance to be used.
+     *
+     * @param structuredLoggerInstance Pointer to structured logger instance.
+    */
+    void setStructuredLoggerInstance( StructuredLogger * structuredLoggerInstance );
+
+    /**
+     * Initializes the Prometheus exporter instance, if a Unix domain socket or a port is configured for it.
+    */
+    void initMetricsExporter();
+
+    /**
+     * Deletes the Prometheus exporter instance.
+    */
+    void deleteMetricsExporterInstance();
+
+    /**
+     * Sets the Prometheus exporter instance to be used.
+     *
+     * @param prometheusExporterInstance Pointer to Prometheus exporter instance, or nullptr if the exporter is not active.
+    */
+    void setPrometheusExporterInstance( PrometheusExporter * prometheusExporterInstance );
+
+    /**
+     * Initializes the device handover instance, if a Unix domain socket is configured for it.
+    */
+    void initDeviceHandover();
+
+    /**
+     * Deletes the device handover instance.
+    */
+    void deleteDeviceHandoverInstance();
+
+    /**
+     * Sets the device handover instance to be used.
+     *
+     * @param deviceHandoverInstance Pointer to device handover instance, or nullptr if the device handover is not active.
+    */
+    void setDeviceHandoverInstance( DeviceHandover * deviceHandoverInstance );
+
+    /**
+     * Gets the device handover instance.
+     *
+     * @return Pointer to the current device handover instance, or nullptr if the device handover is not active.
+    */
+    DeviceHandover * getDeviceHandoverInstance();
+
+    /**
+     * Takes the devices over from the process listening on the handover socket, if there is one, and registers them with their IDs and partial lines;
+     * Their ports get opened while the predecessor's descriptors are still held, so the devices neither reset nor lose any buffered input.
+     *
+     * @return Number of devices taken over.
+    */
+    unsigned int takeOverSerialDevices();
+
+    /**
+     * Registers a device which got handed over, and starts its read loop. Closes the handed over descriptor in any case.
+     *
+     * @param handoverDevice Device which got handed over.
+     * @return Whether the device could be registered.
+    */
+    bool adoptSerialDevice( const HandoverDevice & handoverDevice );
+
+    /**
+     * Stops every read loop, and collects the devices for a successor; Gets called by the device handover.
+     * Gives up once the read loops didn't quit within the time the successor waits for the devices (See "DeviceHandover::RECORD_TIMEOUT").
+     *
+     * @param handoverDevices Devices, each with a newly opened descriptor of its port.
+     * @return Whether every read loop quitted; If not, the handover gets aborted.
+    */
+    bool provideHandoverDevices( std::vector<HandoverDevice> & handoverDevices );
+
+    /**
+     * Stops the gateway once a successor confirmed the handover, or restarts the read loops if it didn't; Gets called by the device handover.
+     *
+     * @param devices Devices which got handed over.
+     * @param confirmed Whether the successor confirmed the handover.
+    */
+    void completeHandover( const std::vector<HandoverDevice> & devices, bool confirmed );
+
+    /**
+     * Initializes the stage tracer instance (which only records if tracing is active).
+    */
+    void initTracer();
+
+    /**
+     * Deletes the stage tracer instance.
+    */
+    void deleteTracerInstance();
+
+    /**
+     * Sets the stage tracer instance to be used.
+     *
+     * @param stageTracerInstance Pointer to stage tracer instance.
+    */
+    void setStageTracerInstance( StageTracer * stageTracerInstance );
+
+    /**
+     * Initializes the callback dispatcher instance.
+    */
+    void initCallbackDispatcher();
+
+    /**
+     * Deletes the callback dispatcher instance.
+    */
+    void deleteCallbackDispatcherInstance();
+
+    /**
+     * Sets the callback dispatcher instance to be used.
+     *
+     * @param callbackDispatcherInstance Pointer to callback dispatcher instance.
+    */
+    void setCallbackDispatcherInstance( CallbackDispatcher * callbackDispatcherInstance );
+
+    /**
+     * Gets the callback dispatcher instance.
+     *
+     * @return Pointer to the callback dispatcher instance.
+    */
+    CallbackDispatcher * getCallbackDispatcherInstance();
+
+    /**
+     * Initializes the worker pools which process the messages, respectively send them.
+    */
+    void initWorkerPools();
+
+    /**
+     * Deletes the message worker pool instance; Waits until the queued messages got processed.
+    */
+    void deleteMessageWorkerPoolInstance();
+
+    /**
+     * Deletes the send worker pool instance; Waits until the queued messages got sent.
+    */
+    void deleteSendWorkerPoolInstance();
+
+    /**
+     * Sets the message worker pool instance to be used.
+     *
+     * @param messageWorkerPoolInstance Pointer to message worker pool instance.
+    */
+    void setMessageWorkerPoolInstance( MessageWorkerPool * messageWorkerPoolInstance );
+
+    /**
+     * Gets the message worker pool instance.
+     *
+     * @return Pointer to the message worker pool instance.
+    */
+    MessageWorkerPool * getMessageWorkerPoolInstance();
+
+    /**
+     * Sets the send worker pool instance to be used.
+     *
+     * @param sendWorkerPoolInstance Pointer to send worker pool instance.
+    */
+    void setSendWorkerPoolInstance( SendWorkerPool * sendWorkerPoolInstance );
+
+    /**
+     * Gets the send worker pool instance.
+     *
+     * @return Pointer to the send worker pool instance.
+    */
+    SendWorkerPool * getSendWorkerPoolInstance();
+
+    /**
+     * Initializes the outbound buffer instance.
+    */
+    void initOutboundBuffer();
+
+    /**
+     * Deletes the outbound buffer instance.
+    */
+    void deleteOutboundBufferInstance();
+
+    /**
+     * Sets the outbound buffer instance to be used.
+     *
+     * @param outboundBufferInstance Pointer to outbound buffer instance.
+    */
+    void setOutboundBufferInstance( OutboundBuffer * outboundBufferInstance );
+
+    /**
+     * Gets the outbound buffer instance.
+     *
+     * @return Pointer to the outbound buffer instance.
+    */
+    OutboundBuffer * getOutboundBufferInstance();
+
+    /**
+     * Initializes the event bus instance, if a capacity is configured for it.
+    */
+    void initEventBus();
+
+    /**
+     * Deletes the event bus instance.
+    */
+    void deleteEventBusInstance();
+
+    /**
+     * Sets the event bus instance to be used.
+     *
+     * @param eventBusInstance Pointer to event bus instance, or nullptr if the event bus is not active.
+    */
+    void setEventBusInstance( EventBus * eventBusInstance );
+
+    /**
+     * Initializes the probe scheduler instance.
+    */
+    void initProbeScheduler();
 
     /**
-     * Gets the currently set scan interval.
-     *
-     * @return Scan interval in ms.
+     * Deletes the probe scheduler instance.
     */
-    unsigned int getScanInterval();
+    void deleteProbeSchedulerInstance();
 
     /**
-     * Sets a waiting time before an inital communication attempt to a device.
+     * Sets the probe scheduler instance to be used.
      *
-     * @param waitBeforeCommunication Waiting time in ms.
+     * @param probeSchedulerInstance Pointer to probe scheduler instance.
     */
-    void setWaitBeforeCommunication( unsigned int waitBeforeCommunication );
+    void setProbeSchedulerInstance( ProbeScheduler * probeSchedulerInstance );
 
     /**
-     * Gets the currently set waiting time before a first communicaiton attempt to a device.
+     * Gets the probe scheduler instance.
      *
-     * @return Waiting time in ms.
+     * @return Pointer to the probe scheduler instance.
     */
-    unsigned int getWaitBeforeCommunication();
+    ProbeScheduler * getProbeSchedulerInstance();
 
     /**
-     * Sets the baud rate to be used for communication from and to the serial device.
+     * Gets the identity of a port: What the system reports about it (description and hardware ID), which changes when another device gets plugged in.
      *
-     * @param baudRate Current baud rate.
+     * @param serialPortInfo Port information.
+     * @return Identity of the port.
     */
-    void setBaudRate( unsigned int baudRate );
+    static std::string getPortIdentity( const serial::PortInfo & serialPortInfo );
 
     /**
-     * Gets the currently set baud rate.
+     * Records a failed probe of a port with the probe scheduler, and logs if the port got quarantined.
      *
-     * @return Current baud rate.
+     * @param serialPort Serial port which failed.
     */
-    unsigned int getBaudRate();
+    void recordFailedProbe( std::string serialPort );
 
     /**
-     * Sets the message delimiter to be used for interpreting messages from serial devices.
-     * The message delimiter separates the message type from the message content.
-     *
-     * @param messageDelimiter The message delimiter to be used. Can be a single or multiple characters.
+     * Initializes the device identity cache instance, if an identity cache file is given, and loads the cache.
     */
-    void setMessageDelimiter( std::string messageDelimiter );
+    void initDeviceIdentityCache();
 
     /**
-     * Gets the currently set message delimiter.
-     *
-     * @return Current message delimiter.
+     * Deletes the device identity cache instance.
     */
-    std::string getMessageDelimiter();
+    void deleteDeviceIdentityCacheInstance();
 
     /**
-     * Sets the command which is used to request/retrieve the device ID for each of the connected devices.
-     * This command needs to be understood by every device connected and result in a validly formatted message (see ReadMe) directly after,
-     * which corresponds to the message type declared with the "setMessageTypeForIds" function and contains the device's ID.
+     * Sets the device identity cache instance to be used.
      *
-     * @param commandToGetDeviceId Command which gets send to each device to request/retrieve the device ID.
+     * @param deviceIdentityCacheInstance Pointer to device identity cache instance, or nullptr if the cache is not active.
     */
-    void setCommandToGetDeviceId( std::string commandToGetDeviceId );
+    void setDeviceIdentityCacheInstance( DeviceIdentityCache * deviceIdentityCacheInstance );
 
     /**
-     * Gets the currently set command to request/retrieve the device ID from devices.
+     * Gets the device identity cache instance.
      *
-     * @return Currently set command to get device ID.
+     * @return Pointer to the device identity cache instance, or nullptr if the cache is not active.
     */
-    std::string getCommandToGetDeviceId();
+    DeviceIdentityCache * getDeviceIdentityCacheInstance();
 
     /**
-     * Sets the message type for messages which are intended to contain a device ID.
-     * This message type needs to be used whenever a device is answereing the command set via "setCommandToGetDeviceId" with a
-     * validly formatted message (see ReadMe), in order to allow the gateway to identify the correct response and extract the contained device ID.
+     * Gets the key a port's device gets cached under: The port, its device path in sysfs (where it's plugged in, e.g. "/sys/devices/pci0000:00/0000:00:14.0/usb1/1-2/1-2:1.0"),
+     * and its hardware ID (including VID:PID and the USB serial number).
+     * Ports without a USB serial number or a device path don't get a key, since two identical devices could be swapped on them unnoticed.
      *
-     * @param messageTypeForIds Message type of a message containing the device ID.
-     * @return
+     * @param serialPort Serial port to get the key of.
+     * @return Identity key; Empty if the port can't be cached.
     */
-    void setMessageTypeForIds( std::string messageTypeForIds );
+    std::string getIdentityKey( std::string serialPort );
 
     /**
-     * Gets the currently set message type for messages containing the device ID.
+     * Gets the device path of a port in sysfs, i.e. the resolved link "/sys/class/tty/<tty>/device"; It changes once the device gets plugged into another USB port.
      *
-     * @return Currently set message type for device IDs.
+     * @param serialPort Serial port to get the device path of; May be a link, e.g. /dev/serial/by-id/...
+     * @return Device path; Empty if the port has none, e.g. a pty.
     */
-    std::string getMessageTypeForIds();
+    std::string getSysfsDevicePath( std::string serialPort );
 
     /**
-     * Sets whether the gateway is started or not.
+     * Asks a device which got registered from the identity cache for its ID, and waits for the answer.
+     * If the device answers with another ID, or doesn't answer in time, the cache entry gets evicted and the device gets deleted; The next scan adds it the regular way.
+     * This function gets solely called in a thread of the gateway by the "addSerialDevice" function.
      *
-     * @param started Started true/false.
+     * @param deviceId Device ID taken from the cache.
+     * @param serialPort Serial port of the device.
+     * @param identityKey Identity key of the port.
     */
-    void setStarted( bool started );
+    void verifyDeviceIdentity( std::string deviceId, std::string serialPort, std::string identityKey );
 
     /**
-     * Sets the config instance to be used.
+     * Hands an ID message over to the verification of the device, if the device's ID is being verified.
      *
-     * @param configInstance Pointer to config instance.
+     * @param deviceId Device ID the message is coming from.
+     * @param content Content of the ID message.
+     * @return Whether the message answered a verification (and must not be handed over to the callbacks).
     */
-    void setConfigInstance( Config * configInstance );
+    bool answerIdentityVerification( std::string deviceId, std::string content );
 
     /**
-     * Initializes the config instance, and loads the config file.
+     * Gets whether the ID of a device, which got registered from the identity cache, is being verified.
+     *
+     * @param deviceId Device ID to be checked.
+     * @return Whether the verification is pending.
     */
-    void initConfig();
+    bool isIdentityBeingVerified( const std::string & deviceId );
 
     /**
-     * Deletes the config instance.
+     * Holds a message back while the ID of its device is being verified, so it can't reach the wrong device: It gets buffered,
+     * and forwarded once the ID is confirmed. If it can't be buffered (buffering is off, or the message alone is too big), waits for the verification instead.
+     *
+     * @param deviceId Device ID the message is for.
+     * @param message Message to be sent.
+     * @param device Device the message is for; Looked up again after waiting, since the device gets deleted if its ID isn't confirmed.
+     * @return Whether the message got buffered; False if it may be written to the device (if it's still there).
     */
-    void deleteConfigInstance();
+    bool holdUntilIdentityVerified( const std::string & deviceId, const std::string & message, SerialDevicePointer & device );
 
     /**
-     * Sets the logger instance to be used.
+     * Gets the Prometheus exporter instance.
      *
-     * @param loggerInstance Pointer to logger instance.
+     * @return Pointer to the current Prometheus exporter instance, or nullptr if the exporter is not active.
     */
-    void setLoggerInstance( Logger * loggerInstance );
+    PrometheusExporter * getPrometheusExporterInstance();
 
     /**
-     * Initializes the logger instance.
+     * Initializes the serial transport factory instance; By default, ports are discovered and opened via wjwwood's serial Library.
     */
-    void initLogger();
+    void initSerialTransportFactory();
 
     /**
-     * Deletes the logger instance.
+     * Deletes the serial transport factory instance.
     */
-    void deleteLoggerInstance();
+    void deleteSerialTransportFactoryInstance();
+
+    /**
+     * Sets the serial transport factory instance to be used.
+     *
+     * @param serialTransportFactoryInstance Pointer to serial transport factory instance.
+    */
+    void setSerialTransportFactoryInstance( SerialTransportFactory * serialTransportFactoryInstance );
 
     /**
      * Loads the hardware whitelist.
@@ -349,10 +1453,126 @@ private:
     */
     bool hasSerialPortBlacklistEntry( std::string serialPort );
 
+    /**
+     * Parses a config file in the format "<key>=<value>", line by line; Empty lines and lines starting with "#" are skipped.
+     * Throws an Exception if the file can't be opened, or a line is malformed.
+     *
+     * @param fileName Path to the file.
+     * @param fileDescription Name of the file in error messages, e.g. "Reset Control File".
+     * @param format Format of a line in error messages, e.g. "<port or VID:PID>=<reset|hold|release>".
+     * @param lineHandler Function which takes the key and the value of every line.
+    */
+    void parseConfigFile( std::string fileName, std::string fileDescription, std::string format, ConfigLineHandler lineHandler );
+
+    /**
+     * Loads and compiles the message schemas.
+     * Every line of the schema file declares a schema in the format "<type>=<name>:<fieldType>,<name>:<fieldType>,...".
+    */
+    void loadMessageSchemas();
+
+    /**
+     * Gets all message schemas currently loaded.
+     *
+     * @return Pointer to a mapping between message types and schemas.
+    */
+    MessageSchemaMap * getMessageSchemas();
+
+    /**
+     * Loads the reset controls.
+     * Every line of the reset control file declares one in the format "<port or VID:PID>=<reset|hold|release>"; Lines starting with "#" are comments.
+    */
+    void loadResetControls();
+
+    /**
+     * Gets all reset controls currently loaded.
+     *
+     * @return Pointer to a mapping between ports/hardwareIds and reset controls.
+    */
+    ResetControlMap * getResetControls();
+
+    /**
+     * Gets how the modem lines of a port get treated; A declaration for the port takes precedence over one for its hardware ID.
+     *
+     * @param serialPort Serial port to get the reset control for.
+     * @return Reset control of the port; ResetControl::RESET_ON_OPEN if nothing has been declared for it.
+    */
+    ResetControl getResetControl( std::string serialPort );
+
+    /**
+     * Loads the latency profiles.
+     * Every line of the latency profile file declares one in the format "<port or VID:PID>=<settings>", applied on top of the default latency profile; Lines starting with "#" are comments.
+    */
+    void loadLatencyProfiles();
+
+    /**
+     * Gets all latency profiles currently loaded.
+     *
+     * @return Pointer to a mapping between ports/hardwareIds and latency profiles.
+    */
+    LatencyProfileMap * getLatencyProfiles();
+
+    /**
+     * Gets the latency profile of a port; A declaration for the port takes precedence over one for its hardware ID.
+     *
+     * @param serialPort Serial port to get the latency profile for.
+     * @return Latency profile of the port; The default latency profile if nothing has been declared for it.
+    */
+    LatencyProfile getLatencyProfile( std::string serialPort );
+
+    /**
+     * Loads the serial parameters.
+     * Every line of the serial parameters file declares them in the format "<port, VID:PID or device ID>=<settings>", applied on top of the default serial parameters; Lines starting with "#" are comments.
+    */
+    void loadSerialParameters();
+
+    /**
+     * Gets all serial parameters currently loaded.
+     *
+     * @return Pointer to a mapping between ports/hardwareIds/deviceIds and serial parameters.
+    */
+    SerialParametersMap * getDeclaredSerialParameters();
+
+    /**
+     * Gets the serial parameters every port uses, which hasn't got any declared: "BAUD_RATE", 8N1, no flow control and "BAUD_ESCALATION_RATE".
+     *
+     * @return Default serial parameters.
+    */
+    SerialParameters getDefaultSerialParameters();
+
+    /**
+     * Gets the serial parameters a port gets opened with; A declaration for the port takes precedence over one for its hardware ID.
+     *
+     * @param serialPort Serial port to get the serial parameters for.
+     * @return Serial parameters of the port; The default serial parameters if nothing has been declared for it.
+    */
+    SerialParameters getSerialParameters( std::string serialPort );
+
+    /**
+     * Gets the metrics registry.
+     *
+     * @return Pointer to the metrics registry.
+    */
+    GatewayMetrics * getMetrics();
+
+    /**
+     * Gets the tracker of the typical boot delays.
+     *
+     * @return Pointer to the boot delay tracker.
+    */
+    BootDelayTracker * getBootDelayTracker();
+
+    /**
+     * Gets the time passed since a specific point in time.
+     *
+     * @param timePoint Point in time (steady clock).
+     * @return Time passed in µs.
+    */
+    static unsigned long long getMicrosecondsSince( SteadyTimePoint timePoint );
+
     /**
      * Loop for periodically adding new serial ports as serial devices to the gateway.
      * This loop is at least executed once. If "getScanInterval" returns 0, it stops executing after the first run.
-     * This loop gets solely called in a detached thread by the "start" function.
+     * This loop gets solely called in a thread of the gateway by the "start" function. Waiting for the next scan gets cut short when the gateway gets stopped.
     */
     void addNewSerialPortsLoop();
 
@@ -360,6 +1580,7 @@ private:
      * Gets a mapping of all currently registered serial devices.
      * The container maps between deviceIds and SerialDevicePointers.
      * ( deviceId -> SerialDevicePointer )
+     * Must only be accessed while holding serialDevicesMutex.
      *
      * @return Pointer to a mapping.
     */
@@ -369,6 +1590,7 @@ private:
      * Gets a mapping of all read loop states.
      * The container maps between deviceIds and a pair of atomic bools, which contain whether a loop is started/quitted.
      * ( deviceId -> <started, quitted> )
+     * Must only be accessed while holding readLoopStatesMutex.
      *
      * @return Pointer to a mapping.
     */
@@ -380,7 +1602,7 @@ private:
      * @param deviceId Device ID to search a device for.
      * @return SerialDevicePointer, or null if nothing found.
     */
-    SerialDevicePointer getSerialDeviceById( std::string deviceId );
+    SerialDevicePointer getSerialDeviceById( const std::string & deviceId );
 
     /**
      * Gets a serial device by its serial port.
@@ -394,15 +1616,17 @@ private:
      * Initialises the serial device (and retrieves the deviceId).
      *
      * @param serialDevice Serial device pointer -with all it's parameters- to initialise.
+     * @param cachedDeviceId Device ID taken from the identity cache; If given, the device doesn't get asked for its ID (and there's no waiting before).
      * @return Whether the serial device was successfully initialised or not.
     */
-    bool initSerialDevice( SerialDevicePointer serialDevice );
+    bool initSerialDevice( SerialDevicePointer serialDevice, std::string cachedDeviceId );
 
     /**
      * Loop for reading data from a serial device.
-     * In case there's a new line from the serial device, a detached thread gets spawned where "processMessage" gets executed.
+     * In case there's a new line from the serial device, it gets queued for the device's message worker, which executes "processMessage".
+     * If inbound queues are active, the line gets pushed onto the device's inbound queue instead, and the overflow policy applies.
      * In case there's an error occuring while reading from the device, a corresponding message gets logged and the device gets deleted.
-     * This loop gets solely called in a detached thread by the "startReadLoop" function.
+     * This loop gets solely called in a thread of the gateway by the "startReadLoop" function.
      *
      * @param deviceId Device ID we're running this readLoop for.
     */
@@ -416,12 +1640,37 @@ private:
     void startReadLoop( std::string deviceId );
 
     /**
-     * Stops a read loop for a specific deviceId.
+     * Stops a read loop for a specific deviceId; Interrupts the read, so the loop doesn't wait for the read timeout.
      *
      * @param deviceId Device ID of which we want to stop the read loop.
     */
     void stopReadLoop( std::string deviceId );
 
+    /**
+     * Loop for processing the messages of a device's inbound queue, one after another; The callbacks run in this thread as well.
+     * This loop gets solely called in a thread of the gateway by the "readLoop" function, and ends once the queue got closed and drained.
+     *
+     * @param deviceId Device ID the queue belongs to.
+     * @param inboundQueue Inbound queue of the device.
+     * @param deviceMetrics Metrics of the device.
+    */
+    void deliveryLoop( std::string deviceId, InboundQueuePointer inboundQueue, DeviceMetricsPointer deviceMetrics );
+
+    /**
+     * Creates the inbound queue of a device, and registers it, so it can be closed by "stopReadLoop".
+     *
+     * @param deviceId Device ID the queue belongs to.
+     * @return Pointer to the inbound queue.
+    */
+    InboundQueuePointer addInboundQueue( std::string deviceId );
+
+    /**
+     * Closes the inbound queue of a device (if there's one), and unregisters it.
+     *
+     * @param deviceId Device ID the queue belongs to.
+    */
+    void closeInboundQueue( std::string deviceId );
+
     /**
      * Stops the read loops of all devices.
     */
@@ -429,6 +1678,7 @@ private:
 
     /**
      * Sets the state of whether a specific device IDs' read loop is started.
+     * Only starting a read loop creates the state; Otherwise nothing happens if there's none.
      *
      * @param deviceId Device ID to set the read loop state for.
      * @param started Whether the read loop is started or not.
@@ -441,13 +1691,15 @@ private:
      * @param deviceId Device ID to check for.
      * @return Whether the read loop is started or not. Also returns false if the device ID was not found.
     */
-    bool isReadLoopStarted( std::string deviceId );
+    bool isReadLoopStarted( const std::string & deviceId );
 
     /**
      * Sets the state of whether a specific device IDs' read loop is quitted.
      *
+     * Nothing happens if there's no state for the device ID.
+     *
      * @param deviceId Device ID to set the read loop state for.
-     * @param started Whether the read loop is quitted or not. Also returns false if the device ID was not found.
+     * @param started Whether the read loop is quitted or not.
     */
     void setReadLoopQuitted( std::string deviceId, bool quitted );
 
@@ -459,6 +1711,14 @@ private:
     */
     bool isReadLoopQuitted( std::string deviceId );
 
+    /**
+     * Erases the read loop state of a device, once its read loop quitted and the device got deleted; Gets called after both, since either may happen last.
+     * Nothing happens as long as the read loop runs, or the device (or a new device with the same ID) is registered.
+     *
+     * @param deviceId Device ID to erase the read loop state for.
+    */
+    void eraseReadLoopState( std::string deviceId );
+
     /**
      * Retrieves a device ID for a device on a specific serial port.
      * If the device ID could be retrieved successfully, it gets set in the passed SerialDevice object's deviceId attribute.
@@ -468,6 +1728,57 @@ private:
     */
     bool retrieveDeviceId( SerialDevicePointer serialDevice );
 
+    /**
+     * Retrieves a device ID like "retrieveDeviceId", but without waiting for the device to boot first:
+     * The command to get the ID gets sent right away, and again on a backoff schedule until the device answers or the handshake deadline passed.
+     * If the device sends anything else meanwhile, it's up, and gets asked again right away. The second attempt is scheduled shortly before the
+     * typical boot delay of the device's hardware ID (if it's known), and the delay observed gets learned.
+     *
+     * @param serialDevice SerialDevicePointer to a SerialDevice object, which has no ID yet.
+     * @param openTime Point in time when the port got opened.
+     * @return Whether the ID could be retrieved or not.
+    */
+    bool retrieveDeviceIdAdaptively( SerialDevicePointer serialDevice, SteadyTimePoint openTime );
+
+    /**
+     * Applies the serial parameters declared for the ID of a device, if there are any; The port stays open.
+     * Throws one of the serial Library's exceptions if the port doesn't accept them.
+     *
+     * @param serialDevice SerialDevicePointer to a SerialDevice object, which has an ID and is initialized.
+    */
+    void applyDeviceSerialParameters( SerialDevicePointer serialDevice );
+
+    /**
+     * Reads lines from a device until a message of a type and content arrives, skipping any other lines (e.g. telemetry).
+     *
+     * @param serialInstance Transport of the device.
+     * @param type Type of the awaited message.
+     * @param content Content of the awaited message.
+     * @param timeout Time in ms to wait at most.
+     * @return Whether the message arrived.
+    */
+    bool awaitMessage( SerialDevice::SerialInstance serialInstance, std::string type, std::string content, unsigned int timeout );
+
+    /**
+     * Asks a device to switch to its escalation baud rate, if there's one above the current baud rate, and switches the port along (without closing it).
+     * The new rate gets confirmed by asking for the device ID again; If that fails, the port switches back, and the device is expected to fall back as well.
+     * Throws one of the serial Library's exceptions if the port doesn't accept the baud rate.
+     *
+     * @param serialDevice SerialDevicePointer to a SerialDevice object, which has an ID and is initialized.
+     * @return Whether the device runs at the escalation baud rate now.
+    */
+    bool escalateBaudRate( SerialDevicePointer serialDevice );
+
+    /**
+     * Reads the error counters of a device's port, counts their increase since the last read in the metrics, and logs it.
+     *
+     * @param deviceId Device ID of the device.
+     * @param serialInstance Transport of the device.
+     * @param lineErrors Counters of the last read; Get replaced by the current ones.
+     * @param deviceMetrics Metrics of the device.
+    */
+    void countLineErrors( std::string deviceId, SerialDevice::SerialInstance serialInstance, LineErrorCounters & lineErrors, DeviceMetricsPointer deviceMetrics );
+
     /**
      * Parses a message from a serial device into a StringPair containing the type and content.
      * ( type, content )
@@ -478,23 +1789,64 @@ private:
     */
     StringPair parseMessage( std::string message, std::string delimiter );
 
+    /**
+     * Parses a message from a serial device, like "parseMessage" above, into the given strings.
+     * They keep their capacity, so parsing into the same strings every time doesn't allocate once they have grown to the longest message.
+     *
+     * @param message Message to be parsed.
+     * @param delimiter Delimiter to use.
+     * @param type Gets replaced by the type of the message.
+     * @param content Gets replaced by the content of the message.
+    */
+    void parseMessage( const std::string & message, const std::string & delimiter, std::string & type, std::string & content );
+
     /**
      * Processes a message from a serial device.
-     * After parsing, the function calls the "messageCallback" in a detached thread, which can be redefined by inheriting classes.
+     * After parsing, the function hands the "messageCallback" over to the callback dispatcher, which can be redefined by inheriting classes.
+     * If there's a schema for the message's type, the fields get extracted and either "schemaMessageCallback" or "schemaMismatchCallback" gets called instead.
+     * Once the stop timeout passed while stopping, the message gets dropped instead.
      *
      * @param deviceId The device ID the message is coming from.
      * @param message The message to process.
+     * @param readTime Point in time when the message has been read.
+     * @param deviceMetrics Metrics of the device the message is coming from.
+     * @param traceContext Trace context of the message.
+    */
+    void processMessage( const std::string & deviceId, const std::string & message, SteadyTimePoint readTime, const DeviceMetricsPointer & deviceMetrics, TraceContext traceContext );
+
+    /**
+     * Runs one of the message callbacks, and records the time from reading the message until the callback started.
+     * This function gets solely called by the callback dispatcher, on behalf of the "processMessage" function.
+     *
+     * @param callbackType Which callback to run.
+     * @param deviceId The device ID the message is coming from.
+     * @param serialMessage Serial message to be handed over to the callback.
+     * @param schemaRecord Record containing the extracted field values. Only used for CallbackType::SCHEMA_MESSAGE.
+     * @param readTime Point in time when the message has been read.
+     * @param deviceMetrics Metrics of the device the message is coming from.
+     * @param traceContext Trace context of the message.
     */
-    void processMessage( std::string deviceId, std::string message );
+    void runMessageCallback( CallbackType callbackType, const std::string & deviceId, const SerialMessage & serialMessage, const SchemaRecord & schemaRecord, SteadyTimePoint readTime, const DeviceMetricsPointer & deviceMetrics, TraceContext traceContext );
 
     /**
      * Unlike "sendMessageToSerialDevice", this function takes over the sending of a message to a device.
-     * This function gets solely called in a detached thread by the "sendMessageToSerialDevice" function.
+     * This function gets solely called by a send worker, on behalf of the "sendMessageToSerialDevice" function.
      *
      * @param deviceId Device ID to send the message to.
      * @param message Message to send to the device.
+     * @param requestTime Point in time when the message has been handed over for sending.
+     * @param deviceMetrics Metrics of the device, or nullptr if the device is unknown.
+    */
+    void sendMessageToSerialDeviceBlocking( const std::string & deviceId, const std::string & message, SteadyTimePoint requestTime, const DeviceMetricsPointer & deviceMetrics );
+
+    /**
+     * Sends all messages buffered for a device, while it was absent, in a single write; Blocks until they're written.
+     * The caller must have started forwarding them (See "OutboundBuffer::startForwarding"); Until they're written, sends to the device get buffered behind them.
+     * If the write fails, the messages get restored to the buffer.
+     *
+     * @param deviceId Device ID to forward the buffered messages to.
     */
-    void sendMessageToSerialDeviceBlocking( std::string deviceId, std::string message );
+    void forwardOutboundMessages( std::string deviceId );
 
 protected:
     // Methods
@@ -512,6 +1864,30 @@ protected:
     */
     Logger * getLoggerInstance();
 
+    /**
+     * Gets the async logger instance.
+     *
+     * @return Pointer to the current async logger instance, or nullptr if async logging is not active.
+    */
+    AsyncLogger * getAsyncLoggerInstance();
+
+    /**
+     * Gets the structured logger instance, which writes either to the async logger or the logger instance.
+     * Use it together with the SPG_LOG_* macros, e.g.: SPG_LOG_INFO( getStructuredLoggerInstance(), "Something happened", logField( "deviceId", deviceId ) );
+     *
+     * @return Pointer to the current structured logger instance.
+    */
+    StructuredLogger * getStructuredLoggerInstance();
+
+    /**
+     * Gets the compiled schema of a message type.
+     * This can be used by inheriting classes for setting up SchemaColumnBuffers or looking up field indices.
+     *
+     * @param type Message type to get the schema for.
+     * @return Pointer to the schema, or nullptr if there's no schema for the type.
+    */
+    const MessageSchema * getMessageSchema( std::string type );
+
 public:
     // Constructors
     /**
@@ -526,7 +1902,7 @@ public:
 
     // Destructors
     /**
-     * Destructor.
+     * Destructor; Stops the gateway, and waits for every thread of the gateway, also those which were still running at the stop timeout.
     */
     ~SerialPortGateway();
 
@@ -578,8 +1954,21 @@ public:
 
     /**
      * Stops the gateway; stops the automatic scanning of new devices, and deletes all devices currently registered.
+     * Waits at most "STOP_TIMEOUT" (See "stop( std::chrono::milliseconds timeout )").
+     *
+     * @return How stopping went; What got dropped, and how many threads are still running.
+    */
+    StopReport stop();
+
+    /**
+     * Stops the gateway; stops the automatic scanning of new devices, and deletes all devices currently registered.
+     * The read loops get interrupted, and the messages read so far get processed, and their callbacks run, until the timeout passed;
+     * Whatever is left afterwards gets dropped. Returns once every thread of the gateway finished, or the timeout passed.
+     *
+     * @param timeout Time in ms.
+     * @return How stopping went; What got dropped, and how many threads are still running.
     */
-    void stop();
+    StopReport stop( std::chrono::milliseconds timeout );
 
     /**
      * Gets whether the gateway is started.
@@ -597,6 +1986,14 @@ public:
     */
     bool isEveryReadLoopQuitted();
 
+    /**
+     * Gets whether the devices got handed over to a successor, which means the gateway stopped serving them.
+     * A process can exit once this returns true.
+     *
+     * @return Whether the devices got handed over or not.
+    */
+    bool isHandedOver();
+
     /**
      * Gets all currently registered device IDs.
      *
@@ -639,14 +2036,37 @@ public:
     */
     std::string getDeviceIdToSerialPortMappingList();
 
+    /**
+     * Gets the ports which are quarantined, because probing them failed too often in a row.
+     *
+     * @return Records of the quarantined ports.
+    */
+    std::vector<ProbeRecord> getQuarantinedSerialPorts();
+
+    /**
+     * Gets a list of the quarantined ports (with their failed probes), separated by LIST_SEPARATOR.
+     *
+     * @return String list containing all quarantined ports.
+    */
+    std::string getQuarantinedSerialPortList();
+
+    /**
+     * Releases a port from quarantine, so the next scan probes it again.
+     *
+     * @param serialPort Serial port to be released.
+     * @return Whether the port was quarantined.
+    */
+    bool releaseQuarantinedSerialPort( std::string serialPort );
+
     /**
      * Sends a message to a specific device ID.
-     * This function calls "sendMessageToSerialDeviceBlocking" in a detached thread (making it async), which handles the main process of delivering messages to a device.
+     * This function queues the message for the device's send worker, which calls "sendMessageToSerialDeviceBlocking" (making it async); That handles the main process of delivering messages to a device.
+     * The messages to a device get sent in the order they were handed over. Only blocks while the worker's queue is full.
      *
      * @param deviceId Device ID to send the message to.
      * @param message Message to send to the device.
     */
-    void sendMessageToSerialDevice( std::string deviceId, std::string message );
+    void sendMessageToSerialDevice( const std::string & deviceId, const std::string & message );
 
     /**
      * Broadcasts a message to all registered serial devices.
@@ -655,6 +2075,66 @@ public:
     */
     void broadcastMessageToSerialDevices( std::string message );
 
+    /**
+     * Gets how many messages have failed to match their schema so far.
+     *
+     * @return Number of messages which didn't match their schema, over all message types.
+    */
+    unsigned long long getSchemaMismatchCount();
+
+    /**
+     * Gets how many log messages have been dropped by the async logger, because its buffer was full.
+     *
+     * @return Number of dropped log messages. Always 0 if async logging is not active.
+    */
+    unsigned long long getDroppedLogCount();
+
+    /**
+     * Gets a snapshot of the metrics of all devices the gateway has seen so far (including disconnected ones).
+     * Taking a snapshot sums up the per-thread counters, but doesn't block reading from or writing to any device.
+     *
+     * @return Snapshot of the gateway's metrics.
+    */
+    GatewayMetricsSnapshot getMetricsSnapshot();
+
+    /**
+     * Gets the stage tracer instance.
+     *
+     * @return Pointer to the stage tracer instance.
+    */
+    StageTracer * getStageTracerInstance();
+
+    /**
+     * Gets the event bus instance. Consumers register on it, and read every message, device added and device deleted event in place,
+     * at their own pace, instead of copying the messages inside "messageCallback"; The callbacks get called nonetheless.
+     *
+     * @return Pointer to the event bus instance, or nullptr if the event bus is not active ("EVENT_BUS_CAPACITY").
+    */
+    EventBus * getEventBusInstance();
+
+    /**
+     * Replaces the serial transport factory, e.g. with a LoopbackTransportFactory to run without any tty.
+     * The gateway takes ownership of the factory, and deletes the previous one. Throws Exception if the gateway is started, or devices are added.
+     *
+     * @param serialTransportFactory Pointer to the serial transport factory to be used.
+    */
+    void useSerialTransportFactory( SerialTransportFactory * serialTransportFactory );
+
+    /**
+     * Gets the serial transport factory instance.
+     *
+     * @return Pointer to the serial transport factory instance.
+    */
+    SerialTransportFactory * getSerialTransportFactoryInstance();
+
+    /**
+     * Exports the most recent trace events as Chrome trace-event JSON, which can be loaded into chrome://tracing or Perfetto.
+     * Every message shows up as a sequence of spans (one per pipeline stage), linked by their "id" argument.
+     *
+     * @return JSON document. Contains no events if tracing is not active.
+    */
+    std::string getTraceJson();
+
     /**
      * Callback which gets called when a new device got added.
      * This function can be redefined by inheriting classes.
@@ -680,6 +2160,23 @@ public:
      * @param serialMessage Serial message instance containing all data necessary for further processing.
     */
     virtual void messageCallback( SerialMessage serialMessage );
+
+    /**
+     * Callback which gets called when a new message arrives, which has a schema and matched it.
+     * This function can be redefined by inheriting classes. By default it hands the message over to "messageCallback".
+     *
+     * @param serialMessage Serial message instance containing all data necessary for further processing.
+     * @param schemaRecord Record containing the extracted field values.
+    */
+    virtual void schemaMessageCallback( SerialMessage serialMessage, SchemaRecord schemaRecord );
+
+    /**
+     * Callback which gets called when a new message arrives, which has a schema but didn't match it.
+     * This function can be redefined by inheriting classes.
+     *
+     * @param serialMessage Serial message instance containing all data necessary for further processing.
+    */
+    virtual void schemaMismatchCallback( SerialMessage serialMessage );
 };
 
 #endif // SERIALPORTGATEWAY_HPP
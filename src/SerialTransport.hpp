@@ -0,0 +1,214 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef SERIALTRANSPORT_HPP
+#define SERIALTRANSPORT_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <memory>
+
+// wjwwood's serial Library (https://github.com/wjwwood/serial)
+#include "serial/serial.h"
+
+#include "LatencyProfile.hpp"
+#include "SerialParameters.hpp"
+
+class SerialDevice;
+
+/**
+ * ResetControl enum
+ * Purpose: Lists how a transport treats the modem lines (DTR and RTS) of a port; Boards like the Arduino reset when DTR gets asserted, which happens whenever the port gets opened.
+*/
+enum class ResetControl
+{
+    RESET_ON_OPEN, // Default tty behaviour: DTR and RTS get asserted on open and dropped on close (HUPCL), so the device resets on every open
+    HOLD_LINES, // HUPCL gets cleared, so DTR and RTS stay asserted after closing; Only the first open after plugging the device in resets it
+    RELEASE_LINES // Like HOLD_LINES, but DTR and RTS get dropped right after opening; For boards which are held in reset (or their bootloader) while a line is asserted
+};
+
+/**
+ * LineErrorCounters struct
+ * Purpose: Holds the error counters the driver keeps for a port (TIOCGICOUNT); They count up from when the driver set the port up, so only their increase is meaningful.
+*/
+struct LineErrorCounters
+{
+    unsigned long long overruns; // Bytes lost, because the UART's FIFO wasn't emptied in time
+    unsigned long long bufferOverruns; // Bytes lost, because the tty's buffer was full; I.e. the gateway didn't read fast enough
+    unsigned long long framingErrors; // Usually a baud rate mismatch, or noise on the line
+    unsigned long long parityErrors;
+};
+
+/**
+ * SerialTransport class
+ * File: SerialTransport.hpp
+ * Purpose: Defines the interface the SerialPortGateway uses to talk to a single device, so the serial implementation can be exchanged;
+ *          E.g. wjwwood's serial Library (SerialLibraryTransport), or an in-process loopback without any tty (LoopbackTransport).
+ *          Errors get reported with the serial Library's exceptions (serial::SerialException, serial::IOException, serial::PortNotOpenedException),
+ *          so the gateway handles them the same way for every transport.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class SerialTransport
+{
+public:
+    // Destructors
+    /**
+     * Destructor.
+    */
+    virtual ~SerialTransport() {}
+
+    // Methods
+    /**
+     * Reads a line into a buffer; Blocks until a newline got read, or the read timeout passed.
+     * Reads "" once the transport got closed (e.g. by deleting the device), so a read loop notices its device is gone instead of getting an exception.
+     * The buffer keeps its capacity, so a read loop which passes the same buffer every time doesn't allocate once it has grown to the longest line.
+     *
+     * @param line Gets replaced by the line including the newline, or whatever got read until the timeout (possibly "").
+    */
+    virtual void readline( std::string & line ) = 0;
+
+    /**
+     * Reads a line, like "readline( line )", into a new string.
+     *
+     * @return The line including the newline, or whatever got read until the timeout (possibly "").
+    */
+    std::string readline()
+    {
+        std::string line;
+        readline( line );
+
+        return line;
+    }
+
+    /**
+     * Wakes up a read which is waiting for data, so it returns what it got so far (possibly ""), instead of waiting for the read timeout;
+     * If no read is waiting, the next one returns immediately. Used to stop the read loop without waiting for the timeout.
+    */
+    virtual void interruptRead() = 0;
+
+    /**
+     * Writes data to the device.
+     *
+     * @param data Data to be written.
+     * @return Number of bytes written.
+    */
+    virtual std::size_t write( const std::string & data ) = 0;
+
+    /**
+     * Flushes the input and output buffers.
+    */
+    virtual void flush() = 0;
+
+    /**
+     * Sets the timeouts for reading and writing; E.g. to wait shorter for an answer during the handshake.
+     *
+     * @param timeout Timeout information to be used from now on.
+    */
+    virtual void setTimeout( serial::Timeout timeout ) = 0;
+
+    /**
+     * Changes the line settings (baud rate, byte size, parity, stop bits and flow control) of the open transport; Without closing it, which would reset many boards.
+     * Throws one of the serial Library's exceptions if the port doesn't accept them.
+     *
+     * @param serialParameters Line settings to be used from now on; The escalation baud rate is ignored.
+    */
+    virtual void setLineSettings( const SerialParameters & serialParameters ) = 0;
+
+    /**
+     * Gets whether opening the transport reset the device, as far as the transport can tell; I.e. whether the modem lines were dropped while the port was closed.
+     *
+     * @return Whether the device (presumably) got reset, and needs time to boot.
+    */
+    virtual bool hasResetDevice() = 0;
+
+    /**
+     * Gets the latency settings in effect; Settings the port doesn't support (e.g. the serial flags of a pty) are left out.
+     *
+     * @return Latency profile in effect.
+    */
+    virtual LatencyProfile getLatencyProfile() = 0;
+
+    /**
+     * Gets the flow control in effect; Drivers which don't support the requested one (e.g. no RTS/CTS on many USB adapters) leave it off.
+     *
+     * @return Flow control in effect.
+    */
+    virtual serial::flowcontrol_t getFlowControl() = 0;
+
+    /**
+     * Reads the error counters the driver keeps for the port.
+     *
+     * @param counters Counters to read into.
+     * @return Whether the port reports them; False e.g. for ptys, and after the transport got closed.
+    */
+    virtual bool getLineErrorCounters( LineErrorCounters & counters ) = 0;
+
+    /**
+     * Closes the transport.
+    */
+    virtual void close() = 0;
+};
+
+/**
+ * SerialTransportFactory class
+ * File: SerialTransport.hpp
+ * Purpose: Defines the interface the SerialPortGateway uses to discover ports, and to open transports to them.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class SerialTransportFactory
+{
+public:
+    // Types
+    typedef std::shared_ptr<SerialTransport> SerialTransportPointer;
+
+    // Destructors
+    /**
+     * Destructor.
+    */
+    virtual ~SerialTransportFactory() {}
+
+    // Methods
+    /**
+     * Lists the available ports.
+     *
+     * @return Port information (port, description and hardware ID) for every available port.
+    */
+    virtual std::vector<serial::PortInfo> listPorts() = 0;
+
+    /**
+     * Checks whether a port exists and can be accessed.
+     *
+     * @param port Port to be checked.
+     * @return Whether the port exists and can be accessed.
+    */
+    virtual bool hasPort( std::string port ) = 0;
+
+    /**
+     * Opens a transport to the port of a serial device, using the device's settings (baud rate, timeout, byte size, parity, stop bits, flow control, reset control, latency profile).
+     * Throws one of the serial Library's exceptions if the port can't be opened.
+     *
+     * @param serialDevice Serial device to open the transport for.
+     * @return The opened transport.
+    */
+    virtual SerialTransportPointer openTransport( SerialDevice & serialDevice ) = 0;
+};
+
+#endif // SERIALTRANSPORT_HPP
@@ -0,0 +1,197 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "StageTracer.hpp"
+
+// C Standard Libraries
+#include <cstdio> // snprintf
+#include <cstring> // std::memcpy
+
+const std::size_t StageTracer::STAGE_COUNT;
+const std::size_t StageTracer::RING_COUNT;
+const std::size_t StageTracer::DEFAULT_RING_CAPACITY;
+const std::size_t StageTracer::MAX_DEVICE_ID_LENGTH;
+const char * const StageTracer::STAGE_NAMES[STAGE_COUNT] = { "readline", "process hand-off", "parse", "schema extraction", "callback hand-off", "callback" };
+
+StageTracer::StageTracer( bool active, std::size_t ringCapacity ) : active( active )
+{
+    this->nextId = 1;
+    this->ringCapacity = 0;
+
+    if ( !active )
+    {
+        return; // Nothing gets recorded, so nothing needs to be allocated
+    }
+
+    // Round up to a power of two, so the slot of a position can be determined by masking
+    this->ringCapacity = 2;
+
+    while ( this->ringCapacity < ringCapacity )
+    {
+        this->ringCapacity *= 2;
+    }
+
+    for ( Ring & ring : rings )
+    {
+        ring.writePosition = 0;
+        ring.events.reset( new TraceEvent[this->ringCapacity] );
+
+        for ( std::size_t position = 0; position < this->ringCapacity; position++ )
+        {
+            ring.events[position].sequence = 0;
+        }
+    }
+
+    stageLatencies.reset( new LatencyHistogram[STAGE_COUNT] );
+}
+
+StageTracer::Ring & StageTracer::getRing()
+{
+    // Threads get their ring assigned round-robin on first use; The read loops and workers are long-lived, so this spreads them evenly
+    static std::atomic<std::size_t> nextRing( 0 );
+    thread_local std::size_t ring = nextRing.fetch_add( 1, std::memory_order_relaxed ) & ( RING_COUNT - 1 );
+
+    return rings[ring];
+}
+
+void StageTracer::record( TraceContext & context, TracePoint tracePoint, const std::string & deviceId )
+{
+    unsigned long long timestamp = getTimestamp();
+
+    if ( tracePoint == TracePoint::READ_BEGIN )
+    {
+        context.lastTimestamp = timestamp;
+
+        return;
+    }
+
+    unsigned long long duration = timestamp - context.lastTimestamp;
+    std::size_t stage = static_cast<std::size_t>( tracePoint ) - 1;
+
+    stageLatencies[stage].record( duration / 1000 );
+
+    Ring & ring = getRing();
+    unsigned long long position = ring.writePosition.fetch_add( 1, std::memory_order_relaxed );
+    TraceEvent & event = ring.events[position & ( ringCapacity - 1 )];
+
+    // Invalidate the slot while it's being written, so the exporter doesn't pick up a half-written event
+    event.sequence.store( 0, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    event.id = context.id;
+    event.begin = context.lastTimestamp;
+    event.duration = duration;
+    event.tracePoint = tracePoint;
+
+    std::size_t deviceIdLength = deviceId.length() < MAX_DEVICE_ID_LENGTH ? deviceId.length() : MAX_DEVICE_ID_LENGTH;
+    std::memcpy( event.deviceId, deviceId.c_str(), deviceIdLength );
+    event.deviceId[deviceIdLength] = '\0';
+
+    event.sequence.store( position + 1, std::memory_order_release );
+
+    context.lastTimestamp = timestamp;
+}
+
+std::string StageTracer::exportChromeTrace() const
+{
+    std::string output = "{\"traceEvents\":[";
+    bool first = true;
+    char line[256];
+
+    for ( std::size_t ringIndex = 0; ringIndex < RING_COUNT && isActive(); ringIndex++ )
+    {
+        const Ring & ring = rings[ringIndex];
+        unsigned long long writePosition = ring.writePosition.load( std::memory_order_acquire );
+        unsigned long long position = writePosition > ringCapacity ? writePosition - ringCapacity : 0;
+
+        for ( ; position < writePosition; position++ )
+        {
+            const TraceEvent & event = ring.events[position & ( ringCapacity - 1 )];
+            unsigned long long sequence = event.sequence.load( std::memory_order_acquire );
+
+            unsigned long long id = event.id;
+            unsigned long long begin = event.begin;
+            unsigned long long duration = event.duration;
+            TracePoint tracePoint = event.tracePoint;
+            char deviceId[MAX_DEVICE_ID_LENGTH + 1];
+            std::memcpy( deviceId, event.deviceId, sizeof( deviceId ) );
+            deviceId[MAX_DEVICE_ID_LENGTH] = '\0';
+
+            std::atomic_thread_fence( std::memory_order_acquire );
+
+            // Skip events which are being written or have been overwritten meanwhile
+            if ( sequence != position + 1 || event.sequence.load( std::memory_order_relaxed ) != sequence )
+            {
+                continue;
+            }
+
+            std::string escapedDeviceId;
+
+            for ( const char * character = deviceId; *character != '\0'; character++ )
+            {
+                if ( *character == '"' || *character == '\\' )
+                {
+                    escapedDeviceId.push_back( '\\' );
+                }
+
+                if ( static_cast<unsigned char>( *character ) >= 0x20 )
+                {
+                    escapedDeviceId.push_back( *character );
+                }
+            }
+
+            // Timestamps and durations are in µs in the trace-event format; Every ring becomes a "thread" of its own
+            int length = snprintf( line, sizeof( line ), "%s{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%zu,\"args\":{\"id\":%llu,\"device\":\"",
+                first ? "" : ",", STAGE_NAMES[static_cast<std::size_t>( tracePoint ) - 1], begin / 1000.0, duration / 1000.0, ringIndex, id );
+
+            output.append( line, length );
+            output.append( escapedDeviceId );
+            output.append( "\"}}" );
+            first = false;
+        }
+    }
+
+    output.append( "],\"displayTimeUnit\":\"ms\"}" );
+
+    return output;
+}
+
+std::map<std::string, LatencyHistogramSnapshot> StageTracer::getStageLatencies() const
+{
+    std::map<std::string, LatencyHistogramSnapshot> stageLatencies;
+
+    if ( !isActive() )
+    {
+        return stageLatencies;
+    }
+
+    for ( std::size_t stage = 0; stage < STAGE_COUNT; stage++ )
+    {
+        this->stageLatencies[stage].addTo( stageLatencies[STAGE_NAMES[stage]] );
+    }
+
+    return stageLatencies;
+}
+
+std::string StageTracer::getStageName( TracePoint tracePoint )
+{
+    if ( tracePoint == TracePoint::READ_BEGIN )
+    {
+        return "";
+    }
+
+    return STAGE_NAMES[static_cast<std::size_t>( tracePoint ) - 1];
+}
@@ -0,0 +1,215 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef STAGETRACER_HPP
+#define STAGETRACER_HPP
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic
+#include <string>
+#include <map>
+#include <memory> // std::unique_ptr
+#include <chrono>
+
+#include "GatewayMetrics.hpp"
+
+/**
+ * TracePoint enum
+ * Purpose: Lists the tracepoints of the message pipeline, in the order a message passes them.
+ *          Every tracepoint (except READ_BEGIN) ends the stage which started at the previous one.
+*/
+enum class TracePoint : unsigned char
+{
+    READ_BEGIN, // "readline" is called
+    BYTES_READ, // "readline" returned a line; Stage: waiting in "readline" (kernel tty buffer & read timeout)
+    PROCESS_BEGIN, // "processMessage" starts; Stage: waiting for the message worker (or the delivery thread)
+    FRAMED, // Message got split into type & content; Stage: parsing
+    DISPATCHED, // Schema got applied, callback gets dispatched; Stage: schema extraction
+    CALLBACK_BEGIN, // Callback starts; Stage: dispatching the callback (or waiting on the isolated lane)
+    CALLBACK_END // Callback returned; Stage: callback
+};
+
+/**
+ * TraceContext struct
+ * Purpose: Travels with a message through the pipeline, and remembers when it passed the last tracepoint.
+*/
+struct TraceContext
+{
+    unsigned long long id; // Sequence number of the message, 0 if tracing is not active
+    unsigned long long lastTimestamp; // ns, steady clock
+};
+
+/**
+ * StageTracer class
+ * File: StageTracer.hpp
+ * Purpose: Defines an optional tracer, which attributes the latency of each message to the stages of the pipeline.
+ *          Every passed tracepoint records the stage it ends as a span into a ring buffer, and into a per-stage latency histogram.
+ *          The rings can be exported as Chrome trace-event JSON (chrome://tracing, Perfetto), the histograms as per-stage summary.
+ *          Threads write into one of several rings (picked once per thread), so they don't contend on a single write position;
+ *          Each ring keeps the most recent events and overwrites the oldest ones.
+ *          If tracing is not active, every tracepoint costs a single, always equally taken branch.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class StageTracer
+{
+public:
+    // Constants
+    static const std::size_t STAGE_COUNT = 6; // Tracepoints except READ_BEGIN
+    static const std::size_t RING_COUNT = 8; // Must be a power of two
+    static const std::size_t DEFAULT_RING_CAPACITY = 4096; // Events per ring
+    static const std::size_t MAX_DEVICE_ID_LENGTH = 31;
+
+private:
+    // Types
+    struct TraceEvent
+    {
+        std::atomic<unsigned long long> sequence; // Position + 1 once the event is completely written; Lets the exporter skip events being overwritten
+        unsigned long long id;
+        unsigned long long begin; // ns
+        unsigned long long duration; // ns
+        TracePoint tracePoint;
+        char deviceId[MAX_DEVICE_ID_LENGTH + 1];
+    };
+
+    struct Ring
+    {
+        std::atomic<unsigned long long> writePosition;
+        std::unique_ptr<TraceEvent[]> events;
+        char padding[64 - sizeof( std::atomic<unsigned long long> ) - sizeof( std::unique_ptr<TraceEvent[]> )]; // Keeps the write positions of different rings on different cache lines
+    };
+
+    // Constants
+    static const char * const STAGE_NAMES[STAGE_COUNT];
+
+    // Variables
+    const bool active;
+    std::size_t ringCapacity;
+    Ring rings[RING_COUNT];
+    std::unique_ptr<LatencyHistogram[]> stageLatencies; // One per stage
+    std::atomic<unsigned long long> nextId;
+
+    // Methods
+    /**
+     * Records the stage ending at a tracepoint. Only called if tracing is active.
+     *
+     * @param context Trace context of the message.
+     * @param tracePoint Tracepoint passed.
+     * @param deviceId Device ID the message is coming from.
+    */
+    void record( TraceContext & context, TracePoint tracePoint, const std::string & deviceId );
+
+    /**
+     * Gets the ring of the calling thread.
+     *
+     * @return Reference to the ring.
+    */
+    Ring & getRing();
+
+    /**
+     * Gets the current time of the steady clock.
+     *
+     * @return Time in ns.
+    */
+    static unsigned long long getTimestamp();
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param active Whether tracing is active. Can't be changed later on, which keeps the check at the tracepoints a constant branch.
+     * @param ringCapacity Number of events each ring keeps. Gets rounded up to a power of two.
+    */
+    StageTracer( bool active, std::size_t ringCapacity = DEFAULT_RING_CAPACITY );
+
+    // Methods
+    /**
+     * Gets whether tracing is active.
+     *
+     * @return Tracing active?
+    */
+    bool isActive() const;
+
+    /**
+     * Starts tracing a new message (at READ_BEGIN).
+     *
+     * @param context Trace context to be initialized.
+    */
+    void begin( TraceContext & context );
+
+    /**
+     * Marks that a message passed a tracepoint.
+     *
+     * @param context Trace context of the message.
+     * @param tracePoint Tracepoint passed.
+     * @param deviceId Device ID the message is coming from.
+    */
+    void mark( TraceContext & context, TracePoint tracePoint, const std::string & deviceId );
+
+    /**
+     * Exports the events currently held by the rings as Chrome trace-event JSON.
+     * Every span becomes a complete event ("ph":"X") named after its stage; "args" contain the message sequence number and device ID.
+     *
+     * @return JSON document.
+    */
+    std::string exportChromeTrace() const;
+
+    /**
+     * Takes a snapshot of the per-stage latency histograms.
+     *
+     * @return Mapping between stage names and histograms (µs). Empty if tracing is not active.
+    */
+    std::map<std::string, LatencyHistogramSnapshot> getStageLatencies() const;
+
+    /**
+     * Gets the name of the stage ending at a tracepoint.
+     *
+     * @param tracePoint Tracepoint (except READ_BEGIN).
+     * @return Stage name.
+    */
+    static std::string getStageName( TracePoint tracePoint );
+};
+
+inline bool StageTracer::isActive() const
+{
+    return this->active;
+}
+
+inline void StageTracer::begin( TraceContext & context )
+{
+    if ( active )
+    {
+        context.id = nextId.fetch_add( 1, std::memory_order_relaxed );
+        context.lastTimestamp = getTimestamp();
+    }
+}
+
+inline void StageTracer::mark( TraceContext & context, TracePoint tracePoint, const std::string & deviceId )
+{
+    if ( active )
+    {
+        record( context, tracePoint, deviceId );
+    }
+}
+
+inline unsigned long long StageTracer::getTimestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+#endif // STAGETRACER_HPP
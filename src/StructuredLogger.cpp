@@ -0,0 +1,149 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "StructuredLogger.hpp"
+
+// C++ Standard Libraries
+#include <stdexcept> // std::invalid_argument
+
+StructuredLogger::StructuredLogger( Logger * loggerInstance, AsyncLogger * asyncLoggerInstance, LogLevel level )
+{
+    if ( loggerInstance == nullptr )
+    {
+        throw std::invalid_argument( "Logger instance must not be null." );
+    }
+
+    this->loggerInstance = loggerInstance;
+    this->asyncLoggerInstance = asyncLoggerInstance;
+
+    setLevel( level );
+}
+
+void StructuredLogger::setLevel( LogLevel level )
+{
+    this->level = static_cast<int>( level );
+}
+
+LogLevel StructuredLogger::getLevel()
+{
+    return static_cast<LogLevel>( this->level.load() );
+}
+
+std::string & StructuredLogger::getFormatBuffer()
+{
+    thread_local std::string buffer;
+
+    return buffer;
+}
+
+void StructuredLogger::appendValue( std::string & buffer, const std::string & value )
+{
+    buffer.append( "\"" );
+    buffer.append( value );
+    buffer.append( "\"" );
+}
+
+void StructuredLogger::appendValue( std::string & buffer, const char * value )
+{
+    buffer.append( "\"" );
+    buffer.append( value );
+    buffer.append( "\"" );
+}
+
+void StructuredLogger::appendValue( std::string & buffer, bool value )
+{
+    buffer.append( value ? "true" : "false" );
+}
+
+void StructuredLogger::appendDigits( std::string & buffer, unsigned long long value )
+{
+    char digits[20];
+    std::size_t position = sizeof( digits );
+
+    do
+    {
+        digits[--position] = static_cast<char>( '0' + value % 10 );
+        value /= 10;
+    } while ( value > 0 );
+
+    buffer.append( digits + position, sizeof( digits ) - position );
+}
+
+void StructuredLogger::write( LogLevel level, const std::string & message )
+{
+    if ( asyncLoggerInstance != nullptr )
+    {
+        switch ( level )
+        {
+            case LogLevel::DEBUG:
+            case LogLevel::INFO:
+                asyncLoggerInstance->writeInfo( message );
+                break;
+            case LogLevel::WARN:
+                asyncLoggerInstance->writeWarn( message );
+                break;
+            case LogLevel::ERROR:
+                asyncLoggerInstance->writeError( message );
+                break;
+            case LogLevel::OFF:
+                break;
+        }
+    }
+    else
+    {
+        switch ( level )
+        {
+            case LogLevel::DEBUG:
+            case LogLevel::INFO:
+                loggerInstance->writeInfo( message );
+                break;
+            case LogLevel::WARN:
+                loggerInstance->writeWarn( message );
+                break;
+            case LogLevel::ERROR:
+                loggerInstance->writeError( message );
+                break;
+            case LogLevel::OFF:
+                break;
+        }
+    }
+}
+
+LogLevel StructuredLogger::parseLevel( std::string name )
+{
+    if ( name == "DEBUG" )
+    {
+        return LogLevel::DEBUG;
+    }
+    else if ( name == "INFO" )
+    {
+        return LogLevel::INFO;
+    }
+    else if ( name == "WARN" )
+    {
+        return LogLevel::WARN;
+    }
+    else if ( name == "ERROR" )
+    {
+        return LogLevel::ERROR;
+    }
+    else if ( name == "OFF" )
+    {
+        return LogLevel::OFF;
+    }
+
+    throw std::invalid_argument( "Unknown log level \"" + name + "\". (Allowed: DEBUG, INFO, WARN, ERROR, OFF)" );
+}
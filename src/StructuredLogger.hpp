@@ -0,0 +1,270 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef STRUCTUREDLOGGER_HPP
+#define STRUCTUREDLOGGER_HPP
+
+// C Standard Libraries
+#include <cstdio> // snprintf
+
+// C++ Standard Libraries
+#include <atomic> // std::atomic
+#include <string>
+#include <type_traits> // std::enable_if, std::is_integral, std::is_signed, std::is_floating_point
+
+#include "AsyncLogger.hpp"
+#include "../dependencies/Logger/src/Logger.hpp"
+
+// Minimum log level which gets compiled in at all (0 = DEBUG, 1 = INFO, 2 = WARN, 3 = ERROR, 4 = OFF).
+// Log calls below this level are removed entirely, including the evaluation of their arguments. (e.g. "-DSERIALPORTGATEWAY_LOG_MIN_LEVEL=2" for release builds)
+#ifndef SERIALPORTGATEWAY_LOG_MIN_LEVEL
+#define SERIALPORTGATEWAY_LOG_MIN_LEVEL 0
+#endif
+
+// Logs an event with typed fields. The level gets checked (at compile time and at runtime) before any argument is evaluated or formatted.
+// Usage: SPG_LOG_INFO( structuredLogger, "Delivered message", logField( "deviceId", deviceId ), logField( "bytesWritten", bytesWritten ) );
+#define SPG_LOG( structuredLogger, level, ... ) \
+    do \
+    { \
+        if ( static_cast<int>( level ) >= SERIALPORTGATEWAY_LOG_MIN_LEVEL && ( structuredLogger )->isEnabled( level ) ) \
+        { \
+            ( structuredLogger )->emit( level, __VA_ARGS__ ); \
+        } \
+    } while ( false )
+
+#define SPG_LOG_DEBUG( structuredLogger, ... ) SPG_LOG( structuredLogger, LogLevel::DEBUG, __VA_ARGS__ )
+#define SPG_LOG_INFO( structuredLogger, ... ) SPG_LOG( structuredLogger, LogLevel::INFO, __VA_ARGS__ )
+#define SPG_LOG_WARN( structuredLogger, ... ) SPG_LOG( structuredLogger, LogLevel::WARN, __VA_ARGS__ )
+#define SPG_LOG_ERROR( structuredLogger, ... ) SPG_LOG( structuredLogger, LogLevel::ERROR, __VA_ARGS__ )
+
+/**
+ * LogLevel enum
+ * Purpose: Lists all log levels, in ascending order of severity.
+*/
+enum class LogLevel : int
+{
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3,
+    OFF = 4
+};
+
+/**
+ * LogField struct
+ * Purpose: Captures a named log argument by reference, so it only gets formatted if the log event is actually emitted.
+*/
+template<typename T>
+struct LogField
+{
+    const char * key;
+    const T & value;
+};
+
+/**
+ * Captures a named log argument.
+ *
+ * @param key Name of the field.
+ * @param value Value of the field. Must outlive the log call.
+ * @return The captured field.
+*/
+template<typename T>
+LogField<T> logField( const char * key, const T & value )
+{
+    return LogField<T>{ key, value };
+}
+
+/**
+ * StructuredLogger class
+ * File: StructuredLogger.hpp
+ * Purpose: Defines a logging facade which emits events with typed fields (formatted as "<event>: key=value key=value ...").
+ *          Used together with the SPG_LOG_* macros, nothing gets built or formatted unless the event's level is enabled.
+ *          Emitted events are written either via the AsyncLogger (if given) or the Logger.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class StructuredLogger
+{
+private:
+    // Variables
+    std::atomic<int> level;
+    Logger * loggerInstance;
+    AsyncLogger * asyncLoggerInstance;
+
+    // Methods
+    /**
+     * Gets the thread-local buffer events are formatted into, so emitting doesn't need to allocate once the buffer has grown.
+     *
+     * @return Reference to the buffer.
+    */
+    static std::string & getFormatBuffer();
+
+    /**
+     * Appends a field's value to the buffer; Strings get quoted.
+    */
+    static void appendValue( std::string & buffer, const std::string & value );
+    static void appendValue( std::string & buffer, const char * value );
+    static void appendValue( std::string & buffer, bool value );
+
+    /**
+     * Appends the decimal digits of an unsigned value to the buffer (Cheaper than going through snprintf).
+     *
+     * @param buffer Buffer to append to.
+     * @param value Value to append.
+    */
+    static void appendDigits( std::string & buffer, unsigned long long value );
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type appendValue( std::string & buffer, T value );
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type appendValue( std::string & buffer, T value );
+
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type appendValue( std::string & buffer, T value );
+
+    /**
+     * Appends a field as " key=value" to the buffer.
+     *
+     * @param buffer Buffer to append to.
+     * @param field Field to append.
+    */
+    template<typename T>
+    static void appendField( std::string & buffer, const LogField<T> & field );
+
+    /**
+     * Writes a formatted event to the Logger or AsyncLogger.
+     *
+     * @param level Level of the event.
+     * @param message Formatted event.
+    */
+    void write( LogLevel level, const std::string & message );
+
+public:
+    // Constructors
+    /**
+     * Default constructor.
+     *
+     * @param loggerInstance Logger to write events to. Must not be null.
+     * @param asyncLoggerInstance AsyncLogger to write events to instead of the Logger, or nullptr.
+     * @param level Minimum level of events to be emitted.
+    */
+    StructuredLogger( Logger * loggerInstance, AsyncLogger * asyncLoggerInstance = nullptr, LogLevel level = LogLevel::INFO );
+
+    // Methods
+    /**
+     * Sets the minimum level of events to be emitted.
+     *
+     * @param level Minimum level.
+    */
+    void setLevel( LogLevel level );
+
+    /**
+     * Gets the minimum level of events to be emitted.
+     *
+     * @return Minimum level.
+    */
+    LogLevel getLevel();
+
+    /**
+     * Checks whether events of a specific level get emitted. This is all a disabled log call costs.
+     *
+     * @param level Level to check.
+     * @return Whether events of the level get emitted.
+    */
+    bool isEnabled( LogLevel level );
+
+    /**
+     * Formats and writes an event. Use the SPG_LOG_* macros instead of calling this directly, so the level gets checked first.
+     *
+     * @param level Level of the event.
+     * @param event Description of the event.
+     * @param fields Fields of the event, captured via "logField".
+    */
+    template<typename... Fields>
+    void emit( LogLevel level, const char * event, const Fields &... fields );
+
+    /**
+     * Parses a log level from its name (DEBUG, INFO, WARN, ERROR, OFF).
+     *
+     * @param name Name of the level.
+     * @return Log level. Throws std::invalid_argument if the name is unknown.
+    */
+    static LogLevel parseLevel( std::string name );
+};
+
+inline bool StructuredLogger::isEnabled( LogLevel level )
+{
+    return static_cast<int>( level ) >= this->level.load( std::memory_order_relaxed );
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type StructuredLogger::appendValue( std::string & buffer, T value )
+{
+    if ( value < 0 )
+    {
+        buffer.append( "-" );
+        appendDigits( buffer, 0ULL - static_cast<unsigned long long>( value ) );
+    }
+    else
+    {
+        appendDigits( buffer, static_cast<unsigned long long>( value ) );
+    }
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type StructuredLogger::appendValue( std::string & buffer, T value )
+{
+    appendDigits( buffer, static_cast<unsigned long long>( value ) );
+}
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type StructuredLogger::appendValue( std::string & buffer, T value )
+{
+    char formatted[32];
+    int length = snprintf( formatted, sizeof( formatted ), "%g", static_cast<double>( value ) );
+    buffer.append( formatted, length );
+}
+
+template<typename T>
+void StructuredLogger::appendField( std::string & buffer, const LogField<T> & field )
+{
+    buffer.append( " " );
+    buffer.append( field.key );
+    buffer.append( "=" );
+    appendValue( buffer, field.value );
+}
+
+template<typename... Fields>
+void StructuredLogger::emit( LogLevel level, const char * event, const Fields &... fields )
+{
+    std::string & buffer = getFormatBuffer();
+    buffer.assign( event );
+
+    if ( sizeof...( fields ) > 0 )
+    {
+        buffer.append( ":" );
+    }
+
+    // Expands to one appendField call per field, in order
+    int expansion[] = { 0, ( appendField( buffer, fields ), 0 )... };
+    ( void ) expansion;
+
+    write( level, buffer );
+}
+
+#endif // STRUCTUREDLOGGER_HPP
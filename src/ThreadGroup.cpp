@@ -0,0 +1,103 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ThreadGroup.hpp"
+
+thread_local const ThreadGroup * ThreadGroup::currentGroup = nullptr;
+
+ThreadGroup::~ThreadGroup()
+{
+    join();
+}
+
+void ThreadGroup::markFinished( ThreadList::iterator member )
+{
+    if ( member->stored && member->finished )
+    {
+        finishedThreads.push_back( member );
+        threadFinished.notify_all();
+    }
+}
+
+void ThreadGroup::takeFinished( std::vector<std::thread> & finished )
+{
+    for ( ThreadList::iterator member : finishedThreads )
+    {
+        finished.push_back( std::move( member->thread ) );
+        threads.erase( member );
+    }
+
+    finishedThreads.clear();
+}
+
+void ThreadGroup::joinFinished( std::vector<std::thread> & finished )
+{
+    // Their tasks returned, so joining only waits for the threads to exit
+    for ( std::thread & thread : finished )
+    {
+        thread.join();
+    }
+}
+
+void ThreadGroup::checkNotMember()
+{
+    if ( currentGroup == this )
+    {
+        throw std::logic_error( "A thread group can't be joined by one of its own threads." );
+    }
+}
+
+std::size_t ThreadGroup::join( SteadyTimePoint deadline )
+{
+    checkNotMember();
+
+    std::vector<std::thread> finished;
+    std::size_t running;
+
+    {
+        std::unique_lock<std::mutex> lock( mutex );
+        threadFinished.wait_until( lock, deadline, [this]() { return finishedThreads.size() == threads.size(); } );
+        takeFinished( finished );
+        running = threads.size();
+    }
+
+    joinFinished( finished );
+
+    return running;
+}
+
+void ThreadGroup::join()
+{
+    checkNotMember();
+
+    std::vector<std::thread> finished;
+
+    {
+        std::unique_lock<std::mutex> lock( mutex );
+        threadFinished.wait( lock, [this]() { return finishedThreads.size() == threads.size(); } );
+        takeFinished( finished );
+    }
+
+    joinFinished( finished );
+}
+
+std::size_t ThreadGroup::getSize()
+{
+    std::lock_guard<std::mutex> lock( mutex );
+
+    return threads.size() - finishedThreads.size();
+}
@@ -0,0 +1,206 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#ifndef THREADGROUP_HPP
+#define THREADGROUP_HPP
+
+// C++ Standard Libraries
+#include <list>
+#include <vector>
+#include <utility> // std::move
+#include <thread> // std::thread
+#include <mutex> // std::mutex, std::unique_lock
+#include <condition_variable> // std::condition_variable
+#include <chrono>
+#include <stdexcept> // std::logic_error
+
+/**
+ * ThreadGroup class
+ * File: ThreadGroup.hpp
+ * Purpose: Defines a group of threads, which can be joined all at once, instead of being detached; So whoever owns the group knows when none of them
+ *          touches it anymore. Every thread puts itself on a list once its task returned; Once a few piled up, the next spawn joins them
+ *          (outside the lock), so short-lived threads (e.g. one per message) don't pile up until the group gets joined. Joining them in batches
+ *          lets them exit first; Joining each one right away would make the spawning thread (e.g. a read loop) wait until it got scheduled again.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+class ThreadGroup
+{
+public:
+    // Types
+    typedef std::chrono::steady_clock::time_point SteadyTimePoint;
+
+private:
+    // Types
+    struct Member
+    {
+        std::thread thread;
+        bool stored; // The spawner put the thread on the list
+        bool finished; // The task returned
+    };
+
+    typedef std::list<Member> ThreadList;
+
+    // Constants
+    static const std::size_t JOIN_BATCH = 32; // Finished threads which pile up, until a spawn joins them
+
+    // Variables
+    static thread_local const ThreadGroup * currentGroup; // Group of the calling thread; nullptr if it doesn't belong to one
+    ThreadList threads; // Running threads, and finished ones which haven't been joined yet
+    std::vector<ThreadList::iterator> finishedThreads;
+    std::mutex mutex;
+    std::condition_variable threadFinished;
+
+    // Methods
+    /**
+     * Runs a task, and marks the thread it runs on as finished afterwards.
+     *
+     * @param task Task to be run.
+     * @param member Place of the thread on the list.
+    */
+    template<typename Task>
+    void run( Task task, ThreadList::iterator member );
+
+    /**
+     * Puts a member on the list of finished threads, once its thread got stored and its task returned. The mutex must be held.
+     *
+     * @param member Member of the group.
+    */
+    void markFinished( ThreadList::iterator member );
+
+    /**
+     * Takes the threads which are finished off the list, so they can be joined without holding the mutex. The mutex must be held.
+     *
+     * @param finished Gets the finished threads appended.
+    */
+    void takeFinished( std::vector<std::thread> & finished );
+
+    /**
+     * Joins threads which are finished.
+     *
+     * @param finished Threads to be joined.
+    */
+    static void joinFinished( std::vector<std::thread> & finished );
+
+    /**
+     * Throws std::logic_error if the calling thread belongs to the group; Joining would wait for itself, and never return.
+    */
+    void checkNotMember();
+
+public:
+    // Destructors
+    /**
+     * Destructor; Waits for every thread of the group. Must not run on a thread of the group (See "join"); It terminates the process then.
+    */
+    ~ThreadGroup();
+
+    // Methods
+    /**
+     * Runs a task on a new thread of the group. The task is a template parameter, so it's moved onto the thread as it is;
+     * Wrapping it in a std::function would cost another allocation per thread.
+     *
+     * @param task Task to be run, e.g. the result of std::bind.
+    */
+    template<typename Task>
+    void spawn( Task task );
+
+    /**
+     * Waits until every thread of the group finished, or the deadline passed; Threads which got spawned meanwhile are waited for as well.
+     * Must not be called by a thread of the group, since it would wait for itself; Throws std::logic_error instead of deadlocking then.
+     *
+     * @param deadline Point in time until which the threads are waited for.
+     * @return Number of threads still running.
+    */
+    std::size_t join( SteadyTimePoint deadline );
+
+    /**
+     * Waits until every thread of the group finished, however long it takes.
+     * Must not be called by a thread of the group, since it would wait for itself; Throws std::logic_error instead of deadlocking then.
+    */
+    void join();
+
+    /**
+     * Gets the number of threads still running.
+     *
+     * @return Number of threads.
+    */
+    std::size_t getSize();
+};
+
+template<typename Task>
+void ThreadGroup::run( Task task, ThreadList::iterator member )
+{
+    currentGroup = this;
+
+    task();
+
+    std::lock_guard<std::mutex> lock( mutex );
+    member->finished = true;
+    markFinished( member );
+}
+
+template<typename Task>
+void ThreadGroup::spawn( Task task )
+{
+    std::vector<std::thread> finished;
+    ThreadList::iterator member;
+
+    // The thread needs its place on the list before it starts, but gets started without holding the mutex;
+    // Otherwise the threads which finish meanwhile would queue up behind the spawner
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+
+        if ( finishedThreads.size() >= JOIN_BATCH )
+        {
+            takeFinished( finished );
+        }
+
+        member = threads.emplace( threads.end() );
+        member->stored = false;
+        member->finished = false;
+    }
+
+    std::thread thread;
+
+    try
+    {
+        thread = std::thread( &ThreadGroup::run<Task>, this, std::move( task ), member );
+    }
+    catch ( ... )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            threads.erase( member );
+        }
+
+        joinFinished( finished );
+
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        member->thread = std::move( thread );
+        member->stored = true;
+        markFinished( member ); // In case its task already returned
+    }
+
+    joinFinished( finished );
+}
+
+#endif // THREADGROUP_HPP
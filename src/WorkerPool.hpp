@@ -0,0 +1,272 @@
+/*
+    Copyright 2019 Jan-Eric Schober
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+// C++ Standard Libraries
+#include <string>
+#include <vector>
+#include <memory> // std::unique_ptr
+#include <utility> // std::swap
+#include <functional> // std::function, std::hash, std::bind
+#include <chrono>
+#include <mutex> // std::mutex, std::unique_lock
+#include <condition_variable> // std::condition_variable
+#include <stdexcept> // std::invalid_argument
+
+#include "ThreadGroup.hpp"
+
+/**
+ * WorkerPool class
+ * File: WorkerPool.hpp
+ * Purpose: Defines a fixed number of worker threads, which run the jobs of all devices; Instead of a thread per job, which costs a thread start
+ *          (and its allocations) every time, and lets the threads pile up without limit while the jobs are slow.
+ *          Every worker has a bounded queue of its own, and the jobs of a device always go to the same worker (chosen by the key), so they run in order.
+ *          While a worker's queue is full, submitting blocks. The queues are rings of jobs which get reused: A job gets filled in place, and swapped
+ *          with the worker's own job once it's run; So the jobs' strings keep their capacity, and once warmed up, submitting and running don't allocate.
+ *          The workers run until the pool gets destroyed; The destructor lets them run the queued jobs first, and waits for them.
+ *
+ * @author Jan-Eric Schober
+ * @version 1.0, 20.01.2019
+*/
+template<typename Job>
+class WorkerPool
+{
+public:
+    // Types
+    typedef std::function<void( Job & job )> Handler;
+    typedef std::chrono::steady_clock::time_point SteadyTimePoint;
+
+private:
+    // Types
+    struct Worker
+    {
+        std::vector<Job> jobs; // Ring of queued jobs
+        std::size_t head; // Oldest queued job
+        std::size_t size; // Number of queued jobs
+        bool busy; // Running a job
+        bool closed;
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::condition_variable idle; // Nothing queued, and not running a job
+    };
+
+    // Variables
+    Handler handler;
+    std::vector<std::unique_ptr<Worker>> workers;
+    ThreadGroup threads; // Last, so the workers are joined before anything they use gets destroyed
+
+    // Methods
+    /**
+     * Loop of a worker thread; Runs the worker's queued jobs, until the pool gets destroyed and the queue is drained.
+     *
+     * @param worker The worker.
+    */
+    void workLoop( Worker * worker );
+
+public:
+    // Constructors
+    /**
+     * Default constructor; Starts the worker threads.
+     *
+     * @param threadCount Number of worker threads.
+     * @param capacity Maximum number of queued jobs per worker.
+     * @param handler Runs a job; Called on the worker threads.
+    */
+    WorkerPool( unsigned int threadCount, std::size_t capacity, Handler handler );
+
+    WorkerPool( const WorkerPool & ) = delete;
+    WorkerPool & operator=( const WorkerPool & ) = delete;
+
+    // Destructors
+    /**
+     * Destructor; Lets the workers run the queued jobs, and waits for them. Must not be called by a worker (See ThreadGroup::join).
+    */
+    ~WorkerPool();
+
+    // Methods
+    /**
+     * Queues a job on the worker of the key. Blocks while the worker's queue is full.
+     * A worker must not submit to its own pool, since it would wait for itself while its queue is full.
+     *
+     * @param key Key whose jobs run in order, e.g. the device ID.
+     * @param fill Gets the queued job passed, to be filled in place; E.g. by assigning the strings, so they keep their capacity.
+     * @return Whether the job got queued; False if the pool is being destroyed.
+    */
+    template<typename Fill>
+    bool submit( const std::string & key, Fill fill );
+
+    /**
+     * Waits until every worker ran its queued jobs, or the deadline passed.
+     *
+     * @param deadline Point in time until which the workers are waited for.
+     * @return True if every worker is idle.
+    */
+    bool waitIdle( SteadyTimePoint deadline );
+
+    /**
+     * Gets the number of workers which are running a job, or have jobs queued.
+     *
+     * @return Number of workers.
+    */
+    std::size_t getBusyWorkers();
+};
+
+template<typename Job>
+WorkerPool<Job>::WorkerPool( unsigned int threadCount, std::size_t capacity, Handler handler )
+{
+    if ( threadCount == 0 )
+    {
+        throw std::invalid_argument( "Number of worker threads must be > 0." );
+    }
+
+    if ( capacity == 0 )
+    {
+        throw std::invalid_argument( "Worker queue capacity must be > 0." );
+    }
+
+    this->handler = handler;
+
+    for ( unsigned int index = 0; index < threadCount; index++ )
+    {
+        std::unique_ptr<Worker> worker( new Worker() );
+        worker->jobs.resize( capacity );
+        worker->head = 0;
+        worker->size = 0;
+        worker->busy = false;
+        worker->closed = false;
+        workers.push_back( std::move( worker ) );
+    }
+
+    for ( std::unique_ptr<Worker> const & worker : workers )
+    {
+        threads.spawn( std::bind( &WorkerPool::workLoop, this, worker.get() ) );
+    }
+}
+
+template<typename Job>
+WorkerPool<Job>::~WorkerPool()
+{
+    for ( std::unique_ptr<Worker> const & worker : workers )
+    {
+        {
+            std::lock_guard<std::mutex> lock( worker->mutex );
+            worker->closed = true;
+        }
+
+        worker->notEmpty.notify_all();
+        worker->notFull.notify_all();
+    }
+
+    threads.join();
+}
+
+template<typename Job>
+void WorkerPool<Job>::workLoop( Worker * worker )
+{
+    Job job;
+    std::unique_lock<std::mutex> lock( worker->mutex );
+
+    while ( true )
+    {
+        worker->notEmpty.wait( lock, [worker]() { return worker->closed || worker->size > 0; } );
+
+        if ( worker->size == 0 ) // Closed, and nothing left to run
+        {
+            return;
+        }
+
+        std::swap( job, worker->jobs[worker->head] ); // The slot gets the previous job, whose buffers the next job gets filled into
+        worker->head = ( worker->head + 1 ) % worker->jobs.size();
+        worker->size--;
+        worker->busy = true;
+
+        lock.unlock();
+        worker->notFull.notify_one();
+
+        handler( job );
+
+        lock.lock();
+        worker->busy = false;
+
+        if ( worker->size == 0 )
+        {
+            worker->idle.notify_all();
+        }
+    }
+}
+
+template<typename Job>
+template<typename Fill>
+bool WorkerPool<Job>::submit( const std::string & key, Fill fill )
+{
+    Worker * worker = workers[std::hash<std::string>()( key ) % workers.size()].get();
+
+    {
+        std::unique_lock<std::mutex> lock( worker->mutex );
+        worker->notFull.wait( lock, [worker]() { return worker->closed || worker->size < worker->jobs.size(); } );
+
+        if ( worker->closed )
+        {
+            return false;
+        }
+
+        fill( worker->jobs[( worker->head + worker->size ) % worker->jobs.size()] );
+        worker->size++;
+    }
+
+    worker->notEmpty.notify_one();
+
+    return true;
+}
+
+template<typename Job>
+bool WorkerPool<Job>::waitIdle( SteadyTimePoint deadline )
+{
+    for ( std::unique_ptr<Worker> const & worker : workers )
+    {
+        std::unique_lock<std::mutex> lock( worker->mutex );
+
+        if ( !worker->idle.wait_until( lock, deadline, [&worker]() { return worker->size == 0 && !worker->busy; } ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename Job>
+std::size_t WorkerPool<Job>::getBusyWorkers()
+{
+    std::size_t busyWorkers = 0;
+
+    for ( std::unique_ptr<Worker> const & worker : workers )
+    {
+        std::lock_guard<std::mutex> lock( worker->mutex );
+
+        if ( worker->busy || worker->size > 0 )
+        {
+            busyWorkers++;
+        }
+    }
+
+    return busyWorkers;
+}
+
+#endif // WORKERPOOL_HPP
@@ -23,6 +23,7 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <fstream>
 #include <stdexcept>
 #include <thread>
 
@@ -49,6 +50,9 @@ const std::string COMMAND_ADDDEVICE = "a";
 const std::string COMMAND_ADDNEWDEVICES = "an";
 const std::string COMMAND_DELETEDEVICE = "d";
 const std::string COMMAND_DELETEALLDEVICES = "da";
+const std::string COMMAND_TRACE = "t";
+const std::string COMMAND_LISTQUARANTINE = "lq";
+const std::string COMMAND_RELEASEQUARANTINE = "rq";
 const std::string COMMAND_QUIT = "q";
 
 // Variables
@@ -71,6 +75,9 @@ void printUsage()
         << "\t" << COMMAND_ADDNEWDEVICES << ": Adds all new devices." << std::endl
         << "\t" << COMMAND_DELETEDEVICE << ": Deletes a device." << std::endl
         << "\t" << COMMAND_DELETEALLDEVICES << ": Deletes all devices." << std::endl
+        << "\t" << COMMAND_TRACE << ": Writes the recent stage trace to a file, and prints the per-stage latencies." << std::endl
+        << "\t" << COMMAND_LISTQUARANTINE << ": Lists all quarantined serial ports." << std::endl
+        << "\t" << COMMAND_RELEASEQUARANTINE << ": Releases a serial port from quarantine." << std::endl
         << "\t" << COMMAND_QUIT << ": Quit the gateway." << std::endl;
 }
 
@@ -165,6 +172,56 @@ void deleteAllDevices()
     gateway->deleteAllSerialDevices();
 }
 
+/**
+ * Writes the recent stage trace (Chrome trace-event JSON) to a file, and prints the latency percentiles of every stage.
+*/
+void writeTrace()
+{
+    if ( !gateway->getStageTracerInstance()->isActive() )
+    {
+        std::cout << "Tracing is not active. (Set TRACING_ACTIVE in the config file.)" << std::endl;
+
+        return;
+    }
+
+    std::string file;
+    std::cout << "-> Enter file: " << std::endl;
+    std::getline( std::cin, file );
+
+    std::ofstream output( file );
+    output << gateway->getTraceJson();
+
+    if ( !output )
+    {
+        std::cout << "Couldn't write \"" + file + "\"." << std::endl;
+    }
+
+    for ( std::pair<const std::string, LatencyHistogramSnapshot> const & entry : gateway->getMetricsSnapshot().stageLatencies )
+    {
+        std::cout << entry.first << ": p50 " << entry.second.getPercentile( 50 ) << " us, p99 " << entry.second.getPercentile( 99 ) << " us, max " << entry.second.getMax() << " us" << std::endl;
+    }
+}
+
+/**
+ * Lists all serial ports which the scan skips, because probing them failed too often in a row.
+*/
+void listQuarantinedSerialPorts()
+{
+    std::cout << gateway->getQuarantinedSerialPortList() << std::endl;
+}
+
+/**
+ * Releases a serial port from quarantine, so the next scan probes it again.
+*/
+void releaseQuarantinedSerialPort()
+{
+    std::string serialPort;
+    std::cout << "-> Enter serial port: " << std::endl;
+    std::getline( std::cin, serialPort );
+
+    gateway->releaseQuarantinedSerialPort( serialPort );
+}
+
 /**
  * Stops the SerialPortGateway gracefully.
  *
@@ -175,15 +232,17 @@ void stopGateway( int param )
     std::cout << std::endl << "Stopping Gateway..." << std::endl;
 
     gatewayStarted = false;
-    gateway->stop();
 
-    // This loop waits for the all read loops being gracefully quit, before exiting the application
-    while( !gateway->isEveryReadLoopQuitted() )
+    // Returns once the read loops quit and the queued messages got processed, or "STOP_TIMEOUT" passed
+    StopReport stopReport = gateway->stop();
+
+    if ( !stopReport.complete )
     {
-        std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
+        std::cout << "Gateway didn't stop within the stop timeout: " << stopReport.inboundDropped << " messages and " << stopReport.callbacksDropped << " callbacks dropped, "
+                  << stopReport.threadsRunning << " threads still running." << std::endl;
     }
 
-    std::cout << "Gateway stopped." << std::endl;
+    std::cout << "Gateway stopped (" << stopReport.elapsed << " ms)." << std::endl;
     exit( 0 );
 }
 
@@ -242,6 +301,18 @@ void fetchCommandsLoop()
         {
             deleteAllDevices();
         }
+        else if ( command == COMMAND_TRACE )
+        {
+            writeTrace();
+        }
+        else if ( command == COMMAND_LISTQUARANTINE )
+        {
+            listQuarantinedSerialPorts();
+        }
+        else if ( command == COMMAND_RELEASEQUARANTINE )
+        {
+            releaseQuarantinedSerialPort();
+        }
         else if ( command == COMMAND_QUIT )
         {
             stopGateway( 0 );
@@ -283,10 +354,17 @@ int main( int argc, char* argv[] )
         std::cout << "Gateway started." << std::endl;
 	    std::cout << "CTRL+C to exit." << std::endl;
 
-        // Infinite Loop
-        while ( gatewayStarted )
+        // Infinite Loop; Ends once a successor took the devices over (See "HANDOVER_SOCKET")
+        while ( gatewayStarted && !gateway->isHandedOver() )
         {
-            std::this_thread::sleep_for( std::chrono::seconds( 10 ) );
+            std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
+        }
+
+        if ( gateway->isHandedOver() )
+        {
+            std::cout << "Devices handed over, exiting." << std::endl;
+
+            return 0;
         }
     }
         catch ( ConfigMalformedException & e )